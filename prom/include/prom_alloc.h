@@ -25,6 +25,8 @@ limitations under the License.
 #include <stdlib.h>
 #include <string.h>
 
+#include "prom_pool.h"
+
 /**
  * @brief Redefine this macro if you wish to override it. The default value is malloc.
  */
@@ -45,4 +47,28 @@ limitations under the License.
  */
 #define prom_free free
 
+/**
+ * @brief Allocates the small objects created for every series, such as samples and list nodes. Redefine this macro if
+ * you wish to override it, together with prom_object_free. The default value is prom_pool_malloc.
+ */
+#define prom_object_malloc prom_pool_malloc
+
+/**
+ * @brief Frees memory from prom_object_malloc, given the size it was allocated with. Redefine this macro if you wish to
+ * override it, e.g. as free(ptr) when prom_object_malloc is malloc. The default value is prom_pool_free.
+ */
+#define prom_object_free prom_pool_free
+
+/**
+ * @brief Copies a key of a map, such as the label set of a series. Redefine this macro if you wish to override it,
+ * together with prom_key_free. The default value is prom_pool_strdup.
+ */
+#define prom_key_dup prom_pool_strdup
+
+/**
+ * @brief Frees a key from prom_key_dup. Redefine this macro if you wish to override it, e.g. as free((void *)key) when
+ * prom_key_dup is strdup. The default value is prom_pool_strfree.
+ */
+#define prom_key_free prom_pool_strfree
+
 #endif  // PROM_ALLOC_H
@@ -44,7 +44,7 @@ typedef prom_map_t *prom_collect_fn(prom_collector_t *self);
 
 /**
  * @brief Create a collector
- * @param name The name of the collector. The name MUST NOT be default or process.
+ * @param name The name of the collector. The name MUST NOT be default, process or self.
  * @return The constructed prom_collector_t*
  */
 prom_collector_t *prom_collector_new(const char *name);
@@ -22,6 +22,9 @@ limitations under the License.
 #ifndef PROM_REGISTRY_H
 #define PROM_REGISTRY_H
 
+#include <stdbool.h>
+#include <sys/types.h>
+
 #include "prom_collector.h"
 #include "prom_metric.h"
 
@@ -30,6 +33,30 @@ limitations under the License.
  */
 typedef struct prom_collector_registry prom_collector_registry_t;
 
+/**
+ * @brief A prom_collector_registry_stream_t renders the exposition of a registry piece by piece
+ */
+typedef struct prom_collector_registry_stream prom_collector_registry_stream_t;
+
+/**
+ * @brief Exposition formats a prom_collector_registry_stream_t can produce
+ *
+ * Reference: https://prometheus.io/docs/instrumenting/exposition_formats/
+ */
+typedef enum prom_exposition_format {
+  PROM_EXPOSITION_TEXT = 0, /**< text/plain; version=0.0.4 */
+  PROM_EXPOSITION_PROTOBUF, /**< io.prometheus.client.MetricFamily messages, each preceded by its varint length */
+} prom_exposition_format_t;
+
+/**
+ * @brief Decides whether a filtered stream renders a metric
+ *
+ * @param metric_name The name of the metric
+ * @param data The data the stream was created with
+ * @return true to render the metric, false to leave it out
+ */
+typedef bool prom_collector_registry_filter_fn(const char *metric_name, void *data);
+
 /**
  * @brief Initialize the default registry by calling prom_collector_registry_init within your program. You MUST NOT
  * modify this value.
@@ -69,6 +96,21 @@ int prom_collector_registry_destroy(prom_collector_registry_t *self);
  */
 int prom_collector_registry_enable_process_metrics(prom_collector_registry_t *self);
 
+/**
+ * @brief Enable self metrics on the given collector registry.
+ *
+ * A collector named "self" then reports, on every scrape:
+ * * prom_series: the live series of all metrics together
+ * * prom_metric_series, prom_metric_memory_bytes and prom_metric_dropped_samples_total: the series count, approximate
+ *   heap memory and samples dropped by the series cap of every metric, labelled by collector and metric
+ * * prom_collector_memory_bytes: the approximate heap memory of every collector with its metrics
+ *
+ * Its cost grows with the series count, since the memory of every series is added up on each scrape.
+ * @param self The target prom_collector_registry_t*
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_enable_self_metrics(prom_collector_registry_t *self);
+
 /**
  * @brief Registers a metric with the default collector on PROM_DEFAULT_COLLECTOR_REGISTRY
  *
@@ -112,6 +154,111 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
  */
 const char *prom_collector_registry_bridge(prom_collector_registry_t *self);
 
+// Size of the buffer prom_collector_registry_delta writes its token to
+#define PROM_COLLECTOR_REGISTRY_DELTA_TOKEN_SIZE 40
+
+/**
+ * @brief Returns the text exposition of what changed since an earlier delta scrape, as a string that MUST be freed.
+ *
+ * Every call is a delta scrape of a new generation and sets token to name it. Passing that token as since to a later
+ * call returns only:
+ * * the series whose value changed in between, each metric with its HELP and TYPE lines
+ * * a "# TOMBSTONE <series>" line, after the HELP and TYPE lines of its metric, for every series removed in between
+ * * every series, after a "# RESET <metric>" line, of a metric that dropped tombstones the token needs or was cleared;
+ *   the client replaces all the series of such a metric
+ * Metrics with nothing to report are left out, so the exposition is empty when nothing changed.
+ *
+ * A NULL token, or one this registry did not hand out, e.g. one from before a restart, gets a full exposition and
+ * *full set to true; the client then replaces everything it holds.
+ *
+ * Changes are found by comparing every series with what the previous delta scrape of any client found, so a value
+ * that changes and changes back in between is not reported. Series are read live, including those of metrics updated
+ * in cycles, and a metric unregistered in between is not reported.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param since The token of the client's previous delta scrape, or NULL
+ * @param filter_fn The filter, or NULL to include every metric. See prom_collector_registry_stream_new_filtered.
+ * @param data Passed to filter_fn
+ * @param token Set to the token of this scrape. Room for PROM_COLLECTOR_REGISTRY_DELTA_TOKEN_SIZE bytes.
+ * @param full If not NULL, set to whether the exposition is a full one
+ * @return The exposition, or NULL upon failure
+ */
+const char *prom_collector_registry_delta(prom_collector_registry_t *self, const char *since,
+                                          prom_collector_registry_filter_fn *filter_fn, void *data, char *token,
+                                          bool *full);
+
+/**
+ * @brief Returns a stream producing the same exposition as prom_collector_registry_bridge, rendered a few metrics at a
+ * time as it is read. Memory use is bounded by the largest metric instead of the whole exposition.
+ *
+ * The registry MUST outlive the stream.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @return The prom_collector_registry_stream_t*, or NULL upon failure.
+ */
+prom_collector_registry_stream_t *prom_collector_registry_stream_new(prom_collector_registry_t *self);
+
+/**
+ * @brief Returns a stream like prom_collector_registry_stream_new, producing the exposition in the given format.
+ *
+ * Metrics without samples are left out of the protobuf exposition. Committed snapshots carry the protobuf form from
+ * the commit after the first protobuf stream is created; until then such metrics are rendered from their live samples.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param format The exposition format
+ * @return The prom_collector_registry_stream_t*, or NULL upon failure.
+ */
+prom_collector_registry_stream_t *prom_collector_registry_stream_new_format(prom_collector_registry_t *self,
+                                                                            prom_exposition_format_t format);
+
+/**
+ * @brief Returns a stream like prom_collector_registry_stream_new_format that renders only the metrics filter_fn
+ * accepts.
+ *
+ * Metrics that are left out cost no rendering, and a collector none of whose registered metrics is accepted is not
+ * collected at all, so a stream of a few metric families costs a fraction of a full one.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param format The exposition format
+ * @param filter_fn The filter, or NULL to render every metric
+ * @param data Passed to filter_fn, and MUST outlive the stream
+ * @return The prom_collector_registry_stream_t*, or NULL upon failure.
+ */
+prom_collector_registry_stream_t *prom_collector_registry_stream_new_filtered(
+    prom_collector_registry_t *self, prom_exposition_format_t format, prom_collector_registry_filter_fn *filter_fn,
+    void *data);
+
+/**
+ * @brief Returns the next piece of the exposition without copying it. A piece is either the committed snapshot of one
+ * metric or a run of live metrics rendered by the stream. Concatenating the pieces gives the whole exposition.
+ *
+ * Do not mix with prom_collector_registry_stream_read on the same stream.
+ *
+ * @param self The target prom_collector_registry_stream_t*
+ * @param text Set to the text of the piece, valid until the next call. Binary for PROM_EXPOSITION_PROTOBUF.
+ * @param len Set to the length of text
+ * @param snapshot If not NULL, set to the snapshot the piece comes from, or NULL for live text. Encodings of an
+ *                 unchanged snapshot can be cached on it with prom_metric_snapshot_set_encoded.
+ * @return 1 if a piece was returned, 0 once the exposition is complete, or -1 upon failure.
+ */
+int prom_collector_registry_stream_next(prom_collector_registry_stream_t *self, const char **text, size_t *len,
+                                        prom_metric_snapshot_t **snapshot);
+
+/**
+ * @brief Copies up to max bytes of the exposition into buf.
+ * @param self The target prom_collector_registry_stream_t*
+ * @param buf The destination buffer
+ * @param max The size of buf
+ * @return The number of bytes copied, 0 once the exposition is complete, or -1 upon failure.
+ */
+ssize_t prom_collector_registry_stream_read(prom_collector_registry_stream_t *self, char *buf, size_t max);
+
+/**
+ * @brief Destroys a prom_collector_registry_stream_t*. The stream may be destroyed before it is complete.
+ * @param self The target prom_collector_registry_stream_t*
+ */
+void prom_collector_registry_stream_destroy(prom_collector_registry_stream_t *self);
+
 /**
  *@brief Validates that the given metric name complies with the specification:
  *
@@ -152,6 +152,24 @@ int prom_gauge_sub(prom_gauge_t *self, double r_value, const char **label_values
  */
 int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values);
 
+/**
+ * @brief Returns a handle to the series of the prom_gauge_t* with the given label values, creating it if needed.
+ *
+ * Resolving the labels happens once here. Afterwards the series can be updated through prom_metric_sample_set and
+ * prom_metric_sample_add and prom_metric_sample_sub, each a single atomic operation with no lookup and no lock. The handle must be
+ * released with prom_metric_sample_release when the series goes away.
+ * @param self The target prom_gauge_t*
+ * @param label_values The label values of the series. Pass NULL if the gauge has no labels.
+ * @return The prom_metric_sample_t* handle, or NULL upon failure.
+ *
+ * *Example*
+ *
+ *     prom_metric_sample_t *child = prom_gauge_child(foo_gauge, (const char*[]) { "bar", "bang" });
+ *     prom_metric_sample_set(child, 22);
+ *     prom_metric_sample_release(child);
+ */
+prom_metric_sample_t *prom_gauge_child(prom_gauge_t *self, const char **label_values);
+
 /**
  * @brief remove the prom_gauge_t* with specified labels
  * @param self The target prom_gauge_t*
@@ -166,4 +184,22 @@ int prom_gauge_remove(prom_gauge_t *self, const char **label_values);
 */
 int prom_gauge_clear(prom_gauge_t *self);
 
+/**
+ * @brief Start an update cycle of the prom_gauge_t*. Every series set, incremented, decremented, added to or subtracted from before the matching
+ *        prom_gauge_end_update is kept, the others are removed by it.
+ *
+ * Use this pair instead of prom_gauge_clear when re-populating the gauge on every update: existing series are reused
+ * in place, so a steady-state update allocates nothing and a concurrent scrape never sees series missing.
+ * @param self The target prom_gauge_t*
+ * @return A non-zero integer value upon failure.
+ */
+int prom_gauge_begin_update(prom_gauge_t *self);
+
+/**
+ * @brief Finish the update cycle started by prom_gauge_begin_update, removing the series not updated since.
+ * @param self The target prom_gauge_t*
+ * @return A non-zero integer value upon failure.
+ */
+int prom_gauge_end_update(prom_gauge_t *self);
+
 #endif  // PROM_GAUGE_H
@@ -60,6 +60,35 @@ typedef prom_metric_t prom_histogram_t;
 prom_histogram_t *prom_histogram_new(const char *name, const char *help, prom_histogram_buckets_t *buckets,
                                      size_t label_key_count, const char **label_keys);
 
+/**
+ * @brief Construct a prom_histogram_t* with sparse exponential buckets instead of explicit bounds.
+ *
+ * Bucket boundaries are the powers of 2^(2^-schema): schema 0 doubles from one bucket to the next, schema 3 grows by
+ * about 9% and schema 8 by 0.27%. Values of either sign are counted; those within about 1e-38 of zero share a zero
+ * bucket. Buckets are allocated as values reach them, in one compact array per sign, so the range need not be known.
+ * When the buckets in use would exceed max_buckets, the resolution is halved by merging neighbours, down to schema -4.
+ * Observing takes the series lock, as the buckets may grow.
+ *
+ * The text exposition shows the populated buckets as classic le buckets. The protobuf exposition carries them as a
+ * native histogram, which Prometheus stores at full resolution.
+ * @param name The name of the metric
+ * @param help The metric description
+ * @param schema The initial resolution, from -4 to 8
+ * @param max_buckets The most buckets a series keeps. Pass 0 for 160.
+ * @param label_key_count is the number of labels associated with the given metric. Pass 0 if the metric does not
+ *                        require labels.
+ * @param label_keys A collection of label keys. The number of keys MUST match the value passed as label_key_count. If
+ *                   no labels are required, pass NULL.
+ * @return The constructed prom_histogram_t*, or NULL upon failure.
+ *
+ * *Example*
+ *
+ *     // Buckets growing by 9% from nanoseconds to hours, in at most 160 buckets
+ *     prom_histogram_new_sparse("foo_seconds", "foo is a sparse histogram", 3, 0, 0, NULL);
+ */
+prom_histogram_t *prom_histogram_new_sparse(const char *name, const char *help, int schema, size_t max_buckets,
+                                            size_t label_key_count, const char **label_keys);
+
 /**
  * @brief Destroy a prom_histogram_t*. self MUSTS be set to NULL after destruction. Returns a non-zero integer value
  *        upon failure.
@@ -78,4 +107,69 @@ int prom_histogram_destroy(prom_histogram_t *self);
  */
 int prom_histogram_observe(prom_histogram_t *self, double value, const char **label_values);
 
+/**
+ * @brief Overwrite the prom_histogram_t sample identified by the labels with externally aggregated data. Useful when
+ *        the observations are already bucketed by the producer and only need to be exported. Sparse histograms do
+ *        not support it.
+ * @param self The target prom_histogram_t*
+ * @param bucket_counts The per-bucket (non-cumulative) observation counts. The array MUST hold one entry per bucket
+ *                      upper bound followed by one entry for observations above the last bound (+Inf).
+ * @param sum The sum of all observed values
+ * @param label_values The label values associated with the metric sample being updated. The number of labels must
+ *                     match the value passed to label_key_count in the histogram's constructor. If no label values
+ *                     are necessary, pass NULL. Otherwise, It may be convenient to pass this value as a literal.
+ * @return Non-zero value upon failure
+ */
+int prom_histogram_set(prom_histogram_t *self, const double *bucket_counts, double sum, const char **label_values);
+
+/**
+ * @brief Returns a handle to the series of the prom_histogram_t* with the given label values, creating it if needed.
+ *
+ * Resolving the labels happens once here. Afterwards observations go straight to prom_metric_sample_histogram_observe,
+ * which takes no lock. Use it on per-event paths. The handle must be released with
+ * prom_metric_sample_histogram_release when the series goes away.
+ * @param self The target prom_histogram_t*
+ * @param label_values The label values of the series. Pass NULL if the histogram has no labels.
+ * @return The prom_metric_sample_histogram_t* handle, or NULL upon failure.
+ *
+ * *Example*
+ *
+ *     prom_metric_sample_histogram_t *child = prom_histogram_child(foo_histogram, (const char*[]) { "bar" });
+ *     prom_metric_sample_histogram_observe(child, 0.25);
+ *     prom_metric_sample_histogram_release(child);
+ */
+prom_metric_sample_histogram_t *prom_histogram_child(prom_histogram_t *self, const char **label_values);
+
+/**
+ * @brief remove the prom_histogram_t* with specified labels
+ * @param self The target prom_histogram_t*
+ * @return A non-zero integer value upon failure.
+*/
+int prom_histogram_remove(prom_histogram_t *self, const char **label_values);
+
+/**
+ * @brief clear all the samples for the prom_histogram_t*
+ * @param self The target prom_histogram_t*
+ * @return A non-zero integer value upon failure.
+*/
+int prom_histogram_clear(prom_histogram_t *self);
+
+/**
+ * @brief Start an update cycle of the prom_histogram_t*. Every series observed or set before the matching
+ *        prom_histogram_end_update is kept, the others are removed by it.
+ *
+ * Use this pair instead of prom_histogram_clear when re-populating the histogram on every update: existing series are reused
+ * in place, so a steady-state update allocates nothing and a concurrent scrape never sees series missing.
+ * @param self The target prom_histogram_t*
+ * @return A non-zero integer value upon failure.
+ */
+int prom_histogram_begin_update(prom_histogram_t *self);
+
+/**
+ * @brief Finish the update cycle started by prom_histogram_begin_update, removing the series not updated since.
+ * @param self The target prom_histogram_t*
+ * @return A non-zero integer value upon failure.
+ */
+int prom_histogram_end_update(prom_histogram_t *self);
+
 #endif  // PROM_HISTOGRAM_INCLUDED
@@ -22,6 +22,8 @@ limitations under the License.
 #ifndef PROM_METRIC_H
 #define PROM_METRIC_H
 
+#include <stddef.h>
+
 #include "prom_metric_sample.h"
 #include "prom_metric_sample_histogram.h"
 
@@ -33,6 +35,45 @@ struct prom_metric;
  */
 typedef struct prom_metric prom_metric_t;
 
+/**
+ * @brief The label of the series that takes the samples of new label sets once a series cap is reached. Its value is
+ * always "true" and the series carries no other label.
+ */
+#define PROM_METRIC_OVERFLOW_LABEL "overflow"
+
+/**
+ * @brief The number of encoding slots of a prom_metric_snapshot_t
+ */
+#define PROM_METRIC_SNAPSHOT_ENCODINGS 4
+
+/**
+ * @brief The exposition text of a metric as of its last committed update cycle.
+ *
+ * Snapshots are immutable and handed out by prom_collector_registry_stream_next. Besides the text, a snapshot can
+ * cache encoded forms of it, such as a compressed copy, so an unchanged metric is encoded only once. An update cycle
+ * that renders the same bytes keeps the previous snapshot, cached encodings included.
+ */
+typedef struct prom_metric_snapshot prom_metric_snapshot_t;
+
+/**
+ * @brief Returns the encoding of the snapshot text cached in the given slot, or NULL if the slot is still empty.
+ * @param self The target prom_metric_snapshot_t*
+ * @param slot The slot, below PROM_METRIC_SNAPSHOT_ENCODINGS. The caller decides which encoding each slot holds.
+ * @param len Set to the length of the encoded data
+ */
+const char *prom_metric_snapshot_get_encoded(prom_metric_snapshot_t *self, int slot, size_t *len);
+
+/**
+ * @brief Caches a copy of an encoding of the snapshot text in the given slot. If another thread filled the slot first,
+ * its data is kept.
+ * @param self The target prom_metric_snapshot_t*
+ * @param slot The slot, below PROM_METRIC_SNAPSHOT_ENCODINGS
+ * @param data The encoded data
+ * @param len The length of data. Set to the length of the cached data on return.
+ * @return The cached data, valid as long as the snapshot, or NULL upon failure.
+ */
+const char *prom_metric_snapshot_set_encoded(prom_metric_snapshot_t *self, int slot, const char *data, size_t *len);
+
 /**
  * @brief Returns a prom_metric_sample_t*. The order of label_values is significant.
  *
@@ -64,4 +105,47 @@ prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_metric_t *self,
                                                                          const char **label_values);
 
+/**
+ * @brief Caps the number of series of the metric.
+ *
+ * Once the metric holds max_series series, a sample for a label set it does not hold yet goes to the single series
+ * labelled PROM_METRIC_OVERFLOW_LABEL="true" instead, and is counted as dropped. The overflow series counts towards
+ * the cap, so the metric never holds more than max_series series. Series that are removed make room again.
+ * @param self The target prom_metric_t*
+ * @param max_series The most series the metric may hold. Pass 0 to lift the cap.
+ * @return A non-zero integer value upon failure.
+ */
+int prom_metric_set_max_series(prom_metric_t *self, size_t max_series);
+
+/**
+ * @brief Caps the number of series of all metrics together.
+ *
+ * Once all metrics together hold max_series series, samples for new label sets of any labelled metric go to its
+ * overflow series, as with prom_metric_set_max_series. The cap is checked without a global lock, so concurrent
+ * updates of different metrics may overshoot it by a few series, and each metric's overflow series may come on top.
+ * @param max_series The most series all metrics may hold. Pass 0 to lift the cap.
+ */
+void prom_metric_set_global_max_series(size_t max_series);
+
+/**
+ * @brief Publishes the update cycles of several metrics at once.
+ *
+ * Call it after the update cycles of a group of metrics that belong together. The first call for a metric switches
+ * it to staging: from then on its end_update, remove and clear only prepare its next snapshot, and scrapes keep
+ * seeing the previous one until the next prom_metrics_commit that includes the metric. A scrape that renders one
+ * metric of a call renders all the others from that same call, so it never mixes cycles of the group. Metrics that
+ * are not updated in cycles are left to render live.
+ * @param metrics The metrics to publish, each of them in at most one group
+ * @param count The count of metrics
+ * @return A non-zero integer value upon failure.
+ */
+int prom_metrics_commit(prom_metric_t **metrics, size_t count);
+
+/**
+ * @brief Returns the name of a metric, which is also the key it is registered under in its collector.
+ * @param self The target prom_metric_t*
+ * @return The name, owned by the metric
+ */
+const char *prom_metric_name(prom_metric_t *self);
+
 #endif  // PROM_METRIC_H
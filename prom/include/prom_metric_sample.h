@@ -57,4 +57,13 @@ int prom_metric_sample_sub(prom_metric_sample_t *self, double r_value);
  */
 int prom_metric_sample_set(prom_metric_sample_t *self, double r_value);
 
+/**
+ * @brief Release a sample handle obtained from prom_gauge_child or prom_counter_child.
+ *
+ * The sample memory is freed once the metric has dropped the series as well, so handles may outlive prom_*_remove,
+ * prom_*_clear and even the metric itself. Updates made through a handle after its series was removed are not exported.
+ * @param self The prom_metric_sample_t* to release. NULL is ignored.
+ */
+void prom_metric_sample_release(prom_metric_sample_t *self);
+
 #endif  // PROM_METRIC_SAMPLE_H
@@ -29,11 +29,30 @@ struct prom_metric_sample_histogram;
 typedef struct prom_metric_sample_histogram prom_metric_sample_histogram_t;
 
 /**
- * @brief Observe the double for the given prom_metric_sample_histogram_observe_t
+ * @brief Observe the double for the given prom_metric_sample_histogram_observe_t. Lock-free: a bucket search over the
+ * bounds and two atomic updates.
  * @param self The target prom_metric_sample_histogram_t*
  * @param value The value to observe.
  * @return Non-zero integer value upon failure
  */
 int prom_metric_sample_histogram_observe(prom_metric_sample_histogram_t *self, double value);
 
+/**
+ * @brief Overwrite the state of the given prom_metric_sample_histogram_t with externally aggregated data
+ * @param self The target prom_metric_sample_histogram_t*
+ * @param bucket_counts The per-bucket (non-cumulative) observation counts. The array MUST hold one entry per bucket
+ *                      upper bound followed by one entry for observations above the last bound (+Inf).
+ * @param sum The sum of all observed values
+ * @return Non-zero integer value upon failure
+ */
+int prom_metric_sample_histogram_set(prom_metric_sample_histogram_t *self, const double *bucket_counts, double sum);
+
+/**
+ * @brief Release a histogram handle obtained from prom_histogram_child.
+ *
+ * As with prom_metric_sample_release, the sample is freed once the metric has dropped the series as well.
+ * @param self The prom_metric_sample_histogram_t* to release. NULL is ignored.
+ */
+void prom_metric_sample_histogram_release(prom_metric_sample_histogram_t *self);
+
 #endif  // PROM_METRIC_SAMPLE_HISOTGRAM_H
@@ -0,0 +1,48 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file prom_metric_sample_summary.h
+ * @brief Functions for interacting with summary metric samples directly
+ */
+
+#ifndef PROM_METRIC_SAMPLE_SUMMARY_H
+#define PROM_METRIC_SAMPLE_SUMMARY_H
+
+struct prom_metric_sample_summary;
+/**
+ * @brief A summary metric sample
+ */
+typedef struct prom_metric_sample_summary prom_metric_sample_summary_t;
+
+/**
+ * @brief Observe the double for the given prom_metric_sample_summary_t. The value is appended to a per-thread shard
+ * buffer under an uncontended lock; every 64th observation of a shard merges its buffer into the quantile sketch.
+ * @param self The target prom_metric_sample_summary_t*
+ * @param value The value to observe.
+ * @return Non-zero integer value upon failure
+ */
+int prom_metric_sample_summary_observe(prom_metric_sample_summary_t *self, double value);
+
+/**
+ * @brief Release a summary handle obtained from prom_summary_child.
+ *
+ * As with prom_metric_sample_release, the sample is freed once the metric has dropped the series as well.
+ * @param self The prom_metric_sample_summary_t* to release. NULL is ignored.
+ */
+void prom_metric_sample_summary_release(prom_metric_sample_summary_t *self);
+
+#endif  // PROM_METRIC_SAMPLE_SUMMARY_H
@@ -0,0 +1,82 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file prom_pool.h
+ * @brief Slab pools for the small objects and keys allocated for every series
+ */
+
+#ifndef PROM_POOL_H
+#define PROM_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The largest size served from a slab pool. Larger requests go to prom_malloc.
+ */
+#define PROM_POOL_MAX_SIZE 512
+
+/**
+ * @brief Counters of the slab pools, for judging how well allocations are pooled.
+ */
+typedef struct prom_pool_stats {
+  size_t slab_bytes;          /**< slab_bytes is the memory held in slabs, live or free */
+  size_t live_bytes;          /**< live_bytes is the slab memory handed out and not yet freed, rounded to classes */
+  size_t live_objects;        /**< live_objects is the number of objects handed out from slabs and not yet freed */
+  uint64_t slab_allocations;  /**< slab_allocations counts the objects ever handed out from slabs */
+  uint64_t heap_allocations;  /**< heap_allocations counts the requests too large for a slab, sent to prom_malloc */
+} prom_pool_stats_t;
+
+/**
+ * @brief Allocates size bytes, from the slab of its size class when size is at most PROM_POOL_MAX_SIZE.
+ *
+ * Slabs are carved into equal objects and kept for the life of the process, so objects freed by one scrape's
+ * clear-and-rebuild are handed straight back to the next one. Thread safe.
+ * @param size The number of bytes to allocate
+ * @return The memory, 16-byte aligned, to be freed with prom_pool_free and the same size
+ */
+void *prom_pool_malloc(size_t size);
+
+/**
+ * @brief Frees memory from prom_pool_malloc. Thread safe.
+ * @param ptr The memory to free, may be NULL
+ * @param size The size it was allocated with
+ */
+void prom_pool_free(void *ptr, size_t size);
+
+/**
+ * @brief Copies a string into pooled memory, like strdup. Keys of up to PROM_POOL_MAX_SIZE bytes share the slabs of the
+ * fixed-size objects, so a series key costs no call to prom_malloc. Thread safe.
+ * @param str The string to copy
+ * @return The copy, to be freed with prom_pool_strfree
+ */
+char *prom_pool_strdup(const char *str);
+
+/**
+ * @brief Frees a string from prom_pool_strdup. Its size is taken from its length, so it must not have been changed.
+ * Thread safe.
+ * @param str The string to free, may be NULL
+ */
+void prom_pool_strfree(const char *str);
+
+/**
+ * @brief Copies the current pool counters into stats.
+ * @param stats Where to store the counters
+ */
+void prom_pool_stats(prom_pool_stats_t *stats);
+
+#endif  // PROM_POOL_H
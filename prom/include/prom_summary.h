@@ -0,0 +1,133 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file prom_summary.h
+ * @brief https://prometheus.io/docs/concepts/metric_types/#summary
+ */
+
+#ifndef PROM_SUMMARY_INCLUDED
+#define PROM_SUMMARY_INCLUDED
+
+#include <stdlib.h>
+
+#include "prom_metric.h"
+#include "prom_metric_sample_summary.h"
+
+/**
+ * @brief A prometheus summary.
+ *
+ * Each series keeps an exact count and sum and estimates its quantiles over a sliding window with a t-digest, a sketch
+ * of fixed size whose tail quantiles are accurate to a fraction of a percent of rank. A series takes about 13 KiB
+ * whatever the number of observations: five window sketches of about 1.7 KiB each, one more to merge them and four
+ * observation shards of 0.5 KiB. An observation costs one uncontended lock on its shard; every 64th one also sorts and
+ * merges the shard's buffer into the current window.
+ *
+ * References
+ * * See https://prometheus.io/docs/concepts/metric_types/#summary
+ */
+typedef prom_metric_t prom_summary_t;
+
+/**
+ * @brief Construct a prom_summary_t*
+ * @param name The name of the metric
+ * @param help The metric description
+ * @param quantile_count The number of quantiles to expose
+ * @param quantiles The quantiles to expose, each between 0 and 1. The values are copied. Pass NULL to expose the 0.5,
+ *                  0.9 and 0.99 quantiles.
+ * @param max_age The quantiles cover the observations of the last max_age seconds, give or take a fifth of it. Pass 0
+ *                for 10 minutes.
+ * @param label_key_count is the number of labels associated with the given metric. Pass 0 if the metric does not
+ *                        require labels.
+ * @param label_keys A collection of label keys. The number of keys MUST match the value passed as label_key_count. If
+ *                   no labels are required, pass NULL. Otherwise, it may be convenient to pass this value as a
+ *                   literal.
+ * @return The constructed prom_summary_t*, or NULL upon failure.
+ *
+ * *Example*
+ *
+ *     // The median and the 99th percentile over the last minute
+ *     prom_summary_new("foo", "foo is a summary", 2, (const double[]) { 0.5, 0.99 }, 60, 0, NULL);
+ */
+prom_summary_t *prom_summary_new(const char *name, const char *help, size_t quantile_count, const double *quantiles,
+                                 double max_age, size_t label_key_count, const char **label_keys);
+
+/**
+ * @brief Destroy a prom_summary_t*. self MUST be set to NULL after destruction. Returns a non-zero integer value
+ *        upon failure.
+ * @return Non-zero value upon failure.
+ */
+int prom_summary_destroy(prom_summary_t *self);
+
+/**
+ * @brief Observe the prom_summary_t given the value and labels
+ * @param self The target prom_summary_t*
+ * @param value The value to observe
+ * @param label_values The label values associated with the metric sample being updated. The number of labels must
+ *                     match the value passed to label_key_count in the summary's constructor. If no label values are
+ *                     necessary, pass NULL. Otherwise, It may be convenient to pass this value as a literal.
+ * @return Non-zero value upon failure
+ */
+int prom_summary_observe(prom_summary_t *self, double value, const char **label_values);
+
+/**
+ * @brief Returns a handle to the series of the prom_summary_t* with the given label values, creating it if needed.
+ *
+ * Resolving the labels happens once here. Afterwards observations go straight to prom_metric_sample_summary_observe.
+ * Use it on per-event paths. The handle must be released with prom_metric_sample_summary_release when the series goes
+ * away.
+ * @param self The target prom_summary_t*
+ * @param label_values The label values of the series. Pass NULL if the summary has no labels.
+ * @return The prom_metric_sample_summary_t* handle, or NULL upon failure.
+ *
+ * *Example*
+ *
+ *     prom_metric_sample_summary_t *child = prom_summary_child(foo_summary, (const char*[]) { "bar" });
+ *     prom_metric_sample_summary_observe(child, 0.25);
+ *     prom_metric_sample_summary_release(child);
+ */
+prom_metric_sample_summary_t *prom_summary_child(prom_summary_t *self, const char **label_values);
+
+/**
+ * @brief remove the prom_summary_t* with specified labels
+ * @param self The target prom_summary_t*
+ * @return A non-zero integer value upon failure.
+ */
+int prom_summary_remove(prom_summary_t *self, const char **label_values);
+
+/**
+ * @brief clear all the samples for the prom_summary_t*
+ * @param self The target prom_summary_t*
+ * @return A non-zero integer value upon failure.
+ */
+int prom_summary_clear(prom_summary_t *self);
+
+/**
+ * @brief Start an update cycle of the prom_summary_t*. Every series observed before the matching
+ *        prom_summary_end_update is kept, the others are removed by it.
+ * @param self The target prom_summary_t*
+ * @return A non-zero integer value upon failure.
+ */
+int prom_summary_begin_update(prom_summary_t *self);
+
+/**
+ * @brief Finish the update cycle started by prom_summary_begin_update, removing the series not observed since.
+ * @param self The target prom_summary_t*
+ * @return A non-zero integer value upon failure.
+ */
+int prom_summary_end_update(prom_summary_t *self);
+
+#endif  // PROM_SUMMARY_INCLUDED
@@ -15,15 +15,20 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 // Public
 #include "prom_alloc.h"
 #include "prom_collector.h"
 #include "prom_collector_registry.h"
+#include "prom_counter.h"
+#include "prom_gauge.h"
 
 // Private
 #include "prom_assert.h"
+#include "prom_collector_registry_i.h"
+#include "prom_collector_registry_t.h"
 #include "prom_collector_t.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
@@ -60,6 +65,7 @@ prom_collector_t *prom_collector_new(const char *name) {
   }
   self->proc_limits_file_path = NULL;
   self->proc_stat_file_path = NULL;
+  self->registry = NULL;
   return self;
 }
 
@@ -275,3 +281,104 @@ prom_map_t *prom_collector_process_collect(prom_collector_t *self) {
 
   return self->metrics;
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Self Collector
+
+#define PROM_COLLECTOR_SELF_SERIES "prom_series"
+#define PROM_COLLECTOR_SELF_METRIC_SERIES "prom_metric_series"
+#define PROM_COLLECTOR_SELF_METRIC_MEMORY "prom_metric_memory_bytes"
+#define PROM_COLLECTOR_SELF_METRIC_DROPPED "prom_metric_dropped_samples_total"
+#define PROM_COLLECTOR_SELF_COLLECTOR_MEMORY "prom_collector_memory_bytes"
+
+prom_map_t *prom_collector_self_collect(prom_collector_t *self);
+
+prom_collector_t *prom_collector_self_new(prom_collector_registry_t *registry) {
+  prom_collector_t *self = prom_collector_new("self");
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+
+  self->registry = registry;
+  self->collect_fn = &prom_collector_self_collect;
+
+  const char *metric_labels[] = {"collector", "metric"};
+  const char *collector_labels[] = {"collector"};
+  prom_metric_t *metrics[] = {
+      prom_gauge_new(PROM_COLLECTOR_SELF_SERIES, "Live series of all metrics.", 0, NULL),
+      prom_gauge_new(PROM_COLLECTOR_SELF_METRIC_SERIES, "Live series of the metric.", 2, metric_labels),
+      prom_gauge_new(PROM_COLLECTOR_SELF_METRIC_MEMORY, "Approximate heap memory of the metric in bytes.", 2,
+                     metric_labels),
+      prom_counter_new(PROM_COLLECTOR_SELF_METRIC_DROPPED,
+                       "Samples of new series folded into the overflow series of the metric by its series cap.", 2,
+                       metric_labels),
+      prom_gauge_new(PROM_COLLECTOR_SELF_COLLECTOR_MEMORY,
+                     "Approximate heap memory of the collector and its metrics in bytes.", 1, collector_labels),
+  };
+  for (size_t i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++) {
+    if (metrics[i] == NULL || prom_collector_add_metric(self, metrics[i])) {
+      // Metrics not handed to the collector yet are freed here, the others with it
+      for (size_t j = i; j < sizeof(metrics) / sizeof(metrics[0]); j++) {
+        if (metrics[j] != NULL) prom_metric_destroy(metrics[j]);
+      }
+      prom_collector_destroy(self);
+      return NULL;
+    }
+  }
+  return self;
+}
+
+/**
+ * @brief API PRIVATE Reports on the metrics of the registry. Like every prom_collect_fn it runs under the registry
+ * lock, so the collectors and their metric maps stay put; each metric is read under its own lock.
+ */
+prom_map_t *prom_collector_self_collect(prom_collector_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || self->registry == NULL) return NULL;
+
+  prom_gauge_t *series = (prom_gauge_t *)prom_map_get(self->metrics, PROM_COLLECTOR_SELF_SERIES);
+  prom_gauge_t *metric_series = (prom_gauge_t *)prom_map_get(self->metrics, PROM_COLLECTOR_SELF_METRIC_SERIES);
+  prom_gauge_t *metric_memory = (prom_gauge_t *)prom_map_get(self->metrics, PROM_COLLECTOR_SELF_METRIC_MEMORY);
+  prom_counter_t *metric_dropped = (prom_counter_t *)prom_map_get(self->metrics, PROM_COLLECTOR_SELF_METRIC_DROPPED);
+  prom_gauge_t *collector_memory = (prom_gauge_t *)prom_map_get(self->metrics, PROM_COLLECTOR_SELF_COLLECTOR_MEMORY);
+
+  // Series of metrics and collectors that went away are dropped at the end of the cycle
+  prom_gauge_begin_update(metric_series);
+  prom_gauge_begin_update(metric_memory);
+  prom_counter_begin_update(metric_dropped);
+  prom_gauge_begin_update(collector_memory);
+
+  int r = 0;
+  size_t collector_iter = 0;
+  void *collector_value = NULL;
+  while (!r && prom_map_next(self->registry->collectors, &collector_iter, NULL, &collector_value)) {
+    prom_collector_t *collector = (prom_collector_t *)collector_value;
+    size_t memory = sizeof(prom_collector_t) + strlen(collector->name) + 1 + prom_map_memory(collector->metrics) +
+                    prom_string_builder_memory(collector->string_builder);
+
+    size_t metric_iter = 0;
+    void *metric_value = NULL;
+    while (!r && prom_map_next(collector->metrics, &metric_iter, NULL, &metric_value)) {
+      prom_metric_t *metric = (prom_metric_t *)metric_value;
+      size_t metric_series_count = 0;
+      size_t metric_memory_bytes = 0;
+      uint64_t metric_dropped_count = 0;
+      r = prom_metric_stats(metric, &metric_series_count, &metric_memory_bytes, &metric_dropped_count);
+      if (r) break;
+      memory += metric_memory_bytes;
+
+      const char *labels[] = {collector->name, metric->name};
+      r = prom_gauge_set(metric_series, (double)metric_series_count, labels);
+      if (!r) r = prom_gauge_set(metric_memory, (double)metric_memory_bytes, labels);
+      if (!r) r = prom_counter_set(metric_dropped, (double)metric_dropped_count, labels);
+    }
+    if (!r) r = prom_gauge_set(collector_memory, (double)memory, (const char *[]){collector->name});
+  }
+
+  prom_gauge_end_update(metric_series);
+  prom_gauge_end_update(metric_memory);
+  prom_counter_end_update(metric_dropped);
+  prom_gauge_end_update(collector_memory);
+  if (!r) r = prom_gauge_set(series, (double)prom_metric_series_total(), NULL);
+  if (r) return NULL;
+  return self->metrics;
+}
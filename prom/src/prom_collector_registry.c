@@ -14,9 +14,14 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <pthread.h>
 #include <regex.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 // Public
 #include "prom_alloc.h"
@@ -25,6 +30,7 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_collector_registry_i.h"
 #include "prom_collector_registry_t.h"
 #include "prom_collector_t.h"
 #include "prom_errors.h"
@@ -32,6 +38,7 @@
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_i.h"
+#include "prom_metric_protobuf_i.h"
 #include "prom_metric_t.h"
 #include "prom_process_limits_i.h"
 #include "prom_string_builder_i.h"
@@ -52,6 +59,13 @@ prom_collector_registry_t *prom_collector_registry_new(const char *name) {
 
   self->metric_formatter = prom_metric_formatter_new();
   self->string_builder = prom_string_builder_new();
+
+  // Tokens handed out before a restart name another instance and get a full resync
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  self->delta_instance = ((uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec) ^ ((uint64_t)getpid() << 48);
+  self->delta_gen = 0;
+
   self->lock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
   r = pthread_rwlock_init(self->lock, NULL);
   if (r) {
@@ -72,6 +86,14 @@ int prom_collector_registry_enable_process_metrics(prom_collector_registry_t *se
   return 1;
 }
 
+int prom_collector_registry_enable_self_metrics(prom_collector_registry_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  prom_collector_t *self_collector = prom_collector_self_new(self);
+  if (self_collector == NULL) return 1;
+  return prom_collector_registry_register_collector(self, self_collector);
+}
+
 int prom_collector_registry_enable_custom_process_metrics(prom_collector_registry_t *self,
                                                           const char *process_limits_path,
                                                           const char *process_stats_path) {
@@ -215,7 +237,289 @@ int prom_collector_registry_validate_metric_name(prom_collector_registry_t *self
 }
 
 const char *prom_collector_registry_bridge(prom_collector_registry_t *self) {
-  prom_metric_formatter_clear(self->metric_formatter);
+  // Scrapes are serialized: they share the formatter buffer and the per-series line caches
+  if (pthread_rwlock_wrlock(self->lock) != 0) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return NULL;
+  }
+  // Reset rather than clear so the buffer keeps the size of the previous exposition
+  prom_metric_formatter_reset(self->metric_formatter);
   prom_metric_formatter_load_metrics(self->metric_formatter, self->collectors);
-  return (const char *)prom_metric_formatter_dump(self->metric_formatter);
+  const char *out = (const char *)prom_metric_formatter_dump(self->metric_formatter);
+  prom_metric_formatter_reset(self->metric_formatter);
+  pthread_rwlock_unlock(self->lock);
+  return out;
+}
+
+/**
+ * @brief API PRIVATE Returns whether the filter accepts any metric registered with the collector, so collectors it
+ * would render nothing of are not collected.
+ */
+static bool prom_collector_registry_wants(prom_collector_t *collector, prom_collector_registry_filter_fn *filter_fn,
+                                          void *data) {
+  if (filter_fn == NULL) return true;
+  const char *metric_name = NULL;
+  size_t iter = 0;
+  while (prom_map_next(collector->metrics, &iter, &metric_name, NULL)) {
+    if (filter_fn(metric_name, data)) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief API PRIVATE Returns the generation a delta token names, or 0 when it names none of this registry's, so that
+ * a full exposition has to be sent
+ */
+static uint64_t prom_collector_registry_delta_since(prom_collector_registry_t *self, const char *since) {
+  if (since == NULL) return 0;
+  uint64_t instance = 0;
+  uint64_t gen = 0;
+  char extra = 0;
+  if (sscanf(since, "%" SCNx64 "-%" SCNu64 "%c", &instance, &gen, &extra) != 2) return 0;
+  if (instance != self->delta_instance || gen > self->delta_gen) return 0;
+  return gen;
+}
+
+const char *prom_collector_registry_delta(prom_collector_registry_t *self, const char *since,
+                                          prom_collector_registry_filter_fn *filter_fn, void *data, char *token,
+                                          bool *full) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+
+  // Delta scrapes are serialized with every other scrape: they stamp the series they compare
+  if (pthread_rwlock_wrlock(self->lock) != 0) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return NULL;
+  }
+  uint64_t since_gen = prom_collector_registry_delta_since(self, since);
+  uint64_t gen = ++self->delta_gen;
+
+  int r = 0;
+  prom_metric_formatter_reset(self->metric_formatter);
+  size_t collector_iter = 0;
+  void *collector_value = NULL;
+  while (!r && prom_map_next(self->collectors, &collector_iter, NULL, &collector_value)) {
+    prom_collector_t *collector = (prom_collector_t *)collector_value;
+    if (!prom_collector_registry_wants(collector, filter_fn, data)) continue;
+    prom_map_t *metrics = collector->collect_fn(collector);
+    if (metrics == NULL) {
+      r = 1;
+      break;
+    }
+
+    size_t metric_iter = 0;
+    const char *metric_name = NULL;
+    void *metric_value = NULL;
+    while (!r && prom_map_next(metrics, &metric_iter, &metric_name, &metric_value)) {
+      if (filter_fn != NULL && !filter_fn(metric_name, data)) continue;
+      prom_metric_t *metric = (prom_metric_t *)metric_value;
+      if (pthread_rwlock_rdlock(metric->rwlock) != 0) {
+        r = 1;
+        break;
+      }
+      r = prom_metric_formatter_load_metric_delta(self->metric_formatter, metric, since_gen, gen);
+      pthread_rwlock_unlock(metric->rwlock);
+    }
+  }
+  const char *out = r ? NULL : (const char *)prom_metric_formatter_dump(self->metric_formatter);
+  prom_metric_formatter_reset(self->metric_formatter);
+  pthread_rwlock_unlock(self->lock);
+  if (out == NULL) return NULL;
+
+  if (token != NULL) {
+    snprintf(token, PROM_COLLECTOR_REGISTRY_DELTA_TOKEN_SIZE, "%016" PRIx64 "-%" PRIu64, self->delta_instance, gen);
+  }
+  if (full != NULL) *full = since_gen == 0;
+  return out;
+}
+
+prom_collector_registry_stream_t *prom_collector_registry_stream_new(prom_collector_registry_t *self) {
+  return prom_collector_registry_stream_new_format(self, PROM_EXPOSITION_TEXT);
+}
+
+prom_collector_registry_stream_t *prom_collector_registry_stream_new_format(prom_collector_registry_t *self,
+                                                                            prom_exposition_format_t format) {
+  return prom_collector_registry_stream_new_filtered(self, format, NULL, NULL);
+}
+
+prom_collector_registry_stream_t *prom_collector_registry_stream_new_filtered(
+    prom_collector_registry_t *self, prom_exposition_format_t format, prom_collector_registry_filter_fn *filter_fn,
+    void *data) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (format != PROM_EXPOSITION_TEXT && format != PROM_EXPOSITION_PROTOBUF) return NULL;
+
+  // Commits from now on render the protobuf form as well, so later scrapes can send it from the snapshots
+  if (format == PROM_EXPOSITION_PROTOBUF) prom_metric_snapshot_enable_protobuf();
+
+  prom_collector_registry_stream_t *stream =
+      (prom_collector_registry_stream_t *)prom_malloc(sizeof(prom_collector_registry_stream_t));
+  stream->registry = self;
+  stream->format = format;
+  stream->formatter = prom_metric_formatter_new();
+  if (stream->formatter == NULL) {
+    prom_free(stream);
+    return NULL;
+  }
+  stream->text = NULL;
+  stream->len = 0;
+  stream->offset = 0;
+  stream->snapshot = NULL;
+  stream->pending = NULL;
+  stream->pins = (prom_metric_pins_t){NULL, 0, 0};
+  stream->collector_iter = 0;
+  stream->metrics = NULL;
+  stream->metric_iter = 0;
+  stream->done = false;
+  stream->filter_fn = filter_fn;
+  stream->filter_data = data;
+  return stream;
+}
+
+/**
+ * @brief API PRIVATE Advances the stream to its next metric. Committed snapshots are held in self->snapshot, or in
+ * self->pending when live text rendered before them has to go out first. Live metrics are rendered into the
+ * formatter until it holds at least one chunk.
+ */
+static int prom_collector_registry_stream_load(prom_collector_registry_stream_t *self) {
+  prom_collector_registry_t *registry = self->registry;
+  int r = 0;
+
+  // Taken per chunk: renders share the per-series line caches with other scrapes
+  if (pthread_rwlock_wrlock(registry->lock) != 0) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return 1;
+  }
+  while (prom_metric_formatter_len(self->formatter) < PROM_COLLECTOR_REGISTRY_STREAM_CHUNK_SIZE) {
+    if (self->metrics == NULL) {
+      void *collector_value = NULL;
+      if (!prom_map_next(registry->collectors, &self->collector_iter, NULL, &collector_value)) {
+        self->done = true;
+        break;
+      }
+      prom_collector_t *collector = (prom_collector_t *)collector_value;
+      if (!prom_collector_registry_wants(collector, self->filter_fn, self->filter_data)) continue;
+      self->metrics = collector->collect_fn(collector);
+      self->metric_iter = 0;
+      if (self->metrics == NULL) {
+        r = 1;
+        break;
+      }
+    }
+
+    const char *metric_name = NULL;
+    void *metric_value = NULL;
+    if (!prom_map_next(self->metrics, &self->metric_iter, &metric_name, &metric_value)) {
+      self->metrics = NULL;
+      continue;
+    }
+    if (self->filter_fn != NULL && !self->filter_fn(metric_name, self->filter_data)) continue;
+    prom_metric_t *metric = (prom_metric_t *)metric_value;
+
+    prom_metric_snapshot_t *snapshot = prom_metric_snapshot_acquire(metric, &self->pins);
+    if (snapshot != NULL && self->format == PROM_EXPOSITION_PROTOBUF) {
+      if (snapshot->proto != NULL && snapshot->proto_len == 0) {
+        // Committed without samples, nothing to send
+        prom_metric_snapshot_release(snapshot);
+        continue;
+      }
+      if (snapshot->proto == NULL) {
+        // Committed before protobuf was first asked for
+        prom_metric_snapshot_release(snapshot);
+        snapshot = NULL;
+      }
+    }
+    if (snapshot != NULL) {
+      if (prom_metric_formatter_len(self->formatter) == 0) {
+        self->snapshot = snapshot;
+      } else {
+        self->pending = snapshot;
+      }
+      break;
+    }
+
+    if (pthread_rwlock_rdlock(metric->rwlock) != 0) {
+      r = 1;
+      break;
+    }
+    if (self->format == PROM_EXPOSITION_PROTOBUF) {
+      r = prom_metric_protobuf_load_metric(self->formatter, metric);
+    } else {
+      r = prom_metric_formatter_load_metric(self->formatter, metric);
+    }
+    pthread_rwlock_unlock(metric->rwlock);
+    if (r) break;
+  }
+  pthread_rwlock_unlock(registry->lock);
+  return r;
+}
+
+int prom_collector_registry_stream_next(prom_collector_registry_stream_t *self, const char **text, size_t *len,
+                                        prom_metric_snapshot_t **snapshot) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return -1;
+
+  // The previous piece has been consumed
+  prom_metric_snapshot_release(self->snapshot);
+  self->snapshot = NULL;
+  prom_metric_formatter_reset(self->formatter);
+
+  if (self->pending != NULL) {
+    self->snapshot = self->pending;
+    self->pending = NULL;
+  } else if (!self->done) {
+    if (prom_collector_registry_stream_load(self)) return -1;
+  }
+
+  if (self->snapshot != NULL && self->format == PROM_EXPOSITION_PROTOBUF) {
+    *text = self->snapshot->proto;
+    *len = self->snapshot->proto_len;
+  } else if (self->snapshot != NULL) {
+    *text = self->snapshot->text;
+    *len = self->snapshot->len;
+  } else if (prom_metric_formatter_len(self->formatter) > 0) {
+    *text = prom_metric_formatter_str(self->formatter);
+    *len = prom_metric_formatter_len(self->formatter);
+  } else {
+    return 0;
+  }
+  if (snapshot != NULL) *snapshot = self->snapshot;
+  return 1;
+}
+
+ssize_t prom_collector_registry_stream_read(prom_collector_registry_stream_t *self, char *buf, size_t max) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return -1;
+
+  size_t copied = 0;
+  while (copied < max) {
+    if (self->offset < self->len) {
+      size_t n = self->len - self->offset < max - copied ? self->len - self->offset : max - copied;
+      memcpy(buf + copied, self->text + self->offset, n);
+      self->offset += n;
+      copied += n;
+      continue;
+    }
+
+    int r = prom_collector_registry_stream_next(self, &self->text, &self->len, NULL);
+    if (r < 0) return -1;
+    self->offset = 0;
+    if (r == 0) {
+      self->len = 0;
+      break;
+    }
+  }
+  return (ssize_t)copied;
+}
+
+void prom_collector_registry_stream_destroy(prom_collector_registry_stream_t *self) {
+  if (self == NULL) return;
+  prom_metric_snapshot_release(self->snapshot);
+  self->snapshot = NULL;
+  prom_metric_snapshot_release(self->pending);
+  self->pending = NULL;
+  prom_metric_pins_release(&self->pins);
+  prom_metric_formatter_destroy(self->formatter);
+  self->formatter = NULL;
+  prom_free(self);
 }
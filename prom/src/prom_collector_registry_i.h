@@ -23,4 +23,10 @@ int prom_collector_registry_enable_custom_process_metrics(prom_collector_registr
                                                           const char *process_limits_path,
                                                           const char *process_stats_path);
 
+/**
+ * @brief API PRIVATE Returns the "self" collector of the registry, which reports the series count, approximate memory
+ * and dropped samples of every metric of the registry, and the approximate memory of every collector.
+ */
+prom_collector_t *prom_collector_self_new(prom_collector_registry_t *registry);
+
 #endif  // PROM_COLLECTOR_REGISTRY_I_INCLUDED
@@ -19,12 +19,14 @@
 
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 // Public
 #include "prom_collector_registry.h"
 
 // Private
 #include "prom_map_t.h"
+#include "prom_metric_t.h"
 #include "prom_metric_formatter_t.h"
 #include "prom_string_builder_t.h"
 
@@ -34,7 +36,31 @@ struct prom_collector_registry {
   prom_map_t *collectors;                    /**< Map of collectors keyed by name */
   prom_string_builder_t *string_builder;     /**< Enables string building */
   prom_metric_formatter_t *metric_formatter; /**< metric formatter for metric exposition on bridge call */
-  pthread_rwlock_t *lock;                    /**< mutex for safety against concurrent registration */
+  pthread_rwlock_t *lock;                    /**< mutex for safety against concurrent registration and scrapes */
+  uint64_t delta_instance;                   /**< identifies the registry in delta tokens, so stale ones are told */
+  uint64_t delta_gen;                        /**< generation of the last delta scrape */
+};
+
+// Render metrics into the stream buffer until it holds at least this many bytes, so the registry lock is taken once
+// per chunk rather than once per metric
+#define PROM_COLLECTOR_REGISTRY_STREAM_CHUNK_SIZE 16384
+
+struct prom_collector_registry_stream {
+  prom_collector_registry_t *registry;
+  prom_exposition_format_t format;              /**< format of the exposition */
+  prom_metric_formatter_t *formatter;           /**< holds the live metrics of the current piece */
+  const char *text;                             /**< current piece, for prom_collector_registry_stream_read */
+  size_t len;                                   /**< length of text */
+  size_t offset;                                /**< bytes of text already read */
+  prom_metric_snapshot_t *snapshot;             /**< snapshot the current piece comes from, if any */
+  prom_metric_snapshot_t *pending;              /**< snapshot to return after the live text in the formatter */
+  prom_metric_pins_t pins;                      /**< batches rendered from, so each group comes from one commit */
+  size_t collector_iter;                        /**< prom_map_next position in registry->collectors */
+  prom_map_t *metrics;                          /**< metrics of the current collector, NULL between collectors */
+  size_t metric_iter;                           /**< prom_map_next position in metrics */
+  bool done;                                    /**< every metric has been rendered */
+  prom_collector_registry_filter_fn *filter_fn; /**< renders only the metrics it accepts, NULL for all */
+  void *filter_data;                            /**< passed to filter_fn */
 };
 
 #endif  // PROM_REGISTRY_T_H
@@ -18,6 +18,7 @@
 #define PROM_COLLECTOR_T_H
 
 #include "prom_collector.h"
+#include "prom_collector_registry.h"
 #include "prom_map_t.h"
 #include "prom_string_builder_t.h"
 
@@ -28,6 +29,7 @@ struct prom_collector {
   prom_string_builder_t *string_builder;
   const char *proc_limits_file_path;
   const char *proc_stat_file_path;
+  prom_collector_registry_t *registry; /**< registry whose metrics the self collector reports on, NULL otherwise */
 };
 
 #endif  // PROM_COLLECTOR_T_H
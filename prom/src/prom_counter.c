@@ -32,6 +32,14 @@ prom_counter_t *prom_counter_new(const char *name, const char *help, size_t labe
   return (prom_counter_t *)prom_metric_new(PROM_COUNTER, name, help, label_key_count, label_keys);
 }
 
+prom_counter_t *prom_counter_new_sharded(const char *name, const char *help, size_t label_key_count,
+                                         const char **label_keys) {
+  prom_counter_t *self = (prom_counter_t *)prom_metric_new(PROM_COUNTER, name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->sharded = true;
+  return self;
+}
+
 int prom_counter_destroy(prom_counter_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
@@ -77,6 +85,16 @@ int prom_counter_set(prom_counter_t *self, double r_value, const char **label_va
   return prom_metric_sample_set(sample, r_value);
 }
 
+prom_metric_sample_t *prom_counter_child(prom_counter_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_child_from_labels(self, label_values);
+}
+
 int prom_counter_remove(prom_counter_t *self, const char **label_values)
 {
   PROM_ASSERT(self != NULL);
@@ -97,4 +115,26 @@ int prom_counter_clear(prom_counter_t *self)
     return 1;
   }
   return prom_metric_clear_samples(self);
+}
+
+int prom_counter_begin_update(prom_counter_t *self)
+{
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_begin_update(self);
+}
+
+int prom_counter_end_update(prom_counter_t *self)
+{
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_end_update(self);
 }
\ No newline at end of file
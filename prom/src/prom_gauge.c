@@ -100,6 +100,16 @@ int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values
   return prom_metric_sample_set(sample, r_value);
 }
 
+prom_metric_sample_t *prom_gauge_child(prom_gauge_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_child_from_labels(self, label_values);
+}
+
 int prom_gauge_remove(prom_gauge_t *self, const char **label_values)
 {
   PROM_ASSERT(self != NULL);
@@ -120,4 +130,26 @@ int prom_gauge_clear(prom_gauge_t *self)
     return 1;
   }
   return prom_metric_clear_samples(self);
+}
+
+int prom_gauge_begin_update(prom_gauge_t *self)
+{
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_begin_update(self);
+}
+
+int prom_gauge_end_update(prom_gauge_t *self)
+{
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_end_update(self);
 }
\ No newline at end of file
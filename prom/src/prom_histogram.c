@@ -23,6 +23,7 @@
 // Private
 #include "prom_assert.h"
 #include "prom_errors.h"
+#include "prom_histogram_sparse_t.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_i.h"
@@ -30,6 +31,9 @@
 #include "prom_metric_sample_histogram_t.h"
 #include "prom_metric_t.h"
 
+// Bucket cap used when the caller leaves it out
+#define PROM_HISTOGRAM_SPARSE_DEFAULT_MAX_BUCKETS 160
+
 prom_histogram_t *prom_histogram_new(const char *name, const char *help, prom_histogram_buckets_t *buckets,
                                      size_t label_key_count, const char **label_keys) {
   prom_histogram_t *self = (prom_histogram_t *)prom_metric_new(PROM_HISTOGRAM, name, help, label_key_count, label_keys);
@@ -54,6 +58,16 @@ prom_histogram_t *prom_histogram_new(const char *name, const char *help, prom_hi
   return self;
 }
 
+prom_histogram_t *prom_histogram_new_sparse(const char *name, const char *help, int schema, size_t max_buckets,
+                                            size_t label_key_count, const char **label_keys) {
+  if (schema < PROM_HISTOGRAM_SPARSE_SCHEMA_MIN || schema > PROM_HISTOGRAM_SPARSE_SCHEMA_MAX) return NULL;
+  prom_histogram_t *self = (prom_histogram_t *)prom_metric_new(PROM_HISTOGRAM, name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->sparse_schema = schema;
+  self->sparse_max_buckets = max_buckets > 0 ? max_buckets : PROM_HISTOGRAM_SPARSE_DEFAULT_MAX_BUCKETS;
+  return self;
+}
+
 int prom_histogram_destroy(prom_histogram_t *self) {
   PROM_ASSERT(self != NULL);
 
@@ -77,3 +91,69 @@ int prom_histogram_observe(prom_histogram_t *self, double value, const char **la
   if (h_sample == NULL) return 1;
   return prom_metric_sample_histogram_observe(h_sample, value);
 }
+
+int prom_histogram_set(prom_histogram_t *self, const double *bucket_counts, double sum, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_HISTOGRAM) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  prom_metric_sample_histogram_t *h_sample = prom_metric_sample_histogram_from_labels(self, label_values);
+  if (h_sample == NULL) return 1;
+  return prom_metric_sample_histogram_set(h_sample, bucket_counts, sum);
+}
+
+prom_metric_sample_histogram_t *prom_histogram_child(prom_histogram_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_HISTOGRAM) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_histogram_child_from_labels(self, label_values);
+}
+
+int prom_histogram_remove(prom_histogram_t *self, const char **label_values)
+{
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_HISTOGRAM) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_remove_sample_from_labels(self, label_values);
+}
+
+int prom_histogram_clear(prom_histogram_t *self)
+{
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_HISTOGRAM) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_clear_samples(self);
+}
+
+int prom_histogram_begin_update(prom_histogram_t *self)
+{
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_HISTOGRAM) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_begin_update(self);
+}
+
+int prom_histogram_end_update(prom_histogram_t *self)
+{
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_HISTOGRAM) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_end_update(self);
+}
@@ -0,0 +1,188 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_histogram_sparse_i.h"
+
+// Width of the zero bucket, the smallest normal float like other Prometheus clients use
+#define PROM_HISTOGRAM_SPARSE_ZERO_THRESHOLD 2.938735877055719e-39
+
+// For every positive schema s, the 2^s bucket boundaries within [0.5, 1): 2^(j * 2^-s - 1)
+static double prom_histogram_sparse_bounds[PROM_HISTOGRAM_SPARSE_SCHEMA_MAX + 1][1 << PROM_HISTOGRAM_SPARSE_SCHEMA_MAX];
+static pthread_once_t prom_histogram_sparse_bounds_once = PTHREAD_ONCE_INIT;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static Declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void prom_histogram_sparse_bounds_init(void);
+static int32_t prom_histogram_sparse_ceil_div(int32_t a, int32_t b);
+static int32_t prom_histogram_sparse_key(int schema, double value);
+static void prom_histogram_sparse_range_add(prom_histogram_sparse_range_t *self, int32_t key);
+static void prom_histogram_sparse_range_halve(prom_histogram_sparse_range_t *self);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End static declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prom_histogram_sparse_t *prom_histogram_sparse_new(int schema, size_t max_buckets) {
+  pthread_once(&prom_histogram_sparse_bounds_once, prom_histogram_sparse_bounds_init);
+
+  prom_histogram_sparse_t *self = (prom_histogram_sparse_t *)prom_malloc(sizeof(prom_histogram_sparse_t));
+  memset(self, 0, sizeof(prom_histogram_sparse_t));
+  self->schema = schema;
+  self->max_buckets = max_buckets;
+  self->zero_threshold = PROM_HISTOGRAM_SPARSE_ZERO_THRESHOLD;
+  return self;
+}
+
+void prom_histogram_sparse_destroy(prom_histogram_sparse_t *self) {
+  if (self == NULL) return;
+  prom_free(self->positive.counts);
+  prom_free(self->negative.counts);
+  prom_free(self);
+}
+
+size_t prom_histogram_sparse_memory(prom_histogram_sparse_t *self) {
+  PROM_ASSERT(self != NULL);
+  return sizeof(prom_histogram_sparse_t) + sizeof(uint64_t) * (self->positive.cap + self->negative.cap);
+}
+
+void prom_histogram_sparse_observe(prom_histogram_sparse_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  if (isnan(value) || isinf(value)) return;
+  double magnitude = fabs(value);
+  if (magnitude <= self->zero_threshold) {
+    self->zero_count++;
+    return;
+  }
+
+  prom_histogram_sparse_range_t *range = value > 0 ? &self->positive : &self->negative;
+  prom_histogram_sparse_range_add(range, prom_histogram_sparse_key(self->schema, magnitude));
+
+  // Halving the resolution halves the span of both ranges; the new value is already counted in its merged bucket
+  while (self->positive.len + self->negative.len > self->max_buckets &&
+         self->schema > PROM_HISTOGRAM_SPARSE_SCHEMA_MIN) {
+    prom_histogram_sparse_range_halve(&self->positive);
+    prom_histogram_sparse_range_halve(&self->negative);
+    self->schema--;
+  }
+}
+
+double prom_histogram_sparse_upper_bound(prom_histogram_sparse_t *self, int32_t key) {
+  PROM_ASSERT(self != NULL);
+  if (self->schema <= 0) return ldexp(1.0, key * (1 << -self->schema));
+  // The same boundaries prom_histogram_sparse_key searches, so a value equal to a bound lands at or below it
+  int32_t per_octave = 1 << self->schema;
+  int32_t octave = -prom_histogram_sparse_ceil_div(-key, per_octave);
+  return ldexp(prom_histogram_sparse_bounds[self->schema][key - octave * per_octave], octave + 1);
+}
+
+static void prom_histogram_sparse_bounds_init(void) {
+  for (int schema = 1; schema <= PROM_HISTOGRAM_SPARSE_SCHEMA_MAX; schema++) {
+    int32_t per_octave = 1 << schema;
+    for (int32_t j = 0; j < per_octave; j++) {
+      prom_histogram_sparse_bounds[schema][j] = exp2((double)j / per_octave - 1);
+    }
+  }
+}
+
+// a / b rounded up, for b > 0
+static int32_t prom_histogram_sparse_ceil_div(int32_t a, int32_t b) {
+  return a > 0 ? (a + b - 1) / b : -(-a / b);
+}
+
+/**
+ * @brief API PRIVATE Returns the key of the bucket holding value, a positive finite double
+ */
+static int32_t prom_histogram_sparse_key(int schema, double value) {
+  int exp = 0;
+  double frac = frexp(value, &exp);
+  if (schema > 0) {
+    // The first boundary at or above frac, within the octave of value
+    const double *bounds = prom_histogram_sparse_bounds[schema];
+    int32_t per_octave = 1 << schema;
+    int32_t lo = 0;
+    int32_t hi = per_octave;
+    while (lo < hi) {
+      int32_t mid = (lo + hi) / 2;
+      if (bounds[mid] < frac) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo + (exp - 1) * per_octave;
+  }
+  // Powers of two close their bucket
+  int32_t key = frac == 0.5 ? exp - 1 : exp;
+  return prom_histogram_sparse_ceil_div(key, 1 << -schema);
+}
+
+/**
+ * @brief API PRIVATE Count one value in the bucket key, extending the range to reach it
+ */
+static void prom_histogram_sparse_range_add(prom_histogram_sparse_range_t *self, int32_t key) {
+  if (self->len == 0) {
+    self->offset = key;
+  }
+  int32_t top = self->offset + (int32_t)self->len - 1;
+  int32_t low = key < self->offset ? key : self->offset;
+  int32_t high = self->len > 0 && top > key ? top : key;
+  size_t len = (size_t)(high - low) + 1;
+  if (len > self->cap) {
+    size_t cap = self->cap > 0 ? self->cap : 8;
+    while (cap < len) cap *= 2;
+    self->counts = (uint64_t *)prom_realloc(self->counts, sizeof(uint64_t) * cap);
+    self->cap = cap;
+  }
+  if (low < self->offset) {
+    // Shift the counts up to make room below them
+    size_t shift = (size_t)(self->offset - low);
+    memmove(self->counts + shift, self->counts, sizeof(uint64_t) * self->len);
+    memset(self->counts, 0, sizeof(uint64_t) * shift);
+  } else if (len > self->len) {
+    memset(self->counts + self->len, 0, sizeof(uint64_t) * (len - self->len));
+  }
+  self->offset = low;
+  self->len = len;
+  self->counts[key - low]++;
+}
+
+/**
+ * @brief API PRIVATE Lower the resolution of the range by one schema: key k becomes ceil(k / 2), which merges every
+ * bucket with its neighbour.
+ */
+static void prom_histogram_sparse_range_halve(prom_histogram_sparse_range_t *self) {
+  if (self->len == 0) return;
+  int32_t offset = prom_histogram_sparse_ceil_div(self->offset, 2);
+  // A bucket only moves down, into a slot whose own count has already moved, so this works in place
+  for (size_t i = 0; i < self->len; i++) {
+    uint64_t count = self->counts[i];
+    self->counts[i] = 0;
+    self->counts[prom_histogram_sparse_ceil_div(self->offset + (int32_t)i, 2) - offset] += count;
+  }
+  self->len = (size_t)(prom_histogram_sparse_ceil_div(self->offset + (int32_t)self->len - 1, 2) - offset) + 1;
+  self->offset = offset;
+}
@@ -0,0 +1,51 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_HISTOGRAM_SPARSE_I_H
+#define PROM_HISTOGRAM_SPARSE_I_H
+
+#include <stdint.h>
+
+#include "prom_histogram_sparse_t.h"
+
+/**
+ * @brief API PRIVATE Returns a prom_histogram_sparse_t* starting at the given schema and keeping at most max_buckets
+ * buckets
+ */
+prom_histogram_sparse_t *prom_histogram_sparse_new(int schema, size_t max_buckets);
+
+/**
+ * @brief API PRIVATE Destroys a prom_histogram_sparse_t*
+ */
+void prom_histogram_sparse_destroy(prom_histogram_sparse_t *self);
+
+/**
+ * @brief API PRIVATE Returns the heap memory held by the sparse buckets in bytes
+ */
+size_t prom_histogram_sparse_memory(prom_histogram_sparse_t *self);
+
+/**
+ * @brief API PRIVATE Count value in its bucket, growing the ranges and lowering the schema as needed. NaN and the
+ * infinities have no bucket and are ignored.
+ */
+void prom_histogram_sparse_observe(prom_histogram_sparse_t *self, double value);
+
+/**
+ * @brief API PRIVATE Returns the upper bound of the positive bucket key at the current schema
+ */
+double prom_histogram_sparse_upper_bound(prom_histogram_sparse_t *self, int32_t key);
+
+#endif  // PROM_HISTOGRAM_SPARSE_I_H
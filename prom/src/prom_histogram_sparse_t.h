@@ -0,0 +1,51 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_HISTOGRAM_SPARSE_T_H
+#define PROM_HISTOGRAM_SPARSE_T_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Range of schemas: bucket boundaries grow by a factor of 2^(2^-schema)
+#define PROM_HISTOGRAM_SPARSE_SCHEMA_MIN -4
+#define PROM_HISTOGRAM_SPARSE_SCHEMA_MAX 8
+
+/**
+ * @brief API PRIVATE A run of consecutive exponential buckets, stored densely from the lowest key in use
+ */
+typedef struct prom_histogram_sparse_range {
+  int32_t offset;   /**< offset is the key of counts[0] */
+  size_t len;       /**< len is the number of keys in use, from offset up */
+  size_t cap;       /**< cap is the number of entries allocated in counts */
+  uint64_t *counts; /**< counts holds the count of every key in use, 0 for the empty ones */
+} prom_histogram_sparse_range_t;
+
+/**
+ * @brief API PRIVATE The buckets of a sparse exponential histogram. Bucket key k of the positive range holds the
+ * values in (2^((k-1) * 2^-schema), 2^(k * 2^-schema)], the negative range mirrors it, and the zero bucket holds
+ * [-zero_threshold, zero_threshold]. It has no lock of its own; its owner serializes access.
+ */
+typedef struct prom_histogram_sparse {
+  int schema;                             /**< schema is the current resolution, lowered to cap the bucket count */
+  size_t max_buckets;                     /**< max_buckets caps the total len of both ranges */
+  double zero_threshold;                  /**< zero_threshold is the half width of the zero bucket */
+  uint64_t zero_count;                    /**< zero_count is the count of the zero bucket */
+  prom_histogram_sparse_range_t positive; /**< positive holds the buckets of the positive values */
+  prom_histogram_sparse_range_t negative; /**< negative holds the buckets of the negative values, keyed by magnitude */
+} prom_histogram_sparse_t;
+
+#endif  // PROM_HISTOGRAM_SPARSE_T_H
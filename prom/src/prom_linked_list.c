@@ -46,7 +46,7 @@ int prom_linked_list_purge(prom_linked_list_t *self) {
         prom_free(node->item);
       }
     }
-    prom_free(node);
+    prom_object_free(node, sizeof(prom_linked_list_node_t));
     node = NULL;
     node = next;
   }
@@ -89,7 +89,7 @@ void *prom_linked_list_last(prom_linked_list_t *self) {
 int prom_linked_list_append(prom_linked_list_t *self, void *item) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
-  prom_linked_list_node_t *node = (prom_linked_list_node_t *)prom_malloc(sizeof(prom_linked_list_node_t));
+  prom_linked_list_node_t *node = (prom_linked_list_node_t *)prom_object_malloc(sizeof(prom_linked_list_node_t));
 
   node->item = item;
   if (self->tail) {
@@ -106,7 +106,7 @@ int prom_linked_list_append(prom_linked_list_t *self, void *item) {
 int prom_linked_list_push(prom_linked_list_t *self, void *item) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
-  prom_linked_list_node_t *node = (prom_linked_list_node_t *)prom_malloc(sizeof(prom_linked_list_node_t));
+  prom_linked_list_node_t *node = (prom_linked_list_node_t *)prom_object_malloc(sizeof(prom_linked_list_node_t));
 
   node->item = item;
   node->next = self->head;
@@ -183,7 +183,7 @@ int prom_linked_list_remove(prom_linked_list_t *self, void *item) {
   }
 
   node->item = NULL;
-  prom_free(node);
+  prom_object_free(node, sizeof(prom_linked_list_node_t));
   node = NULL;
   self->size--;
   return 0;
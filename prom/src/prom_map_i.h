@@ -17,6 +17,8 @@
 #ifndef PROM_MAP_I_INCLUDED
 #define PROM_MAP_I_INCLUDED
 
+#include <stdbool.h>
+
 #include "prom_map_t.h"
 
 prom_map_t *prom_map_new(void);
@@ -29,10 +31,31 @@ int prom_map_set(prom_map_t *self, const char *key, void *value);
 
 int prom_map_delete(prom_map_t *self, const char *key);
 
+/**
+ * @brief API PRIVATE Deletes every entry for which match_fn returns true, in a single pass over the entries.
+ *
+ * The entry array is compacted at most once, after the pass, so nothing is allocated unless enough entries went away.
+ */
+int prom_map_delete_matching(prom_map_t *self, prom_map_node_match_fn match_fn, void *arg);
+
 int prom_map_destroy(prom_map_t *self);
 
 size_t prom_map_size(prom_map_t *self);
 
-prom_map_node_t *prom_map_node_new(const char *key, void *value, prom_map_node_free_value_fn free_value_fn);
+/**
+ * @brief API PRIVATE Returns the approximate heap memory of the map and its keys in bytes, not counting the values. The
+ * caller must hold whatever lock keeps the map from being modified.
+ */
+size_t prom_map_memory(prom_map_t *self);
+
+/**
+ * @brief API PRIVATE Advances *iter to the next live entry in insertion order.
+ *
+ * Start with *iter set to 0. The map is not locked; the caller must hold whatever lock keeps it from being modified
+ * for the duration of the iteration.
+ *
+ * @return true if an entry was found, in which case its key and value are stored in *key and *value (either may be NULL)
+ */
+bool prom_map_next(prom_map_t *self, size_t *iter, const char **key, void **value);
 
 #endif  // PROM_MAP_I_INCLUDED
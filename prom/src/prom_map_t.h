@@ -18,26 +18,36 @@
 #define PROM_MAP_T_H
 
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 // Public
 #include "prom_map.h"
 
-// Private
-#include "prom_linked_list_t.h"
-
 typedef void (*prom_map_node_free_value_fn)(void *);
 
+typedef bool (*prom_map_node_match_fn)(const char *key, void *value, void *arg);
+
 struct prom_map_node {
-  const char *key;
+  const char *key; /**< owned copy of the key, NULL once the entry is deleted */
   void *value;
-  prom_map_node_free_value_fn free_value_fn;
+  uint64_t hash; /**< hash of key, compared before the key itself */
 };
 
+/**
+ * @brief Open-addressing hash map that keeps insertion order.
+ *
+ * Entries live in a dense array in insertion order. The index is a power-of-two table of positions into that array
+ * probed linearly, so lookups never allocate and iteration follows insertion order.
+ */
 struct prom_map {
-  size_t size;                /**< contains the size of the map */
-  size_t max_size;            /**< stores the current max_size */
-  prom_linked_list_t *keys;   /**< linked list containing containing all keys present */
-  prom_linked_list_t **addrs; /**< Sequence of linked lists. Each list contains nodes with the same index */
+  size_t size;               /**< number of live entries */
+  size_t max_size;           /**< number of index slots, always a power of two */
+  size_t used;               /**< index slots that are not empty, including tombstones */
+  prom_map_node_t *entries;  /**< entries in insertion order, deleted entries have a NULL key */
+  size_t entries_len;        /**< number of entries in use, including deleted ones */
+  size_t entries_cap;        /**< allocated capacity of entries */
+  uint32_t *index;           /**< positions into entries, or PROM_MAP_EMPTY/PROM_MAP_DELETED */
   pthread_rwlock_t *rwlock;
   prom_map_node_free_value_fn free_value_fn;
 };
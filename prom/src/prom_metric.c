@@ -15,6 +15,8 @@
  */
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
 // Public
 #include "prom_alloc.h"
@@ -27,11 +29,72 @@
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_i.h"
+#include "prom_metric_protobuf_i.h"
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_i.h"
+#include "prom_metric_sample_summary_i.h"
 
 char *prom_metric_type_map[4] = {"counter", "gauge", "histogram", "summary"};
 
+// Set once anything asks for the protobuf exposition
+static atomic_bool prom_metric_snapshot_protobuf = ATOMIC_VAR_INIT(false);
+
+// Live series of every metric, and the cap prom_metric_set_global_max_series put on them (0 for none)
+static atomic_size_t prom_metric_series_count = ATOMIC_VAR_INIT(0);
+static atomic_size_t prom_metric_global_max_series = ATOMIC_VAR_INIT(0);
+
+// The label set of the overflow series
+static const char *prom_metric_overflow_label_keys[1] = {PROM_METRIC_OVERFLOW_LABEL};
+static const char *prom_metric_overflow_label_values[1] = {"true"};
+
+/**
+ * @brief API PRIVATE Returns the function freeing the values of a samples map for the metric type
+ */
+static prom_map_node_free_value_fn prom_metric_free_value_fn(prom_metric_type_t metric_type) {
+  if (metric_type == PROM_HISTOGRAM) return &prom_metric_sample_histogram_free_generic;
+  if (metric_type == PROM_SUMMARY) return &prom_metric_sample_summary_free_generic;
+  return &prom_metric_sample_free_generic;
+}
+
+/**
+ * @brief API PRIVATE Records a removed series for delta scrapes. Only metrics a delta scrape has visited keep
+ * tombstones; when the ring is full the oldest is dropped and clients that have not seen it get the whole metric.
+ * Takes ownership of l_value. The caller must hold the write lock.
+ */
+static void prom_metric_add_removed(prom_metric_t *self, char *l_value) {
+  if (self->delta_gen == 0) {
+    prom_free(l_value);
+    return;
+  }
+  if (self->removed == NULL) {
+    size_t size = sizeof(prom_metric_tombstone_t) * PROM_METRIC_TOMBSTONES_MAX;
+    self->removed = (prom_metric_tombstone_t *)prom_malloc(size);
+  }
+  if (self->removed_count == PROM_METRIC_TOMBSTONES_MAX) {
+    prom_metric_tombstone_t *oldest = &self->removed[self->removed_head];
+    if (oldest->gen > self->delta_reset_gen) self->delta_reset_gen = oldest->gen;
+    prom_free(oldest->l_value);
+    self->removed_head = (self->removed_head + 1) % PROM_METRIC_TOMBSTONES_MAX;
+    self->removed_count--;
+  }
+  prom_metric_tombstone_t *tombstone =
+      &self->removed[(self->removed_head + self->removed_count) % PROM_METRIC_TOMBSTONES_MAX];
+  tombstone->l_value = l_value;
+  tombstone->gen = self->delta_gen + 1;
+  self->removed_count++;
+}
+
+/**
+ * @brief API PRIVATE Drops every tombstone. The caller must hold the write lock, or be destroying the metric.
+ */
+static void prom_metric_forget_removed(prom_metric_t *self) {
+  for (size_t i = 0; i < self->removed_count; i++) {
+    prom_free(self->removed[(self->removed_head + i) % PROM_METRIC_TOMBSTONES_MAX].l_value);
+  }
+  self->removed_head = 0;
+  self->removed_count = 0;
+}
+
 prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name, const char *help,
                                size_t label_key_count, const char **label_keys) {
   int r = 0;
@@ -40,6 +103,26 @@ prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name,
   self->name = name;
   self->help = help;
   self->buckets = NULL;
+  self->sharded = false;
+  self->sparse_schema = 0;
+  self->sparse_max_buckets = 0;
+  self->quantiles = NULL;
+  self->quantile_count = 0;
+  self->max_age = 0.0;
+  self->max_series = 0;
+  self->dropped = 0;
+  self->gen = 0;
+  self->header = NULL;
+  self->snapshot = NULL;
+  pthread_mutex_init(&self->snapshot_lock, NULL);
+  self->batch = NULL;
+  self->staged = NULL;
+  self->staging = false;
+  self->delta_gen = 0;
+  self->delta_reset_gen = 0;
+  self->removed = NULL;
+  self->removed_head = 0;
+  self->removed_count = 0;
 
   const char **k = (const char **)prom_malloc(sizeof(const char *) * label_key_count);
 
@@ -60,18 +143,10 @@ prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name,
   self->label_key_count = label_key_count;
   self->samples = prom_map_new();
 
-  if (metric_type == PROM_HISTOGRAM) {
-    r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_histogram_free_generic);
-    if (r) {
-      prom_metric_destroy(self);
-      return NULL;
-    }
-  } else {
-    r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
-    if (r) {
-      prom_metric_destroy(self);
-      return NULL;
-    }
+  r = prom_map_set_free_value_fn(self->samples, prom_metric_free_value_fn(metric_type));
+  if (r) {
+    prom_metric_destroy(self);
+    return NULL;
   }
 
   self->formatter = prom_metric_formatter_new();
@@ -79,6 +154,13 @@ prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name,
     prom_metric_destroy(self);
     return NULL;
   }
+  r = prom_metric_formatter_load_help(self->formatter, self->name, self->help);
+  if (!r) r = prom_metric_formatter_load_type(self->formatter, self->name, self->type);
+  if (!r) self->header = prom_metric_formatter_dump(self->formatter);
+  if (self->header == NULL) {
+    prom_metric_destroy(self);
+    return NULL;
+  }
   self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
   r = pthread_rwlock_init(self->rwlock, NULL);
   if (r) {
@@ -101,10 +183,28 @@ int prom_metric_destroy(prom_metric_t *self) {
     if (r) ret = r;
   }
 
+  prom_free(self->quantiles);
+  self->quantiles = NULL;
+
+  if (self->samples != NULL) atomic_fetch_sub(&prom_metric_series_count, prom_map_size(self->samples));
   r = prom_map_destroy(self->samples);
   self->samples = NULL;
   if (r) ret = r;
 
+  prom_metric_snapshot_release(self->snapshot);
+  self->snapshot = NULL;
+  prom_metric_snapshot_release(self->staged);
+  self->staged = NULL;
+  prom_metric_batch_release(self->batch);
+  self->batch = NULL;
+  prom_free(self->header);
+  self->header = NULL;
+  pthread_mutex_destroy(&self->snapshot_lock);
+
+  prom_metric_forget_removed(self);
+  prom_free(self->removed);
+  self->removed = NULL;
+
   r = prom_metric_formatter_destroy(self->formatter);
   self->formatter = NULL;
   if (r) ret = r;
@@ -144,7 +244,29 @@ void prom_metric_free_generic(void *item) {
   prom_metric_destroy(self);
 }
 
-prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const char **label_values) {
+/**
+ * @brief API PRIVATE Called when the l_value in the formatter names no series yet. If the metric or all metrics
+ * together are at their series cap, loads the l_value of the overflow series instead, counts the sample as dropped and
+ * sets *overflow. The caller holds the write lock.
+ */
+static int prom_metric_load_overflow(prom_metric_t *self, bool *overflow) {
+  *overflow = false;
+  // Without labels there is a single series anyway
+  if (self->label_key_count == 0) return 0;
+  size_t global_max = atomic_load(&prom_metric_global_max_series);
+  if ((self->max_series == 0 || prom_map_size(self->samples) < self->max_series) &&
+      (global_max == 0 || atomic_load(&prom_metric_series_count) < global_max)) {
+    return 0;
+  }
+  *overflow = true;
+  self->dropped++;
+  prom_metric_formatter_reset(self->formatter);
+  return prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, 1, prom_metric_overflow_label_keys,
+                                            prom_metric_overflow_label_values);
+}
+
+static prom_metric_sample_t *prom_metric_sample_from_labels_internal(prom_metric_t *self, const char **label_values,
+                                                                    bool retain) {
   PROM_ASSERT(self != NULL);
   int r = 0;
   r = pthread_rwlock_wrlock(self->rwlock);
@@ -162,31 +284,57 @@ prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const
   r = prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, self->label_key_count, self->label_keys,
                                          label_values);
   if (r) {
+    prom_metric_formatter_reset(self->formatter);
     PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
   }
 
-  // This must be freed before returning
-  const char *l_value = prom_metric_formatter_dump(self->formatter);
-  if (l_value == NULL) {
-    PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
-  }
+  // Look the l_value up in place; it is only copied when a new sample is created
+  const char *l_value = prom_metric_formatter_str(self->formatter);
 
   // Get sample
   prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(self->samples, l_value);
+  bool overflow = false;
   if (sample == NULL) {
-    sample = prom_metric_sample_new(self->type, l_value, 0.0);
+    r = prom_metric_load_overflow(self, &overflow);
+    if (r) {
+      prom_metric_formatter_reset(self->formatter);
+      PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
+    }
+    l_value = prom_metric_formatter_str(self->formatter);
+    if (overflow) sample = (prom_metric_sample_t *)prom_map_get(self->samples, l_value);
+  }
+  if (sample == NULL) {
+    sample = self->sharded ? prom_metric_sample_new_sharded(self->type, l_value)
+                           : prom_metric_sample_new(self->type, l_value, 0.0);
+    // The overflow series has none of the metric's labels, see prom_metric_label_pairs
+    if (!overflow) sample->label_values = prom_metric_sample_label_values_copy(self->label_key_count, label_values);
     r = prom_map_set(self->samples, l_value, sample);
     if (r) {
+      prom_metric_sample_destroy(sample);
+      prom_metric_formatter_reset(self->formatter);
       PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
     }
+    atomic_fetch_add(&prom_metric_series_count, 1);
   }
+  prom_metric_formatter_reset(self->formatter);
+  sample->gen = self->gen;
+  // Taken under the lock so a concurrent remove or clear cannot free the sample first
+  if (retain) prom_metric_sample_retain(sample);
   pthread_rwlock_unlock(self->rwlock);
-  prom_free((void *)l_value);
   return sample;
 }
 
-prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_metric_t *self,
-                                                                         const char **label_values) {
+prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const char **label_values) {
+  return prom_metric_sample_from_labels_internal(self, label_values, false);
+}
+
+prom_metric_sample_t *prom_metric_sample_child_from_labels(prom_metric_t *self, const char **label_values) {
+  return prom_metric_sample_from_labels_internal(self, label_values, true);
+}
+
+static prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels_internal(prom_metric_t *self,
+                                                                                         const char **label_values,
+                                                                                         bool retain) {
   PROM_ASSERT(self != NULL);
 
   int r = 0;
@@ -198,45 +346,230 @@ prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_me
 
 #define PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK() \
   r = pthread_rwlock_unlock(self->rwlock);                       \
-  if (r) {                                                       \
-    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);                  \
-    return NULL;                                                 \
-  }
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);             \
+  return NULL;
 
   // Load the l_value
   r = prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, self->label_key_count, self->label_keys,
                                          label_values);
   if (r) {
+    prom_metric_formatter_reset(self->formatter);
     PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
   }
 
-  // This must be freed before returning
-  const char *l_value = prom_metric_formatter_dump(self->formatter);
-  if (l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
-  }
+  // Look the l_value up in place; it is only copied when a new sample is created
+  const char *l_value = prom_metric_formatter_str(self->formatter);
 
   // Get sample
   prom_metric_sample_histogram_t *sample = (prom_metric_sample_histogram_t *)prom_map_get(self->samples, l_value);
+  bool overflow = false;
   if (sample == NULL) {
-    sample = prom_metric_sample_histogram_new(self->name, self->buckets, self->label_key_count, self->label_keys,
-                                              label_values);
+    r = prom_metric_load_overflow(self, &overflow);
+    if (r) {
+      prom_metric_formatter_reset(self->formatter);
+      PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
+    }
+    l_value = prom_metric_formatter_str(self->formatter);
+    if (overflow) sample = (prom_metric_sample_histogram_t *)prom_map_get(self->samples, l_value);
+  }
+  if (sample == NULL) {
+    size_t label_count = self->label_key_count;
+    const char **label_keys = self->label_keys;
+    if (overflow) {
+      label_count = 1;
+      label_keys = prom_metric_overflow_label_keys;
+      label_values = prom_metric_overflow_label_values;
+    }
+    if (self->sparse_max_buckets > 0) {
+      sample = prom_metric_sample_histogram_new_sparse(self->name, self->sparse_schema, self->sparse_max_buckets,
+                                                       label_count, label_keys, label_values);
+    } else {
+      sample = prom_metric_sample_histogram_new(self->name, self->buckets, label_count, label_keys, label_values);
+    }
     if (sample == NULL) {
-      prom_free((void *)l_value);
+      prom_metric_formatter_reset(self->formatter);
       PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
     }
+    if (overflow) {
+      // The lines carry the overflow label; the series has none of the metric's labels, see prom_metric_label_pairs
+      prom_free((void *)sample->label_values);
+      sample->label_values = NULL;
+    }
     r = prom_map_set(self->samples, l_value, sample);
     if (r) {
-      prom_free((void *)l_value);
-      pthread_rwlock_unlock(self->rwlock);
+      prom_metric_sample_histogram_destroy(sample);
+      prom_metric_formatter_reset(self->formatter);
       PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
     }
+    atomic_fetch_add(&prom_metric_series_count, 1);
   }
+  prom_metric_formatter_reset(self->formatter);
+  sample->gen = self->gen;
+  if (retain) prom_metric_sample_histogram_retain(sample);
   pthread_rwlock_unlock(self->rwlock);
-  prom_free((void *)l_value);
   return sample;
 }
 
+prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_metric_t *self,
+                                                                         const char **label_values) {
+  return prom_metric_sample_histogram_from_labels_internal(self, label_values, false);
+}
+
+prom_metric_sample_histogram_t *prom_metric_sample_histogram_child_from_labels(prom_metric_t *self,
+                                                                               const char **label_values) {
+  return prom_metric_sample_histogram_from_labels_internal(self, label_values, true);
+}
+
+static prom_metric_sample_summary_t *prom_metric_sample_summary_from_labels_internal(prom_metric_t *self,
+                                                                                     const char **label_values,
+                                                                                     bool retain) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+  r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return NULL;
+  }
+
+#define PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK() \
+  r = pthread_rwlock_unlock(self->rwlock);                     \
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);           \
+  return NULL;
+
+  // Load the l_value
+  r = prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, self->label_key_count, self->label_keys,
+                                         label_values);
+  if (r) {
+    prom_metric_formatter_reset(self->formatter);
+    PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK();
+  }
+
+  // Look the l_value up in place; it is only copied when a new sample is created
+  const char *l_value = prom_metric_formatter_str(self->formatter);
+
+  // Get sample
+  prom_metric_sample_summary_t *sample = (prom_metric_sample_summary_t *)prom_map_get(self->samples, l_value);
+  bool overflow = false;
+  if (sample == NULL) {
+    r = prom_metric_load_overflow(self, &overflow);
+    if (r) {
+      prom_metric_formatter_reset(self->formatter);
+      PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK();
+    }
+    l_value = prom_metric_formatter_str(self->formatter);
+    if (overflow) sample = (prom_metric_sample_summary_t *)prom_map_get(self->samples, l_value);
+  }
+  if (sample == NULL) {
+    size_t label_count = self->label_key_count;
+    const char **label_keys = self->label_keys;
+    if (overflow) {
+      label_count = 1;
+      label_keys = prom_metric_overflow_label_keys;
+      label_values = prom_metric_overflow_label_values;
+    }
+    sample = prom_metric_sample_summary_new(self->name, self->quantile_count, self->quantiles, self->max_age,
+                                            label_count, label_keys, label_values);
+    if (sample == NULL) {
+      prom_metric_formatter_reset(self->formatter);
+      PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK();
+    }
+    if (overflow) {
+      // The lines carry the overflow label; the series has none of the metric's labels, see prom_metric_label_pairs
+      prom_free((void *)sample->label_values);
+      sample->label_values = NULL;
+    }
+    r = prom_map_set(self->samples, l_value, sample);
+    if (r) {
+      prom_metric_sample_summary_destroy(sample);
+      prom_metric_formatter_reset(self->formatter);
+      PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK();
+    }
+    atomic_fetch_add(&prom_metric_series_count, 1);
+  }
+  prom_metric_formatter_reset(self->formatter);
+  sample->gen = self->gen;
+  if (retain) prom_metric_sample_summary_retain(sample);
+  pthread_rwlock_unlock(self->rwlock);
+  return sample;
+}
+
+prom_metric_sample_summary_t *prom_metric_sample_summary_from_labels(prom_metric_t *self, const char **label_values) {
+  return prom_metric_sample_summary_from_labels_internal(self, label_values, false);
+}
+
+prom_metric_sample_summary_t *prom_metric_sample_summary_child_from_labels(prom_metric_t *self,
+                                                                           const char **label_values) {
+  return prom_metric_sample_summary_from_labels_internal(self, label_values, true);
+}
+
+/**
+ * @brief API PRIVATE Render the metric and publish the result as its snapshot, or stage it for prom_metrics_commit
+ * once the metric is committed in batches. The caller must hold the write lock. A render byte-identical to the
+ * current snapshot keeps that snapshot, along with the encodings cached on it.
+ */
+static int prom_metric_commit(prom_metric_t *self) {
+  prom_metric_snapshot_t *current = self->staged != NULL ? self->staged : self->snapshot;
+  int r = prom_metric_formatter_load_metric(self->formatter, self);
+  if (r) {
+    prom_metric_formatter_reset(self->formatter);
+    return r;
+  }
+
+  size_t len = prom_metric_formatter_len(self->formatter);
+  const char *text = prom_metric_formatter_str(self->formatter);
+  bool unchanged = current != NULL && current->len == len && memcmp(current->text, text, len) == 0;
+  prom_metric_snapshot_t *snapshot = (prom_metric_snapshot_t *)prom_malloc(sizeof(prom_metric_snapshot_t));
+  snapshot->len = len;
+  // An unchanged text is copied from the current snapshot only if the protobuf turns out to differ
+  snapshot->text = unchanged ? NULL : (char *)prom_malloc(len + 1);
+  if (!unchanged) memcpy(snapshot->text, text, len + 1);
+  snapshot->proto = NULL;
+  snapshot->proto_len = 0;
+  snapshot->ref_count = ATOMIC_VAR_INIT(1);
+  for (int i = 0; i < PROM_METRIC_SNAPSHOT_ENCODINGS; i++) atomic_init(&snapshot->encoded[i], NULL);
+  // The formatter keeps its buffer, so the next commit renders without growing it again
+  prom_metric_formatter_reset(self->formatter);
+
+  if (atomic_load_explicit(&prom_metric_snapshot_protobuf, memory_order_relaxed)) {
+    r = prom_metric_protobuf_load_metric(self->formatter, self);
+    if (r) {
+      prom_metric_formatter_reset(self->formatter);
+      prom_metric_snapshot_release(snapshot);
+      return r;
+    }
+    snapshot->proto_len = prom_metric_formatter_len(self->formatter);
+    const char *proto = prom_metric_formatter_str(self->formatter);
+    unchanged = unchanged && current->proto != NULL && current->proto_len == snapshot->proto_len &&
+                memcmp(current->proto, proto, snapshot->proto_len) == 0;
+    if (!unchanged) {
+      snapshot->proto = (char *)prom_malloc(snapshot->proto_len + 1);
+      memcpy(snapshot->proto, proto, snapshot->proto_len);
+    }
+    prom_metric_formatter_reset(self->formatter);
+  }
+
+  if (unchanged) {
+    prom_metric_snapshot_release(snapshot);
+    return 0;
+  }
+  if (snapshot->text == NULL) {
+    snapshot->text = (char *)prom_malloc(len + 1);
+    memcpy(snapshot->text, current->text, len + 1);
+  }
+
+  if (self->staging) {
+    prom_metric_snapshot_release(self->staged);
+    self->staged = snapshot;
+    return 0;
+  }
+  pthread_mutex_lock(&self->snapshot_lock);
+  prom_metric_snapshot_t *old = self->snapshot;
+  self->snapshot = snapshot;
+  pthread_mutex_unlock(&self->snapshot_lock);
+  prom_metric_snapshot_release(old);
+  return 0;
+}
+
 int prom_metric_remove_sample_from_labels(prom_metric_t *self, const char **label_values)
 {
   PROM_ASSERT(self != NULL);
@@ -265,7 +598,14 @@ int prom_metric_remove_sample_from_labels(prom_metric_t *self, const char **labe
   }
 
   // Delete sample
+  size_t size = prom_map_size(self->samples);
   ret = prom_map_delete(self->samples, l_value);
+  atomic_fetch_sub(&prom_metric_series_count, size - prom_map_size(self->samples));
+  if (prom_map_size(self->samples) < size) {
+    prom_metric_add_removed(self, l_value);
+    l_value = NULL;
+  }
+  if (ret == 0 && self->snapshot != NULL) ret = prom_metric_commit(self);
 
 out:
   pthread_rwlock_unlock(self->rwlock);
@@ -283,17 +623,340 @@ int prom_metric_clear_samples(prom_metric_t *self)
     return -1;
   }
 
-  if (self != NULL)
+  if (self != NULL) {
+    atomic_fetch_sub(&prom_metric_series_count, prom_map_size(self->samples));
     ret = prom_map_destroy(self->samples);
+  }
   if (ret == 0) {
     self->samples = prom_map_new();
+    prom_map_set_free_value_fn(self->samples, prom_metric_free_value_fn(self->type));
+    // Delta scrapes send the whole, now empty, metric rather than a tombstone per series
+    if (self->delta_gen != 0) {
+      prom_metric_forget_removed(self);
+      self->delta_reset_gen = self->delta_gen + 1;
+    }
+    if (self->snapshot != NULL) ret = prom_metric_commit(self);
+  }
+
+  pthread_rwlock_unlock(self->rwlock);
+  return ret;
+}
+
+/**
+ * @brief API PRIVATE A prom_map_node_match_fn selecting the samples not touched in the metric's current generation.
+ * Samples still referenced by a child handle are kept; those go away with an explicit remove.
+ */
+static bool prom_metric_sample_is_stale(const char *key, void *value, void *arg) {
+  prom_metric_t *self = (prom_metric_t *)arg;
+  if (self->type == PROM_HISTOGRAM) {
+    prom_metric_sample_histogram_t *hist = (prom_metric_sample_histogram_t *)value;
+    return hist->gen != self->gen && atomic_load(&hist->ref_count) == 1;
+  }
+  if (self->type == PROM_SUMMARY) {
+    prom_metric_sample_summary_t *summary = (prom_metric_sample_summary_t *)value;
+    return summary->gen != self->gen && atomic_load(&summary->ref_count) == 1;
+  }
+  prom_metric_sample_t *sample = (prom_metric_sample_t *)value;
+  return sample->gen != self->gen && atomic_load(&sample->ref_count) == 1;
+}
+
+/**
+ * @brief API PRIVATE prom_metric_sample_is_stale, also recording the stale samples for delta scrapes
+ */
+static bool prom_metric_sample_is_removed(const char *key, void *value, void *arg) {
+  if (!prom_metric_sample_is_stale(key, value, arg)) return false;
+  prom_metric_t *self = (prom_metric_t *)arg;
+  if (self->delta_gen != 0) prom_metric_add_removed(self, prom_strdup(key));
+  return true;
+}
+
+int prom_metric_begin_update(prom_metric_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  if (pthread_rwlock_wrlock(self->rwlock) != 0) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return 1;
+  }
+  self->gen++;
+  // Publish the state before the first cycle so scrapes never see a cycle half done
+  int ret = self->snapshot == NULL ? prom_metric_commit(self) : 0;
+  pthread_rwlock_unlock(self->rwlock);
+  return ret;
+}
+
+int prom_metric_end_update(prom_metric_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  if (pthread_rwlock_wrlock(self->rwlock) != 0) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return 1;
+  }
+  size_t size = prom_map_size(self->samples);
+  int ret = prom_map_delete_matching(self->samples, prom_metric_sample_is_removed, self);
+  atomic_fetch_sub(&prom_metric_series_count, size - prom_map_size(self->samples));
+  if (ret == 0) ret = prom_metric_commit(self);
+  pthread_rwlock_unlock(self->rwlock);
+  return ret;
+}
+
+int prom_metric_set_max_series(prom_metric_t *self, size_t max_series) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  if (pthread_rwlock_wrlock(self->rwlock) != 0) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return 1;
+  }
+  self->max_series = max_series;
+  pthread_rwlock_unlock(self->rwlock);
+  return 0;
+}
+
+void prom_metric_set_global_max_series(size_t max_series) {
+  atomic_store(&prom_metric_global_max_series, max_series);
+}
+
+const char *prom_metric_name(prom_metric_t *self) {
+  PROM_ASSERT(self != NULL);
+  return self->name;
+}
+
+size_t prom_metric_series_total(void) { return atomic_load(&prom_metric_series_count); }
+
+size_t prom_metric_label_pairs(prom_metric_t *self, const char **label_values, const char ***label_keys,
+                               const char ***pair_values) {
+  PROM_ASSERT(self != NULL);
+  if (label_values == NULL && self->label_key_count > 0) {
+    *label_keys = prom_metric_overflow_label_keys;
+    *pair_values = prom_metric_overflow_label_values;
+    return 1;
+  }
+  *label_keys = self->label_keys;
+  *pair_values = label_values;
+  return label_values == NULL ? 0 : self->label_key_count;
+}
+
+/**
+ * @brief API PRIVATE Returns the approximate heap memory of a committed snapshot and its cached encodings
+ */
+static size_t prom_metric_snapshot_memory(prom_metric_snapshot_t *snapshot) {
+  size_t size = sizeof(prom_metric_snapshot_t) + snapshot->len + 1;
+  if (snapshot->proto != NULL) size += snapshot->proto_len + 1;
+  for (int i = 0; i < PROM_METRIC_SNAPSHOT_ENCODINGS; i++) {
+    prom_metric_snapshot_encoded_t *encoded = atomic_load_explicit(&snapshot->encoded[i], memory_order_acquire);
+    if (encoded != NULL) size += sizeof(prom_metric_snapshot_encoded_t) + encoded->len;
+  }
+  return size;
+}
+
+int prom_metric_stats(prom_metric_t *self, size_t *series, size_t *memory, uint64_t *dropped) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  if (pthread_rwlock_rdlock(self->rwlock) != 0) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return 1;
+  }
+  *series = prom_map_size(self->samples);
+  *dropped = self->dropped;
+
+  size_t size = sizeof(prom_metric_t) + sizeof(pthread_rwlock_t) + strlen(self->header) + 1 +
+                sizeof(const char *) * self->label_key_count + prom_map_memory(self->samples) +
+                prom_metric_formatter_memory(self->formatter);
+  for (size_t i = 0; i < self->label_key_count; i++) size += strlen(self->label_keys[i]) + 1;
+  if (self->quantiles != NULL) size += sizeof(double) * self->quantile_count;
+
+  size_t iter = 0;
+  void *value = NULL;
+  while (prom_map_next(self->samples, &iter, NULL, &value)) {
+    const char **label_values = NULL;
     if (self->type == PROM_HISTOGRAM) {
-      prom_map_set_free_value_fn(self->samples, &prom_metric_sample_histogram_free_generic);
+      prom_metric_sample_histogram_t *hist = (prom_metric_sample_histogram_t *)value;
+      size += prom_metric_sample_histogram_memory(hist);
+      label_values = hist->label_values;
+    } else if (self->type == PROM_SUMMARY) {
+      prom_metric_sample_summary_t *summary = (prom_metric_sample_summary_t *)value;
+      size += prom_metric_sample_summary_memory(summary);
+      label_values = summary->label_values;
     } else {
-      prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
+      prom_metric_sample_t *sample = (prom_metric_sample_t *)value;
+      size += prom_metric_sample_memory(sample);
+      label_values = sample->label_values;
     }
+    size += prom_metric_sample_label_values_memory(self->label_key_count, label_values);
   }
 
+  pthread_mutex_lock(&self->snapshot_lock);
+  if (self->snapshot != NULL) size += prom_metric_snapshot_memory(self->snapshot);
+  pthread_mutex_unlock(&self->snapshot_lock);
+  if (self->staged != NULL) size += prom_metric_snapshot_memory(self->staged);
+
   pthread_rwlock_unlock(self->rwlock);
+  *memory = size;
+  return 0;
+}
+
+prom_metric_snapshot_t *prom_metric_snapshot_acquire(prom_metric_t *self, prom_metric_pins_t *pins) {
+  PROM_ASSERT(self != NULL);
+  prom_metric_snapshot_t *snapshot = NULL;
+  // A metric of a batch this scrape has already rendered from comes from that batch too
+  if (pins != NULL) {
+    for (size_t i = 0; i < pins->count; i++) {
+      prom_metric_batch_t *batch = pins->batches[i];
+      for (size_t j = 0; j < batch->count; j++) {
+        if (batch->metrics[j] != self) continue;
+        snapshot = batch->snapshots[j];
+        atomic_fetch_add_explicit(&snapshot->ref_count, 1, memory_order_relaxed);
+        return snapshot;
+      }
+    }
+  }
+
+  prom_metric_batch_t *batch = NULL;
+  pthread_mutex_lock(&self->snapshot_lock);
+  snapshot = self->snapshot;
+  if (snapshot != NULL) atomic_fetch_add_explicit(&snapshot->ref_count, 1, memory_order_relaxed);
+  if (pins != NULL && self->batch != NULL) {
+    batch = self->batch;
+    atomic_fetch_add_explicit(&batch->ref_count, 1, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&self->snapshot_lock);
+
+  if (batch != NULL) {
+    if (pins->count == pins->size) {
+      size_t size = pins->size == 0 ? 8 : pins->size * 2;
+      prom_metric_batch_t **batches =
+          (prom_metric_batch_t **)prom_realloc(pins->batches, sizeof(prom_metric_batch_t *) * size);
+      if (batches == NULL) {
+        // Rendering the rest of the batch from later commits is still correct, only not consistent
+        prom_metric_batch_release(batch);
+        return snapshot;
+      }
+      pins->batches = batches;
+      pins->size = size;
+    }
+    pins->batches[pins->count++] = batch;
+  }
+  return snapshot;
+}
+
+void prom_metric_pins_release(prom_metric_pins_t *pins) {
+  for (size_t i = 0; i < pins->count; i++) prom_metric_batch_release(pins->batches[i]);
+  prom_free(pins->batches);
+  pins->batches = NULL;
+  pins->count = 0;
+  pins->size = 0;
+}
+
+void prom_metric_batch_release(prom_metric_batch_t *batch) {
+  if (batch == NULL) return;
+  if (atomic_fetch_sub_explicit(&batch->ref_count, 1, memory_order_acq_rel) != 1) return;
+  for (size_t i = 0; i < batch->count; i++) prom_metric_snapshot_release(batch->snapshots[i]);
+  prom_free(batch->snapshots);
+  prom_free(batch->metrics);
+  prom_free(batch);
+}
+
+int prom_metrics_commit(prom_metric_t **metrics, size_t count) {
+  PROM_ASSERT(metrics != NULL || count == 0);
+  if (count == 0) return 0;
+
+  int ret = 0;
+  prom_metric_batch_t *batch = (prom_metric_batch_t *)prom_malloc(sizeof(prom_metric_batch_t));
+  atomic_init(&batch->ref_count, 1);
+  batch->count = 0;
+  batch->metrics = (prom_metric_t **)prom_malloc(sizeof(prom_metric_t *) * count);
+  batch->snapshots = (prom_metric_snapshot_t **)prom_malloc(sizeof(prom_metric_snapshot_t *) * count);
+
+  // Collect every metric's staged snapshot, or its current one if the cycle changed nothing
+  for (size_t i = 0; i < count; i++) {
+    prom_metric_t *metric = metrics[i];
+    if (pthread_rwlock_wrlock(metric->rwlock) != 0) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+      ret = 1;
+      continue;
+    }
+    metric->staging = true;
+    prom_metric_snapshot_t *snapshot = metric->staged;
+    metric->staged = NULL;
+    if (snapshot == NULL && metric->snapshot != NULL) {
+      snapshot = metric->snapshot;
+      atomic_fetch_add_explicit(&snapshot->ref_count, 1, memory_order_relaxed);
+    }
+    pthread_rwlock_unlock(metric->rwlock);
+    // Metrics never updated in cycles render live
+    if (snapshot == NULL) continue;
+    batch->metrics[batch->count] = metric;
+    batch->snapshots[batch->count] = snapshot;
+    batch->count++;
+  }
+
+  // A scrape meeting the batch at any of its metrics takes the others from it too, so the order of the swaps does not
+  // matter
+  for (size_t i = 0; i < batch->count; i++) {
+    prom_metric_t *metric = batch->metrics[i];
+    if (pthread_rwlock_wrlock(metric->rwlock) != 0) {
+      PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+      ret = 1;
+      continue;
+    }
+    atomic_fetch_add_explicit(&batch->snapshots[i]->ref_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&batch->ref_count, 1, memory_order_relaxed);
+    pthread_mutex_lock(&metric->snapshot_lock);
+    prom_metric_snapshot_t *old = metric->snapshot;
+    prom_metric_batch_t *old_batch = metric->batch;
+    metric->snapshot = batch->snapshots[i];
+    metric->batch = batch;
+    pthread_mutex_unlock(&metric->snapshot_lock);
+    pthread_rwlock_unlock(metric->rwlock);
+    prom_metric_snapshot_release(old);
+    prom_metric_batch_release(old_batch);
+  }
+  prom_metric_batch_release(batch);
   return ret;
+}
+
+void prom_metric_snapshot_release(prom_metric_snapshot_t *snapshot) {
+  if (snapshot == NULL) return;
+  if (atomic_fetch_sub_explicit(&snapshot->ref_count, 1, memory_order_acq_rel) != 1) return;
+  for (int i = 0; i < PROM_METRIC_SNAPSHOT_ENCODINGS; i++) prom_free(atomic_load(&snapshot->encoded[i]));
+  prom_free(snapshot->proto);
+  prom_free(snapshot->text);
+  prom_free(snapshot);
+}
+
+void prom_metric_snapshot_enable_protobuf(void) {
+  atomic_store_explicit(&prom_metric_snapshot_protobuf, true, memory_order_relaxed);
+}
+
+const char *prom_metric_snapshot_get_encoded(prom_metric_snapshot_t *self, int slot, size_t *len) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || slot < 0 || slot >= PROM_METRIC_SNAPSHOT_ENCODINGS) return NULL;
+  prom_metric_snapshot_encoded_t *encoded = atomic_load_explicit(&self->encoded[slot], memory_order_acquire);
+  if (encoded == NULL) return NULL;
+  *len = encoded->len;
+  return encoded->data;
+}
+
+const char *prom_metric_snapshot_set_encoded(prom_metric_snapshot_t *self, int slot, const char *data, size_t *len) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || slot < 0 || slot >= PROM_METRIC_SNAPSHOT_ENCODINGS) return NULL;
+
+  prom_metric_snapshot_encoded_t *encoded =
+      (prom_metric_snapshot_encoded_t *)prom_malloc(sizeof(prom_metric_snapshot_encoded_t) + *len);
+  if (encoded == NULL) return NULL;
+  encoded->len = *len;
+  memcpy(encoded->data, data, *len);
+
+  prom_metric_snapshot_encoded_t *expected = NULL;
+  if (!atomic_compare_exchange_strong_explicit(&self->encoded[slot], &expected, encoded, memory_order_acq_rel,
+                                               memory_order_acquire)) {
+    // Another scrape encoded the same text first
+    prom_free(encoded);
+    encoded = expected;
+  }
+  *len = encoded->len;
+  return encoded->data;
 }
\ No newline at end of file
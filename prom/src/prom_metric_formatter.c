@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -22,13 +25,19 @@
 // Private
 #include "prom_assert.h"
 #include "prom_collector_t.h"
-#include "prom_linked_list_t.h"
+#include "prom_errors.h"
+#include "prom_histogram_sparse_i.h"
+#include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
-#include "prom_metric_sample_histogram_t.h"
+#include "prom_metric_i.h"
+#include "prom_metric_sample_histogram_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_summary_i.h"
 #include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
 #include "prom_string_builder_i.h"
+#include "prom_text_writer_i.h"
 
 prom_metric_formatter_t *prom_metric_formatter_new() {
   prom_metric_formatter_t *self = (prom_metric_formatter_t *)prom_malloc(sizeof(prom_metric_formatter_t));
@@ -80,7 +89,7 @@ int prom_metric_formatter_load_help(prom_metric_formatter_t *self, const char *n
   r = prom_string_builder_add_char(self->string_builder, ' ');
   if (r) return r;
 
-  r = prom_string_builder_add_str(self->string_builder, help);
+  r = prom_text_writer_add_escaped(self->string_builder, help, false);
   if (r) return r;
 
   return prom_string_builder_add_char(self->string_builder, '\n');
@@ -141,7 +150,7 @@ int prom_metric_formatter_load_l_value(prom_metric_formatter_t *self, const char
     r = prom_string_builder_add_char(self->string_builder, '"');
     if (r) return r;
 
-    r = prom_string_builder_add_str(self->string_builder, (const char *)label_values[i]);
+    r = prom_text_writer_add_escaped(self->string_builder, (const char *)label_values[i], true);
     if (r) return r;
 
     r = prom_string_builder_add_char(self->string_builder, '"');
@@ -161,26 +170,49 @@ int prom_metric_formatter_load_l_value(prom_metric_formatter_t *self, const char
 int prom_metric_formatter_load_sample(prom_metric_formatter_t *self, prom_metric_sample_t *sample) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
+  return prom_metric_formatter_load_sample_value(self, sample, prom_metric_sample_value(sample));
+}
 
-  int r = 0;
+int prom_metric_formatter_load_sample_value(prom_metric_formatter_t *self, prom_metric_sample_t *sample,
+                                            double value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
 
-  r = prom_string_builder_add_str(self->string_builder, sample->l_value);
-  if (r) return r;
+  // Series whose value did not change since the last render reuse their cached line
+  if (sample->line_len == 0 || memcmp(&value, &sample->line_value, sizeof(double)) != 0) {
+    char *end = sample->line + sample->prefix_len;
+    end += prom_text_writer_format_double(end, value);
+    *end++ = '\n';
+    sample->line_len = end - sample->line;
+    sample->line_value = value;
+  }
+  return prom_string_builder_add_strn(self->string_builder, sample->line, sample->line_len);
+}
 
-  r = prom_string_builder_add_char(self->string_builder, ' ');
-  if (r) return r;
+int prom_metric_formatter_clear(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  return prom_string_builder_clear(self->string_builder);
+}
 
-  char buffer[50];
-  sprintf(buffer, "%.17g", sample->r_value);
-  r = prom_string_builder_add_str(self->string_builder, buffer);
-  if (r) return r;
+int prom_metric_formatter_reset(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  return prom_string_builder_truncate(self->string_builder, 0);
+}
 
-  return prom_string_builder_add_char(self->string_builder, '\n');
+const char *prom_metric_formatter_str(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  return prom_string_builder_str(self->string_builder);
 }
 
-int prom_metric_formatter_clear(prom_metric_formatter_t *self) {
+size_t prom_metric_formatter_len(prom_metric_formatter_t *self) {
   PROM_ASSERT(self != NULL);
-  return prom_string_builder_clear(self->string_builder);
+  return prom_string_builder_len(self->string_builder);
+}
+
+size_t prom_metric_formatter_memory(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  return sizeof(prom_metric_formatter_t) + prom_string_builder_memory(self->string_builder) +
+         prom_string_builder_memory(self->err_builder);
 }
 
 char *prom_metric_formatter_dump(prom_metric_formatter_t *self) {
@@ -197,37 +229,170 @@ char *prom_metric_formatter_dump(prom_metric_formatter_t *self) {
   return data;
 }
 
+/**
+ * @brief API PRIVATE Loads one le bucket line of a sparse histogram. keys and values hold the label_count label pairs of
+ * the series with room for le at the end.
+ */
+static int prom_metric_formatter_load_sparse_bucket(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                                    size_t label_count, const char **keys, const char **values,
+                                                    double bound, uint64_t cumulative) {
+  char *le = prom_metric_sample_histogram_bucket_to_str(bound);
+  values[label_count] = le;
+  int r = prom_metric_formatter_load_l_value(self, metric->name, NULL, label_count + 1, keys, values);
+  prom_free(le);
+  if (r) return r;
+
+  char buf[PROM_METRIC_SAMPLE_VALUE_SIZE + 1];
+  buf[0] = ' ';
+  size_t len = 1 + prom_text_writer_format_double(buf + 1, (double)cumulative);
+  buf[len++] = '\n';
+  return prom_string_builder_add_strn(self->string_builder, buf, len);
+}
+
+/**
+ * @brief API PRIVATE Loads the populated buckets of a sparse histogram as cumulative le buckets, lowest bound first.
+ * The caller holds the histogram's lock.
+ */
+static int prom_metric_formatter_load_sparse(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                             prom_metric_sample_histogram_t *hist) {
+  prom_histogram_sparse_t *sparse = hist->sparse;
+  const char **label_keys = NULL;
+  const char **label_values = NULL;
+  size_t label_count = prom_metric_label_pairs(metric, hist->label_values, &label_keys, &label_values);
+  const char **keys = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+  const char **values = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+  for (size_t i = 0; i < label_count; i++) {
+    keys[i] = label_keys[i];
+    values[i] = label_values[i];
+  }
+  keys[label_count] = "le";
+
+  int r = 0;
+  uint64_t cumulative = 0;
+  // Negative key k holds [-bound(k), -bound(k - 1)), so the largest magnitude comes first
+  const prom_histogram_sparse_range_t *negative = &sparse->negative;
+  for (size_t i = negative->len; i-- > 0 && !r;) {
+    if (negative->counts[i] == 0) continue;
+    cumulative += negative->counts[i];
+    double bound = -prom_histogram_sparse_upper_bound(sparse, negative->offset + (int32_t)i - 1);
+    r = prom_metric_formatter_load_sparse_bucket(self, metric, label_count, keys, values, bound, cumulative);
+  }
+  if (!r && sparse->zero_count > 0) {
+    cumulative += sparse->zero_count;
+    r = prom_metric_formatter_load_sparse_bucket(self, metric, label_count, keys, values, sparse->zero_threshold,
+                                                 cumulative);
+  }
+  const prom_histogram_sparse_range_t *positive = &sparse->positive;
+  for (size_t i = 0; i < positive->len && !r; i++) {
+    if (positive->counts[i] == 0) continue;
+    cumulative += positive->counts[i];
+    double bound = prom_histogram_sparse_upper_bound(sparse, positive->offset + (int32_t)i);
+    r = prom_metric_formatter_load_sparse_bucket(self, metric, label_count, keys, values, bound, cumulative);
+  }
+
+  prom_free(keys);
+  prom_free(values);
+  return r;
+}
+
+/**
+ * @brief API PRIVATE Loads every line of a histogram series from the counts prom_metric_sample_histogram_collect read
+ * and returned sum of. The caller holds the histogram's lock.
+ */
+static int prom_metric_formatter_load_histogram_lines(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                                      prom_metric_sample_histogram_t *hist, double sum) {
+  int r = 0;
+  // The bucket lines, sparse buckets and +Inf carry the cumulative counts, then come count and sum
+  for (size_t i = 0; i < hist->bucket_count && !r; i++) {
+    r = prom_metric_formatter_load_sample_value(self, hist->lines[i], (double)hist->cumulative[i]);
+  }
+  if (!r && hist->sparse != NULL) r = prom_metric_formatter_load_sparse(self, metric, hist);
+  if (!r) {
+    r = prom_metric_formatter_load_sample_value(self, hist->lines[hist->bucket_count],
+                                                (double)hist->cumulative[hist->bucket_count]);
+  }
+  if (!r) {
+    r = prom_metric_formatter_load_sample_value(self, hist->lines[hist->bucket_count + 1],
+                                                (double)hist->cumulative[hist->bucket_count]);
+  }
+  if (!r) r = prom_metric_formatter_load_sample_value(self, hist->lines[hist->bucket_count + 2], sum);
+  return r;
+}
+
+/**
+ * @brief API PRIVATE Loads every line of a histogram series from one consistent read of its counters
+ */
+static int prom_metric_formatter_load_histogram(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                                prom_metric_sample_histogram_t *hist) {
+  int r = pthread_mutex_lock(&hist->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  double sum = prom_metric_sample_histogram_collect(hist);
+  r = prom_metric_formatter_load_histogram_lines(self, metric, hist, sum);
+  pthread_mutex_unlock(&hist->lock);
+  return r;
+}
+
+/**
+ * @brief API PRIVATE Loads every line of a summary series from the values prom_metric_sample_summary_collect read. The
+ * caller holds the summary's lock.
+ */
+static int prom_metric_formatter_load_summary_lines(prom_metric_formatter_t *self,
+                                                    prom_metric_sample_summary_t *summary, uint64_t count, double sum) {
+  int r = 0;
+  for (size_t i = 0; i < summary->quantile_count && !r; i++) {
+    r = prom_metric_formatter_load_sample_value(self, summary->lines[i], summary->values[i]);
+  }
+  if (!r) r = prom_metric_formatter_load_sample_value(self, summary->lines[summary->quantile_count], (double)count);
+  if (!r) r = prom_metric_formatter_load_sample_value(self, summary->lines[summary->quantile_count + 1], sum);
+  return r;
+}
+
+/**
+ * @brief API PRIVATE Loads every line of a summary series: its quantiles, count and sum
+ */
+static int prom_metric_formatter_load_summary(prom_metric_formatter_t *self, prom_metric_sample_summary_t *summary) {
+  int r = pthread_mutex_lock(&summary->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  uint64_t count = 0;
+  double sum = 0.0;
+  prom_metric_sample_summary_collect(summary, &count, &sum);
+  r = prom_metric_formatter_load_summary_lines(self, summary, count, sum);
+
+  pthread_mutex_unlock(&summary->lock);
+  return r;
+}
+
 int prom_metric_formatter_load_metric(prom_metric_formatter_t *self, prom_metric_t *metric) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
 
   int r = 0;
 
-  r = prom_metric_formatter_load_help(self, metric->name, metric->help);
-  if (r) return r;
-
-  r = prom_metric_formatter_load_type(self, metric->name, metric->type);
+  r = prom_string_builder_add_str(self->string_builder, metric->header);
   if (r) return r;
 
-  for (prom_linked_list_node_t *current_node = metric->samples->keys->head; current_node != NULL;
-       current_node = current_node->next) {
-    const char *key = (const char *)current_node->item;
+  size_t iter = 0;
+  void *value = NULL;
+  while (prom_map_next(metric->samples, &iter, NULL, &value)) {
     if (metric->type == PROM_HISTOGRAM) {
-      prom_metric_sample_histogram_t *hist_sample =
-          (prom_metric_sample_histogram_t *)prom_map_get(metric->samples, key);
-
+      prom_metric_sample_histogram_t *hist_sample = (prom_metric_sample_histogram_t *)value;
       if (hist_sample == NULL) return 1;
-
-      for (prom_linked_list_node_t *current_hist_node = hist_sample->l_value_list->head; current_hist_node != NULL;
-           current_hist_node = current_hist_node->next) {
-        const char *hist_key = (const char *)current_hist_node->item;
-        prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(hist_sample->samples, hist_key);
-        if (sample == NULL) return 1;
-        r = prom_metric_formatter_load_sample(self, sample);
-        if (r) return r;
-      }
+      r = prom_metric_formatter_load_histogram(self, metric, hist_sample);
+      if (r) return r;
+    } else if (metric->type == PROM_SUMMARY) {
+      prom_metric_sample_summary_t *summary_sample = (prom_metric_sample_summary_t *)value;
+      if (summary_sample == NULL) return 1;
+      r = prom_metric_formatter_load_summary(self, summary_sample);
+      if (r) return r;
     } else {
-      prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(metric->samples, key);
+      prom_metric_sample_t *sample = (prom_metric_sample_t *)value;
       if (sample == NULL) return 1;
       r = prom_metric_formatter_load_sample(self, sample);
       if (r) return r;
@@ -236,28 +401,183 @@ int prom_metric_formatter_load_metric(prom_metric_formatter_t *self, prom_metric
   return prom_string_builder_add_char(self->string_builder, '\n');
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Delta exposition
+
+#define PROM_METRIC_FORMATTER_HASH_SEED 14695981039346656037ULL
+#define PROM_METRIC_FORMATTER_HASH_PRIME 1099511628211ULL
+
+/**
+ * @brief API PRIVATE FNV-1a over the bytes of the counts and values a delta scrape compares
+ */
+static uint64_t prom_metric_formatter_hash(uint64_t hash, const void *data, size_t len) {
+  const unsigned char *p = (const unsigned char *)data;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= p[i];
+    hash *= PROM_METRIC_FORMATTER_HASH_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * @brief API PRIVATE Stamps a series with gen when the hash of its state differs from the one the last delta scrape
+ * found, and returns the generation the series last changed in
+ */
+static uint64_t prom_metric_formatter_delta_stamp(uint64_t *delta_hash, uint64_t *delta_gen, uint64_t hash,
+                                                  uint64_t gen) {
+  if (*delta_gen == 0 || *delta_hash != hash) {
+    *delta_hash = hash;
+    *delta_gen = gen;
+  }
+  return *delta_gen;
+}
+
+/**
+ * @brief API PRIVATE Loads the HELP and TYPE lines of a metric in a delta exposition, then the RESET line when the
+ * whole metric follows in place of a delta
+ */
+static int prom_metric_formatter_load_delta_header(prom_metric_formatter_t *self, prom_metric_t *metric, bool reset) {
+  int r = prom_string_builder_add_str(self->string_builder, metric->header);
+  if (r || !reset) return r;
+  r = prom_string_builder_add_str(self->string_builder, "# RESET ");
+  if (!r) r = prom_string_builder_add_str(self->string_builder, metric->name);
+  if (!r) r = prom_string_builder_add_char(self->string_builder, '\n');
+  return r;
+}
+
+int prom_metric_formatter_load_metric_delta(prom_metric_formatter_t *self, prom_metric_t *metric, uint64_t since,
+                                            uint64_t gen) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = 0;
+  bool reset = since == 0 || metric->delta_reset_gen > since;
+  // The header goes out before the first series or tombstone; a reset metric goes out even without series
+  bool loaded = reset;
+  if (reset) {
+    r = prom_metric_formatter_load_delta_header(self, metric, since != 0);
+    if (r) return r;
+  }
+
+  size_t iter = 0;
+  void *value = NULL;
+  while (prom_map_next(metric->samples, &iter, NULL, &value) && !r) {
+    uint64_t changed = 0;
+    if (metric->type == PROM_HISTOGRAM) {
+      prom_metric_sample_histogram_t *hist = (prom_metric_sample_histogram_t *)value;
+      r = pthread_mutex_lock(&hist->lock);
+      if (r) {
+        PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+        return r;
+      }
+      double sum = prom_metric_sample_histogram_collect(hist);
+      uint64_t hash = prom_metric_formatter_hash(PROM_METRIC_FORMATTER_HASH_SEED, hist->cumulative,
+                                                 sizeof(uint64_t) * (hist->bucket_count + 1));
+      hash = prom_metric_formatter_hash(hash, &sum, sizeof(double));
+      changed = prom_metric_formatter_delta_stamp(&hist->delta_hash, &hist->delta_gen, hash, gen);
+      if (reset || changed > since) {
+        if (!loaded) r = prom_metric_formatter_load_delta_header(self, metric, false);
+        loaded = true;
+        if (!r) r = prom_metric_formatter_load_histogram_lines(self, metric, hist, sum);
+      }
+      pthread_mutex_unlock(&hist->lock);
+    } else if (metric->type == PROM_SUMMARY) {
+      prom_metric_sample_summary_t *summary = (prom_metric_sample_summary_t *)value;
+      r = pthread_mutex_lock(&summary->lock);
+      if (r) {
+        PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+        return r;
+      }
+      uint64_t count = 0;
+      double sum = 0.0;
+      prom_metric_sample_summary_collect(summary, &count, &sum);
+      // Quantiles move as observations age out, so they are compared along with count and sum
+      uint64_t hash = prom_metric_formatter_hash(PROM_METRIC_FORMATTER_HASH_SEED, summary->values,
+                                                 sizeof(double) * summary->quantile_count);
+      hash = prom_metric_formatter_hash(hash, &count, sizeof(uint64_t));
+      hash = prom_metric_formatter_hash(hash, &sum, sizeof(double));
+      changed = prom_metric_formatter_delta_stamp(&summary->delta_hash, &summary->delta_gen, hash, gen);
+      if (reset || changed > since) {
+        if (!loaded) r = prom_metric_formatter_load_delta_header(self, metric, false);
+        loaded = true;
+        if (!r) r = prom_metric_formatter_load_summary_lines(self, summary, count, sum);
+      }
+      pthread_mutex_unlock(&summary->lock);
+    } else {
+      prom_metric_sample_t *sample = (prom_metric_sample_t *)value;
+      double sample_value = prom_metric_sample_value(sample);
+      if (sample->delta_gen == 0 || memcmp(&sample_value, &sample->delta_value, sizeof(double)) != 0) {
+        sample->delta_value = sample_value;
+        sample->delta_gen = gen;
+      }
+      if (reset || sample->delta_gen > since) {
+        if (!loaded) r = prom_metric_formatter_load_delta_header(self, metric, false);
+        loaded = true;
+        if (!r) r = prom_metric_formatter_load_sample_value(self, sample, sample_value);
+      }
+    }
+  }
+  if (r) return r;
+
+  // A reset metric is sent whole, which already leaves out what was removed
+  for (size_t i = 0; i < metric->removed_count && !reset && !r; i++) {
+    prom_metric_tombstone_t *tombstone = &metric->removed[(metric->removed_head + i) % PROM_METRIC_TOMBSTONES_MAX];
+    if (tombstone->gen <= since) continue;
+    // The series came back after it was removed, and its new state was loaded above, which a client applies in place
+    // of whatever it held; a tombstone after it would delete a live series
+    if (prom_map_get(metric->samples, tombstone->l_value) != NULL) continue;
+    if (!loaded) r = prom_metric_formatter_load_delta_header(self, metric, false);
+    loaded = true;
+    if (!r) r = prom_string_builder_add_str(self->string_builder, "# TOMBSTONE ");
+    if (!r) r = prom_string_builder_add_str(self->string_builder, tombstone->l_value);
+    if (!r) r = prom_string_builder_add_char(self->string_builder, '\n');
+  }
+  if (r) return r;
+
+  metric->delta_gen = gen;
+  return loaded ? prom_string_builder_add_char(self->string_builder, '\n') : 0;
+}
+
+int prom_metric_formatter_load_registered_metric(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                                 prom_metric_pins_t *pins) {
+  PROM_ASSERT(self != NULL);
+  if (metric == NULL) return 1;
+
+  int r = 0;
+  // Metrics updated in cycles are rendered from their last committed snapshot without touching metric->rwlock
+  prom_metric_snapshot_t *snapshot = prom_metric_snapshot_acquire(metric, pins);
+  if (snapshot != NULL) {
+    r = prom_string_builder_add_strn(self->string_builder, snapshot->text, snapshot->len);
+    prom_metric_snapshot_release(snapshot);
+    return r;
+  }
+
+  if (pthread_rwlock_rdlock(metric->rwlock) != 0) return 1;
+  r = prom_metric_formatter_load_metric(self, metric);
+  if (pthread_rwlock_unlock(metric->rwlock) != 0) return 1;
+  return r;
+}
+
 int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t *collectors) {
   PROM_ASSERT(self != NULL);
   int r = 0;
-  for (prom_linked_list_node_t *current_node = collectors->keys->head; current_node != NULL;
-       current_node = current_node->next) {
-    const char *collector_name = (const char *)current_node->item;
-    prom_collector_t *collector = (prom_collector_t *)prom_map_get(collectors, collector_name);
-    if (collector == NULL) return 1;
-
-    prom_map_t *metrics = collector->collect_fn(collector);
-    if (metrics == NULL) return 1;
-
-    for (prom_linked_list_node_t *current_node = metrics->keys->head; current_node != NULL;
-         current_node = current_node->next) {
-      const char *metric_name = (const char *)current_node->item;
-      prom_metric_t *metric = (prom_metric_t *)prom_map_get(metrics, metric_name);
-      if (metric == NULL) return 1;
-      if (pthread_rwlock_rdlock(metric->rwlock) != 0) return 1;
-      r = prom_metric_formatter_load_metric(self, metric);
-      if (pthread_rwlock_unlock(metric->rwlock) != 0) return 1;
-      if (r) return r;
+  prom_metric_pins_t pins = {NULL, 0, 0};
+  size_t collector_iter = 0;
+  void *collector_value = NULL;
+  while (r == 0 && prom_map_next(collectors, &collector_iter, NULL, &collector_value)) {
+    prom_collector_t *collector = (prom_collector_t *)collector_value;
+    prom_map_t *metrics = collector == NULL ? NULL : collector->collect_fn(collector);
+    if (metrics == NULL) {
+      r = 1;
+      break;
+    }
+
+    size_t metric_iter = 0;
+    void *metric_value = NULL;
+    while (r == 0 && prom_map_next(metrics, &metric_iter, NULL, &metric_value)) {
+      r = prom_metric_formatter_load_registered_metric(self, (prom_metric_t *)metric_value, &pins);
     }
   }
+  prom_metric_pins_release(&pins);
   return r;
 }
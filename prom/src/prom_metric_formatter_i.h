@@ -61,11 +61,37 @@ int prom_metric_formatter_load_l_value(prom_metric_formatter_t *metric_formatter
  */
 int prom_metric_formatter_load_sample(prom_metric_formatter_t *metric_formatter, prom_metric_sample_t *sample);
 
+/**
+ * @brief API PRIVATE Loads the formatter with the line of a metric sample carrying the given value instead of the
+ * sample's own
+ */
+int prom_metric_formatter_load_sample_value(prom_metric_formatter_t *metric_formatter, prom_metric_sample_t *sample,
+                                            double value);
+
 /**
  * @brief API PRIVATE Loads a metric in the string exposition format
  */
 int prom_metric_formatter_load_metric(prom_metric_formatter_t *self, prom_metric_t *metric);
 
+/**
+ * @brief API PRIVATE Loads the series of a metric that changed after delta generation since, stamping the changes it
+ * finds with gen, then a "# TOMBSTONE <series>" line for every series removed after since that has not come back
+ * since. A metric with nothing to report is left out.
+ *
+ * Every series is loaded when since is 0, and also, after a "# RESET <metric>" line, when the metric no longer has
+ * all the tombstones since needs. Series are read live, not from the committed snapshot. The caller holds the
+ * metric's read lock and serializes delta scrapes.
+ */
+int prom_metric_formatter_load_metric_delta(prom_metric_formatter_t *self, prom_metric_t *metric, uint64_t since,
+                                            uint64_t gen);
+
+/**
+ * @brief API PRIVATE Loads a registered metric: its committed snapshot if it has one, or else rendered under its read
+ * lock. pins are passed on to prom_metric_snapshot_acquire.
+ */
+int prom_metric_formatter_load_registered_metric(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                                 prom_metric_pins_t *pins);
+
 /**
  * @brief API PRIVATE Loads the given metrics
  */
@@ -76,6 +102,27 @@ int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t
  */
 int prom_metric_formatter_clear(prom_metric_formatter_t *self);
 
+/**
+ * @brief API PRIVATE Empty the underlying string_builder but keep its buffer for reuse
+ */
+int prom_metric_formatter_reset(prom_metric_formatter_t *self);
+
+/**
+ * @brief API PRIVATE Returns the string built so far without copying it. It is only valid until the next change to
+ * the formatter.
+ */
+const char *prom_metric_formatter_str(prom_metric_formatter_t *self);
+
+/**
+ * @brief API PRIVATE Returns the length of the string built so far
+ */
+size_t prom_metric_formatter_len(prom_metric_formatter_t *self);
+
+/**
+ * @brief API PRIVATE Returns the heap memory held by the formatter and its buffers in bytes
+ */
+size_t prom_metric_formatter_memory(prom_metric_formatter_t *self);
+
 /**
  * @brief API PRIVATE Returns the string built by prom_metric_formatter
  */
@@ -16,6 +16,7 @@
 
 // Private
 #include "prom_metric_sample_histogram_t.h"
+#include "prom_metric_sample_summary_t.h"
 #include "prom_metric_t.h"
 
 #ifndef PROM_METRIC_I_INCLUDED
@@ -42,6 +43,31 @@ int prom_metric_destroy_generic(void *item);
  */
 void prom_metric_free_generic(void *item);
 
+/**
+ * @brief API PRIVATE Returns the sample for the label values with an extra reference held for the caller, creating it
+ * if needed. The caller must balance it with prom_metric_sample_release.
+ */
+prom_metric_sample_t *prom_metric_sample_child_from_labels(prom_metric_t *self, const char **label_values);
+
+/**
+ * @brief API PRIVATE Returns the histogram sample for the label values with an extra reference held for the caller,
+ * creating it if needed. The caller must balance it with prom_metric_sample_histogram_release.
+ */
+prom_metric_sample_histogram_t *prom_metric_sample_histogram_child_from_labels(prom_metric_t *self,
+                                                                               const char **label_values);
+
+/**
+ * @brief API PRIVATE Returns the summary sample for the label values, creating it if needed
+ */
+prom_metric_sample_summary_t *prom_metric_sample_summary_from_labels(prom_metric_t *self, const char **label_values);
+
+/**
+ * @brief API PRIVATE Returns the summary sample for the label values with an extra reference held for the caller,
+ * creating it if needed. The caller must balance it with prom_metric_sample_summary_release.
+ */
+prom_metric_sample_summary_t *prom_metric_sample_summary_child_from_labels(prom_metric_t *self,
+                                                                           const char **label_values);
+
 /**
  * @brief API PRIVATE Remove sample in a *prom_metric
  */
@@ -52,4 +78,66 @@ int prom_metric_remove_sample_from_labels(prom_metric_t *self, const char **labe
  */
 int prom_metric_clear_samples(prom_metric_t *self);
 
+/**
+ * @brief API PRIVATE Start a new update generation. Every sample looked up from now on is marked with it. The first
+ * call switches the metric to snapshot rendering.
+ */
+int prom_metric_begin_update(prom_metric_t *self);
+
+/**
+ * @brief API PRIVATE Delete the samples that were not looked up since the last prom_metric_begin_update and commit
+ * the result as the metric's snapshot. From then on scrapes render the metric from its committed snapshot. Once the
+ * metric has been passed to prom_metrics_commit, the snapshot is only staged for the next such call.
+ */
+int prom_metric_end_update(prom_metric_t *self);
+
+/**
+ * @brief API PRIVATE Returns the number of live series of all metrics together
+ */
+size_t prom_metric_series_total(void);
+
+/**
+ * @brief API PRIVATE Resolves the label pairs of one of the metric's series: sets *label_keys and *pair_values and
+ * returns their count. label_values are the series' own; the overflow series has none and gets the overflow label.
+ */
+size_t prom_metric_label_pairs(prom_metric_t *self, const char **label_values, const char ***label_keys,
+                               const char ***pair_values);
+
+/**
+ * @brief API PRIVATE Reads the series count, the approximate heap memory in bytes and the dropped sample count of the
+ * metric, under its read lock.
+ */
+int prom_metric_stats(prom_metric_t *self, size_t *series, size_t *memory, uint64_t *dropped);
+
+/**
+ * @brief API PRIVATE Returns the metric's committed snapshot with a reference held for the caller, or NULL if the metric
+ * has never completed an update cycle. Release it with prom_metric_snapshot_release.
+ *
+ * A scrape passes the same pins for every metric it renders: once it has rendered a metric published by
+ * prom_metrics_commit, the other metrics of that call are taken from the same call even if they were committed again
+ * since. Pass NULL to always get the latest snapshot.
+ */
+prom_metric_snapshot_t *prom_metric_snapshot_acquire(prom_metric_t *self, prom_metric_pins_t *pins);
+
+/**
+ * @brief API PRIVATE Drop the batches a scrape pinned through prom_metric_snapshot_acquire. The pins can be reused.
+ */
+void prom_metric_pins_release(prom_metric_pins_t *pins);
+
+/**
+ * @brief API PRIVATE Drop a reference to a batch of snapshots published by prom_metrics_commit
+ */
+void prom_metric_batch_release(prom_metric_batch_t *batch);
+
+/**
+ * @brief API PRIVATE Drop a reference obtained from prom_metric_snapshot_acquire
+ */
+void prom_metric_snapshot_release(prom_metric_snapshot_t *snapshot);
+
+/**
+ * @brief API PRIVATE Have every commit from now on render the protobuf exposition too. Called on the first protobuf
+ * scrape, so agents that are only scraped as text never pay for it.
+ */
+void prom_metric_snapshot_enable_protobuf(void);
+
 #endif  // PROM_METRIC_I_INCLUDED
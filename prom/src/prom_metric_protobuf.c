@@ -0,0 +1,455 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+// Private
+#include "prom_assert.h"
+#include "prom_histogram_sparse_t.h"
+#include "prom_map_i.h"
+#include "prom_metric_i.h"
+#include "prom_metric_protobuf_i.h"
+#include "prom_metric_sample_histogram_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_metric_sample_t.h"
+#include "prom_string_builder_i.h"
+
+// Protobuf wire types
+#define PROM_PROTOBUF_VARINT 0
+#define PROM_PROTOBUF_FIXED64 1
+#define PROM_PROTOBUF_BYTES 2
+
+// Room reserved for the length prefix of a MetricFamily, enough for any message below 32 GiB
+#define PROM_PROTOBUF_LEN_PREFIX_SIZE 5
+
+// Field numbers of io.prometheus.client messages
+#define PROM_PROTOBUF_FAMILY_NAME 1
+#define PROM_PROTOBUF_FAMILY_HELP 2
+#define PROM_PROTOBUF_FAMILY_TYPE 3
+#define PROM_PROTOBUF_FAMILY_METRIC 4
+#define PROM_PROTOBUF_METRIC_LABEL 1
+#define PROM_PROTOBUF_METRIC_GAUGE 2
+#define PROM_PROTOBUF_METRIC_COUNTER 3
+#define PROM_PROTOBUF_METRIC_SUMMARY 4
+#define PROM_PROTOBUF_METRIC_HISTOGRAM 7
+#define PROM_PROTOBUF_LABEL_NAME 1
+#define PROM_PROTOBUF_LABEL_VALUE 2
+#define PROM_PROTOBUF_VALUE 1
+#define PROM_PROTOBUF_SUMMARY_COUNT 1
+#define PROM_PROTOBUF_SUMMARY_SUM 2
+#define PROM_PROTOBUF_SUMMARY_QUANTILE 3
+#define PROM_PROTOBUF_QUANTILE_QUANTILE 1
+#define PROM_PROTOBUF_QUANTILE_VALUE 2
+#define PROM_PROTOBUF_HISTOGRAM_COUNT 1
+#define PROM_PROTOBUF_HISTOGRAM_SUM 2
+#define PROM_PROTOBUF_HISTOGRAM_BUCKET 3
+#define PROM_PROTOBUF_HISTOGRAM_SCHEMA 5
+#define PROM_PROTOBUF_HISTOGRAM_ZERO_THRESHOLD 6
+#define PROM_PROTOBUF_HISTOGRAM_ZERO_COUNT 7
+#define PROM_PROTOBUF_HISTOGRAM_NEGATIVE_SPAN 9
+#define PROM_PROTOBUF_HISTOGRAM_NEGATIVE_DELTA 10
+#define PROM_PROTOBUF_HISTOGRAM_POSITIVE_SPAN 12
+#define PROM_PROTOBUF_HISTOGRAM_POSITIVE_DELTA 13
+#define PROM_PROTOBUF_BUCKET_COUNT 1
+#define PROM_PROTOBUF_BUCKET_UPPER_BOUND 2
+#define PROM_PROTOBUF_SPAN_OFFSET 1
+#define PROM_PROTOBUF_SPAN_LENGTH 2
+
+// Longest run of empty buckets kept inside a native histogram span; a longer one starts a new span
+#define PROM_PROTOBUF_SPAN_MAX_GAP 2
+
+// Values of io.prometheus.client.MetricType, indexed by prom_metric_type_t
+static const int prom_metric_protobuf_type_map[4] = {0, 1, 4, 2};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Wire format
+//
+// All field numbers used here are below 16, so every tag is a single byte. Messages are sized before they are written,
+// so they are written straight into the string builder without intermediate buffers.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static size_t prom_protobuf_varint_size(uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+static size_t prom_protobuf_put_varint(char *buf, uint64_t value) {
+  size_t i = 0;
+  while (value >= 0x80) {
+    buf[i++] = (char)(value | 0x80);
+    value >>= 7;
+  }
+  buf[i++] = (char)value;
+  return i;
+}
+
+// Maps a signed value onto the unsigned one a sint32 or sint64 field carries
+static uint64_t prom_protobuf_zigzag(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+// Size of a length-delimited field holding len bytes
+static size_t prom_protobuf_bytes_size(size_t len) {
+  return 1 + prom_protobuf_varint_size(len) + len;
+}
+
+// Size of a double field
+#define PROM_PROTOBUF_DOUBLE_SIZE 9
+
+static int prom_protobuf_add_varint(prom_string_builder_t *sb, int field, uint64_t value) {
+  char buf[11];
+  buf[0] = (char)(field << 3 | PROM_PROTOBUF_VARINT);
+  return prom_string_builder_add_strn(sb, buf, 1 + prom_protobuf_put_varint(buf + 1, value));
+}
+
+// Adds the tag and length of a length-delimited field; the caller adds the len bytes
+static int prom_protobuf_add_len(prom_string_builder_t *sb, int field, size_t len) {
+  char buf[11];
+  buf[0] = (char)(field << 3 | PROM_PROTOBUF_BYTES);
+  return prom_string_builder_add_strn(sb, buf, 1 + prom_protobuf_put_varint(buf + 1, len));
+}
+
+static int prom_protobuf_add_bytes(prom_string_builder_t *sb, int field, const char *data, size_t len) {
+  int r = prom_protobuf_add_len(sb, field, len);
+  if (r) return r;
+  return prom_string_builder_add_strn(sb, data, len);
+}
+
+static int prom_protobuf_add_double(prom_string_builder_t *sb, int field, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  char buf[PROM_PROTOBUF_DOUBLE_SIZE];
+  buf[0] = (char)(field << 3 | PROM_PROTOBUF_FIXED64);
+  // fixed64 is little endian on the wire
+  for (int i = 0; i < 8; i++) buf[1 + i] = (char)(bits >> (8 * i));
+  return prom_string_builder_add_strn(sb, buf, PROM_PROTOBUF_DOUBLE_SIZE);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Native histograms
+//
+// A sparse range is sent as spans of consecutive buckets and the count of each bucket as a delta to the previous one.
+// Both walks below run once with sb NULL to size the fields and once to write them.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Finds the next span of range at or after index i: it starts at the next populated bucket and ends after the last
+// populated bucket not preceded by a run of more than PROM_PROTOBUF_SPAN_MAX_GAP empty ones. Returns the start index,
+// or range->len when no populated bucket is left, and sets *end to the index just past the span.
+static size_t prom_metric_protobuf_next_span(prom_histogram_sparse_range_t *range, size_t i, size_t *end) {
+  while (i < range->len && range->counts[i] == 0) i++;
+  size_t last = i;
+  for (size_t k = i + 1; k < range->len; k++) {
+    if (range->counts[k] == 0) continue;
+    if (k - last - 1 > PROM_PROTOBUF_SPAN_MAX_GAP) break;
+    last = k;
+  }
+  *end = last + 1;
+  return i;
+}
+
+// Size of a BucketSpan message
+static size_t prom_metric_protobuf_span_size(int64_t offset, size_t length) {
+  return 2 + prom_protobuf_varint_size(prom_protobuf_zigzag(offset)) + prom_protobuf_varint_size(length);
+}
+
+static int prom_metric_protobuf_add_span(prom_string_builder_t *sb, int field, int64_t offset, size_t length) {
+  int r = prom_protobuf_add_len(sb, field, prom_metric_protobuf_span_size(offset, length));
+  if (r) return r;
+  r = prom_protobuf_add_varint(sb, PROM_PROTOBUF_SPAN_OFFSET, prom_protobuf_zigzag(offset));
+  if (r) return r;
+  return prom_protobuf_add_varint(sb, PROM_PROTOBUF_SPAN_LENGTH, length);
+}
+
+// Adds the BucketSpan fields of range, or with sb NULL only adds their size to *size. The first span is offset from
+// key 0 and every later one from the end of the previous one.
+static int prom_metric_protobuf_sparse_spans(prom_string_builder_t *sb, prom_histogram_sparse_range_t *range,
+                                             int field, size_t *size) {
+  int64_t offset = range->offset;
+  size_t end = 0;
+  for (size_t i = prom_metric_protobuf_next_span(range, 0, &end); i < range->len;
+       i = prom_metric_protobuf_next_span(range, end, &end)) {
+    offset += (int64_t)i;
+    if (sb == NULL) {
+      *size += prom_protobuf_bytes_size(prom_metric_protobuf_span_size(offset, end - i));
+    } else {
+      int r = prom_metric_protobuf_add_span(sb, field, offset, end - i);
+      if (r) return r;
+    }
+    offset = -(int64_t)end;
+  }
+  return 0;
+}
+
+// Adds the packed deltas of range, or with sb NULL only adds their size to *len. The caller adds the tag and length.
+static int prom_metric_protobuf_sparse_deltas(prom_string_builder_t *sb, prom_histogram_sparse_range_t *range,
+                                              size_t *len) {
+  uint64_t prev = 0;
+  size_t end = 0;
+  for (size_t i = prom_metric_protobuf_next_span(range, 0, &end); i < range->len;
+       i = prom_metric_protobuf_next_span(range, end, &end)) {
+    for (; i < end; i++) {
+      uint64_t delta = prom_protobuf_zigzag((int64_t)(range->counts[i] - prev));
+      prev = range->counts[i];
+      if (sb == NULL) {
+        *len += prom_protobuf_varint_size(delta);
+      } else {
+        char buf[10];
+        int r = prom_string_builder_add_strn(sb, buf, prom_protobuf_put_varint(buf, delta));
+        if (r) return r;
+      }
+    }
+  }
+  return 0;
+}
+
+// Sizes the native fields of a sparse histogram: schema, zero bucket, and the spans and deltas of both ranges. An
+// empty histogram gets one empty positive span, which marks it native to the reader.
+static size_t prom_metric_protobuf_sparse_size(prom_histogram_sparse_t *sparse, size_t *negative_len,
+                                               size_t *positive_len) {
+  size_t size = 1 + prom_protobuf_varint_size(prom_protobuf_zigzag(sparse->schema)) + PROM_PROTOBUF_DOUBLE_SIZE + 1 +
+                prom_protobuf_varint_size(sparse->zero_count);
+  size_t spans_size = 0;
+  prom_metric_protobuf_sparse_spans(NULL, &sparse->negative, 0, &spans_size);
+  prom_metric_protobuf_sparse_spans(NULL, &sparse->positive, 0, &spans_size);
+  if (spans_size == 0) spans_size = prom_protobuf_bytes_size(prom_metric_protobuf_span_size(0, 0));
+  size += spans_size;
+
+  *negative_len = 0;
+  *positive_len = 0;
+  prom_metric_protobuf_sparse_deltas(NULL, &sparse->negative, negative_len);
+  prom_metric_protobuf_sparse_deltas(NULL, &sparse->positive, positive_len);
+  if (*negative_len > 0) size += prom_protobuf_bytes_size(*negative_len);
+  if (*positive_len > 0) size += prom_protobuf_bytes_size(*positive_len);
+  return size;
+}
+
+static int prom_metric_protobuf_add_sparse(prom_string_builder_t *sb, prom_histogram_sparse_t *sparse,
+                                           size_t negative_len, size_t positive_len) {
+  int r = prom_protobuf_add_varint(sb, PROM_PROTOBUF_HISTOGRAM_SCHEMA, prom_protobuf_zigzag(sparse->schema));
+  if (r) return r;
+  r = prom_protobuf_add_double(sb, PROM_PROTOBUF_HISTOGRAM_ZERO_THRESHOLD, sparse->zero_threshold);
+  if (r) return r;
+  r = prom_protobuf_add_varint(sb, PROM_PROTOBUF_HISTOGRAM_ZERO_COUNT, sparse->zero_count);
+  if (r) return r;
+
+  if (negative_len > 0) {
+    r = prom_metric_protobuf_sparse_spans(sb, &sparse->negative, PROM_PROTOBUF_HISTOGRAM_NEGATIVE_SPAN, NULL);
+    if (r) return r;
+    r = prom_protobuf_add_len(sb, PROM_PROTOBUF_HISTOGRAM_NEGATIVE_DELTA, negative_len);
+    if (r) return r;
+    r = prom_metric_protobuf_sparse_deltas(sb, &sparse->negative, NULL);
+    if (r) return r;
+  }
+  if (positive_len > 0) {
+    r = prom_metric_protobuf_sparse_spans(sb, &sparse->positive, PROM_PROTOBUF_HISTOGRAM_POSITIVE_SPAN, NULL);
+    if (r) return r;
+    r = prom_protobuf_add_len(sb, PROM_PROTOBUF_HISTOGRAM_POSITIVE_DELTA, positive_len);
+    if (r) return r;
+    r = prom_metric_protobuf_sparse_deltas(sb, &sparse->positive, NULL);
+    if (r) return r;
+  }
+  if (negative_len == 0 && positive_len == 0) {
+    r = prom_metric_protobuf_add_span(sb, PROM_PROTOBUF_HISTOGRAM_POSITIVE_SPAN, 0, 0);
+  }
+  return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Messages
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Size of the LabelPair fields of a Metric
+static size_t prom_metric_protobuf_labels_size(prom_metric_t *metric, const char **label_values) {
+  const char **keys = NULL;
+  const char **values = NULL;
+  size_t count = prom_metric_label_pairs(metric, label_values, &keys, &values);
+  size_t size = 0;
+  for (size_t i = 0; i < count; i++) {
+    size_t pair = prom_protobuf_bytes_size(strlen(keys[i])) + prom_protobuf_bytes_size(strlen(values[i]));
+    size += prom_protobuf_bytes_size(pair);
+  }
+  return size;
+}
+
+static int prom_metric_protobuf_add_labels(prom_string_builder_t *sb, prom_metric_t *metric, const char **label_values) {
+  const char **keys = NULL;
+  const char **values = NULL;
+  size_t count = prom_metric_label_pairs(metric, label_values, &keys, &values);
+  int r = 0;
+  for (size_t i = 0; i < count; i++) {
+    size_t key_len = strlen(keys[i]);
+    size_t value_len = strlen(values[i]);
+    r = prom_protobuf_add_len(sb, PROM_PROTOBUF_METRIC_LABEL,
+                              prom_protobuf_bytes_size(key_len) + prom_protobuf_bytes_size(value_len));
+    if (r) return r;
+    r = prom_protobuf_add_bytes(sb, PROM_PROTOBUF_LABEL_NAME, keys[i], key_len);
+    if (r) return r;
+    r = prom_protobuf_add_bytes(sb, PROM_PROTOBUF_LABEL_VALUE, values[i], value_len);
+    if (r) return r;
+  }
+  return 0;
+}
+
+// Adds a Metric holding a Gauge or a Counter
+static int prom_metric_protobuf_add_sample(prom_string_builder_t *sb, prom_metric_t *metric,
+                                           prom_metric_sample_t *sample) {
+  int field = metric->type == PROM_COUNTER ? PROM_PROTOBUF_METRIC_COUNTER : PROM_PROTOBUF_METRIC_GAUGE;
+  size_t size = prom_metric_protobuf_labels_size(metric, sample->label_values) +
+                prom_protobuf_bytes_size(PROM_PROTOBUF_DOUBLE_SIZE);
+
+  int r = prom_protobuf_add_len(sb, PROM_PROTOBUF_FAMILY_METRIC, size);
+  if (r) return r;
+  r = prom_metric_protobuf_add_labels(sb, metric, sample->label_values);
+  if (r) return r;
+  r = prom_protobuf_add_len(sb, field, PROM_PROTOBUF_DOUBLE_SIZE);
+  if (r) return r;
+  return prom_protobuf_add_double(sb, PROM_PROTOBUF_VALUE, prom_metric_sample_value(sample));
+}
+
+// Adds a Metric holding a Histogram. The caller holds the histogram's lock and has collected it, so the cumulative
+// counts stay put while they are sized and written. A sparse histogram is sent with native buckets only.
+static int prom_metric_protobuf_add_histogram(prom_string_builder_t *sb, prom_metric_t *metric,
+                                              prom_metric_sample_histogram_t *hist, double sum) {
+  // The +Inf bucket is left out as it always equals sample_count
+  uint64_t count = hist->cumulative[hist->bucket_count];
+  size_t hist_size = 1 + prom_protobuf_varint_size(count) + PROM_PROTOBUF_DOUBLE_SIZE;
+  for (size_t i = 0; i < hist->bucket_count; i++) {
+    size_t bucket_size = 1 + prom_protobuf_varint_size(hist->cumulative[i]) + PROM_PROTOBUF_DOUBLE_SIZE;
+    hist_size += prom_protobuf_bytes_size(bucket_size);
+  }
+  size_t negative_len = 0;
+  size_t positive_len = 0;
+  if (hist->sparse != NULL) hist_size += prom_metric_protobuf_sparse_size(hist->sparse, &negative_len, &positive_len);
+  size_t size = prom_metric_protobuf_labels_size(metric, hist->label_values) + prom_protobuf_bytes_size(hist_size);
+
+  int r = prom_protobuf_add_len(sb, PROM_PROTOBUF_FAMILY_METRIC, size);
+  if (r) return r;
+  r = prom_metric_protobuf_add_labels(sb, metric, hist->label_values);
+  if (r) return r;
+  r = prom_protobuf_add_len(sb, PROM_PROTOBUF_METRIC_HISTOGRAM, hist_size);
+  if (r) return r;
+  r = prom_protobuf_add_varint(sb, PROM_PROTOBUF_HISTOGRAM_COUNT, count);
+  if (r) return r;
+  r = prom_protobuf_add_double(sb, PROM_PROTOBUF_HISTOGRAM_SUM, sum);
+  if (r) return r;
+
+  for (size_t i = 0; i < hist->bucket_count; i++) {
+    r = prom_protobuf_add_len(sb, PROM_PROTOBUF_HISTOGRAM_BUCKET,
+                              1 + prom_protobuf_varint_size(hist->cumulative[i]) + PROM_PROTOBUF_DOUBLE_SIZE);
+    if (r) return r;
+    r = prom_protobuf_add_varint(sb, PROM_PROTOBUF_BUCKET_COUNT, hist->cumulative[i]);
+    if (r) return r;
+    r = prom_protobuf_add_double(sb, PROM_PROTOBUF_BUCKET_UPPER_BOUND, hist->upper_bounds[i]);
+    if (r) return r;
+  }
+  if (hist->sparse != NULL) return prom_metric_protobuf_add_sparse(sb, hist->sparse, negative_len, positive_len);
+  return 0;
+}
+
+// Adds a Metric holding a Summary. The caller holds the summary's lock and has collected it.
+static int prom_metric_protobuf_add_summary(prom_string_builder_t *sb, prom_metric_t *metric,
+                                            prom_metric_sample_summary_t *summary, uint64_t count, double sum) {
+  size_t quantile_size = 2 * PROM_PROTOBUF_DOUBLE_SIZE;
+  size_t summary_size = 1 + prom_protobuf_varint_size(count) + PROM_PROTOBUF_DOUBLE_SIZE +
+                        summary->quantile_count * prom_protobuf_bytes_size(quantile_size);
+  size_t size = prom_metric_protobuf_labels_size(metric, summary->label_values) + prom_protobuf_bytes_size(summary_size);
+
+  int r = prom_protobuf_add_len(sb, PROM_PROTOBUF_FAMILY_METRIC, size);
+  if (r) return r;
+  r = prom_metric_protobuf_add_labels(sb, metric, summary->label_values);
+  if (r) return r;
+  r = prom_protobuf_add_len(sb, PROM_PROTOBUF_METRIC_SUMMARY, summary_size);
+  if (r) return r;
+  r = prom_protobuf_add_varint(sb, PROM_PROTOBUF_SUMMARY_COUNT, count);
+  if (r) return r;
+  r = prom_protobuf_add_double(sb, PROM_PROTOBUF_SUMMARY_SUM, sum);
+  if (r) return r;
+
+  for (size_t i = 0; i < summary->quantile_count; i++) {
+    r = prom_protobuf_add_len(sb, PROM_PROTOBUF_SUMMARY_QUANTILE, quantile_size);
+    if (r) return r;
+    r = prom_protobuf_add_double(sb, PROM_PROTOBUF_QUANTILE_QUANTILE, summary->quantiles[i]);
+    if (r) return r;
+    r = prom_protobuf_add_double(sb, PROM_PROTOBUF_QUANTILE_VALUE, summary->values[i]);
+    if (r) return r;
+  }
+  return 0;
+}
+
+int prom_metric_protobuf_load_metric(prom_metric_formatter_t *self, prom_metric_t *metric) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || metric == NULL) return 1;
+
+  prom_string_builder_t *sb = self->string_builder;
+  int r = 0;
+
+  // The length prefix is written once the family is complete, into room reserved up front
+  size_t start = prom_string_builder_len(sb);
+  char prefix[PROM_PROTOBUF_LEN_PREFIX_SIZE] = {0};
+  r = prom_string_builder_add_strn(sb, prefix, PROM_PROTOBUF_LEN_PREFIX_SIZE);
+  if (r) return r;
+
+  r = prom_protobuf_add_bytes(sb, PROM_PROTOBUF_FAMILY_NAME, metric->name, strlen(metric->name));
+  if (r) return r;
+  r = prom_protobuf_add_bytes(sb, PROM_PROTOBUF_FAMILY_HELP, metric->help, strlen(metric->help));
+  if (r) return r;
+  r = prom_protobuf_add_varint(sb, PROM_PROTOBUF_FAMILY_TYPE, prom_metric_protobuf_type_map[metric->type]);
+  if (r) return r;
+
+  size_t sample_count = 0;
+  size_t iter = 0;
+  void *value = NULL;
+  while (prom_map_next(metric->samples, &iter, NULL, &value)) {
+    if (value == NULL) return 1;
+    if (metric->type == PROM_HISTOGRAM) {
+      prom_metric_sample_histogram_t *hist = (prom_metric_sample_histogram_t *)value;
+      if (pthread_mutex_lock(&hist->lock) != 0) return 1;
+      r = prom_metric_protobuf_add_histogram(sb, metric, hist, prom_metric_sample_histogram_collect(hist));
+      pthread_mutex_unlock(&hist->lock);
+    } else if (metric->type == PROM_SUMMARY) {
+      prom_metric_sample_summary_t *summary = (prom_metric_sample_summary_t *)value;
+      uint64_t count = 0;
+      double sum = 0.0;
+      if (pthread_mutex_lock(&summary->lock) != 0) return 1;
+      prom_metric_sample_summary_collect(summary, &count, &sum);
+      r = prom_metric_protobuf_add_summary(sb, metric, summary, count, sum);
+      pthread_mutex_unlock(&summary->lock);
+    } else {
+      r = prom_metric_protobuf_add_sample(sb, metric, (prom_metric_sample_t *)value);
+    }
+    if (r) return r;
+    sample_count++;
+  }
+
+  // A family without metrics is dropped rather than sent empty
+  if (sample_count == 0) return prom_string_builder_truncate(sb, start);
+
+  size_t len = prom_string_builder_len(sb) - start - PROM_PROTOBUF_LEN_PREFIX_SIZE;
+  if (prom_protobuf_varint_size(len) > PROM_PROTOBUF_LEN_PREFIX_SIZE) return 1;
+  size_t prefix_len = prom_protobuf_put_varint(prefix, len);
+  char *str = prom_string_builder_str(sb);
+  memmove(str + start + prefix_len, str + start + PROM_PROTOBUF_LEN_PREFIX_SIZE, len);
+  memcpy(str + start, prefix, prefix_len);
+  return prom_string_builder_truncate(sb, start + prefix_len + len);
+}
@@ -15,6 +15,8 @@
  */
 
 #include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -23,23 +25,130 @@
 #include "prom_assert.h"
 #include "prom_errors.h"
 #include "prom_log.h"
+#include "prom_metric_formatter_i.h"
 #include "prom_metric_sample_i.h"
 #include "prom_metric_sample_t.h"
 
+// Hands out shard hints round robin, one per incrementing thread
+static atomic_uint prom_metric_sample_next_shard = ATOMIC_VAR_INIT(0);
+
+// The shard hint of the calling thread plus one, 0 until its first increment of a sharded sample
+static _Thread_local unsigned prom_metric_sample_shard_hint = 0;
+
 prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value) {
-  prom_metric_sample_t *self = (prom_metric_sample_t *)prom_malloc(sizeof(prom_metric_sample_t));
+  prom_metric_sample_t *self = (prom_metric_sample_t *)prom_object_malloc(sizeof(prom_metric_sample_t));
   self->type = type;
-  self->l_value = prom_strdup(l_value);
+  self->label_values = NULL;
+  // The label prefix of the exposition line is rendered once; only the value part is rewritten on scrape. The sample
+  // keeps no other copy of l_value.
+  size_t l_value_len = strlen(l_value);
+  self->prefix_len = l_value_len + 1;
+  self->line = (char *)prom_object_malloc(self->prefix_len + PROM_METRIC_SAMPLE_VALUE_SIZE);
+  memcpy(self->line, l_value, l_value_len);
+  self->line[l_value_len] = ' ';
+  self->line_len = 0;
+  self->line_value = 0.0;
   self->r_value = ATOMIC_VAR_INIT(r_value);
+  self->shards = NULL;
+  self->shards_mem = NULL;
+  self->ref_count = ATOMIC_VAR_INIT(1);
+  self->gen = 0;
+  self->delta_value = 0.0;
+  self->delta_gen = 0;
+  return self;
+}
+
+prom_metric_sample_t *prom_metric_sample_new_sharded(prom_metric_type_t type, const char *l_value) {
+  prom_metric_sample_t *self = prom_metric_sample_new(type, l_value, 0.0);
+  // One spare slot leaves room to start the array on a cache line boundary
+  self->shards_mem = prom_malloc(sizeof(prom_metric_sample_shard_t) * (PROM_METRIC_SAMPLE_SHARDS + 1));
+  uintptr_t addr = (uintptr_t)self->shards_mem;
+  addr = (addr + PROM_METRIC_SAMPLE_SHARD_SIZE - 1) & ~(uintptr_t)(PROM_METRIC_SAMPLE_SHARD_SIZE - 1);
+  self->shards = (prom_metric_sample_shard_t *)addr;
+  for (size_t i = 0; i < PROM_METRIC_SAMPLE_SHARDS; i++) atomic_init(&self->shards[i].value, 0.0);
   return self;
 }
 
+prom_metric_sample_t *prom_metric_sample_line_new(prom_metric_formatter_t *formatter, prom_metric_type_t type,
+                                                  const char *name, const char *suffix, size_t label_count,
+                                                  const char **label_keys, const char **label_values,
+                                                  const char *extra_key, const char *extra_value) {
+  int r = 0;
+  if (extra_key == NULL) {
+    r = prom_metric_formatter_load_l_value(formatter, name, suffix, label_count, label_keys, label_values);
+  } else {
+    // The user labels followed by the extra one
+    const char **keys = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+    const char **values = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+    for (size_t i = 0; i < label_count; i++) {
+      keys[i] = label_keys[i];
+      values[i] = label_values[i];
+    }
+    keys[label_count] = extra_key;
+    values[label_count] = extra_value;
+    r = prom_metric_formatter_load_l_value(formatter, name, suffix, label_count + 1, keys, values);
+    prom_free(keys);
+    prom_free(values);
+  }
+
+  prom_metric_sample_t *line = NULL;
+  if (!r) line = prom_metric_sample_new(type, prom_metric_formatter_str(formatter), 0.0);
+  prom_metric_formatter_reset(formatter);
+  return line;
+}
+
+const char **prom_metric_sample_label_values_copy(size_t label_count, const char **label_values) {
+  if (label_count == 0) return NULL;
+  size_t size = sizeof(const char *) * label_count;
+  for (size_t i = 0; i < label_count; i++) size += strlen(label_values[i]) + 1;
+
+  // The pointer array is followed by the strings it points to
+  const char **copy = (const char **)prom_malloc(size);
+  char *p = (char *)(copy + label_count);
+  for (size_t i = 0; i < label_count; i++) {
+    size_t len = strlen(label_values[i]) + 1;
+    memcpy(p, label_values[i], len);
+    copy[i] = p;
+    p += len;
+  }
+  return copy;
+}
+
+size_t prom_metric_sample_label_values_memory(size_t label_count, const char **label_values) {
+  if (label_values == NULL) return 0;
+  size_t size = sizeof(const char *) * label_count;
+  for (size_t i = 0; i < label_count; i++) size += strlen(label_values[i]) + 1;
+  return size;
+}
+
+size_t prom_metric_sample_memory(prom_metric_sample_t *self) {
+  PROM_ASSERT(self != NULL);
+  size_t size = sizeof(prom_metric_sample_t) + self->prefix_len + PROM_METRIC_SAMPLE_VALUE_SIZE;
+  if (self->shards_mem != NULL) size += sizeof(prom_metric_sample_shard_t) * (PROM_METRIC_SAMPLE_SHARDS + 1);
+  return size;
+}
+
+void prom_metric_sample_retain(prom_metric_sample_t *self) {
+  PROM_ASSERT(self != NULL);
+  atomic_fetch_add_explicit(&self->ref_count, 1, memory_order_relaxed);
+}
+
+void prom_metric_sample_release(prom_metric_sample_t *self) {
+  if (self == NULL) return;
+  if (atomic_fetch_sub_explicit(&self->ref_count, 1, memory_order_acq_rel) == 1) prom_metric_sample_destroy(self);
+}
+
 int prom_metric_sample_destroy(prom_metric_sample_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
-  prom_free((void *)self->l_value);
-  self->l_value = NULL;
-  prom_free((void *)self);
+  prom_free((void *)self->label_values);
+  self->label_values = NULL;
+  prom_object_free(self->line, self->prefix_len + PROM_METRIC_SAMPLE_VALUE_SIZE);
+  self->line = NULL;
+  prom_free(self->shards_mem);
+  self->shards_mem = NULL;
+  self->shards = NULL;
+  prom_object_free(self, sizeof(prom_metric_sample_t));
   self = NULL;
   return 0;
 }
@@ -55,7 +164,7 @@ int prom_metric_sample_destroy_generic(void *gen) {
 
 void prom_metric_sample_free_generic(void *gen) {
   prom_metric_sample_t *self = (prom_metric_sample_t *)gen;
-  prom_metric_sample_destroy(self);
+  prom_metric_sample_release(self);
 }
 
 int prom_metric_sample_add(prom_metric_sample_t *self, double r_value) {
@@ -63,10 +172,17 @@ int prom_metric_sample_add(prom_metric_sample_t *self, double r_value) {
   if (r_value < 0) {
     return 1;
   }
-  _Atomic double old = atomic_load(&self->r_value);
+  _Atomic double *target = &self->r_value;
+  if (self->shards != NULL) {
+    if (prom_metric_sample_shard_hint == 0) {
+      prom_metric_sample_shard_hint = atomic_fetch_add(&prom_metric_sample_next_shard, 1) + 1;
+    }
+    target = &self->shards[(prom_metric_sample_shard_hint - 1) % PROM_METRIC_SAMPLE_SHARDS].value;
+  }
+  _Atomic double old = atomic_load(target);
   for (;;) {
     _Atomic double new = ATOMIC_VAR_INIT(old + r_value);
-    if (atomic_compare_exchange_weak(&self->r_value, &old, new)) {
+    if (atomic_compare_exchange_weak(target, &old, new)) {
       return 0;
     }
   }
@@ -92,6 +208,20 @@ int prom_metric_sample_set(prom_metric_sample_t *self, double r_value) {
   //   PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
   //   return 1;
   // }
+  // Shards are left as they are and r_value takes up the difference in a single store, so a concurrent read never
+  // sees the new base next to the old shard sums, and increments landing in a shard meanwhile are kept
+  if (self->shards != NULL) {
+    for (size_t i = 0; i < PROM_METRIC_SAMPLE_SHARDS; i++) r_value -= atomic_load(&self->shards[i].value);
+  }
   atomic_store(&self->r_value, r_value);
   return 0;
 }
+
+double prom_metric_sample_value(prom_metric_sample_t *self) {
+  PROM_ASSERT(self != NULL);
+  double value = atomic_load(&self->r_value);
+  if (self->shards != NULL) {
+    for (size_t i = 0; i < PROM_METRIC_SAMPLE_SHARDS; i++) value += atomic_load(&self->shards[i].value);
+  }
+  return value;
+}
@@ -15,7 +15,8 @@
  */
 
 #include <pthread.h>
-#include <stdio.h>
+#include <stdatomic.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -24,248 +25,77 @@
 // Private
 #include "prom_assert.h"
 #include "prom_errors.h"
-#include "prom_linked_list_i.h"
+#include "prom_histogram_sparse_i.h"
 #include "prom_log.h"
-#include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_i.h"
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Static Declarations
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-static const char *prom_metric_sample_histogram_l_value_for_bucket(prom_metric_sample_histogram_t *self,
-                                                                   const char *name, size_t label_count,
-                                                                   const char **label_keys, const char **label_values,
-                                                                   double bucket);
-
-static const char *prom_metric_sample_histogram_l_value_for_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                                size_t label_count, const char **label_keys,
-                                                                const char **label_values);
-
-static void prom_metric_sample_histogram_free_str_generic(void *gen);
-
-static int prom_metric_sample_histogram_init_bucket_samples(prom_metric_sample_histogram_t *self, const char *name,
-                                                            size_t label_count, const char **label_keys,
-                                                            const char **label_values);
-
-static int prom_metric_sample_histogram_init_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                 size_t label_count, const char **label_keys,
-                                                 const char **label_values);
-
-static int prom_metric_sample_histogram_init_count(prom_metric_sample_histogram_t *self, const char *name,
-                                                   size_t label_count, const char **label_keys,
-                                                   const char **label_values);
-
-static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogram_t *self, const char *name,
-                                                     size_t label_count, const char **label_keys,
-                                                     const char **label_values);
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// End static declarations
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "prom_text_writer_i.h"
 
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_new(const char *name, prom_histogram_buckets_t *buckets,
                                                                  size_t label_count, const char **label_keys,
                                                                  const char **label_values) {
-  // Capture return codes
-  int r = 0;
+  size_t bucket_count = buckets != NULL ? prom_histogram_buckets_count(buckets) : 0;
 
   // Allocate and set self
   prom_metric_sample_histogram_t *self =
-      (prom_metric_sample_histogram_t *)prom_malloc(sizeof(prom_metric_sample_histogram_t));
-
-  // Allocate and set the l_value_list
-  self->l_value_list = prom_linked_list_new();
-  if (self->l_value_list == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Allocate and set the metric formatter
-  self->metric_formatter = prom_metric_formatter_new();
-  if (self->metric_formatter == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Store map of l_value/prom_metric_sample_t
-  self->samples = prom_map_new();
-  if (self->samples == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set the free value function on the samples map
-  r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set a map of bucket: l_value
-  self->l_values = prom_map_new();  // Store map of bucket/l_value
-  if (self->l_values == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set the free value function for thhe l_values map
-  r = prom_map_set_free_value_fn(self->l_values, prom_metric_sample_histogram_free_str_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  self->buckets = buckets;
-
-  // Allocate and initialize the lock
-  self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
-  r = pthread_rwlock_init(self->rwlock, NULL);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Allocate and initialize bucket metric samples
-  r = prom_metric_sample_histogram_init_bucket_samples(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Allocate and initialize the +Inf metric sample
-  r = prom_metric_sample_histogram_init_inf(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Allocate and initialize the count metric sample
-  r = prom_metric_sample_histogram_init_count(self, name, label_count, label_keys, label_values);
-  if (r) {
+      (prom_metric_sample_histogram_t *)prom_object_malloc(sizeof(prom_metric_sample_histogram_t));
+  self->gen = 0;
+  self->delta_hash = 0;
+  self->delta_gen = 0;
+  self->ref_count = ATOMIC_VAR_INIT(1);
+  self->bucket_count = bucket_count;
+  self->sparse = NULL;
+  self->label_values = prom_metric_sample_label_values_copy(label_count, label_values);
+  pthread_mutex_init(&self->lock, NULL);
+
+  // Bounds and counters sit in flat arrays, so observe touches no map and no string
+  self->upper_bounds = (double *)prom_object_malloc(sizeof(double) * (bucket_count + 1));
+  if (bucket_count > 0) memcpy(self->upper_bounds, buckets->upper_bounds, sizeof(double) * bucket_count);
+  self->counts = (_Atomic uint64_t *)prom_object_malloc(sizeof(_Atomic uint64_t) * (bucket_count + 1));
+  for (size_t i = 0; i <= bucket_count; i++) atomic_init(&self->counts[i], 0);
+  atomic_init(&self->sum, 0.0);
+  self->cumulative = (uint64_t *)prom_object_malloc(sizeof(uint64_t) * (bucket_count + 1));
+
+  // The exposition lines are rendered once here: the buckets in order, then +Inf, count and sum
+  self->lines = (prom_metric_sample_t **)prom_object_malloc(sizeof(prom_metric_sample_t *) * (bucket_count + 3));
+  memset(self->lines, 0, sizeof(prom_metric_sample_t *) * (bucket_count + 3));
+  prom_metric_formatter_t *formatter = prom_metric_formatter_new();
+  if (formatter == NULL) {
     prom_metric_sample_histogram_destroy(self);
     return NULL;
   }
-
-  // Add summary sample
-  r = prom_metric_sample_histogram_init_summary(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // The value of nodes in this map will be simple prom_metric_sample pointers.
-  r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  for (size_t i = 0; i <= bucket_count + 2; i++) {
+    const char *suffix = i == bucket_count + 1 ? "count" : i == bucket_count + 2 ? "sum" : NULL;
+    char *le = NULL;
+    if (i < bucket_count) {
+      le = prom_metric_sample_histogram_bucket_to_str(self->upper_bounds[i]);
+    } else if (i == bucket_count) {
+      le = prom_strdup("+Inf");
+    }
+    self->lines[i] = prom_metric_sample_line_new(formatter, PROM_HISTOGRAM, name, suffix, label_count, label_keys,
+                                                 label_values, le == NULL ? NULL : "le", le);
+    prom_free(le);
+    if (self->lines[i] == NULL) {
+      prom_metric_formatter_destroy(formatter);
+      prom_metric_sample_histogram_destroy(self);
+      return NULL;
+    }
   }
+  prom_metric_formatter_destroy(formatter);
   return self;
 }
 
-static int prom_metric_sample_histogram_init_bucket_samples(prom_metric_sample_histogram_t *self, const char *name,
-                                                            size_t label_count, const char **label_keys,
-                                                            const char **label_values) {
-  PROM_ASSERT(self);
-  int r = 0;
-  int bucket_count = prom_histogram_buckets_count(self->buckets);
-
-  // For each bucket, create an prom_metric_sample_t with an appropriate l_value and default value of 0.0. The
-  // l_value will contain the metric name, user labels, and finally, the le label and bucket value.
-  for (int i = 0; i < bucket_count; i++) {
-    const char *l_value = prom_metric_sample_histogram_l_value_for_bucket(self, name, label_count, label_keys,
-                                                                          label_values, self->buckets->upper_bounds[i]);
-    if (l_value == NULL) return 1;
-
-    r = prom_linked_list_append(self->l_value_list, prom_strdup(l_value));
-    if (r) return r;
-
-    const char *bucket_key = prom_metric_sample_histogram_bucket_to_str(self->buckets->upper_bounds[i]);
-    if (bucket_key == NULL) return 1;
-
-    r = prom_map_set(self->l_values, bucket_key, (char *)l_value);
-    if (r) return r;
-
-    prom_metric_sample_t *sample = prom_metric_sample_new(PROM_HISTOGRAM, l_value, 0.0);
-    if (sample == NULL) return 1;
-
-    r = prom_map_set(self->samples, l_value, sample);
-    if (r) return r;
-
-    prom_free((void *)bucket_key);
-  }
-  return 0;
-}
-
-static int prom_metric_sample_histogram_init_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                 size_t label_count, const char **label_keys,
-                                                 const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-  const char *inf_l_value =
-      prom_metric_sample_histogram_l_value_for_inf(self, name, label_count, label_keys, label_values);
-  if (inf_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(inf_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "+Inf", (char *)inf_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *inf_sample = prom_metric_sample_new(PROM_HISTOGRAM, (char *)inf_l_value, 0.0);
-  if (inf_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, inf_l_value, inf_sample);
-}
-
-static int prom_metric_sample_histogram_init_count(prom_metric_sample_histogram_t *self, const char *name,
-                                                   size_t label_count, const char **label_keys,
-                                                   const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, "count", label_count, label_keys, label_values);
-  if (r) return r;
-
-  const char *count_l_value = prom_metric_formatter_dump(self->metric_formatter);
-  if (count_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(count_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "count", (char *)count_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *count_sample = prom_metric_sample_new(PROM_HISTOGRAM, count_l_value, 0.0);
-  if (count_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, count_l_value, count_sample);
-}
-
-static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogram_t *self, const char *name,
-                                                     size_t label_count, const char **label_keys,
-                                                     const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, "sum", label_count, label_keys, label_values);
-  if (r) return r;
-
-  const char *sum_l_value = prom_metric_formatter_dump(self->metric_formatter);
-  if (sum_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(sum_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "sum", (char *)sum_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *sum_sample = prom_metric_sample_new(PROM_HISTOGRAM, sum_l_value, 0.0);
-  if (sum_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, sum_l_value, sum_sample);
+prom_metric_sample_histogram_t *prom_metric_sample_histogram_new_sparse(const char *name, int schema,
+                                                                        size_t max_buckets, size_t label_count,
+                                                                        const char **label_keys,
+                                                                        const char **label_values) {
+  // No upper bounds: the lines are +Inf, count and sum, and the buckets are rendered from sparse at exposition
+  prom_metric_sample_histogram_t *self =
+      prom_metric_sample_histogram_new(name, NULL, label_count, label_keys, label_values);
+  if (self == NULL) return NULL;
+  self->sparse = prom_histogram_sparse_new(schema, max_buckets);
+  return self;
 }
 
 int prom_metric_sample_histogram_destroy(prom_metric_sample_histogram_t *self) {
@@ -275,29 +105,32 @@ int prom_metric_sample_histogram_destroy(prom_metric_sample_histogram_t *self) {
 
   if (self == NULL) return 0;
 
-  r = prom_linked_list_destroy(self->l_value_list);
-  self->l_value_list = NULL;
-  if (r) ret = r;
-
-  r = prom_map_destroy(self->samples);
-  if (r) ret = r;
-  self->samples = NULL;
-
-  r = prom_map_destroy(self->l_values);
-  if (r) ret = r;
-  self->l_values = NULL;
-
-  r = prom_metric_formatter_destroy(self->metric_formatter);
-  if (r) ret = r;
-  self->metric_formatter = NULL;
-
-  r = pthread_rwlock_destroy(self->rwlock);
+  if (self->lines != NULL) {
+    for (size_t i = 0; i <= self->bucket_count + 2; i++) {
+      if (self->lines[i] == NULL) continue;
+      r = prom_metric_sample_destroy(self->lines[i]);
+      if (r) ret = r;
+    }
+  }
+  prom_object_free(self->lines, sizeof(prom_metric_sample_t *) * (self->bucket_count + 3));
+  self->lines = NULL;
+
+  prom_object_free(self->upper_bounds, sizeof(double) * (self->bucket_count + 1));
+  self->upper_bounds = NULL;
+  prom_object_free((void *)self->counts, sizeof(_Atomic uint64_t) * (self->bucket_count + 1));
+  self->counts = NULL;
+  prom_object_free(self->cumulative, sizeof(uint64_t) * (self->bucket_count + 1));
+  self->cumulative = NULL;
+  prom_histogram_sparse_destroy(self->sparse);
+  self->sparse = NULL;
+
+  r = pthread_mutex_destroy(&self->lock);
   if (r) ret = r;
 
-  prom_free(self->rwlock);
-  self->rwlock = NULL;
+  prom_free((void *)self->label_values);
+  self->label_values = NULL;
 
-  prom_free(self);
+  prom_object_free(self, sizeof(prom_metric_sample_histogram_t));
   self = NULL;
   return ret;
 }
@@ -313,196 +146,117 @@ int prom_metric_sample_histogram_destroy_generic(void *gen) {
 
 void prom_metric_sample_histogram_free_generic(void *gen) {
   prom_metric_sample_histogram_t *self = (prom_metric_sample_histogram_t *)gen;
-  prom_metric_sample_histogram_destroy(self);
+  prom_metric_sample_histogram_release(self);
 }
 
-int prom_metric_sample_histogram_observe(prom_metric_sample_histogram_t *self, double value) {
-  int r = 0;
-
-  r = pthread_rwlock_wrlock(self->rwlock);
-  if (r) {
-    printf("RETURN CODE: %d\n", r);
-    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
-    return r;
-  }
-
-#define PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r) \
-  int rr = 0;                                                 \
-  rr = pthread_rwlock_unlock(self->rwlock);                   \
-  if (rr) {                                                   \
-    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);               \
-    return rr;                                                \
-  } else {                                                    \
-    return r;                                                 \
+size_t prom_metric_sample_histogram_memory(prom_metric_sample_histogram_t *self) {
+  PROM_ASSERT(self != NULL);
+  size_t n = self->bucket_count;
+  size_t size = sizeof(prom_metric_sample_histogram_t) +
+                (n + 1) * (sizeof(double) + sizeof(_Atomic uint64_t) + sizeof(uint64_t)) +
+                (n + 3) * sizeof(prom_metric_sample_t *);
+  for (size_t i = 0; i <= n + 2; i++) size += prom_metric_sample_memory(self->lines[i]);
+  if (self->sparse != NULL && pthread_mutex_lock(&self->lock) == 0) {
+    size += prom_histogram_sparse_memory(self->sparse);
+    pthread_mutex_unlock(&self->lock);
   }
+  return size;
+}
 
-  // Update the counter for the proper bucket if found
-  int bucket_count = prom_histogram_buckets_count(self->buckets);
-  for (int i = (bucket_count - 1); i >= 0; i--) {
-    if (value > self->buckets->upper_bounds[i]) {
-      break;
-    }
-
-    const char *bucket_key = prom_metric_sample_histogram_bucket_to_str(self->buckets->upper_bounds[i]);
-    if (bucket_key == NULL) {
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
+void prom_metric_sample_histogram_retain(prom_metric_sample_histogram_t *self) {
+  PROM_ASSERT(self != NULL);
+  atomic_fetch_add_explicit(&self->ref_count, 1, memory_order_relaxed);
+}
 
-    const char *l_value = prom_map_get(self->l_values, bucket_key);
-    if (l_value == NULL) {
-      prom_free((void *)bucket_key);
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
+void prom_metric_sample_histogram_release(prom_metric_sample_histogram_t *self) {
+  if (self == NULL) return;
+  if (atomic_fetch_sub_explicit(&self->ref_count, 1, memory_order_acq_rel) == 1) {
+    prom_metric_sample_histogram_destroy(self);
+  }
+}
 
-    prom_metric_sample_t *sample = prom_map_get(self->samples, l_value);
-    if (sample == NULL) {
-      prom_free((void *)bucket_key);
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
+int prom_metric_sample_histogram_observe(prom_metric_sample_histogram_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
 
-    prom_free((void *)bucket_key);
-    r = prom_metric_sample_add(sample, 1.0);
+  if (self->sparse != NULL) {
+    // Sparse buckets may grow or change schema, so they are updated under the lock
+    int r = pthread_mutex_lock(&self->lock);
     if (r) {
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r);
+      PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+      return r;
     }
+    prom_histogram_sparse_observe(self->sparse, value);
+    atomic_fetch_add_explicit(&self->counts[0], 1, memory_order_relaxed);
+    atomic_store_explicit(&self->sum, atomic_load_explicit(&self->sum, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+    pthread_mutex_unlock(&self->lock);
+    return 0;
   }
 
-  // Update the +Inf and count samples
-  const char *inf_l_value = prom_map_get(self->l_values, "+Inf");
-  if (inf_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  prom_metric_sample_t *inf_sample = prom_map_get(self->samples, inf_l_value);
-  if (inf_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  r = prom_metric_sample_add(inf_sample, 1.0);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  const char *count_l_value = prom_map_get(self->l_values, "count");
-  if (count_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  prom_metric_sample_t *count_sample = prom_map_get(self->samples, count_l_value);
-  if (count_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  r = prom_metric_sample_add(count_sample, 1.0);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  // Update the sum sample
-  const char *sum_l_value = prom_map_get(self->l_values, "sum");
-  if (sum_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
+  // Find the first bucket whose upper bound is at least value. Values above every bound, and NaN, land in the last
+  // slot, +Inf.
+  size_t bucket = 0;
+  size_t n = self->bucket_count;
+  while (n > 0) {
+    size_t half = n / 2;
+    if (!(self->upper_bounds[bucket + half] >= value)) {
+      bucket += half + 1;
+      n -= half + 1;
+    } else {
+      n = half;
+    }
   }
+  atomic_fetch_add_explicit(&self->counts[bucket], 1, memory_order_relaxed);
 
-  prom_metric_sample_t *sum_sample = prom_map_get(self->samples, sum_l_value);
-  if (sum_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
+  double old = atomic_load_explicit(&self->sum, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(&self->sum, &old, old + value, memory_order_relaxed,
+                                                memory_order_relaxed)) {
   }
-
-  r = prom_metric_sample_add(sum_sample, value);
-  PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r);
-  return r;
+  return 0;
 }
 
-static const char *prom_metric_sample_histogram_l_value_for_bucket(prom_metric_sample_histogram_t *self,
-                                                                   const char *name, size_t label_count,
-                                                                   const char **label_keys, const char **label_values,
-                                                                   double bucket) {
+int prom_metric_sample_histogram_set(prom_metric_sample_histogram_t *self, const double *bucket_counts, double sum) {
   PROM_ASSERT(self != NULL);
-  int r = 0;
-
-#define PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_BUCKET_CLEANUP() \
-  for (size_t i = 0; i < label_count + 1; i++) {                  \
-    prom_free((char *)new_keys[i]);                               \
-    prom_free((char *)new_values[i]);                             \
-  }                                                               \
-  prom_free(new_keys);                                            \
-  prom_free(new_values);
-
-  // Make new array to hold label_keys with le label key
-  const char **new_keys = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
-  for (size_t i = 0; i < label_count; i++) {
-    new_keys[i] = prom_strdup(label_keys[i]);
+  if (self == NULL || bucket_counts == NULL) return 1;
+  if (self->sparse != NULL) {
+    // There are no upper bounds for bucket_counts to match
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
   }
-  new_keys[label_count] = prom_strdup("le");
 
-  // Make new array to hold label_values with le label value
-  const char **new_values = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
-  for (size_t i = 0; i < label_count; i++) {
-    new_values[i] = prom_strdup(label_values[i]);
-  }
-
-  new_values[label_count] = prom_metric_sample_histogram_bucket_to_str(bucket);
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, NULL, label_count + 1, new_keys, new_values);
+  int r = pthread_mutex_lock(&self->lock);
   if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_BUCKET_CLEANUP();
-    return NULL;
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
   }
-  const char *ret = (const char *)prom_metric_formatter_dump(self->metric_formatter);
-  PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_BUCKET_CLEANUP();
-  return ret;
+  // Counts are whole observations; the doubles are rounded to the nearest one
+  for (size_t i = 0; i <= self->bucket_count; i++) {
+    uint64_t count = bucket_counts[i] > 0 ? (uint64_t)(bucket_counts[i] + 0.5) : 0;
+    atomic_store_explicit(&self->counts[i], count, memory_order_relaxed);
+  }
+  atomic_store_explicit(&self->sum, sum, memory_order_relaxed);
+  pthread_mutex_unlock(&self->lock);
+  return 0;
 }
 
-static const char *prom_metric_sample_histogram_l_value_for_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                                size_t label_count, const char **label_keys,
-                                                                const char **label_values) {
+double prom_metric_sample_histogram_collect(prom_metric_sample_histogram_t *self) {
   PROM_ASSERT(self != NULL);
-  int r = 0;
-
-#define PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_INF_CLEANUP() \
-  for (size_t i = 0; i < label_count + 1; i++) {               \
-    prom_free((char *)new_keys[i]);                            \
-    prom_free((char *)new_values[i]);                          \
-  }                                                            \
-  prom_free(new_keys);                                         \
-  prom_free(new_values);
-
-  // Make new array to hold label_keys with le label key
-  const char **new_keys = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
-  for (size_t i = 0; i < label_count; i++) {
-    new_keys[i] = prom_strdup(label_keys[i]);
-  }
-  new_keys[label_count] = prom_strdup("le");
-
-  // Make new array to hold label_values with le label value
-  const char **new_values = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
-  for (size_t i = 0; i < label_count; i++) {
-    new_values[i] = prom_strdup(label_values[i]);
+  // Each counter is read once, so the buckets, +Inf and count always agree with each other. The sum may include
+  // observations still in flight.
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i <= self->bucket_count; i++) {
+    cumulative += atomic_load_explicit(&self->counts[i], memory_order_relaxed);
+    self->cumulative[i] = cumulative;
   }
-
-  new_values[label_count] = prom_strdup("+Inf");
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, NULL, label_count + 1, new_keys, new_values);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_INF_CLEANUP()
-    return NULL;
-  }
-  const char *ret = (const char *)prom_metric_formatter_dump(self->metric_formatter);
-  PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_INF_CLEANUP()
-  return ret;
-}
-
-static void prom_metric_sample_histogram_free_str_generic(void *gen) {
-  char *str = (char *)gen;
-  prom_free((void *)str);
-  str = NULL;
+  return atomic_load_explicit(&self->sum, memory_order_relaxed);
 }
 
 char *prom_metric_sample_histogram_bucket_to_str(double bucket) {
-  char *buf = (char *)prom_malloc(sizeof(char) * 50);
-  sprintf(buf, "%g", bucket);
-  if (!strchr(buf, '.')) {
+  char *buf = (char *)prom_malloc(PROM_TEXT_WRITER_DOUBLE_SIZE + 2);
+  prom_text_writer_format_double(buf, bucket);
+  // Whole bounds keep the le="1.0" form; exponents and +Inf are left alone
+  if (strspn(buf + (buf[0] == '-'), "0123456789") == strlen(buf + (buf[0] == '-'))) {
     strcat(buf, ".0");
   }
   return buf;
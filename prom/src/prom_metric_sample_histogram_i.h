@@ -30,6 +30,15 @@ prom_metric_sample_histogram_t *prom_metric_sample_histogram_new(const char *nam
                                                                  size_t label_count, const char **label_keys,
                                                                  const char **label_vales);
 
+/**
+ * @brief API PRIVATE Create a pointer to a prom_metric_sample_histogram_t with sparse exponential buckets at the given
+ * schema, keeping at most max_buckets of them
+ */
+prom_metric_sample_histogram_t *prom_metric_sample_histogram_new_sparse(const char *name, int schema,
+                                                                        size_t max_buckets, size_t label_count,
+                                                                        const char **label_keys,
+                                                                        const char **label_values);
+
 /**
  * @brief API PRIVATE Destroy a prom_metric_sample_histogram_t
  */
@@ -42,6 +51,26 @@ int prom_metric_sample_histogram_destroy_generic(void *gen);
 
 char *prom_metric_sample_histogram_bucket_to_str(double bucket);
 
+/**
+ * @brief API PRIVATE Drop the sample map's reference to a void pointer that is cast to a prom_metric_sample_histogram_t*
+ */
 void prom_metric_sample_histogram_free_generic(void *gen);
 
+/**
+ * @brief API PRIVATE Returns the approximate heap memory of the histogram in bytes, not counting its label_values
+ */
+size_t prom_metric_sample_histogram_memory(prom_metric_sample_histogram_t *self);
+
+/**
+ * @brief API PRIVATE Take an additional reference on the sample. Balanced by prom_metric_sample_histogram_release.
+ */
+void prom_metric_sample_histogram_retain(prom_metric_sample_histogram_t *self);
+
+/**
+ * @brief API PRIVATE Read the histogram for exposition. Fills self->cumulative with the cumulative count of every
+ * bucket, +Inf last, so its last entry is the total count, and returns the sum. The caller MUST hold self->lock until
+ * it is done with self->cumulative.
+ */
+double prom_metric_sample_histogram_collect(prom_metric_sample_histogram_t *self);
+
 #endif  // PROM_METRIC_HISTOGRAM_SAMPLE_I_H
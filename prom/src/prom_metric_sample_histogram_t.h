@@ -15,25 +15,33 @@
  */
 
 #include <pthread.h>
+#include <stdint.h>
 
 // Public
 #include "prom_histogram_buckets.h"
 #include "prom_metric_sample_histogram.h"
 
 // Private
-#include "prom_map_t.h"
-#include "prom_metric_formatter_t.h"
+#include "prom_histogram_sparse_t.h"
+#include "prom_metric_sample_t.h"
 
 #ifndef PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 #define PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 
 struct prom_metric_sample_histogram {
-  prom_linked_list_t *l_value_list;
-  prom_map_t *l_values;
-  prom_map_t *samples;
-  prom_metric_formatter_t *metric_formatter;
-  prom_histogram_buckets_t *buckets;
-  pthread_rwlock_t *rwlock;
+  size_t bucket_count;             /**< bucket_count is the number of upper bounds, not counting +Inf */
+  double *upper_bounds;            /**< upper_bounds is a copy of the bucket bounds, so handles may outlive the metric */
+  _Atomic uint64_t *counts;        /**< counts holds the non-cumulative count per bucket, the last one for +Inf */
+  _Atomic double sum;              /**< sum is the sum of all observed values */
+  uint64_t *cumulative;            /**< cumulative receives the counts read by prom_metric_sample_histogram_collect */
+  prom_metric_sample_t **lines;    /**< lines are the exposition lines: one per bucket, +Inf, count and sum */
+  prom_histogram_sparse_t *sparse; /**< sparse holds the buckets of a sparse histogram, which has no upper bounds */
+  pthread_mutex_t lock;            /**< lock serializes set, exposition and sparse observe; others observe without it */
+  const char **label_values;       /**< label_values are the label values shared by every line of the histogram */
+  _Atomic int ref_count;           /**< ref_count counts the owning sample map plus every outstanding child handle */
+  uint64_t gen;                    /**< gen is the metric update generation that last touched the sample */
+  uint64_t delta_hash;             /**< delta_hash is the hash of the counts and sum the last delta scrape found */
+  uint64_t delta_gen;              /**< delta_gen is the delta generation the series last changed in, 0 if never */
 };
 
 #endif  // PROM_METRIC_HISTOGRAM_SAMPLE_T_H
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "prom_metric_formatter_t.h"
 #include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
 
@@ -29,11 +30,53 @@
  */
 prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value);
 
+/**
+ * @brief API PRIVATE Return a sharded prom_metric_sample_t* starting at 0. prom_metric_sample_add spreads its
+ * increments over per-thread slots, each on a cache line of its own, which prom_metric_sample_value sums up.
+ */
+prom_metric_sample_t *prom_metric_sample_new_sharded(prom_metric_type_t type, const char *l_value);
+
+/**
+ * @brief API PRIVATE Return the prom_metric_sample_t* for one exposition line of a histogram or summary series: name
+ * with the suffix, the series labels and, unless extra_key is NULL, one more label such as le or quantile. The sample
+ * carries no label_values. formatter is used as scratch space and left empty.
+ */
+prom_metric_sample_t *prom_metric_sample_line_new(prom_metric_formatter_t *formatter, prom_metric_type_t type,
+                                                  const char *name, const char *suffix, size_t label_count,
+                                                  const char **label_keys, const char **label_values,
+                                                  const char *extra_key, const char *extra_value);
+
 /**
  * @brief API PRIVATE Destroy the prom_metric_sample**
  */
 int prom_metric_sample_destroy(prom_metric_sample_t *self);
 
+/**
+ * @brief API PRIVATE Copies label_count label values into a single allocation, to be freed with prom_free. Returns NULL
+ * when label_count is 0.
+ */
+const char **prom_metric_sample_label_values_copy(size_t label_count, const char **label_values);
+
+/**
+ * @brief API PRIVATE Returns the current value of the sample, summing the slots of a sharded one
+ */
+double prom_metric_sample_value(prom_metric_sample_t *self);
+
+/**
+ * @brief API PRIVATE Returns the memory taken by a copy of label_count label values, 0 if label_values is NULL
+ */
+size_t prom_metric_sample_label_values_memory(size_t label_count, const char **label_values);
+
+/**
+ * @brief API PRIVATE Returns the approximate heap memory of the sample in bytes, not counting its label_values
+ */
+size_t prom_metric_sample_memory(prom_metric_sample_t *self);
+
+/**
+ * @brief API PRIVATE Take an additional reference on the sample. Balanced by prom_metric_sample_release.
+ */
+void prom_metric_sample_retain(prom_metric_sample_t *self);
+
 /**
  * @brief API PRIVATE A prom_linked_list_free_item_fn to enable item destruction within a linked list's destructor
  */
@@ -42,7 +85,8 @@ int prom_metric_sample_destroy_generic(void *);
 /**
  * @brief API PRIVATE A prom_linked_list_free_item_fn to enable item destruction within a linked list's destructor.
  *
- * This function ignores any errors.
+ * Drops the container's reference; the sample is destroyed once no child handle holds it either. This function
+ * ignores any errors.
  */
 void prom_metric_sample_free_generic(void *gen);
 
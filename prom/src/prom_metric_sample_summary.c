@@ -0,0 +1,274 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_metric_formatter_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_tdigest_i.h"
+#include "prom_text_writer_i.h"
+
+// Hands out shard hints round robin, one per observing thread
+static atomic_uint prom_metric_sample_summary_next_shard = ATOMIC_VAR_INIT(0);
+
+// The shard hint of the calling thread plus one, 0 until its first observation
+static _Thread_local unsigned prom_metric_sample_summary_shard_hint = 0;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static Declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t prom_metric_sample_summary_epoch(prom_metric_sample_summary_t *self);
+static void prom_metric_sample_summary_flush(prom_metric_sample_summary_t *self, uint64_t epoch, double *values,
+                                             size_t count);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End static declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prom_metric_sample_summary_t *prom_metric_sample_summary_new(const char *name, size_t quantile_count,
+                                                             const double *quantiles, double max_age,
+                                                             size_t label_count, const char **label_keys,
+                                                             const char **label_values) {
+  // Allocate and set self
+  prom_metric_sample_summary_t *self =
+      (prom_metric_sample_summary_t *)prom_malloc(sizeof(prom_metric_sample_summary_t));
+  self->gen = 0;
+  self->delta_hash = 0;
+  self->delta_gen = 0;
+  self->ref_count = ATOMIC_VAR_INIT(1);
+  self->label_values = prom_metric_sample_label_values_copy(label_count, label_values);
+  pthread_mutex_init(&self->lock, NULL);
+
+  for (int i = 0; i < PROM_METRIC_SAMPLE_SUMMARY_SHARDS; i++) {
+    prom_metric_sample_summary_shard_t *shard = &self->shards[i];
+    pthread_mutex_init(&shard->lock, NULL);
+    shard->count = 0;
+    shard->sum = 0.0;
+    shard->buffered = 0;
+  }
+  self->age_width = max_age / PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS;
+  for (int i = 0; i < PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS; i++) {
+    self->epochs[i] = 0;
+    prom_tdigest_reset(&self->windows[i]);
+  }
+  prom_tdigest_reset(&self->merged);
+
+  self->quantile_count = quantile_count;
+  self->quantiles = (double *)prom_object_malloc(sizeof(double) * (quantile_count + 1));
+  memcpy(self->quantiles, quantiles, sizeof(double) * quantile_count);
+  self->values = (double *)prom_object_malloc(sizeof(double) * (quantile_count + 1));
+
+  // The exposition lines are rendered once here: the quantiles in order, then count and sum
+  self->lines = (prom_metric_sample_t **)prom_object_malloc(sizeof(prom_metric_sample_t *) * (quantile_count + 2));
+  memset(self->lines, 0, sizeof(prom_metric_sample_t *) * (quantile_count + 2));
+  prom_metric_formatter_t *formatter = prom_metric_formatter_new();
+  if (formatter == NULL) {
+    prom_metric_sample_summary_destroy(self);
+    return NULL;
+  }
+  for (size_t i = 0; i < quantile_count + 2; i++) {
+    if (i < quantile_count) {
+      char quantile[PROM_TEXT_WRITER_DOUBLE_SIZE];
+      prom_text_writer_format_double(quantile, quantiles[i]);
+      self->lines[i] = prom_metric_sample_line_new(formatter, PROM_SUMMARY, name, NULL, label_count, label_keys,
+                                                   label_values, "quantile", quantile);
+    } else {
+      const char *suffix = i == quantile_count ? "count" : "sum";
+      self->lines[i] = prom_metric_sample_line_new(formatter, PROM_SUMMARY, name, suffix, label_count, label_keys,
+                                                   label_values, NULL, NULL);
+    }
+    if (self->lines[i] == NULL) {
+      prom_metric_formatter_destroy(formatter);
+      prom_metric_sample_summary_destroy(self);
+      return NULL;
+    }
+  }
+  prom_metric_formatter_destroy(formatter);
+  return self;
+}
+
+int prom_metric_sample_summary_destroy(prom_metric_sample_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+  int ret = 0;
+
+  if (self == NULL) return 0;
+
+  if (self->lines != NULL) {
+    for (size_t i = 0; i < self->quantile_count + 2; i++) {
+      if (self->lines[i] == NULL) continue;
+      r = prom_metric_sample_destroy(self->lines[i]);
+      if (r) ret = r;
+    }
+  }
+  prom_object_free(self->lines, sizeof(prom_metric_sample_t *) * (self->quantile_count + 2));
+  self->lines = NULL;
+
+  prom_object_free(self->quantiles, sizeof(double) * (self->quantile_count + 1));
+  self->quantiles = NULL;
+  prom_object_free(self->values, sizeof(double) * (self->quantile_count + 1));
+  self->values = NULL;
+
+  for (int i = 0; i < PROM_METRIC_SAMPLE_SUMMARY_SHARDS; i++) {
+    r = pthread_mutex_destroy(&self->shards[i].lock);
+    if (r) ret = r;
+  }
+  r = pthread_mutex_destroy(&self->lock);
+  if (r) ret = r;
+
+  prom_free((void *)self->label_values);
+  self->label_values = NULL;
+
+  prom_free(self);
+  self = NULL;
+  return ret;
+}
+
+void prom_metric_sample_summary_free_generic(void *gen) {
+  prom_metric_sample_summary_t *self = (prom_metric_sample_summary_t *)gen;
+  prom_metric_sample_summary_release(self);
+}
+
+size_t prom_metric_sample_summary_memory(prom_metric_sample_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+  size_t n = self->quantile_count;
+  size_t size = sizeof(prom_metric_sample_summary_t) + 2 * (n + 1) * sizeof(double) +
+                (n + 2) * sizeof(prom_metric_sample_t *);
+  for (size_t i = 0; i < n + 2; i++) size += prom_metric_sample_memory(self->lines[i]);
+  return size;
+}
+
+void prom_metric_sample_summary_retain(prom_metric_sample_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+  atomic_fetch_add_explicit(&self->ref_count, 1, memory_order_relaxed);
+}
+
+void prom_metric_sample_summary_release(prom_metric_sample_summary_t *self) {
+  if (self == NULL) return;
+  if (atomic_fetch_sub_explicit(&self->ref_count, 1, memory_order_acq_rel) == 1) {
+    prom_metric_sample_summary_destroy(self);
+  }
+}
+
+int prom_metric_sample_summary_observe(prom_metric_sample_summary_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  if (prom_metric_sample_summary_shard_hint == 0) {
+    prom_metric_sample_summary_shard_hint = atomic_fetch_add(&prom_metric_sample_summary_next_shard, 1) + 1;
+  }
+  prom_metric_sample_summary_shard_t *shard =
+      &self->shards[(prom_metric_sample_summary_shard_hint - 1) % PROM_METRIC_SAMPLE_SUMMARY_SHARDS];
+
+  int r = pthread_mutex_lock(&shard->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  shard->count++;
+  shard->sum += value;
+  shard->buffer[shard->buffered++] = value;
+  if (shard->buffered < PROM_METRIC_SAMPLE_SUMMARY_SHARD_BUFFER) {
+    pthread_mutex_unlock(&shard->lock);
+    return 0;
+  }
+
+  // The shard is full: take its values and merge them without holding up the other observers of the shard
+  double values[PROM_METRIC_SAMPLE_SUMMARY_SHARD_BUFFER];
+  memcpy(values, shard->buffer, sizeof(values));
+  shard->buffered = 0;
+  pthread_mutex_unlock(&shard->lock);
+
+  r = pthread_mutex_lock(&self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  prom_metric_sample_summary_flush(self, prom_metric_sample_summary_epoch(self), values,
+                                   PROM_METRIC_SAMPLE_SUMMARY_SHARD_BUFFER);
+  pthread_mutex_unlock(&self->lock);
+  return 0;
+}
+
+void prom_metric_sample_summary_collect(prom_metric_sample_summary_t *self, uint64_t *count, double *sum) {
+  PROM_ASSERT(self != NULL);
+  uint64_t epoch = prom_metric_sample_summary_epoch(self);
+
+  *count = 0;
+  *sum = 0.0;
+  for (int i = 0; i < PROM_METRIC_SAMPLE_SUMMARY_SHARDS; i++) {
+    prom_metric_sample_summary_shard_t *shard = &self->shards[i];
+    double values[PROM_METRIC_SAMPLE_SUMMARY_SHARD_BUFFER];
+    pthread_mutex_lock(&shard->lock);
+    *count += shard->count;
+    *sum += shard->sum;
+    size_t buffered = shard->buffered;
+    memcpy(values, shard->buffer, sizeof(double) * buffered);
+    shard->buffered = 0;
+    pthread_mutex_unlock(&shard->lock);
+    prom_metric_sample_summary_flush(self, epoch, values, buffered);
+  }
+
+  // Only the windows of the last PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS periods count
+  prom_tdigest_reset(&self->merged);
+  for (int i = 0; i < PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS; i++) {
+    if (epoch - self->epochs[i] < PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS) {
+      prom_tdigest_merge(&self->merged, &self->windows[i]);
+    }
+  }
+  for (size_t i = 0; i < self->quantile_count; i++) {
+    self->values[i] = prom_tdigest_quantile(&self->merged, self->quantiles[i]);
+  }
+}
+
+/**
+ * @brief API PRIVATE Returns the number of the age period the present falls in
+ */
+static uint64_t prom_metric_sample_summary_epoch(prom_metric_sample_summary_t *self) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)((now.tv_sec + now.tv_nsec / 1e9) / self->age_width);
+}
+
+/**
+ * @brief API PRIVATE Add values to the window of the given age period, recycling the window of the period
+ * PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS before it. The caller holds self->lock.
+ *
+ * Buffered values are dated by the flush that merges them, so an observation may count in a later period than the
+ * one it was made in, by at most the time its shard took to fill or to the next scrape.
+ */
+static void prom_metric_sample_summary_flush(prom_metric_sample_summary_t *self, uint64_t epoch, double *values,
+                                             size_t count) {
+  if (count == 0) return;
+  size_t slot = epoch % PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS;
+  if (self->epochs[slot] != epoch) {
+    prom_tdigest_reset(&self->windows[slot]);
+    self->epochs[slot] = epoch;
+  }
+  prom_tdigest_add(&self->windows[slot], values, count);
+}
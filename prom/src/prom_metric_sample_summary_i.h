@@ -0,0 +1,64 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_SAMPLE_SUMMARY_I_H
+#define PROM_METRIC_SAMPLE_SUMMARY_I_H
+
+#include <stdint.h>
+
+// Public
+#include "prom_metric_sample_summary.h"
+
+// Private
+#include "prom_metric_sample_summary_t.h"
+
+/**
+ * @brief API PRIVATE Create a pointer to a prom_metric_sample_summary_t exposing quantile_count quantiles over the
+ * last max_age seconds
+ */
+prom_metric_sample_summary_t *prom_metric_sample_summary_new(const char *name, size_t quantile_count,
+                                                             const double *quantiles, double max_age,
+                                                             size_t label_count, const char **label_keys,
+                                                             const char **label_values);
+
+/**
+ * @brief API PRIVATE Destroy a prom_metric_sample_summary_t
+ */
+int prom_metric_sample_summary_destroy(prom_metric_sample_summary_t *self);
+
+/**
+ * @brief API PRIVATE Drop the sample map's reference to a void pointer that is cast to a prom_metric_sample_summary_t*
+ */
+void prom_metric_sample_summary_free_generic(void *gen);
+
+/**
+ * @brief API PRIVATE Returns the approximate heap memory of the summary in bytes, not counting its label_values
+ */
+size_t prom_metric_sample_summary_memory(prom_metric_sample_summary_t *self);
+
+/**
+ * @brief API PRIVATE Take an additional reference on the sample. Balanced by prom_metric_sample_summary_release.
+ */
+void prom_metric_sample_summary_retain(prom_metric_sample_summary_t *self);
+
+/**
+ * @brief API PRIVATE Read the summary for exposition. Drains the shard buffers into the sketch, fills self->values
+ * with one estimate per quantile, NaN while the window is empty, and stores the total count and sum. The caller MUST
+ * hold self->lock until it is done with self->values.
+ */
+void prom_metric_sample_summary_collect(prom_metric_sample_summary_t *self, uint64_t *count, double *sum);
+
+#endif  // PROM_METRIC_SAMPLE_SUMMARY_I_H
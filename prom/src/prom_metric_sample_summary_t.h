@@ -0,0 +1,66 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+
+// Public
+#include "prom_metric_sample_summary.h"
+
+// Private
+#include "prom_metric_sample_t.h"
+#include "prom_tdigest_t.h"
+
+#ifndef PROM_METRIC_SAMPLE_SUMMARY_T_H
+#define PROM_METRIC_SAMPLE_SUMMARY_T_H
+
+// Observations are spread over this many shards, each picked by a per-thread hint
+#define PROM_METRIC_SAMPLE_SUMMARY_SHARDS 4
+
+// Observations a shard buffers before merging them into the sketch
+#define PROM_METRIC_SAMPLE_SUMMARY_SHARD_BUFFER 64
+
+// The max_age window is covered by this many sketches, each holding max_age / PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS
+// seconds of observations
+#define PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS 5
+
+typedef struct prom_metric_sample_summary_shard {
+  pthread_mutex_t lock; /**< lock guards the shard; only the threads sharing its hint contend on it */
+  uint64_t count;       /**< count is the number of values observed through the shard */
+  double sum;           /**< sum is the sum of the values observed through the shard */
+  size_t buffered;      /**< buffered is the number of values in buffer */
+  double buffer[PROM_METRIC_SAMPLE_SUMMARY_SHARD_BUFFER]; /**< buffer holds values not yet merged into the sketch */
+} prom_metric_sample_summary_shard_t;
+
+struct prom_metric_sample_summary {
+  prom_metric_sample_summary_shard_t shards[PROM_METRIC_SAMPLE_SUMMARY_SHARDS]; /**< shards take the observations */
+  pthread_mutex_t lock; /**< lock guards the windows and serializes exposition */
+  double age_width;     /**< age_width is the number of seconds covered by each window */
+  uint64_t epochs[PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS];          /**< epochs are the age periods of the windows */
+  prom_tdigest_t windows[PROM_METRIC_SAMPLE_SUMMARY_AGE_BUCKETS];   /**< windows are the sketches of recent periods */
+  prom_tdigest_t merged;        /**< merged receives the live windows on collection */
+  size_t quantile_count;        /**< quantile_count is the number of quantiles exposed */
+  double *quantiles;            /**< quantiles is a copy of the quantiles exposed, so handles may outlive the metric */
+  double *values;               /**< values receives the estimates made by prom_metric_sample_summary_collect */
+  prom_metric_sample_t **lines; /**< lines are the exposition lines: one per quantile, then count and sum */
+  const char **label_values;    /**< label_values are the label values shared by every line of the summary */
+  _Atomic int ref_count;        /**< ref_count counts the owning sample map plus every outstanding child handle */
+  uint64_t gen;                 /**< gen is the metric update generation that last touched the sample */
+  uint64_t delta_hash;          /**< delta_hash is the hash of the values the last delta scrape found */
+  uint64_t delta_gen;           /**< delta_gen is the delta generation the series last changed in, 0 if never */
+};
+
+#endif  // PROM_METRIC_SAMPLE_SUMMARY_T_H
@@ -19,11 +19,36 @@
 
 #include "prom_metric_sample.h"
 #include "prom_metric_t.h"
+#include "prom_text_writer_i.h"
+
+// Room reserved in prom_metric_sample.line for the rendered value and its trailing newline
+#define PROM_METRIC_SAMPLE_VALUE_SIZE (PROM_TEXT_WRITER_DOUBLE_SIZE + 1)
+
+// Increments to a sharded sample are spread over this many slots, each picked by a per-thread hint
+#define PROM_METRIC_SAMPLE_SHARDS 16
+
+// Size of a cache line; every shard slot gets one of its own
+#define PROM_METRIC_SAMPLE_SHARD_SIZE 64
+
+typedef struct prom_metric_sample_shard {
+  _Atomic double value;                                     /**< value is the sum added through the slot */
+  char pad[PROM_METRIC_SAMPLE_SHARD_SIZE - sizeof(double)]; /**< pad keeps neighbouring slots off the cache line */
+} prom_metric_sample_shard_t;
 
 struct prom_metric_sample {
   prom_metric_type_t type; /**< type is the metric type for the sample */
-  char *l_value;           /**< l_value is the full metric name and label set represeted as a string */
-  _Atomic double r_value;  /**< r_value is the value of the metric sample */
+  const char **label_values; /**< label_values are the label values of l_value, NULL for the samples of a histogram */
+  _Atomic double r_value;  /**< r_value is the value of the metric sample, less what shards hold */
+  prom_metric_sample_shard_t *shards; /**< shards are the increment slots of a sharded sample, NULL otherwise */
+  void *shards_mem;        /**< shards_mem is the allocation shards was aligned within */
+  _Atomic int ref_count;   /**< ref_count counts the owning sample map plus every outstanding child handle */
+  uint64_t gen;            /**< gen is the metric update generation that last touched the sample */
+  char *line;              /**< line is the exposition line: l_value and a space, then the last rendered value */
+  size_t prefix_len;       /**< prefix_len is the length of the l_value and space at the start of line */
+  size_t line_len;         /**< line_len is the length of the rendered line, 0 until it is first rendered */
+  double line_value;       /**< line_value is the r_value the line was last rendered for */
+  double delta_value;      /**< delta_value is the value the last delta scrape found */
+  uint64_t delta_gen;      /**< delta_gen is the delta generation the value last changed in, 0 until first scraped */
 };
 
 #endif  // PROM_METRIC_SAMPLE_T_H
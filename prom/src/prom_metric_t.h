@@ -18,6 +18,8 @@
 #define PROM_METRIC_T_H
 
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 // Public
 #include "prom_histogram_buckets.h"
@@ -38,6 +40,56 @@ typedef enum prom_metric_type { PROM_COUNTER, PROM_GAUGE, PROM_HISTOGRAM, PROM_S
  */
 extern char *prom_metric_type_map[4];
 
+/**
+ * @brief API PRIVATE The exposition text of a metric as of its last committed update cycle. Shared by reference
+ * between the metric and any scrape still copying it.
+ */
+typedef struct prom_metric_snapshot_encoded {
+  size_t len;
+  char data[];
+} prom_metric_snapshot_encoded_t;
+
+struct prom_metric_snapshot {
+  _Atomic int ref_count; /**< ref_count  The metric's reference plus one per reader */
+  size_t len;            /**< len        Length of text */
+  char *text;            /**< text       HELP, TYPE and sample lines, as rendered by prom_metric_formatter_load_metric */
+  size_t proto_len;      /**< proto_len  Length of proto */
+  char *proto;           /**< proto      Delimited MetricFamily, as rendered by prom_metric_protobuf_load_metric, or NULL */
+  prom_metric_snapshot_encoded_t *_Atomic encoded[PROM_METRIC_SNAPSHOT_ENCODINGS]; /**< encoded  Filled at most once */
+};
+
+/**
+ * @brief API PRIVATE The snapshots one prom_metrics_commit published together. Every metric of the call holds a
+ * reference, and so does every scrape that rendered one of them, so the scrape takes the rest from the same call.
+ */
+typedef struct prom_metric_batch {
+  _Atomic int ref_count;              /**< ref_count  One per metric still publishing the batch plus one per scrape */
+  size_t count;                       /**< count      The count of metrics */
+  prom_metric_t **metrics;            /**< metrics    The metrics of the call, only ever compared */
+  prom_metric_snapshot_t **snapshots; /**< snapshots  The snapshot published for each of metrics, referenced */
+} prom_metric_batch_t;
+
+/**
+ * @brief API PRIVATE The batches a scrape has rendered a metric from so far
+ */
+typedef struct prom_metric_pins {
+  prom_metric_batch_t **batches; /**< batches  Referenced batches */
+  size_t count;                  /**< count    The count of batches */
+  size_t size;                   /**< size     Allocated length of batches */
+} prom_metric_pins_t;
+
+// Removed series a metric remembers for delta scrapes; when older ones are dropped, clients that have not seen them
+// get the whole metric instead
+#define PROM_METRIC_TOMBSTONES_MAX 1024
+
+/**
+ * @brief API PRIVATE A series removed after the delta scrape of generation gen - 1
+ */
+typedef struct prom_metric_tombstone {
+  char *l_value; /**< l_value  The name and labels of the series */
+  uint64_t gen;  /**< gen      Delta generation the removal is first reported in */
+} prom_metric_tombstone_t;
+
 /**
  * @brief API PRIVATE An opaque struct to users containing metric metadata; one or more metric samples; and a metric
  * formatter for locating metric samples and exporting metric data
@@ -48,10 +100,30 @@ struct prom_metric {
   const char *help;                   /**< help             The help output for the metric */
   prom_map_t *samples;                /**< samples          Map comprised of samples for the given metric */
   prom_histogram_buckets_t *buckets;  /**< buckets          Array of histogram bucket upper bound values */
+  bool sharded;                       /**< sharded          Whether counter samples spread increments over shards */
+  int sparse_schema;                  /**< sparse_schema    Initial schema of a sparse histogram's buckets */
+  size_t sparse_max_buckets;          /**< sparse_max_buckets Bucket cap of a sparse histogram, 0 for explicit bounds */
+  double *quantiles;                  /**< quantiles        Array of the quantiles a summary exposes */
+  size_t quantile_count;              /**< quantile_count   The count of quantiles */
+  double max_age;                     /**< max_age          Seconds of observations a summary's quantiles cover */
   size_t label_key_count;             /**< label_keys_count The count of labe_keys*/
+  size_t max_series;                  /**< max_series       Cap on the series count, 0 for no cap */
+  uint64_t dropped;                   /**< dropped          Samples of new series folded into the overflow series */
   prom_metric_formatter_t *formatter; /**< formatter        The metric formatter  */
   pthread_rwlock_t *rwlock;           /**< rwlock           Required for locking on certain non-atomic operations */
   const char **label_keys;            /**< labels           Array comprised of const char **/
+  uint64_t gen;                       /**< gen              Current update generation, stamped on every sample touched */
+  char *header;                       /**< header           HELP and TYPE lines, rendered once at creation */
+  prom_metric_snapshot_t *snapshot;   /**< snapshot         Last committed snapshot, NULL until the first update cycle */
+  pthread_mutex_t snapshot_lock;      /**< snapshot_lock    Guards swapping and acquiring snapshot, never held for long */
+  prom_metric_batch_t *batch;         /**< batch            Batch snapshot was published in, NULL if committed alone */
+  prom_metric_snapshot_t *staged;     /**< staged           Snapshot waiting for the next prom_metrics_commit, or NULL */
+  bool staging;                       /**< staging          Whether commits stage, set by the first prom_metrics_commit */
+  uint64_t delta_gen;                 /**< delta_gen        Last delta scrape generation, 0 if none */
+  uint64_t delta_reset_gen;           /**< delta_reset_gen  Delta scrapes older than this get every series */
+  prom_metric_tombstone_t *removed;   /**< removed          Ring of tombstones, allocated on first use */
+  size_t removed_head;                /**< removed_head     Index of the oldest tombstone */
+  size_t removed_count;               /**< removed_count    The count of tombstones */
 };
 
 #endif  // PROM_METRIC_T_H
@@ -0,0 +1,165 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_pool_t.h"
+
+#define PROM_POOL_CLASS_COUNT 16
+
+// Object sizes of the classes: steps of 16 bytes up to 128, 32 up to 256 and 64 up to PROM_POOL_MAX_SIZE
+static prom_pool_class_t prom_pool_classes[PROM_POOL_CLASS_COUNT];
+
+// For every size rounded up to PROM_POOL_ALIGN, divided by it, the index of the smallest class that fits
+static uint8_t prom_pool_class_index[PROM_POOL_MAX_SIZE / PROM_POOL_ALIGN + 1];
+
+static pthread_once_t prom_pool_once = PTHREAD_ONCE_INIT;
+static _Atomic uint64_t prom_pool_heap_allocations = 0;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static Declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void prom_pool_init(void);
+static prom_pool_class_t *prom_pool_class(size_t size);
+static int prom_pool_class_grow(prom_pool_class_t *self);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End static declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void prom_pool_init(void) {
+  size_t size = 0;
+  for (int i = 0; i < PROM_POOL_CLASS_COUNT; i++) {
+    size += size < 128 ? 16 : size < 256 ? 32 : 64;
+    prom_pool_class_t *class = &prom_pool_classes[i];
+    memset(class, 0, sizeof(prom_pool_class_t));
+    pthread_mutex_init(&class->lock, NULL);
+    class->size = size;
+  }
+  PROM_ASSERT(size == PROM_POOL_MAX_SIZE);
+
+  int i = 0;
+  for (size_t slot = 0; slot <= PROM_POOL_MAX_SIZE / PROM_POOL_ALIGN; slot++) {
+    while (prom_pool_classes[i].size < slot * PROM_POOL_ALIGN) i++;
+    prom_pool_class_index[slot] = (uint8_t)i;
+  }
+}
+
+/**
+ * @brief API PRIVATE Returns the class serving size, or NULL if size is too large for any
+ */
+static prom_pool_class_t *prom_pool_class(size_t size) {
+  if (size > PROM_POOL_MAX_SIZE) return NULL;
+  pthread_once(&prom_pool_once, prom_pool_init);
+  return &prom_pool_classes[prom_pool_class_index[(size + PROM_POOL_ALIGN - 1) / PROM_POOL_ALIGN]];
+}
+
+/**
+ * @brief API PRIVATE Adds a slab to the class. The caller must hold its lock.
+ */
+static int prom_pool_class_grow(prom_pool_class_t *self) {
+  if (self->slab_count == self->slab_cap) {
+    size_t new_cap = self->slab_cap == 0 ? 8 : self->slab_cap * 2;
+    void **slabs = (void **)prom_realloc(self->slabs, sizeof(void *) * new_cap);
+    if (slabs == NULL) return 1;
+    self->slabs = slabs;
+    self->slab_cap = new_cap;
+  }
+  char *slab = (char *)prom_malloc(PROM_POOL_SLAB_SIZE);
+  if (slab == NULL) return 1;
+  self->slabs[self->slab_count++] = slab;
+  self->cursor = slab;
+  self->end = slab + PROM_POOL_SLAB_SIZE - PROM_POOL_SLAB_SIZE % self->size;
+  return 0;
+}
+
+void *prom_pool_malloc(size_t size) {
+  prom_pool_class_t *class = prom_pool_class(size);
+  if (class == NULL) {
+    atomic_fetch_add_explicit(&prom_pool_heap_allocations, 1, memory_order_relaxed);
+    return prom_malloc(size);
+  }
+
+  void *ptr = NULL;
+  pthread_mutex_lock(&class->lock);
+  if (class->free != NULL) {
+    ptr = class->free;
+    class->free = class->free->next;
+  } else if (class->cursor != class->end || prom_pool_class_grow(class) == 0) {
+    ptr = class->cursor;
+    class->cursor += class->size;
+  }
+  if (ptr != NULL) {
+    class->live++;
+    class->allocations++;
+  }
+  pthread_mutex_unlock(&class->lock);
+  return ptr;
+}
+
+void prom_pool_free(void *ptr, size_t size) {
+  if (ptr == NULL) return;
+  prom_pool_class_t *class = prom_pool_class(size);
+  if (class == NULL) {
+    prom_free(ptr);
+    return;
+  }
+
+  prom_pool_object_t *object = (prom_pool_object_t *)ptr;
+  pthread_mutex_lock(&class->lock);
+  object->next = class->free;
+  class->free = object;
+  class->live--;
+  pthread_mutex_unlock(&class->lock);
+}
+
+char *prom_pool_strdup(const char *str) {
+  PROM_ASSERT(str != NULL);
+  size_t size = strlen(str) + 1;
+  char *copy = (char *)prom_pool_malloc(size);
+  if (copy != NULL) memcpy(copy, str, size);
+  return copy;
+}
+
+void prom_pool_strfree(const char *str) {
+  if (str == NULL) return;
+  prom_pool_free((void *)str, strlen(str) + 1);
+}
+
+void prom_pool_stats(prom_pool_stats_t *stats) {
+  PROM_ASSERT(stats != NULL);
+  pthread_once(&prom_pool_once, prom_pool_init);
+  memset(stats, 0, sizeof(prom_pool_stats_t));
+
+  for (int i = 0; i < PROM_POOL_CLASS_COUNT; i++) {
+    prom_pool_class_t *class = &prom_pool_classes[i];
+    pthread_mutex_lock(&class->lock);
+    stats->slab_bytes += class->slab_count * PROM_POOL_SLAB_SIZE;
+    stats->live_bytes += class->live * class->size;
+    stats->live_objects += class->live;
+    stats->slab_allocations += class->allocations;
+    pthread_mutex_unlock(&class->lock);
+  }
+  stats->heap_allocations = atomic_load_explicit(&prom_pool_heap_allocations, memory_order_relaxed);
+}
@@ -0,0 +1,56 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_POOL_T_H
+#define PROM_POOL_T_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Public
+#include "prom_pool.h"
+
+// Size of a slab, carved into objects of one class
+#define PROM_POOL_SLAB_SIZE 65536
+
+// Object sizes are multiples of the alignment malloc guarantees on 64-bit targets
+#define PROM_POOL_ALIGN 16
+
+/**
+ * @brief API PRIVATE A free object, linked through its own memory
+ */
+typedef struct prom_pool_object {
+  struct prom_pool_object *next;
+} prom_pool_object_t;
+
+/**
+ * @brief API PRIVATE The slabs of one object size
+ */
+typedef struct prom_pool_class {
+  pthread_mutex_t lock;
+  size_t size;               /**< size is the object size of the class */
+  prom_pool_object_t *free;  /**< free lists the freed objects, reused first */
+  char *cursor;              /**< cursor is the next never used object of the newest slab */
+  char *end;                 /**< end is the end of the newest slab */
+  void **slabs;              /**< slabs holds every slab of the class */
+  size_t slab_count;         /**< slab_count is the number of slabs */
+  size_t slab_cap;           /**< slab_cap is the allocated capacity of slabs */
+  size_t live;               /**< live is the number of objects handed out and not yet freed */
+  uint64_t allocations;      /**< allocations counts the objects ever handed out */
+} prom_pool_class_t;
+
+#endif  // PROM_POOL_T_H
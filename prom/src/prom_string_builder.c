@@ -87,13 +87,19 @@ static int prom_string_builder_ensure_space(prom_string_builder_t *self, size_t
 }
 
 int prom_string_builder_add_str(prom_string_builder_t *self, const char *str) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (str == NULL || *str == '\0') return 0;
+  return prom_string_builder_add_strn(self, str, strlen(str));
+}
+
+int prom_string_builder_add_strn(prom_string_builder_t *self, const char *str, size_t len) {
   PROM_ASSERT(self != NULL);
   int r = 0;
 
   if (self == NULL) return 1;
-  if (str == NULL || *str == '\0') return 0;
+  if (len == 0) return 0;
 
-  size_t len = strlen(str);
   r = prom_string_builder_ensure_space(self, len);
   if (r) return r;
 
@@ -139,6 +145,11 @@ size_t prom_string_builder_len(prom_string_builder_t *self) {
   return self->len;
 }
 
+size_t prom_string_builder_memory(prom_string_builder_t *self) {
+  PROM_ASSERT(self != NULL);
+  return sizeof(prom_string_builder_t) + self->allocated;
+}
+
 char *prom_string_builder_dump(prom_string_builder_t *self) {
   PROM_ASSERT(self != NULL);
   // +1 to accommodate \0
@@ -0,0 +1,129 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+// Public
+#include "prom_summary.h"
+
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_metric_i.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_metric_t.h"
+
+// Window and quantiles used when the caller leaves them out
+#define PROM_SUMMARY_DEFAULT_MAX_AGE 600.0
+static const double prom_summary_default_quantiles[] = {0.5, 0.9, 0.99};
+
+prom_summary_t *prom_summary_new(const char *name, const char *help, size_t quantile_count, const double *quantiles,
+                                 double max_age, size_t label_key_count, const char **label_keys) {
+  if (quantiles == NULL) {
+    quantiles = prom_summary_default_quantiles;
+    quantile_count = sizeof(prom_summary_default_quantiles) / sizeof(double);
+  }
+  // Ensure the quantiles are within [0, 1]
+  for (size_t i = 0; i < quantile_count; i++) {
+    if (!(quantiles[i] >= 0.0 && quantiles[i] <= 1.0)) return NULL;
+  }
+
+  prom_summary_t *self = (prom_summary_t *)prom_metric_new(PROM_SUMMARY, name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->quantiles = (double *)prom_malloc(sizeof(double) * (quantile_count + 1));
+  memcpy(self->quantiles, quantiles, sizeof(double) * quantile_count);
+  self->quantile_count = quantile_count;
+  self->max_age = max_age > 0.0 && isfinite(max_age) ? max_age : PROM_SUMMARY_DEFAULT_MAX_AGE;
+  return self;
+}
+
+int prom_summary_destroy(prom_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+
+  int r = 0;
+
+  if (self == NULL) return r;
+  r = prom_metric_destroy(self);
+  if (r) return r;
+  self = NULL;
+  return r;
+}
+
+int prom_summary_observe(prom_summary_t *self, double value, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_SUMMARY) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  prom_metric_sample_summary_t *s_sample = prom_metric_sample_summary_from_labels(self, label_values);
+  if (s_sample == NULL) return 1;
+  return prom_metric_sample_summary_observe(s_sample, value);
+}
+
+prom_metric_sample_summary_t *prom_summary_child(prom_summary_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_SUMMARY) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_summary_child_from_labels(self, label_values);
+}
+
+int prom_summary_remove(prom_summary_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_SUMMARY) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_remove_sample_from_labels(self, label_values);
+}
+
+int prom_summary_clear(prom_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_SUMMARY) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_clear_samples(self);
+}
+
+int prom_summary_begin_update(prom_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_SUMMARY) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_begin_update(self);
+}
+
+int prom_summary_end_update(prom_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_SUMMARY) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_end_update(self);
+}
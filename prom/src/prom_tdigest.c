@@ -0,0 +1,176 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+// Private
+#include "prom_assert.h"
+#include "prom_tdigest_i.h"
+
+// Room for a full digest plus as many incoming centroids
+#define PROM_TDIGEST_SCRATCH (2 * PROM_TDIGEST_CAPACITY)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static Declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int prom_tdigest_compare_double(const void *a, const void *b);
+static double prom_tdigest_q_limit(double q);
+static void prom_tdigest_merge_sorted(prom_tdigest_t *self, const prom_tdigest_centroid_t *in, size_t in_count);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End static declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void prom_tdigest_reset(prom_tdigest_t *self) {
+  PROM_ASSERT(self != NULL);
+  self->count = 0;
+  self->weight = 0.0;
+  self->min = INFINITY;
+  self->max = -INFINITY;
+}
+
+void prom_tdigest_add(prom_tdigest_t *self, double *values, size_t count) {
+  PROM_ASSERT(self != NULL);
+
+  // NaN has no rank; move it out of the way before sorting
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!isnan(values[i])) values[n++] = values[i];
+  }
+  if (n == 0) return;
+  qsort(values, n, sizeof(double), prom_tdigest_compare_double);
+  if (values[0] < self->min) self->min = values[0];
+  if (values[n - 1] > self->max) self->max = values[n - 1];
+
+  prom_tdigest_centroid_t in[PROM_TDIGEST_CAPACITY];
+  for (size_t done = 0; done < n;) {
+    size_t chunk = n - done < PROM_TDIGEST_CAPACITY ? n - done : PROM_TDIGEST_CAPACITY;
+    for (size_t i = 0; i < chunk; i++) {
+      in[i].mean = values[done + i];
+      in[i].weight = 1.0;
+    }
+    prom_tdigest_merge_sorted(self, in, chunk);
+    done += chunk;
+  }
+}
+
+void prom_tdigest_merge(prom_tdigest_t *self, const prom_tdigest_t *other) {
+  PROM_ASSERT(self != NULL);
+  PROM_ASSERT(other != NULL);
+  if (other->count == 0) return;
+  if (other->min < self->min) self->min = other->min;
+  if (other->max > self->max) self->max = other->max;
+  prom_tdigest_merge_sorted(self, other->centroids, other->count);
+}
+
+double prom_tdigest_quantile(const prom_tdigest_t *self, double q) {
+  PROM_ASSERT(self != NULL);
+  if (self->count == 0) return NAN;
+  if (q <= 0.0) return self->min;
+  if (q >= 1.0) return self->max;
+
+  // Each centroid stands for its weight spread evenly around its mean. Between the centres of two neighbours the
+  // estimate is interpolated; below the first and above the last centre it runs out to min and max.
+  const prom_tdigest_centroid_t *c = self->centroids;
+  double target = q * self->weight;
+  if (target < c[0].weight / 2) {
+    return self->min + (c[0].mean - self->min) * target / (c[0].weight / 2);
+  }
+  double cumulative = 0.0;
+  for (size_t i = 0; i + 1 < self->count; i++) {
+    double left = cumulative + c[i].weight / 2;
+    double right = cumulative + c[i].weight + c[i + 1].weight / 2;
+    if (target < right) return c[i].mean + (c[i + 1].mean - c[i].mean) * (target - left) / (right - left);
+    cumulative += c[i].weight;
+  }
+  const prom_tdigest_centroid_t *last = &c[self->count - 1];
+  double centre = self->weight - last->weight / 2;
+  return last->mean + (self->max - last->mean) * (target - centre) / (last->weight / 2);
+}
+
+static int prom_tdigest_compare_double(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief API PRIVATE Returns the highest quantile a centroid starting at quantile q may reach. With the scale function
+ * k(q) = compression / (2 pi) * asin(2q - 1) every centroid spans at most one unit of k, which keeps centroids small
+ * near both tails and bounds their number by the compression.
+ *
+ * That is (sin(asin(s) + t) + 1) / 2 with s = 2q - 1 and t = 2 pi / compression, expanded so that only a square root
+ * is left to compute.
+ */
+static double prom_tdigest_q_limit(double q) {
+  // Both fold to constants at compile time
+  const double cos_t = cos(2 * M_PI / PROM_TDIGEST_COMPRESSION);
+  const double sin_t = sin(2 * M_PI / PROM_TDIGEST_COMPRESSION);
+  double s = 2 * q - 1;
+  if (s >= cos_t) return 1.0;
+  return (s * cos_t + sqrt(1 - s * s) * sin_t + 1) / 2;
+}
+
+/**
+ * @brief API PRIVATE Merge in_count centroids, sorted by mean, into the digest and compress the result
+ */
+static void prom_tdigest_merge_sorted(prom_tdigest_t *self, const prom_tdigest_centroid_t *in, size_t in_count) {
+  // Nothing to merge; the walk below needs at least one centroid to start from
+  if (in_count == 0 && self->count == 0) return;
+
+  prom_tdigest_centroid_t merged[PROM_TDIGEST_SCRATCH];
+  size_t n = 0;
+  size_t i = 0;
+  size_t j = 0;
+  double total = self->weight;
+  while (i < self->count || j < in_count) {
+    if (j == in_count || (i < self->count && self->centroids[i].mean <= in[j].mean)) {
+      merged[n++] = self->centroids[i++];
+    } else {
+      total += in[j].weight;
+      merged[n++] = in[j++];
+    }
+  }
+
+  // Walk the centroids in order, folding each into the current one while the k span allows it. The limit is kept as
+  // a weight and the current centroid as a weighted sum, so the loop divides only when a centroid is closed.
+  size_t count = 0;
+  double done = 0.0;
+  double limit = prom_tdigest_q_limit(0.0) * total;
+  double weight = merged[0].weight;
+  double weighted_sum = merged[0].mean * merged[0].weight;
+  for (size_t k = 1; k < n; k++) {
+    if (done + weight + merged[k].weight <= limit || count == PROM_TDIGEST_CAPACITY - 1) {
+      weight += merged[k].weight;
+      weighted_sum += merged[k].mean * merged[k].weight;
+    } else {
+      self->centroids[count].mean = weighted_sum / weight;
+      self->centroids[count].weight = weight;
+      count++;
+      done += weight;
+      limit = prom_tdigest_q_limit(done / total) * total;
+      weight = merged[k].weight;
+      weighted_sum = merged[k].mean * merged[k].weight;
+    }
+  }
+  self->centroids[count].mean = weighted_sum / weight;
+  self->centroids[count].weight = weight;
+  count++;
+  self->count = count;
+  self->weight = total;
+}
@@ -0,0 +1,44 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_TDIGEST_I_H
+#define PROM_TDIGEST_I_H
+
+#include <stddef.h>
+
+#include "prom_tdigest_t.h"
+
+/**
+ * @brief API PRIVATE Empty the digest
+ */
+void prom_tdigest_reset(prom_tdigest_t *self);
+
+/**
+ * @brief API PRIVATE Add count values to the digest. values is sorted in place. NaN values are skipped.
+ */
+void prom_tdigest_add(prom_tdigest_t *self, double *values, size_t count);
+
+/**
+ * @brief API PRIVATE Merge the centroids of other into the digest
+ */
+void prom_tdigest_merge(prom_tdigest_t *self, const prom_tdigest_t *other);
+
+/**
+ * @brief API PRIVATE Returns the estimate of the q quantile, 0 <= q <= 1, or NaN if the digest is empty
+ */
+double prom_tdigest_quantile(const prom_tdigest_t *self, double q);
+
+#endif  // PROM_TDIGEST_I_H
@@ -0,0 +1,51 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_TDIGEST_T_H
+#define PROM_TDIGEST_T_H
+
+#include <stddef.h>
+
+/**
+ * @brief API PRIVATE The compression of a prom_tdigest_t. Tail quantiles come out within a fraction of a percent of
+ * the true rank; the median is the least precise, at about 1/PROM_TDIGEST_COMPRESSION of the rank.
+ */
+#define PROM_TDIGEST_COMPRESSION 100
+
+/**
+ * @brief API PRIVATE Most centroids a prom_tdigest_t can hold. The scale function bounds a compressed digest to
+ * PROM_TDIGEST_COMPRESSION + 1 centroids; the rest is slack.
+ */
+#define PROM_TDIGEST_CAPACITY (PROM_TDIGEST_COMPRESSION + 4)
+
+typedef struct prom_tdigest_centroid {
+  double mean;   /**< mean is the mean of the values merged into the centroid */
+  double weight; /**< weight is the number of values merged into the centroid */
+} prom_tdigest_centroid_t;
+
+/**
+ * @brief API PRIVATE A merging t-digest: a fixed size sketch of a distribution that answers quantile queries. It has
+ * no lock of its own; its owner serializes access.
+ */
+typedef struct prom_tdigest {
+  size_t count;                                         /**< count is the number of centroids in use */
+  double weight;                                        /**< weight is the total weight of all centroids */
+  double min;                                           /**< min is the smallest value added */
+  double max;                                           /**< max is the largest value added */
+  prom_tdigest_centroid_t centroids[PROM_TDIGEST_CAPACITY]; /**< centroids are sorted by mean */
+} prom_tdigest_t;
+
+#endif  // PROM_TDIGEST_T_H
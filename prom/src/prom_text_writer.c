@@ -0,0 +1,346 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Private
+#include "prom_string_builder_i.h"
+#include "prom_text_writer_i.h"
+#include "prom_text_writer_pow5.h"
+
+// Doubles with a magnitude below this are integers exactly when they have no fractional part
+#define PROM_TEXT_WRITER_EXACT_INT 9007199254740992.0  // 2^53
+
+static size_t prom_text_writer_format_int(char *buf, int64_t value) {
+  char digits[20];
+  size_t n = 0;
+  uint64_t v = value < 0 ? (uint64_t)(-value) : (uint64_t)value;
+  do {
+    digits[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+
+  size_t len = 0;
+  if (value < 0) buf[len++] = '-';
+  while (n > 0) buf[len++] = digits[--n];
+  buf[len] = '\0';
+  return len;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Shortest round-trip digits, following Ryu (Ulf Adams, PLDI 2018)
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define PROM_TEXT_WRITER_MANTISSA_BITS 52
+#define PROM_TEXT_WRITER_EXPONENT_BITS 11
+#define PROM_TEXT_WRITER_BIAS 1023
+
+// ceil(log2(5^e)) for 0 < e <= 3528, and 1 for e = 0
+static int32_t prom_text_writer_pow5bits(int32_t e) {
+  return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) for 0 <= e <= 1650
+static uint32_t prom_text_writer_log10_pow2(int32_t e) {
+  return ((uint32_t)e * 78913) >> 18;
+}
+
+// floor(log10(5^e)) for 0 <= e <= 2620
+static uint32_t prom_text_writer_log10_pow5(int32_t e) {
+  return ((uint32_t)e * 732923) >> 20;
+}
+
+static uint32_t prom_text_writer_pow5_factor(uint64_t value) {
+  uint32_t count = 0;
+  while (value % 5 == 0) {
+    value /= 5;
+    count++;
+  }
+  return count;
+}
+
+static bool prom_text_writer_multiple_of_pow5(uint64_t value, uint32_t p) {
+  return prom_text_writer_pow5_factor(value) >= p;
+}
+
+static bool prom_text_writer_multiple_of_pow2(uint64_t value, uint32_t p) {
+  return (value & ((1ull << p) - 1)) == 0;
+}
+
+static uint64_t prom_text_writer_mul_shift(uint64_t m, const uint64_t *mul, int32_t j) {
+  unsigned __int128 b0 = (unsigned __int128)m * mul[0];
+  unsigned __int128 b2 = (unsigned __int128)m * mul[1];
+  return (uint64_t)(((b0 >> 64) + b2) >> (j - 64));
+}
+
+static uint32_t prom_text_writer_decimal_length(uint64_t v) {
+  uint32_t len = 1;
+  while (v >= 10) {
+    v /= 10;
+    len++;
+  }
+  return len;
+}
+
+/**
+ * @brief API PRIVATE Computes the shortest decimal digits that round to the finite, non-zero double with the given
+ * IEEE fields. The value is *output * 10^*exponent.
+ */
+static void prom_text_writer_shortest(uint64_t ieee_mantissa, uint32_t ieee_exponent, uint64_t *output,
+                                      int32_t *exponent) {
+  int32_t e2;
+  uint64_t m2;
+  if (ieee_exponent == 0) {
+    // Two extra bits for the interval bounds below
+    e2 = 1 - PROM_TEXT_WRITER_BIAS - PROM_TEXT_WRITER_MANTISSA_BITS - 2;
+    m2 = ieee_mantissa;
+  } else {
+    e2 = (int32_t)ieee_exponent - PROM_TEXT_WRITER_BIAS - PROM_TEXT_WRITER_MANTISSA_BITS - 2;
+    m2 = (1ull << PROM_TEXT_WRITER_MANTISSA_BITS) | ieee_mantissa;
+  }
+  bool accept_bounds = (m2 & 1) == 0;
+
+  // The value and the halfway points to its neighbours, scaled by 4: mm < mv < mp
+  uint64_t mv = 4 * m2;
+  uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+  // Convert the interval to a decimal power base
+  uint64_t vr, vp, vm;
+  int32_t e10;
+  bool vm_trailing_zeros = false;
+  bool vr_trailing_zeros = false;
+  if (e2 >= 0) {
+    uint32_t q = prom_text_writer_log10_pow2(e2) - (e2 > 3);
+    e10 = (int32_t)q;
+    int32_t k = PROM_TEXT_WRITER_POW5_INV_BITCOUNT + prom_text_writer_pow5bits((int32_t)q) - 1;
+    int32_t i = -e2 + (int32_t)q + k;
+    vr = prom_text_writer_mul_shift(4 * m2, PROM_TEXT_WRITER_POW5_INV[q], i);
+    vp = prom_text_writer_mul_shift(4 * m2 + 2, PROM_TEXT_WRITER_POW5_INV[q], i);
+    vm = prom_text_writer_mul_shift(4 * m2 - 1 - mm_shift, PROM_TEXT_WRITER_POW5_INV[q], i);
+    if (q <= 21) {
+      // At most one of mp, mv and mm is a multiple of 5
+      if (mv % 5 == 0) {
+        vr_trailing_zeros = prom_text_writer_multiple_of_pow5(mv, q);
+      } else if (accept_bounds) {
+        vm_trailing_zeros = prom_text_writer_multiple_of_pow5(mv - 1 - mm_shift, q);
+      } else {
+        vp -= prom_text_writer_multiple_of_pow5(mv + 2, q);
+      }
+    }
+  } else {
+    uint32_t q = prom_text_writer_log10_pow5(-e2) - (-e2 > 1);
+    e10 = (int32_t)q + e2;
+    int32_t i = -e2 - (int32_t)q;
+    int32_t k = prom_text_writer_pow5bits(i) - PROM_TEXT_WRITER_POW5_BITCOUNT;
+    int32_t j = (int32_t)q - k;
+    vr = prom_text_writer_mul_shift(4 * m2, PROM_TEXT_WRITER_POW5[i], j);
+    vp = prom_text_writer_mul_shift(4 * m2 + 2, PROM_TEXT_WRITER_POW5[i], j);
+    vm = prom_text_writer_mul_shift(4 * m2 - 1 - mm_shift, PROM_TEXT_WRITER_POW5[i], j);
+    if (q <= 1) {
+      // mv has at least q trailing zero bits, so vr has at least q trailing decimal zeros
+      vr_trailing_zeros = true;
+      if (accept_bounds) {
+        vm_trailing_zeros = mm_shift == 1;
+      } else {
+        vp--;
+      }
+    } else if (q < 63) {
+      vr_trailing_zeros = prom_text_writer_multiple_of_pow2(mv, q);
+    }
+  }
+
+  // Drop digits while the interval still holds a shorter number
+  int32_t removed = 0;
+  uint8_t last_removed_digit = 0;
+  if (vm_trailing_zeros || vr_trailing_zeros) {
+    // Rare: the exact bounds matter
+    while (vp / 10 > vm / 10) {
+      vm_trailing_zeros &= vm % 10 == 0;
+      vr_trailing_zeros &= last_removed_digit == 0;
+      last_removed_digit = (uint8_t)(vr % 10);
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      removed++;
+    }
+    if (vm_trailing_zeros) {
+      while (vm % 10 == 0) {
+        vr_trailing_zeros &= last_removed_digit == 0;
+        last_removed_digit = (uint8_t)(vr % 10);
+        vr /= 10;
+        vp /= 10;
+        vm /= 10;
+        removed++;
+      }
+    }
+    // Round half to even
+    if (vr_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) last_removed_digit = 4;
+    *output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed_digit >= 5);
+  } else {
+    bool round_up = false;
+    if (vp / 100 > vm / 100) {
+      round_up = vr % 100 >= 50;
+      vr /= 100;
+      vp /= 100;
+      vm /= 100;
+      removed += 2;
+    }
+    while (vp / 10 > vm / 10) {
+      round_up = vr % 10 >= 5;
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      removed++;
+    }
+    *output = vr + (vr == vm || round_up);
+  }
+  *exponent = e10 + removed;
+}
+
+size_t prom_text_writer_format_double(char *buf, double value) {
+  if (isnan(value)) return (size_t)snprintf(buf, PROM_TEXT_WRITER_DOUBLE_SIZE, "NaN");
+  if (isinf(value)) return (size_t)snprintf(buf, PROM_TEXT_WRITER_DOUBLE_SIZE, value > 0 ? "+Inf" : "-Inf");
+
+  // Counters, byte counts and most gauges are whole numbers
+  if (fabs(value) < PROM_TEXT_WRITER_EXACT_INT && value == (double)(int64_t)value) {
+    return prom_text_writer_format_int(buf, (int64_t)value);
+  }
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint64_t ieee_mantissa = bits & ((1ull << PROM_TEXT_WRITER_MANTISSA_BITS) - 1);
+  uint32_t ieee_exponent =
+      (uint32_t)(bits >> PROM_TEXT_WRITER_MANTISSA_BITS) & ((1u << PROM_TEXT_WRITER_EXPONENT_BITS) - 1);
+
+  uint64_t output;
+  int32_t exponent;
+  prom_text_writer_shortest(ieee_mantissa, ieee_exponent, &output, &exponent);
+
+  char digits[20];
+  uint32_t olength = prom_text_writer_decimal_length(output);
+  for (uint32_t i = olength; i > 0; i--) {
+    digits[i - 1] = (char)('0' + output % 10);
+    output /= 10;
+  }
+
+  // Same layout as printf %.17g: scientific notation only outside 1e-4 <= |value| < 1e17
+  size_t len = 0;
+  if (value < 0) buf[len++] = '-';
+  int32_t sci_exponent = exponent + (int32_t)olength - 1;
+  if (sci_exponent < -4 || sci_exponent >= 17) {
+    buf[len++] = digits[0];
+    if (olength > 1) {
+      buf[len++] = '.';
+      memcpy(buf + len, digits + 1, olength - 1);
+      len += olength - 1;
+    }
+    buf[len++] = 'e';
+    buf[len++] = sci_exponent < 0 ? '-' : '+';
+    uint32_t e = (uint32_t)(sci_exponent < 0 ? -sci_exponent : sci_exponent);
+    if (e >= 100) buf[len++] = (char)('0' + e / 100);
+    buf[len++] = (char)('0' + e / 10 % 10);
+    buf[len++] = (char)('0' + e % 10);
+  } else if (sci_exponent >= 0) {
+    uint32_t int_digits = (uint32_t)sci_exponent + 1;
+    if (olength <= int_digits) {
+      memcpy(buf + len, digits, olength);
+      len += olength;
+      memset(buf + len, '0', int_digits - olength);
+      len += int_digits - olength;
+    } else {
+      memcpy(buf + len, digits, int_digits);
+      len += int_digits;
+      buf[len++] = '.';
+      memcpy(buf + len, digits + int_digits, olength - int_digits);
+      len += olength - int_digits;
+    }
+  } else {
+    buf[len++] = '0';
+    buf[len++] = '.';
+    memset(buf + len, '0', (size_t)(-sci_exponent - 1));
+    len += (size_t)(-sci_exponent - 1);
+    memcpy(buf + len, digits, olength);
+    len += olength;
+  }
+  buf[len] = '\0';
+  return len;
+}
+
+/**
+ * @brief API PRIVATE Returns the offset of the first byte of str that needs escaping, or len if there is none. quote
+ * is the extra byte to look for besides backslash and line feed.
+ */
+static size_t prom_text_writer_scan(const char *str, size_t len, char quote) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i q = _mm_set1_epi8(quote);
+  for (; i + 16 <= len; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(str + i));
+    __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, backslash), _mm_cmpeq_epi8(chunk, newline)),
+                               _mm_cmpeq_epi8(chunk, q));
+    int mask = _mm_movemask_epi8(hit);
+    if (mask != 0) return i + __builtin_ctz(mask);
+  }
+#elif defined(__aarch64__)
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t newline = vdupq_n_u8('\n');
+  const uint8x16_t q = vdupq_n_u8((uint8_t)quote);
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t chunk = vld1q_u8((const uint8_t *)(str + i));
+    uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(chunk, backslash), vceqq_u8(chunk, newline)), vceqq_u8(chunk, q));
+    // The block holds a byte to escape; the scalar loop below finds it
+    if (vmaxvq_u8(hit) != 0) break;
+  }
+#endif
+  for (; i < len; i++) {
+    if (str[i] == '\\' || str[i] == '\n' || str[i] == quote) return i;
+  }
+  return len;
+}
+
+int prom_text_writer_add_escaped(prom_string_builder_t *sb, const char *str, bool escape_quote) {
+  // Without quote escaping the quote check repeats the backslash one
+  char quote = escape_quote ? '"' : '\\';
+  size_t len = strlen(str);
+  int r = 0;
+
+  // Label values rarely need escaping, so they are copied in runs between the bytes that do
+  while (len > 0) {
+    size_t run = prom_text_writer_scan(str, len, quote);
+    r = prom_string_builder_add_strn(sb, str, run);
+    if (r) return r;
+    if (run == len) break;
+
+    char escaped[2] = {'\\', str[run] == '\n' ? 'n' : str[run]};
+    r = prom_string_builder_add_strn(sb, escaped, 2);
+    if (r) return r;
+    str += run + 1;
+    len -= run + 1;
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Reference: https://prometheus.io/docs/instrumenting/exposition_formats/#text-format-details
+
+#ifndef PROM_TEXT_WRITER_I_H
+#define PROM_TEXT_WRITER_I_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Private
+#include "prom_string_builder_t.h"
+
+/**
+ * @brief API PRIVATE Room needed by prom_text_writer_format_double, including the terminating null byte
+ */
+#define PROM_TEXT_WRITER_DOUBLE_SIZE 32
+
+/**
+ * @brief API PRIVATE Writes the shortest decimal form of value that parses back to the same double, e.g. 0.1 rather
+ * than 0.10000000000000001, laid out like printf %.17g. Integral values take an integer fast path. Infinities and NaN
+ * are written as +Inf, -Inf and NaN.
+ * @param buf Receives the null-terminated text, at least PROM_TEXT_WRITER_DOUBLE_SIZE bytes
+ * @return The length of the text
+ */
+size_t prom_text_writer_format_double(char *buf, double value);
+
+/**
+ * @brief API PRIVATE Adds str with backslash and line feed escaped, and double quotes too if escape_quote is set. Label
+ * values need all three escaped, HELP text only the first two.
+ */
+int prom_text_writer_add_escaped(prom_string_builder_t *sb, const char *str, bool escape_quote);
+
+#endif  // PROM_TEXT_WRITER_I_H
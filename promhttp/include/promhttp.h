@@ -23,6 +23,7 @@
  * https://www.gnu.org/software/libmicrohttpd/manual/libmicrohttpd.html#index-_002aMHD_005fAcceptPolicyCallback
  */
 
+#include <stdbool.h>
 #include <string.h>
 
 #include "microhttpd.h"
@@ -36,6 +37,59 @@
  */
 void promhttp_set_active_collector_registry(prom_collector_registry_t *active_registry);
 
+/**
+ * @brief Adds a metric to a group. The metrics of a group are served at /metrics/<group>, and /metrics also takes
+ * group=<group> and name[]=<metric> arguments, any number of each, to serve only the metrics they select.
+ *
+ * Groups MUST be set up before the daemon is started.
+ *
+ * @param group The name of the group, created on first use
+ * @param metric_name The name of the metric
+ * @return A non-zero integer value upon failure
+ */
+int promhttp_add_group_metric(const char *group, const char *metric_name);
+
+/**
+ * @brief Removes every group. MUST NOT be called while the daemon is running.
+ */
+void promhttp_clear_groups(void);
+
+/**
+ * @brief Makes scrapes of the full exposition share renders. A scrape that arrives while a render of the same format
+ * and coding is in flight joins it and is sent the same body instead of rendering its own. With a non-zero
+ * min_interval_ms, a finished render is also sent to every scrape within min_interval_ms of its start, so values can
+ * be up to that old. Filtered and /delta scrapes always render their own.
+ *
+ * Shared bodies are rendered as their scrapes read them. With a min_interval_ms of 0, the parts every scrape has
+ * sent are freed, a scrape can only join until that first happens, and nothing is kept once the last scrape is done.
+ * Otherwise the last body of each format and coding is kept whole until the next render replaces it or
+ * promhttp_clear_render_cache. MUST be called before the daemon is started.
+ *
+ * @param enabled Whether scrapes share renders; off by default, each scrape then streams its own render
+ * @param min_interval_ms How long a render is reused for, 0 to share only renders in flight
+ */
+void promhttp_set_render_coalescing(bool enabled, unsigned int min_interval_ms);
+
+/**
+ * @brief Frees the renders kept for promhttp_set_render_coalescing. MUST NOT be called while the daemon is running.
+ */
+void promhttp_clear_render_cache(void);
+
+/**
+ * @brief Sets whether connections are kept open between requests. When off, every response asks MHD to close the
+ * connection after it. On by default; idle kept-alive connections are closed after MHD_OPTION_CONNECTION_TIMEOUT.
+ *
+ * @param enabled Whether to keep connections alive
+ */
+void promhttp_set_keep_alive(bool enabled);
+
+/*
+ * /delta serves the text exposition of what changed since the request that returned the token in its since=<token>
+ * argument, see prom_collector_registry_delta. It takes the group and name[] arguments of /metrics as well. The
+ * X-Prometheus-Delta-Token response header carries the token for the next request, and X-Prometheus-Delta is "full"
+ * when the body replaces everything the client holds or "delta" when it applies on top.
+ */
+
 /**
  *  @brief Starts a daemon in the background and returns a pointer to an HMD_Daemon.
  *
@@ -46,3 +100,14 @@ void promhttp_set_active_collector_registry(prom_collector_registry_t *active_re
  */
 struct MHD_Daemon *promhttp_start_daemon(unsigned int flags, unsigned short port, MHD_AcceptPolicyCallback apc,
                                          void *apc_cls);
+
+/**
+ * @brief Starts a daemon like promhttp_start_daemon, passing options to MHD, e.g. a thread pool size, connection
+ * limits and timeouts, or an already listening socket through MHD_OPTION_LISTEN_SOCKET.
+ *
+ * @param options An array terminated by an MHD_OPTION_END item, see MHD_OPTION_ARRAY. May be NULL.
+ * @return struct MHD_Daemon*, or NULL upon failure
+ */
+struct MHD_Daemon *promhttp_start_daemon_with_options(unsigned int flags, unsigned short port,
+                                                      MHD_AcceptPolicyCallback apc, void *apc_cls,
+                                                      const struct MHD_OptionItem *options);
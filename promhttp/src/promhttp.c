@@ -14,10 +14,17 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 
 #include "microhttpd.h"
 #include "prom.h"
+#include "promhttp_encoder_i.h"
 
 prom_collector_registry_t *PROM_ACTIVE_REGISTRY;
 
@@ -29,37 +36,769 @@ void promhttp_set_active_collector_registry(prom_collector_registry_t *active_re
   }
 }
 
+// Prefix of the per-group exposition paths, /metrics/<group>
+#define PROMHTTP_GROUP_PATH "/metrics/"
+
+// Path of the delta exposition, which takes since=<token> besides the arguments of /metrics
+#define PROMHTTP_DELTA_PATH "/delta"
+
+// Response headers of the delta exposition: the token of the next request, and whether the body is full or a delta
+#define PROMHTTP_HEADER_DELTA_TOKEN "X-Prometheus-Delta-Token"
+#define PROMHTTP_HEADER_DELTA "X-Prometheus-Delta"
+
+// Metric groups, registered before the daemon is started and read-only afterwards
+typedef struct promhttp_group {
+  char *name;
+  char **metric_names;
+  size_t count;
+  size_t cap;
+} promhttp_group_t;
+
+static promhttp_group_t *promhttp_groups = NULL;
+static size_t promhttp_group_cnt = 0;
+
+static promhttp_group_t *promhttp_group_find(const char *name, size_t len) {
+  for (size_t i = 0; i < promhttp_group_cnt; i++) {
+    if (strlen(promhttp_groups[i].name) == len && strncmp(promhttp_groups[i].name, name, len) == 0) {
+      return &promhttp_groups[i];
+    }
+  }
+  return NULL;
+}
+
+int promhttp_add_group_metric(const char *group, const char *metric_name) {
+  promhttp_group_t *g = promhttp_group_find(group, strlen(group));
+  if (g == NULL) {
+    promhttp_group_t *groups =
+        (promhttp_group_t *)realloc(promhttp_groups, sizeof(promhttp_group_t) * (promhttp_group_cnt + 1));
+    if (groups == NULL) return 1;
+    promhttp_groups = groups;
+    g = &promhttp_groups[promhttp_group_cnt];
+    memset(g, 0, sizeof(promhttp_group_t));
+    g->name = strdup(group);
+    if (g->name == NULL) return 1;
+    promhttp_group_cnt++;
+  }
+  if (g->count == g->cap) {
+    size_t cap = g->cap == 0 ? 16 : g->cap * 2;
+    char **names = (char **)realloc(g->metric_names, sizeof(char *) * cap);
+    if (names == NULL) return 1;
+    g->metric_names = names;
+    g->cap = cap;
+  }
+  g->metric_names[g->count] = strdup(metric_name);
+  if (g->metric_names[g->count] == NULL) return 1;
+  g->count++;
+  return 0;
+}
+
+void promhttp_clear_groups(void) {
+  for (size_t i = 0; i < promhttp_group_cnt; i++) {
+    for (size_t j = 0; j < promhttp_groups[i].count; j++) free(promhttp_groups[i].metric_names[j]);
+    free(promhttp_groups[i].metric_names);
+    free(promhttp_groups[i].name);
+  }
+  free(promhttp_groups);
+  promhttp_groups = NULL;
+  promhttp_group_cnt = 0;
+}
+
+// Metric names a /metrics request selected through its path or its group and name[] arguments
+typedef struct promhttp_filter {
+  char **names; /**< sorted, each owned by the filter */
+  size_t count;
+  size_t cap;
+  bool selected;      /**< the request selected metrics, even if none exist */
+  bool unknown_group; /**< the request named a group that was never registered */
+  bool failed;        /**< an argument could not be added */
+} promhttp_filter_t;
+
+static int promhttp_filter_add(promhttp_filter_t *self, const char *name) {
+  if (self->count == self->cap) {
+    size_t cap = self->cap == 0 ? 16 : self->cap * 2;
+    char **names = (char **)realloc(self->names, sizeof(char *) * cap);
+    if (names == NULL) return 1;
+    self->names = names;
+    self->cap = cap;
+  }
+  self->names[self->count] = strdup(name);
+  if (self->names[self->count] == NULL) return 1;
+  self->count++;
+  return 0;
+}
+
+static int promhttp_filter_add_group(promhttp_filter_t *self, const char *group, size_t len) {
+  self->selected = true;
+  promhttp_group_t *g = promhttp_group_find(group, len);
+  if (g == NULL) {
+    self->unknown_group = true;
+    return 0;
+  }
+  for (size_t i = 0; i < g->count; i++) {
+    if (promhttp_filter_add(self, g->metric_names[i])) return 1;
+  }
+  return 0;
+}
+
+static void promhttp_filter_destroy(promhttp_filter_t *self) {
+  if (self == NULL) return;
+  for (size_t i = 0; i < self->count; i++) free(self->names[i]);
+  free(self->names);
+  free(self);
+}
+
+static int promhttp_filter_argument(void *cls, enum MHD_ValueKind kind, const char *key, const char *value) {
+  promhttp_filter_t *self = (promhttp_filter_t *)cls;
+  if (value == NULL) return MHD_YES;
+  int r = 0;
+  if (strcmp(key, "group") == 0) {
+    r = promhttp_filter_add_group(self, value, strlen(value));
+  } else if (strcmp(key, "name[]") == 0 || strcmp(key, "name") == 0) {
+    self->selected = true;
+    r = promhttp_filter_add(self, value);
+  }
+  if (r) self->failed = true;
+  return r ? MHD_NO : MHD_YES;
+}
+
+static int promhttp_filter_compare(const void *a, const void *b) {
+  return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static bool promhttp_filter_accepts(const char *metric_name, void *data) {
+  promhttp_filter_t *self = (promhttp_filter_t *)data;
+  return bsearch(&metric_name, self->names, self->count, sizeof(char *), promhttp_filter_compare) != NULL;
+}
+
+/**
+ * @brief Builds the filter of a /metrics request from the group in its path, if any, and its group and name[]
+ * arguments. Sets *filter to NULL when the request selects nothing, so every metric is rendered.
+ * @return 0 on success, 1 on failure
+ */
+static int promhttp_filter_new(struct MHD_Connection *connection, const char *group, promhttp_filter_t **filter) {
+  *filter = NULL;
+  promhttp_filter_t *self = (promhttp_filter_t *)calloc(1, sizeof(promhttp_filter_t));
+  if (self == NULL) return 1;
+  if (group != NULL && promhttp_filter_add_group(self, group, strlen(group))) goto err;
+  MHD_get_connection_values(connection, MHD_GET_ARGUMENT_KIND, (MHD_KeyValueIterator)&promhttp_filter_argument, self);
+  if (self->failed) goto err;
+  if (!self->selected) {
+    promhttp_filter_destroy(self);
+    return 0;
+  }
+  if (self->count > 1) qsort(self->names, self->count, sizeof(char *), promhttp_filter_compare);
+  *filter = self;
+  return 0;
+
+err:
+  promhttp_filter_destroy(self);
+  return 1;
+}
+
+// Size of the buffer MHD hands to promhttp_stream_reader
+#define PROMHTTP_STREAM_BLOCK_SIZE 32768
+
+#define PROMHTTP_CONTENT_TYPE_TEXT "text/plain; version=0.0.4; charset=utf-8"
+#define PROMHTTP_CONTENT_TYPE_PROTOBUF \
+  "application/vnd.google.protobuf; proto=io.prometheus.client.MetricFamily; encoding=delimited"
+
+// Length of a token, up to the first separator, with trailing blanks removed
+static size_t promhttp_token_len(const char *p, const char *separators) {
+  size_t len = strcspn(p, separators);
+  while (len > 0 && (p[len - 1] == ' ' || p[len - 1] == '\t')) len--;
+  return len;
+}
+
+static bool promhttp_token_eq(const char *token, size_t len, const char *value) {
+  return len == strlen(value) && strncasecmp(token, value, len) == 0;
+}
+
+/**
+ * @brief Picks the exposition format from an Accept header value. Protobuf is served when the client accepts the
+ * delimited MetricFamily encoding at least as much as the text format.
+ */
+static prom_exposition_format_t promhttp_negotiate_format(const char *accept) {
+  if (accept == NULL) return PROM_EXPOSITION_TEXT;
+
+  double protobuf_q = 0;
+  double text_q = 0;
+  const char *p = accept;
+  while (*p != '\0') {
+    while (*p == ' ' || *p == '\t' || *p == ',') p++;
+    if (*p == '\0') break;
+
+    const char *type = p;
+    size_t type_len = promhttp_token_len(p, ";,");
+    p += strcspn(p, ";,");
+
+    double q = 1.0;
+    bool proto = false;
+    bool delimited = false;
+    while (*p == ';') {
+      p++;
+      while (*p == ' ' || *p == '\t') p++;
+      const char *param = p;
+      size_t param_len = promhttp_token_len(p, ";,");
+      p += strcspn(p, ";,");
+      if (param_len > 2 && strncasecmp(param, "q=", 2) == 0) {
+        q = strtod(param + 2, NULL);
+      } else if (promhttp_token_eq(param, param_len, "proto=io.prometheus.client.MetricFamily")) {
+        proto = true;
+      } else if (promhttp_token_eq(param, param_len, "encoding=delimited")) {
+        delimited = true;
+      }
+    }
+
+    if (promhttp_token_eq(type, type_len, "application/vnd.google.protobuf")) {
+      if (proto && delimited && q > protobuf_q) protobuf_q = q;
+    } else if (promhttp_token_eq(type, type_len, "text/plain") || promhttp_token_eq(type, type_len, "text/*") ||
+               promhttp_token_eq(type, type_len, "*/*")) {
+      if (q > text_q) text_q = q;
+    }
+  }
+  return protobuf_q > 0 && protobuf_q >= text_q ? PROM_EXPOSITION_PROTOBUF : PROM_EXPOSITION_TEXT;
+}
+
+// State of a /metrics response
+typedef struct promhttp_response {
+  prom_collector_registry_stream_t *stream;
+  promhttp_filter_t *filter;   /**< metrics the stream renders, NULL for all */
+  promhttp_encoder_t *encoder; /**< NULL for an identity response */
+  int slot;                    /**< snapshot slot caching this response's format in this response's coding */
+  const char *piece;           /**< encoded piece being sent, owned by the encoder or by the piece's snapshot */
+  size_t piece_len;
+  size_t offset;               /**< bytes of piece already handed to MHD */
+  size_t piece_cnt;            /**< pieces encoded so far */
+} promhttp_response_t;
+
+static ssize_t promhttp_stream_reader(void *cls, uint64_t pos, char *buf, size_t max) {
+  promhttp_response_t *self = (promhttp_response_t *)cls;
+  ssize_t n = prom_collector_registry_stream_read(self->stream, buf, max);
+  if (n < 0) return MHD_CONTENT_READER_END_WITH_ERROR;
+  if (n == 0) return MHD_CONTENT_READER_END_OF_STREAM;
+  return n;
+}
+
+// Loads the next encoded piece. Returns 1 when a piece is loaded, 0 at the end of the body and -1 on error.
+static int promhttp_response_load(promhttp_response_t *self) {
+  const char *text;
+  size_t len;
+  prom_metric_snapshot_t *snapshot;
+  int r = prom_collector_registry_stream_next(self->stream, &text, &len, &snapshot);
+  if (r < 0) return -1;
+  if (r == 0) {
+    if (self->piece_cnt > 0) return 0;
+    // An empty body still needs one member, an empty gzip or zstd stream is not valid
+    text = "";
+    len = 0;
+    snapshot = NULL;
+  }
+  self->piece_cnt++;
+  self->offset = 0;
+
+  // A committed snapshot is compressed by the first response that sends it and reused until the metric commits again
+  int slot = self->slot;
+  if (snapshot != NULL) {
+    self->piece = prom_metric_snapshot_get_encoded(snapshot, slot, &self->piece_len);
+    if (self->piece != NULL) return 1;
+  }
+  if (promhttp_encoder_encode(self->encoder, text, len, &self->piece, &self->piece_len)) return -1;
+  if (snapshot != NULL) {
+    size_t cached_len = self->piece_len;
+    const char *cached = prom_metric_snapshot_set_encoded(snapshot, slot, self->piece, &cached_len);
+    if (cached != NULL) {
+      self->piece = cached;
+      self->piece_len = cached_len;
+    }
+  }
+  return 1;
+}
+
+static ssize_t promhttp_encoded_reader(void *cls, uint64_t pos, char *buf, size_t max) {
+  promhttp_response_t *self = (promhttp_response_t *)cls;
+  size_t n = 0;
+  while (n < max) {
+    if (self->offset == self->piece_len) {
+      int r = promhttp_response_load(self);
+      if (r < 0) return MHD_CONTENT_READER_END_WITH_ERROR;
+      if (r == 0) break;
+      continue;
+    }
+    size_t cnt = self->piece_len - self->offset;
+    if (cnt > max - n) cnt = max - n;
+    memcpy(buf + n, self->piece + self->offset, cnt);
+    self->offset += cnt;
+    n += cnt;
+  }
+  if (n == 0) return MHD_CONTENT_READER_END_OF_STREAM;
+  return n;
+}
+
+static void promhttp_response_free(void *cls) {
+  promhttp_response_t *self = (promhttp_response_t *)cls;
+  prom_collector_registry_stream_destroy(self->stream);
+  promhttp_filter_destroy(self->filter);
+  promhttp_encoder_release(self->encoder);
+  free(self);
+}
+
+// Snapshot slot caching the pieces of a format in a coding other than identity: text then protobuf, each in gzip
+// then zstd
+static int promhttp_snapshot_slot(prom_exposition_format_t format, promhttp_encoding_t encoding) {
+  return (format == PROM_EXPOSITION_PROTOBUF ? 2 : 0) + (encoding - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Shared Renders
+
+// Bytes of a shared render held per chunk
+#define PROMHTTP_RENDER_CHUNK_SIZE (4 * PROMHTTP_STREAM_BLOCK_SIZE)
+
+// A piece of a shared render's body
+typedef struct promhttp_render_chunk {
+  struct promhttp_render_chunk *next;
+  uint64_t pos; /**< offset of data in the body */
+  size_t len;
+  char data[PROMHTTP_RENDER_CHUNK_SIZE];
+} promhttp_render_chunk_t;
+
+struct promhttp_render;
+
+// A response reading a shared render
+typedef struct promhttp_render_cursor {
+  struct promhttp_render *render;
+  struct promhttp_render_cursor *next;
+  uint64_t pos; /**< bytes of the body already handed to MHD */
+} promhttp_render_cursor_t;
+
+/**
+ * A /metrics body rendered once and sent to every request that shares it. It is rendered as its readers ask for it,
+ * so the first bytes go out before the last metric is rendered. Unless the render is kept for reuse, the chunks every
+ * reader is past are freed, and from then on no request can join it.
+ */
+typedef struct promhttp_render {
+  pthread_mutex_t lock;             /**< guards everything below but refs */
+  promhttp_response_t ctx;          /**< renders the body, released once it is done */
+  MHD_ContentReaderCallback reader; /**< reads ctx */
+  promhttp_render_chunk_t *head;    /**< oldest chunk still held */
+  promhttp_render_chunk_t *tail;    /**< chunk being filled */
+  uint64_t len;                     /**< bytes rendered so far */
+  bool done;                        /**< the whole body has been rendered */
+  bool failed;                      /**< rendering failed or was abandoned */
+  bool trimmed;                     /**< chunks have been freed, the body no longer starts at head */
+  bool keep;                        /**< keeps every chunk, to be sent again until min interval passes */
+  uint64_t rendered_ms;             /**< monotonic time the render started */
+  promhttp_render_cursor_t *cursors; /**< responses reading the render */
+  struct promhttp_render **slot; /**< the slot the render is current in, under promhttp_render_lock */
+  int refs; /**< cursors plus one while the render is current in its slot, under promhttp_render_lock */
+} promhttp_render_t;
+
+static bool promhttp_coalesce = false;
+static unsigned int promhttp_min_render_interval_ms = 0;
+static pthread_mutex_t promhttp_render_lock = PTHREAD_MUTEX_INITIALIZER;
+// The render of the full exposition in one format and coding that requests join, NULL if none
+static promhttp_render_t *promhttp_render_slots[PROM_EXPOSITION_PROTOBUF + 1][PROMHTTP_ENCODING_ZSTD + 1];
+
+void promhttp_set_render_coalescing(bool enabled, unsigned int min_interval_ms) {
+  promhttp_coalesce = enabled;
+  promhttp_min_render_interval_ms = enabled ? min_interval_ms : 0;
+}
+
+static uint64_t promhttp_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Releases the stream and encoder of a render. The caller must hold render->lock.
+static void promhttp_render_finish_locked(promhttp_render_t *self) {
+  prom_collector_registry_stream_destroy(self->ctx.stream);
+  self->ctx.stream = NULL;
+  promhttp_encoder_release(self->ctx.encoder);
+  self->ctx.encoder = NULL;
+}
+
+// Frees the chunks below pos. The caller must hold render->lock.
+static void promhttp_render_trim_locked(promhttp_render_t *self, uint64_t pos) {
+  while (self->head != NULL && self->head->pos + self->head->len <= pos) {
+    // The tail is still being filled
+    if (self->head == self->tail && !self->done && !self->failed) break;
+    promhttp_render_chunk_t *chunk = self->head;
+    self->head = chunk->next;
+    if (self->head == NULL) self->tail = NULL;
+    free(chunk);
+    self->trimmed = true;
+  }
+}
+
+static void promhttp_render_unref_locked(promhttp_render_t *self) {
+  if (self == NULL || --self->refs > 0) return;
+  promhttp_render_finish_locked(self);
+  while (self->head != NULL) {
+    promhttp_render_chunk_t *chunk = self->head;
+    self->head = chunk->next;
+    free(chunk);
+  }
+  pthread_mutex_destroy(&self->lock);
+  free(self);
+}
+
+// Stops requests from joining the render. The caller must hold promhttp_render_lock.
+static void promhttp_render_detach_locked(promhttp_render_t *self) {
+  if (self->slot == NULL) return;
+  *self->slot = NULL;
+  self->slot = NULL;
+  promhttp_render_unref_locked(self);
+}
+
+void promhttp_clear_render_cache(void) {
+  pthread_mutex_lock(&promhttp_render_lock);
+  for (size_t i = 0; i <= PROM_EXPOSITION_PROTOBUF; i++) {
+    for (size_t j = 0; j <= PROMHTTP_ENCODING_ZSTD; j++) {
+      if (promhttp_render_slots[i][j] != NULL) promhttp_render_detach_locked(promhttp_render_slots[i][j]);
+    }
+  }
+  pthread_mutex_unlock(&promhttp_render_lock);
+}
+
+// Starts a render of the whole unfiltered body through the readers a streamed response uses. Returns NULL upon failure.
+static promhttp_render_t *promhttp_render_new(prom_exposition_format_t format, promhttp_encoding_t encoding) {
+  promhttp_render_t *self = (promhttp_render_t *)calloc(1, sizeof(promhttp_render_t));
+  if (self == NULL) return NULL;
+  pthread_mutex_init(&self->lock, NULL);
+  self->rendered_ms = promhttp_now_ms();
+  self->keep = promhttp_min_render_interval_ms > 0;
+
+  self->ctx.stream = prom_collector_registry_stream_new_format(PROM_ACTIVE_REGISTRY, format);
+  if (encoding != PROMHTTP_ENCODING_IDENTITY) {
+    self->ctx.encoder = promhttp_encoder_acquire(encoding);
+    self->ctx.slot = promhttp_snapshot_slot(format, encoding);
+  }
+  self->reader = encoding == PROMHTTP_ENCODING_IDENTITY ? promhttp_stream_reader : promhttp_encoded_reader;
+  if (self->ctx.stream == NULL || (encoding != PROMHTTP_ENCODING_IDENTITY && self->ctx.encoder == NULL)) {
+    promhttp_render_finish_locked(self);
+    pthread_mutex_destroy(&self->lock);
+    free(self);
+    return NULL;
+  }
+  return self;
+}
+
+// Whether a request arriving now may be sent the render. The caller must hold render->lock.
+static bool promhttp_render_joinable_locked(promhttp_render_t *self, uint64_t now_ms) {
+  if (self->failed || self->trimmed) return false;
+  if (!self->done) return true;
+  return self->keep && now_ms - self->rendered_ms < promhttp_min_render_interval_ms;
+}
+
+/**
+ * @brief Returns a cursor on a render of the full exposition, or NULL to have the caller stream one of its own.
+ *
+ * Requests that arrive while a render is in flight join it, and with promhttp_min_render_interval_ms a finished
+ * render younger than that is sent to every request too, so the cost of rendering follows time, not scrapers.
+ */
+static promhttp_render_cursor_t *promhttp_render_acquire(prom_exposition_format_t format,
+                                                         promhttp_encoding_t encoding) {
+  promhttp_render_cursor_t *cursor = (promhttp_render_cursor_t *)calloc(1, sizeof(promhttp_render_cursor_t));
+  if (cursor == NULL) return NULL;
+  promhttp_render_t **slot = &promhttp_render_slots[format][encoding];
+
+  pthread_mutex_lock(&promhttp_render_lock);
+  promhttp_render_t *render = *slot;
+  if (render != NULL) {
+    pthread_mutex_lock(&render->lock);
+    bool joinable = promhttp_render_joinable_locked(render, promhttp_now_ms());
+    if (joinable) {
+      cursor->next = render->cursors;
+      render->cursors = cursor;
+    }
+    pthread_mutex_unlock(&render->lock);
+    if (!joinable) {
+      promhttp_render_detach_locked(render);
+      render = NULL;
+    }
+  }
+  if (render == NULL) {
+    render = promhttp_render_new(format, encoding);
+    if (render == NULL) {
+      pthread_mutex_unlock(&promhttp_render_lock);
+      free(cursor);
+      return NULL;
+    }
+    render->cursors = cursor;
+    render->slot = slot;
+    render->refs = 1;
+    *slot = render;
+  }
+  render->refs++;
+  cursor->render = render;
+  pthread_mutex_unlock(&promhttp_render_lock);
+  return cursor;
+}
+
+static void promhttp_render_release(void *cls) {
+  promhttp_render_cursor_t *cursor = (promhttp_render_cursor_t *)cls;
+  promhttp_render_t *render = cursor->render;
+
+  pthread_mutex_lock(&promhttp_render_lock);
+  pthread_mutex_lock(&render->lock);
+  promhttp_render_cursor_t **p = &render->cursors;
+  while (*p != cursor) p = &(*p)->next;
+  *p = cursor->next;
+  // Nobody is left to pull a render that is not kept, so it is over
+  bool over = render->cursors == NULL && !render->keep;
+  if (over) {
+    if (!render->done) render->failed = true;
+    promhttp_render_finish_locked(render);
+    promhttp_render_trim_locked(render, UINT64_MAX);
+  }
+  pthread_mutex_unlock(&render->lock);
+  if (over) promhttp_render_detach_locked(render);
+  promhttp_render_unref_locked(render);
+  pthread_mutex_unlock(&promhttp_render_lock);
+  free(cursor);
+}
+
+// Renders the next bytes of the body into the tail chunk. The caller must hold render->lock.
+static int promhttp_render_fill_locked(promhttp_render_t *self) {
+  if (self->tail == NULL || self->tail->len == PROMHTTP_RENDER_CHUNK_SIZE) {
+    promhttp_render_chunk_t *chunk = (promhttp_render_chunk_t *)malloc(sizeof(promhttp_render_chunk_t));
+    if (chunk == NULL) return -1;
+    chunk->next = NULL;
+    chunk->pos = self->len;
+    chunk->len = 0;
+    if (self->tail != NULL) self->tail->next = chunk;
+    else self->head = chunk;
+    self->tail = chunk;
+  }
+  promhttp_render_chunk_t *tail = self->tail;
+  ssize_t n = self->reader(&self->ctx, self->len, tail->data + tail->len, PROMHTTP_RENDER_CHUNK_SIZE - tail->len);
+  if (n == MHD_CONTENT_READER_END_OF_STREAM) {
+    self->done = true;
+    promhttp_render_finish_locked(self);
+    return 0;
+  }
+  if (n < 0) return -1;
+  tail->len += n;
+  self->len += n;
+  return 0;
+}
+
+static ssize_t promhttp_render_reader(void *cls, uint64_t pos, char *buf, size_t max) {
+  promhttp_render_cursor_t *cursor = (promhttp_render_cursor_t *)cls;
+  promhttp_render_t *self = cursor->render;
+  ssize_t ret = 0;
+
+  pthread_mutex_lock(&self->lock);
+  // The reader furthest ahead renders the next bytes for everyone
+  while (!self->failed && !self->done && pos >= self->len) {
+    if (promhttp_render_fill_locked(self)) {
+      self->failed = true;
+      promhttp_render_finish_locked(self);
+    }
+  }
+  if (self->failed) {
+    ret = MHD_CONTENT_READER_END_WITH_ERROR;
+  } else if (pos >= self->len) {
+    ret = MHD_CONTENT_READER_END_OF_STREAM;
+  } else {
+    size_t n = 0;
+    for (promhttp_render_chunk_t *chunk = self->head; chunk != NULL && n < max; chunk = chunk->next) {
+      uint64_t at = pos + n;
+      if (at >= chunk->pos + chunk->len) continue;
+      size_t cnt = chunk->pos + chunk->len - at;
+      if (cnt > max - n) cnt = max - n;
+      memcpy(buf + n, chunk->data + (at - chunk->pos), cnt);
+      n += cnt;
+    }
+    ret = n;
+    cursor->pos = pos + n;
+    if (!self->keep) {
+      uint64_t min_pos = cursor->pos;
+      for (promhttp_render_cursor_t *c = self->cursors; c != NULL; c = c->next) {
+        if (c->pos < min_pos) min_pos = c->pos;
+      }
+      promhttp_render_trim_locked(self, min_pos);
+    }
+  }
+  pthread_mutex_unlock(&self->lock);
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Responses
+
+static void promhttp_metrics_headers(struct MHD_Response *response, prom_exposition_format_t format,
+                                     promhttp_encoding_t encoding) {
+  if (encoding != PROMHTTP_ENCODING_IDENTITY) {
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, promhttp_encoding_name(encoding));
+  }
+  MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE,
+                          format == PROM_EXPOSITION_PROTOBUF ? PROMHTTP_CONTENT_TYPE_PROTOBUF : PROMHTTP_CONTENT_TYPE_TEXT);
+  MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, MHD_HTTP_HEADER_ACCEPT ", " MHD_HTTP_HEADER_ACCEPT_ENCODING);
+}
+
+static struct MHD_Response *promhttp_metrics_response(struct MHD_Connection *connection, promhttp_filter_t *filter) {
+  const char *accept = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT);
+  prom_exposition_format_t format = promhttp_negotiate_format(accept);
+  const char *accept_encoding =
+      MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+  promhttp_encoding_t encoding = promhttp_encoding_negotiate(accept_encoding);
+
+  // Filtered scrapes are cheap and rarely identical, only the full exposition is shared
+  if (promhttp_coalesce && filter == NULL) {
+    promhttp_render_cursor_t *cursor = promhttp_render_acquire(format, encoding);
+    if (cursor != NULL) {
+      struct MHD_Response *response = MHD_create_response_from_callback(
+          MHD_SIZE_UNKNOWN, PROMHTTP_STREAM_BLOCK_SIZE, promhttp_render_reader, cursor, promhttp_render_release);
+      if (response == NULL) {
+        promhttp_render_release(cursor);
+        return NULL;
+      }
+      promhttp_metrics_headers(response, format, encoding);
+      return response;
+    }
+  }
+
+  promhttp_response_t *ctx = (promhttp_response_t *)calloc(1, sizeof(promhttp_response_t));
+  if (ctx == NULL) {
+    promhttp_filter_destroy(filter);
+    return NULL;
+  }
+  ctx->filter = filter;
+
+  ctx->stream = prom_collector_registry_stream_new_filtered(
+      PROM_ACTIVE_REGISTRY, format, filter != NULL ? promhttp_filter_accepts : NULL, filter);
+  if (ctx->stream == NULL) {
+    promhttp_response_free(ctx);
+    return NULL;
+  }
+
+  if (encoding != PROMHTTP_ENCODING_IDENTITY) {
+    // Fall back to identity if no encoder can be created
+    ctx->encoder = promhttp_encoder_acquire(encoding);
+    if (ctx->encoder == NULL) encoding = PROMHTTP_ENCODING_IDENTITY;
+  }
+
+  struct MHD_Response *response = NULL;
+  // The exposition is rendered as MHD asks for it, so the first bytes go out before the last metric is rendered
+  if (encoding == PROMHTTP_ENCODING_IDENTITY) {
+    response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, PROMHTTP_STREAM_BLOCK_SIZE,
+                                                 promhttp_stream_reader, ctx, promhttp_response_free);
+  } else {
+    ctx->slot = promhttp_snapshot_slot(format, encoding);
+    response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, PROMHTTP_STREAM_BLOCK_SIZE,
+                                                 promhttp_encoded_reader, ctx, promhttp_response_free);
+  }
+  if (response == NULL) {
+    promhttp_response_free(ctx);
+    return NULL;
+  }
+  promhttp_metrics_headers(response, format, encoding);
+  return response;
+}
+
+static struct MHD_Response *promhttp_delta_response(struct MHD_Connection *connection, promhttp_filter_t *filter) {
+  const char *since = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "since");
+  char token[PROM_COLLECTOR_REGISTRY_DELTA_TOKEN_SIZE];
+  bool full = false;
+  prom_collector_registry_filter_fn *filter_fn = filter != NULL ? promhttp_filter_accepts : NULL;
+  const char *text = prom_collector_registry_delta(PROM_ACTIVE_REGISTRY, since, filter_fn, filter, token, &full);
+  promhttp_filter_destroy(filter);
+  if (text == NULL) return NULL;
+
+  // Deltas are small and built whole, so they are encoded in one go
+  const char *body = text;
+  size_t len = strlen(text);
+  const char *accept_encoding =
+      MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+  promhttp_encoding_t encoding = promhttp_encoding_negotiate(accept_encoding);
+  promhttp_encoder_t *encoder = NULL;
+  if (encoding != PROMHTTP_ENCODING_IDENTITY) {
+    encoder = promhttp_encoder_acquire(encoding);
+    if (encoder == NULL || promhttp_encoder_encode(encoder, text, len, &body, &len)) {
+      encoding = PROMHTTP_ENCODING_IDENTITY;
+      body = text;
+      len = strlen(text);
+    }
+  }
+  struct MHD_Response *response = MHD_create_response_from_buffer(len, (void *)body, MHD_RESPMEM_MUST_COPY);
+  promhttp_encoder_release(encoder);
+  prom_free((void *)text);
+  if (response == NULL) return NULL;
+
+  if (encoding != PROMHTTP_ENCODING_IDENTITY) {
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, promhttp_encoding_name(encoding));
+  }
+  MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, PROMHTTP_CONTENT_TYPE_TEXT);
+  MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+  MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, "no-store");
+  MHD_add_response_header(response, PROMHTTP_HEADER_DELTA_TOKEN, token);
+  MHD_add_response_header(response, PROMHTTP_HEADER_DELTA, full ? "full" : "delta");
+  return response;
+}
+
+static bool promhttp_keep_alive = true;
+
+void promhttp_set_keep_alive(bool enabled) { promhttp_keep_alive = enabled; }
+
+// Queues and releases a response, asking MHD to close the connection after it when keep-alive is off
+static int promhttp_queue_response(struct MHD_Connection *connection, unsigned int status,
+                                   struct MHD_Response *response) {
+  if (!promhttp_keep_alive) MHD_add_response_header(response, MHD_HTTP_HEADER_CONNECTION, "close");
+  int ret = MHD_queue_response(connection, status, response);
+  MHD_destroy_response(response);
+  return ret;
+}
+
 int promhttp_handler(void *cls, struct MHD_Connection *connection, const char *url, const char *method,
                      const char *version, const char *upload_data, size_t *upload_data_size, void **con_cls) {
   if (strcmp(method, "GET") != 0) {
     char *buf = "Invalid HTTP Method\n";
     struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
-    int ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
-    MHD_destroy_response(response);
-    return ret;
+    return promhttp_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
   }
   if (strcmp(url, "/") == 0) {
     char *buf = "OK\n";
     struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
-    int ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
-    MHD_destroy_response(response);
-    return ret;
+    return promhttp_queue_response(connection, MHD_HTTP_OK, response);
   }
-  if (strcmp(url, "/metrics") == 0) {
-    const char *buf = prom_collector_registry_bridge(PROM_ACTIVE_REGISTRY);
-    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_MUST_FREE);
-    int ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
-    MHD_destroy_response(response);
-    return ret;
+  bool grouped = strncmp(url, PROMHTTP_GROUP_PATH, strlen(PROMHTTP_GROUP_PATH)) == 0 &&
+                 url[strlen(PROMHTTP_GROUP_PATH)] != '\0' && strchr(url + strlen(PROMHTTP_GROUP_PATH), '/') == NULL;
+  bool delta = strcmp(url, PROMHTTP_DELTA_PATH) == 0;
+  if (strcmp(url, "/metrics") == 0 || grouped || delta) {
+    promhttp_filter_t *filter = NULL;
+    struct MHD_Response *response = NULL;
+    if (promhttp_filter_new(connection, grouped ? url + strlen(PROMHTTP_GROUP_PATH) : NULL, &filter) == 0) {
+      if (filter != NULL && filter->unknown_group) {
+        promhttp_filter_destroy(filter);
+        char *buf = "Not Found\n";
+        response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
+        return promhttp_queue_response(connection, MHD_HTTP_NOT_FOUND, response);
+      }
+      response = delta ? promhttp_delta_response(connection, filter) : promhttp_metrics_response(connection, filter);
+    }
+    if (response == NULL) {
+      char *err = "Internal Server Error\n";
+      response = MHD_create_response_from_buffer(strlen(err), (void *)err, MHD_RESPMEM_PERSISTENT);
+      return promhttp_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+    }
+    return promhttp_queue_response(connection, MHD_HTTP_OK, response);
   }
   char *buf = "Bad Request\n";
   struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
-  int ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
-  MHD_destroy_response(response);
-  return ret;
+  return promhttp_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
 }
 
 struct MHD_Daemon *promhttp_start_daemon(unsigned int flags, unsigned short port, MHD_AcceptPolicyCallback apc,
                                          void *apc_cls) {
   return MHD_start_daemon(flags, port, apc, apc_cls, (MHD_AccessHandlerCallback)&promhttp_handler, NULL, MHD_OPTION_END);
 }
+
+struct MHD_Daemon *promhttp_start_daemon_with_options(unsigned int flags, unsigned short port,
+                                                      MHD_AcceptPolicyCallback apc, void *apc_cls,
+                                                      const struct MHD_OptionItem *options) {
+  if (options == NULL) return promhttp_start_daemon(flags, port, apc, apc_cls);
+  return MHD_start_daemon(flags, port, apc, apc_cls, (MHD_AccessHandlerCallback)&promhttp_handler, NULL,
+                          MHD_OPTION_ARRAY, options, MHD_OPTION_END);
+}
@@ -0,0 +1,212 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+#ifdef PROMHTTP_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "promhttp_encoder_i.h"
+
+#define PROMHTTP_GZIP_LEVEL Z_DEFAULT_COMPRESSION
+#define PROMHTTP_ZSTD_LEVEL 3
+
+// Idle encoders kept per coding; more concurrent responses than this allocate and free their own
+#define PROMHTTP_ENCODER_POOL_SIZE 8
+
+struct promhttp_encoder {
+  promhttp_encoding_t encoding;
+  z_stream zs;
+#ifdef PROMHTTP_WITH_ZSTD
+  ZSTD_CCtx *cctx;
+#endif
+  char *buf;      /**< output buffer, reused across pieces and responses */
+  size_t buf_cap; /**< allocated size of buf */
+  promhttp_encoder_t *next;
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static promhttp_encoder_t *pool[PROMHTTP_ENCODING_ZSTD + 1];
+static int pool_cnt[PROMHTTP_ENCODING_ZSTD + 1];
+
+promhttp_encoding_t promhttp_encoding_negotiate(const char *accept_encoding) {
+  if (accept_encoding == NULL) return PROMHTTP_ENCODING_IDENTITY;
+
+  int gzip = -1;  // -1 when not listed, otherwise whether q > 0
+  int zstd = -1;
+  int any = -1;
+  const char *p = accept_encoding;
+  while (*p != '\0') {
+    while (*p == ' ' || *p == '\t' || *p == ',') p++;
+    if (*p == '\0') break;
+
+    const char *token = p;
+    while (*p != '\0' && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') p++;
+    size_t token_len = p - token;
+
+    double q = 1.0;
+    while (*p != '\0' && *p != ',') {
+      if (*p == ';') {
+        p++;
+        while (*p == ' ' || *p == '\t') p++;
+        if ((*p == 'q' || *p == 'Q') && p[1] == '=') q = strtod(p + 2, NULL);
+      } else {
+        p++;
+      }
+    }
+
+    int accepted = q > 0;
+    if ((token_len == 4 && strncasecmp(token, "gzip", 4) == 0) ||
+        (token_len == 6 && strncasecmp(token, "x-gzip", 6) == 0)) {
+      gzip = accepted;
+    } else if (token_len == 4 && strncasecmp(token, "zstd", 4) == 0) {
+      zstd = accepted;
+    } else if (token_len == 1 && *token == '*') {
+      any = accepted;
+    }
+  }
+
+#ifdef PROMHTTP_WITH_ZSTD
+  if (zstd == 1) return PROMHTTP_ENCODING_ZSTD;
+#else
+  (void)zstd;
+#endif
+  if (gzip == 1 || (gzip == -1 && any == 1)) return PROMHTTP_ENCODING_GZIP;
+  return PROMHTTP_ENCODING_IDENTITY;
+}
+
+const char *promhttp_encoding_name(promhttp_encoding_t encoding) {
+  switch (encoding) {
+    case PROMHTTP_ENCODING_GZIP:
+      return "gzip";
+    case PROMHTTP_ENCODING_ZSTD:
+      return "zstd";
+    default:
+      return "identity";
+  }
+}
+
+static void promhttp_encoder_destroy(promhttp_encoder_t *self) {
+  if (self->encoding == PROMHTTP_ENCODING_GZIP) deflateEnd(&self->zs);
+#ifdef PROMHTTP_WITH_ZSTD
+  if (self->encoding == PROMHTTP_ENCODING_ZSTD) ZSTD_freeCCtx(self->cctx);
+#endif
+  free(self->buf);
+  free(self);
+}
+
+static promhttp_encoder_t *promhttp_encoder_new(promhttp_encoding_t encoding) {
+  promhttp_encoder_t *self = (promhttp_encoder_t *)calloc(1, sizeof(promhttp_encoder_t));
+  if (self == NULL) return NULL;
+  self->encoding = encoding;
+
+  if (encoding == PROMHTTP_ENCODING_GZIP) {
+    // windowBits 15 + 16 selects the gzip wrapper
+    if (deflateInit2(&self->zs, PROMHTTP_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      free(self);
+      return NULL;
+    }
+    return self;
+  }
+#ifdef PROMHTTP_WITH_ZSTD
+  if (encoding == PROMHTTP_ENCODING_ZSTD) {
+    self->cctx = ZSTD_createCCtx();
+    if (self->cctx == NULL) {
+      free(self);
+      return NULL;
+    }
+    ZSTD_CCtx_setParameter(self->cctx, ZSTD_c_compressionLevel, PROMHTTP_ZSTD_LEVEL);
+    return self;
+  }
+#endif
+  free(self);
+  return NULL;
+}
+
+promhttp_encoder_t *promhttp_encoder_acquire(promhttp_encoding_t encoding) {
+  if (encoding <= PROMHTTP_ENCODING_IDENTITY || encoding > PROMHTTP_ENCODING_ZSTD) return NULL;
+
+  pthread_mutex_lock(&pool_lock);
+  promhttp_encoder_t *self = pool[encoding];
+  if (self != NULL) {
+    pool[encoding] = self->next;
+    pool_cnt[encoding]--;
+  }
+  pthread_mutex_unlock(&pool_lock);
+
+  if (self == NULL) self = promhttp_encoder_new(encoding);
+  return self;
+}
+
+void promhttp_encoder_release(promhttp_encoder_t *self) {
+  if (self == NULL) return;
+
+  pthread_mutex_lock(&pool_lock);
+  if (pool_cnt[self->encoding] < PROMHTTP_ENCODER_POOL_SIZE) {
+    self->next = pool[self->encoding];
+    pool[self->encoding] = self;
+    pool_cnt[self->encoding]++;
+    self = NULL;
+  }
+  pthread_mutex_unlock(&pool_lock);
+
+  if (self != NULL) promhttp_encoder_destroy(self);
+}
+
+promhttp_encoding_t promhttp_encoder_encoding(promhttp_encoder_t *self) {
+  return self->encoding;
+}
+
+static int promhttp_encoder_reserve(promhttp_encoder_t *self, size_t size) {
+  if (self->buf_cap >= size) return 0;
+  char *buf = (char *)realloc(self->buf, size);
+  if (buf == NULL) return 1;
+  self->buf = buf;
+  self->buf_cap = size;
+  return 0;
+}
+
+int promhttp_encoder_encode(promhttp_encoder_t *self, const char *text, size_t len, const char **out, size_t *out_len) {
+  if (self->encoding == PROMHTTP_ENCODING_GZIP) {
+    if (deflateReset(&self->zs) != Z_OK) return 1;
+    // deflateBound covers the gzip header and trailer, so a single Z_FINISH call completes the member
+    if (promhttp_encoder_reserve(self, deflateBound(&self->zs, len))) return 1;
+    self->zs.next_in = (Bytef *)text;
+    self->zs.avail_in = (uInt)len;
+    self->zs.next_out = (Bytef *)self->buf;
+    self->zs.avail_out = (uInt)self->buf_cap;
+    if (deflate(&self->zs, Z_FINISH) != Z_STREAM_END) return 1;
+    *out = self->buf;
+    *out_len = self->buf_cap - self->zs.avail_out;
+    return 0;
+  }
+#ifdef PROMHTTP_WITH_ZSTD
+  if (self->encoding == PROMHTTP_ENCODING_ZSTD) {
+    if (promhttp_encoder_reserve(self, ZSTD_compressBound(len))) return 1;
+    size_t n = ZSTD_compress2(self->cctx, self->buf, self->buf_cap, text, len);
+    if (ZSTD_isError(n)) return 1;
+    *out = self->buf;
+    *out_len = n;
+    return 0;
+  }
+#endif
+  return 1;
+}
@@ -0,0 +1,67 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROMHTTP_ENCODER_I_H
+#define PROMHTTP_ENCODER_I_H
+
+#include <stddef.h>
+
+/**
+ * @brief API PRIVATE Content codings promhttp can produce. Each coding also names the prom_metric_snapshot_t slot its
+ * cached output lives in.
+ */
+typedef enum promhttp_encoding {
+  PROMHTTP_ENCODING_IDENTITY = 0,
+  PROMHTTP_ENCODING_GZIP,
+  PROMHTTP_ENCODING_ZSTD,
+} promhttp_encoding_t;
+
+typedef struct promhttp_encoder promhttp_encoder_t;
+
+/**
+ * @brief API PRIVATE Picks the best coding the client accepts from an Accept-Encoding header value, which may be NULL
+ */
+promhttp_encoding_t promhttp_encoding_negotiate(const char *accept_encoding);
+
+/**
+ * @brief API PRIVATE Returns the Content-Encoding token of a coding
+ */
+const char *promhttp_encoding_name(promhttp_encoding_t encoding);
+
+/**
+ * @brief API PRIVATE Takes an encoder for the coding from the pool, creating one if the pool is empty
+ */
+promhttp_encoder_t *promhttp_encoder_acquire(promhttp_encoding_t encoding);
+
+/**
+ * @brief API PRIVATE Returns an encoder to the pool, keeping its context and output buffer for the next response
+ */
+void promhttp_encoder_release(promhttp_encoder_t *self);
+
+/**
+ * @brief API PRIVATE Returns the coding of the encoder
+ */
+promhttp_encoding_t promhttp_encoder_encoding(promhttp_encoder_t *self);
+
+/**
+ * @brief API PRIVATE Encodes text into one self-contained gzip member or zstd frame. Members and frames concatenate
+ * into a valid body, so each piece of the exposition can be encoded, and cached, on its own.
+ *
+ * *out points into the encoder's buffer and stays valid until the next call.
+ */
+int promhttp_encoder_encode(promhttp_encoder_t *self, const char *text, size_t len, const char **out, size_t *out_len);
+
+#endif  // PROMHTTP_ENCODER_I_H
@@ -56,6 +56,26 @@ void free_all_metrics()
 	g_list_free(mgroups);
 }
 
+// 一个group的update完成后，将其所有metrics的本轮结果一起发布，避免采集时看到同一group中不同轮次的数据
+static void commit_group_metrics(metric_group *group)
+{
+	guint cnt = g_list_length(group->metrics);
+	if (cnt == 0) {
+		return;
+	}
+
+	prom_metric_t **metrics = g_new(prom_metric_t *, cnt);
+	guint i = 0;
+	GList *miter = NULL;
+	for (miter = g_list_first(group->metrics); miter != NULL; miter = g_list_next(miter)) {
+		metrics[i++] = (prom_metric_t *)miter->data;
+	}
+	if (prom_metrics_commit(metrics, cnt) != 0) {
+		CPDS_LOG_WARN("Failed to commit metrics of group %s", group->name);
+	}
+	g_free(metrics);
+}
+
 static void do_update_metrics(void *arg)
 {
 	pthread_testcancel();
@@ -70,6 +90,7 @@ static void do_update_metrics(void *arg)
 			metric_group *group = (metric_group *)giter->data;
 			if (group->update && (group->update_period > 0) && ((i + offset) % group->update_period == 0)) {
 				(*group->update)();
+				commit_group_metrics(group);
 			}
 			if (i > 0) // 初始第一次全部都更新
 				offset++;
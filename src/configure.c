@@ -20,6 +20,21 @@
 
 #include <glib.h>
 
+// 读取整型配置项，未配置或类型不符时返回默认值
+static int get_int_item(cJSON *cfg_json, const char *key, int default_value)
+{
+	cJSON *temp = cJSON_GetObjectItem(cfg_json, key);
+	if (temp && cJSON_IsNumber(temp))
+		return temp->valueint;
+	return default_value;
+}
+
+static gchar *get_string_item(cJSON *cfg_json, const char *key, const char *default_value)
+{
+	char *temp_str = cJSON_GetStringValue(cJSON_GetObjectItem(cfg_json, key));
+	return g_strdup(temp_str != NULL ? temp_str : default_value);
+}
+
 int load_config(agent_context *ctx, const char *cfg_file)
 {
 	if (ctx == NULL || cfg_file == NULL) {
@@ -61,6 +76,19 @@ int load_config(agent_context *ctx, const char *cfg_file)
 			ctx->expose_port = DEFAULT_EXPOSE_PORT;
 	}
 
+	// 抓取合并：并发的全量抓取共享同一次渲染，最小渲染间隔内复用上次渲染结果
+	ctx->scrape_coalesce = get_int_item(cfg_json, "scrape_coalesce", DEFAULT_SCRAPE_COALESCE);
+	ctx->scrape_min_interval_ms = get_int_item(cfg_json, "scrape_min_interval_ms", DEFAULT_SCRAPE_MIN_INTERVAL_MS);
+
+	// http 服务线程、连接数限制、超时和 keep-alive，以及可选的 unix socket 监听
+	ctx->http_threads = get_int_item(cfg_json, "http_threads", DEFAULT_HTTP_THREADS);
+	ctx->http_connection_limit = get_int_item(cfg_json, "http_connection_limit", DEFAULT_HTTP_CONNECTION_LIMIT);
+	ctx->http_per_ip_limit = get_int_item(cfg_json, "http_per_ip_limit", DEFAULT_HTTP_PER_IP_LIMIT);
+	ctx->http_connection_timeout_s =
+	    get_int_item(cfg_json, "http_connection_timeout_s", DEFAULT_HTTP_CONNECTION_TIMEOUT_S);
+	ctx->http_keep_alive = get_int_item(cfg_json, "http_keep_alive", DEFAULT_HTTP_KEEP_ALIVE);
+	ctx->http_unix_socket = get_string_item(cfg_json, "http_unix_socket", "");
+
 	char *temp_str = cJSON_GetStringValue(cJSON_GetObjectItem(cfg_json, "net_diagnostic_dest"));
 	if (temp_str != NULL) {
 		ctx->net_diagnostic_dest = g_strdup(temp_str);
@@ -69,6 +97,49 @@ int load_config(agent_context *ctx, const char *cfg_file)
 		CPDS_LOG_INFO("Use DEFAULT_NET_DIAGNOSTIC_DEST %s", ctx->net_diagnostic_dest);
 	}
 
+	// ping 探测调度参数
+	ctx->ping_interval_ms = get_int_item(cfg_json, "ping_interval_ms", DEFAULT_PING_INTERVAL_MS);
+	ctx->ping_jitter_ms = get_int_item(cfg_json, "ping_jitter_ms", DEFAULT_PING_JITTER_MS);
+	ctx->ping_max_pps = get_int_item(cfg_json, "ping_max_pps", DEFAULT_PING_MAX_PPS);
+
+	// ping 探测方式
+	ctx->ping_socket_type = get_string_item(cfg_json, "ping_socket_type", DEFAULT_PING_SOCKET_TYPE);
+	ctx->ping_probe_type = get_string_item(cfg_json, "ping_probe_type", DEFAULT_PING_PROBE_TYPE);
+	ctx->ping_tcp_port = get_int_item(cfg_json, "ping_tcp_port", DEFAULT_PING_TCP_PORT);
+
+	// 指标序列数上限，超出后新序列合并到 overflow="true" 序列
+	ctx->max_series_per_metric = get_int_item(cfg_json, "max_series_per_metric", DEFAULT_MAX_SERIES_PER_METRIC);
+	ctx->max_series_total = get_int_item(cfg_json, "max_series_total", DEFAULT_MAX_SERIES_TOTAL);
+
+	// remote write 推送，未配置接收端地址时不启用
+	ctx->remote_write_url = get_string_item(cfg_json, "remote_write_url", "");
+	ctx->remote_write_batch_size = get_int_item(cfg_json, "remote_write_batch_size", DEFAULT_REMOTE_WRITE_BATCH_SIZE);
+	ctx->remote_write_flush_interval_ms =
+	    get_int_item(cfg_json, "remote_write_flush_interval_ms", DEFAULT_REMOTE_WRITE_FLUSH_INTERVAL_MS);
+	ctx->remote_write_shards = get_int_item(cfg_json, "remote_write_shards", DEFAULT_REMOTE_WRITE_SHARDS);
+	ctx->remote_write_min_backoff_ms =
+	    get_int_item(cfg_json, "remote_write_min_backoff_ms", DEFAULT_REMOTE_WRITE_MIN_BACKOFF_MS);
+	ctx->remote_write_max_backoff_ms =
+	    get_int_item(cfg_json, "remote_write_max_backoff_ms", DEFAULT_REMOTE_WRITE_MAX_BACKOFF_MS);
+	ctx->remote_write_timeout_ms = get_int_item(cfg_json, "remote_write_timeout_ms", DEFAULT_REMOTE_WRITE_TIMEOUT_MS);
+	ctx->remote_write_wal_dir = get_string_item(cfg_json, "remote_write_wal_dir", DEFAULT_REMOTE_WRITE_WAL_DIR);
+	ctx->remote_write_wal_size_mb =
+	    get_int_item(cfg_json, "remote_write_wal_size_mb", DEFAULT_REMOTE_WRITE_WAL_SIZE_MB);
+
+	// ping 丢包率统计窗口(s)，未配置时由 ping 服务使用默认窗口
+	ctx->ping_loss_window_cnt = 0;
+	cJSON *windows = cJSON_GetObjectItem(cfg_json, "ping_loss_windows");
+	if (windows && cJSON_IsArray(windows)) {
+		cJSON *item = NULL;
+		cJSON_ArrayForEach(item, windows)
+		{
+			if (ctx->ping_loss_window_cnt >= PING_MAX_LOSS_WINDOWS)
+				break;
+			if (cJSON_IsNumber(item) && item->valueint > 0)
+				ctx->ping_loss_windows[ctx->ping_loss_window_cnt++] = item->valueint;
+		}
+	}
+
 	ret = 0;
 
 out:
@@ -73,7 +73,8 @@ typedef struct _ping_stat {
 	int tag;      // 注册用标识
 	int send_cnt; // 发送次数
 	int recv_cnt; // 接收次数
-	double rtt;   // 往返时间(s)
+	double rtt;       // 往返时间(s)
+	ping_dist_t dist; // RTT分布和丢包率
 } ping_stat_t;
 
 typedef struct _container_info {
@@ -559,6 +560,7 @@ static void update_ping_stat(container_info_t *info, const char *ip_addr)
 		info->ping_stat.send_cnt = ping_info.send_cnt;
 		info->ping_stat.recv_cnt = ping_info.recv_cnt;
 		info->ping_stat.rtt = ping_info.rtt;
+		info->ping_stat.dist = ping_info.dist;
 	}
 }
 
@@ -863,6 +865,7 @@ static void cache_container_resource_info_list()
 		crm->ctn_ping_stat.send_cnt = cinfo->ping_stat.send_cnt;
 		crm->ctn_ping_stat.recv_cnt = cinfo->ping_stat.recv_cnt;
 		crm->ctn_ping_stat.rtt = cinfo->ping_stat.rtt;
+		crm->ctn_ping_stat.dist = cinfo->ping_stat.dist;
 
 		crm->ctn_net_dev_stat_list = NULL;
 		for (GList *ls = g_list_first(cinfo->net_dev_stat_list); ls != NULL; ls = g_list_next(ls)) {
@@ -17,6 +17,8 @@
 #ifndef _CONTAINER_COLLECTOR_H_
 #define _CONTAINER_COLLECTOR_H_
 
+#include "ping.h"
+
 #include <glib.h>
 
 typedef struct _ctn_basic_metric {
@@ -57,7 +59,8 @@ typedef struct _ctn_net_snmp_stat_metrics {
 typedef struct _ctn_ping_stat_metrics {
 	double send_cnt; // 发送次数
 	double recv_cnt; // 接收次数
-	double rtt;      // 往返时间(s)
+	double rtt;       // 往返时间(s)
+	ping_dist_t dist; // RTT分布和丢包率
 } ctn_ping_stat_metrics;
 
 typedef struct _ctn_resource_metrics {
@@ -21,7 +21,32 @@ agent_context global_ctx = {
 	.config_file = NULL,
 	.log_cfg_file = NULL,
 	.net_diagnostic_dest = NULL,
-	.expose_port = 0
+	.expose_port = 0,
+	.scrape_coalesce = DEFAULT_SCRAPE_COALESCE,
+	.scrape_min_interval_ms = DEFAULT_SCRAPE_MIN_INTERVAL_MS,
+	.http_threads = DEFAULT_HTTP_THREADS,
+	.http_connection_limit = DEFAULT_HTTP_CONNECTION_LIMIT,
+	.http_per_ip_limit = DEFAULT_HTTP_PER_IP_LIMIT,
+	.http_connection_timeout_s = DEFAULT_HTTP_CONNECTION_TIMEOUT_S,
+	.http_keep_alive = DEFAULT_HTTP_KEEP_ALIVE,
+	.http_unix_socket = NULL,
+	.ping_interval_ms = DEFAULT_PING_INTERVAL_MS,
+	.ping_jitter_ms = DEFAULT_PING_JITTER_MS,
+	.ping_max_pps = DEFAULT_PING_MAX_PPS,
+	.ping_socket_type = NULL,
+	.ping_probe_type = NULL,
+	.ping_tcp_port = DEFAULT_PING_TCP_PORT,
+	.max_series_per_metric = DEFAULT_MAX_SERIES_PER_METRIC,
+	.max_series_total = DEFAULT_MAX_SERIES_TOTAL,
+	.remote_write_url = NULL,
+	.remote_write_batch_size = DEFAULT_REMOTE_WRITE_BATCH_SIZE,
+	.remote_write_flush_interval_ms = DEFAULT_REMOTE_WRITE_FLUSH_INTERVAL_MS,
+	.remote_write_shards = DEFAULT_REMOTE_WRITE_SHARDS,
+	.remote_write_min_backoff_ms = DEFAULT_REMOTE_WRITE_MIN_BACKOFF_MS,
+	.remote_write_max_backoff_ms = DEFAULT_REMOTE_WRITE_MAX_BACKOFF_MS,
+	.remote_write_timeout_ms = DEFAULT_REMOTE_WRITE_TIMEOUT_MS,
+	.remote_write_wal_dir = NULL,
+	.remote_write_wal_size_mb = DEFAULT_REMOTE_WRITE_WAL_SIZE_MB
 };
 
 void free_global_context()
@@ -39,4 +64,24 @@ void free_global_context()
 		g_free(ctx->net_diagnostic_dest);
 		ctx->net_diagnostic_dest = NULL;
 	}
+	if (ctx->ping_socket_type) {
+		g_free(ctx->ping_socket_type);
+		ctx->ping_socket_type = NULL;
+	}
+	if (ctx->ping_probe_type) {
+		g_free(ctx->ping_probe_type);
+		ctx->ping_probe_type = NULL;
+	}
+	if (ctx->http_unix_socket) {
+		g_free(ctx->http_unix_socket);
+		ctx->http_unix_socket = NULL;
+	}
+	if (ctx->remote_write_url) {
+		g_free(ctx->remote_write_url);
+		ctx->remote_write_url = NULL;
+	}
+	if (ctx->remote_write_wal_dir) {
+		g_free(ctx->remote_write_wal_dir);
+		ctx->remote_write_wal_dir = NULL;
+	}
 }
@@ -17,19 +17,71 @@
 #ifndef _CONTEX_H_
 #define _CONTEX_H_
 
+#include "ping.h"
+
 #include <glib.h>
 
 #define DEFAULT_CFG_FILE "/etc/cpds/agent/config.json"
 #define DEFAULT_LOG_CFG_FILE "/etc/cpds/agent/log.conf"
 #define DEFAULT_EXPOSE_PORT 20001
+#define DEFAULT_SCRAPE_COALESCE 1
+#define DEFAULT_SCRAPE_MIN_INTERVAL_MS 0
+#define DEFAULT_HTTP_THREADS 4
+#define DEFAULT_HTTP_CONNECTION_LIMIT 256
+#define DEFAULT_HTTP_PER_IP_LIMIT 64
+#define DEFAULT_HTTP_CONNECTION_TIMEOUT_S 30
+#define DEFAULT_HTTP_KEEP_ALIVE 1
 #define DEFAULT_NET_DIAGNOSTIC_DEST "127.0.0.1"
+#define DEFAULT_PING_INTERVAL_MS 1000
+#define DEFAULT_PING_JITTER_MS 100
+#define DEFAULT_PING_MAX_PPS 1000
+#define DEFAULT_PING_SOCKET_TYPE "auto"
+#define DEFAULT_PING_PROBE_TYPE "icmp"
+#define DEFAULT_PING_TCP_PORT 80
+#define DEFAULT_MAX_SERIES_PER_METRIC 10000
+#define DEFAULT_MAX_SERIES_TOTAL 200000
+#define DEFAULT_REMOTE_WRITE_BATCH_SIZE 2000
+#define DEFAULT_REMOTE_WRITE_FLUSH_INTERVAL_MS 15000
+#define DEFAULT_REMOTE_WRITE_SHARDS 2
+#define DEFAULT_REMOTE_WRITE_MIN_BACKOFF_MS 100
+#define DEFAULT_REMOTE_WRITE_MAX_BACKOFF_MS 30000
+#define DEFAULT_REMOTE_WRITE_TIMEOUT_MS 10000
+#define DEFAULT_REMOTE_WRITE_WAL_DIR "/var/lib/cpds/agent/wal"
+#define DEFAULT_REMOTE_WRITE_WAL_SIZE_MB 64
 
 typedef struct _agent_context {
 	gboolean show_version;
 	gchar *config_file;
 	gchar *log_cfg_file;
 	gint expose_port;
+	gint scrape_coalesce;        // 并发的全量抓取是否共享同一次渲染
+	gint scrape_min_interval_ms; // 全量渲染结果的复用时间(ms)
+	gint http_threads;           // epoll 工作线程数，<=0 时使用单个 select 线程
+	gint http_connection_limit;
+	gint http_per_ip_limit;
+	gint http_connection_timeout_s;
+	gint http_keep_alive;
+	gchar *http_unix_socket; // unix socket 监听路径，为空时不监听
 	gchar *net_diagnostic_dest;
+	gint ping_interval_ms;
+	gint ping_jitter_ms;
+	gint ping_max_pps;
+	gint ping_loss_windows[PING_MAX_LOSS_WINDOWS]; // 丢包率统计窗口(s)
+	gint ping_loss_window_cnt;
+	gchar *ping_socket_type; // auto/dgram/raw
+	gchar *ping_probe_type;  // icmp/tcp
+	gint ping_tcp_port;
+	gint max_series_per_metric; // 单个指标序列数上限，<=0 表示不限制
+	gint max_series_total;      // 全部指标序列数上限，<=0 表示不限制
+	gchar *remote_write_url;    // remote write 接收端地址，为空时不推送
+	gint remote_write_batch_size;
+	gint remote_write_flush_interval_ms;
+	gint remote_write_shards;
+	gint remote_write_min_backoff_ms;
+	gint remote_write_max_backoff_ms;
+	gint remote_write_timeout_ms;
+	gchar *remote_write_wal_dir;
+	gint remote_write_wal_size_mb;
 } agent_context;
 
 // 全局上下文
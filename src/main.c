@@ -22,6 +22,7 @@
 #include "registration.h"
 #include "web_service.h"
 #include "ping.h"
+#include "remote_write.h"
 
 #include <signal.h>
 #include <glib.h>
@@ -40,7 +41,25 @@ static int do_cpds_agent_service(agent_context *ctx)
 
 	CPDS_LOG_INFO("cpds-agent service started. port=%d", ctx->expose_port);
 	
-	ret = init_ping_svc();
+	ping_svc_cfg_t ping_cfg = {
+	    .interval_ms = ctx->ping_interval_ms,
+	    .jitter_ms = ctx->ping_jitter_ms,
+	    .max_pps = ctx->ping_max_pps,
+	    .tcp_port = ctx->ping_tcp_port,
+	};
+	if (g_strcmp0(ctx->ping_socket_type, "dgram") == 0)
+		ping_cfg.socket_type = PING_SOCKET_DGRAM;
+	else if (g_strcmp0(ctx->ping_socket_type, "raw") == 0)
+		ping_cfg.socket_type = PING_SOCKET_RAW;
+	else if (g_strcmp0(ctx->ping_socket_type, "auto") != 0)
+		CPDS_LOG_WARN("Unknown ping_socket_type %s, use auto", ctx->ping_socket_type);
+	if (g_strcmp0(ctx->ping_probe_type, "tcp") == 0)
+		ping_cfg.probe_type = PING_PROBE_TCP;
+	else if (g_strcmp0(ctx->ping_probe_type, "icmp") != 0)
+		CPDS_LOG_WARN("Unknown ping_probe_type %s, use icmp", ctx->ping_probe_type);
+	for (int i = 0; i < ctx->ping_loss_window_cnt; i++)
+		ping_cfg.loss_window_s[ping_cfg.loss_window_cnt++] = ctx->ping_loss_windows[i];
+	ret = init_ping_svc(&ping_cfg);
 	if (ret != 0) {
 		CPDS_LOG_ERROR("Failed to init ping svc");
 		goto out;
@@ -57,7 +76,37 @@ static int do_cpds_agent_service(agent_context *ctx)
 		goto out;
 	}
 
-	if (start_http_service(ctx->expose_port) != 0) {
+	// remote write 会注册自身指标，须在 http 服务开始遍历 registry 之前启动
+	if (ctx->remote_write_url != NULL && ctx->remote_write_url[0] != '\0') {
+		remote_write_cfg_t rw_cfg = {
+		    .url = ctx->remote_write_url,
+		    .batch_size = ctx->remote_write_batch_size,
+		    .flush_interval_ms = ctx->remote_write_flush_interval_ms,
+		    .shards = ctx->remote_write_shards,
+		    .min_backoff_ms = ctx->remote_write_min_backoff_ms,
+		    .max_backoff_ms = ctx->remote_write_max_backoff_ms,
+		    .timeout_ms = ctx->remote_write_timeout_ms,
+		    .wal_dir = ctx->remote_write_wal_dir,
+		    .wal_size_mb = ctx->remote_write_wal_size_mb,
+		};
+		if (init_remote_write(&rw_cfg) != 0) {
+			CPDS_LOG_ERROR_PRINT("start remote write error");
+			goto out;
+		}
+	}
+
+	http_service_cfg_t http_cfg = {
+	    .port = ctx->expose_port,
+	    .coalesce_scrapes = ctx->scrape_coalesce,
+	    .min_render_interval_ms = ctx->scrape_min_interval_ms,
+	    .threads = ctx->http_threads,
+	    .connection_limit = ctx->http_connection_limit,
+	    .per_ip_limit = ctx->http_per_ip_limit,
+	    .connection_timeout_s = ctx->http_connection_timeout_s,
+	    .keep_alive = ctx->http_keep_alive,
+	    .unix_socket = ctx->http_unix_socket,
+	};
+	if (start_http_service(&http_cfg) != 0) {
 		CPDS_LOG_ERROR_PRINT("start http service error");
 		goto out;
 	}
@@ -78,6 +127,7 @@ static int do_cpds_agent_service(agent_context *ctx)
 out:
 	stop_updating_metrics();
 	stop_http_service();
+	destroy_remote_write();
 	destroy_default_prometheus_registry();
 	free_all_metrics();
 	destroy_ping_svc();
@@ -47,7 +47,7 @@ static void group_container_basic_destroy()
 
 static void update_container_basic_info(GList *plist)
 {
-	prom_gauge_clear(cpds_container_state);
+	prom_gauge_begin_update(cpds_container_state);
 
 	GList *iter = plist;
 	while (iter != NULL) {
@@ -59,6 +59,8 @@ static void update_container_basic_info(GList *plist)
 		prom_gauge_set(cpds_container_state, 1, (const char *[]){cbm->cid, str_pid, cbm->status, str_exit_code, cbm->ip_addr});
 		iter = iter->next;
 	}
+
+	prom_gauge_end_update(cpds_container_state);
 }
 
 static void group_container_basic_update()
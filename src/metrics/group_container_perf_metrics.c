@@ -62,12 +62,12 @@ static void group_container_perf_destroy()
 
 static void update_container_perf_info(GList *plist)
 {
-	prom_counter_clear(cpds_container_alloc_memory_fail_cnt_total);
-	prom_counter_clear(cpds_container_alloc_memory_time_seconds_total);
-	prom_counter_clear(cpds_container_alloc_memory_bytes_total);
-	prom_counter_clear(cpds_container_alloc_memory_count_total);
-	prom_counter_clear(cpds_container_create_process_fail_cnt_total);
-	prom_counter_clear(cpds_container_create_thread_fail_cnt_total);
+	prom_counter_begin_update(cpds_container_alloc_memory_fail_cnt_total);
+	prom_counter_begin_update(cpds_container_alloc_memory_time_seconds_total);
+	prom_counter_begin_update(cpds_container_alloc_memory_bytes_total);
+	prom_counter_begin_update(cpds_container_alloc_memory_count_total);
+	prom_counter_begin_update(cpds_container_create_process_fail_cnt_total);
+	prom_counter_begin_update(cpds_container_create_thread_fail_cnt_total);
 
 	GList *iter = plist;
 	while (iter != NULL) {
@@ -80,6 +80,13 @@ static void update_container_perf_info(GList *plist)
 		prom_counter_set(cpds_container_create_thread_fail_cnt_total, cpm->total_create_thread_fail_cnt, (const char *[]){cpm->cid});
 		iter = iter->next;
 	}
+
+	prom_counter_end_update(cpds_container_alloc_memory_fail_cnt_total);
+	prom_counter_end_update(cpds_container_alloc_memory_time_seconds_total);
+	prom_counter_end_update(cpds_container_alloc_memory_bytes_total);
+	prom_counter_end_update(cpds_container_alloc_memory_count_total);
+	prom_counter_end_update(cpds_container_create_process_fail_cnt_total);
+	prom_counter_end_update(cpds_container_create_thread_fail_cnt_total);
 }
 
 static void group_container_perf_update()
@@ -47,7 +47,7 @@ static void group_container_process_destroy()
 
 static void update_container_process_info(GList *plist)
 {
-	prom_gauge_clear(cpds_container_sub_process_info);
+	prom_gauge_begin_update(cpds_container_sub_process_info);
 
 	GList *iter = plist;
 	while (iter != NULL) {
@@ -63,6 +63,8 @@ static void update_container_process_info(GList *plist)
 		}
 		iter = iter->next;
 	}
+
+	prom_gauge_end_update(cpds_container_sub_process_info);
 }
 
 static void group_container_process_update()
@@ -60,6 +60,49 @@ static prom_counter_t *cpds_container_network_transmit_packets_total;
 static prom_counter_t *cpds_container_ping_send_count_total;
 static prom_counter_t *cpds_container_ping_recv_count_total;
 static prom_counter_t *cpds_container_ping_rtt_total;
+static prom_histogram_t *cpds_container_ping_rtt_seconds;
+static prom_gauge_t *cpds_container_ping_loss_ratio;
+
+// 容器每个网卡的计数器句柄
+typedef struct {
+	guint64 cycle; // 最近一次出现的更新轮次
+	prom_metric_sample_t *receive_bytes_total;
+	prom_metric_sample_t *receive_drop_total;
+	prom_metric_sample_t *receive_errors_total;
+	prom_metric_sample_t *receive_packets_total;
+	prom_metric_sample_t *transmit_bytes_total;
+	prom_metric_sample_t *transmit_drop_total;
+	prom_metric_sample_t *transmit_errors_total;
+	prom_metric_sample_t *transmit_packets_total;
+} ctn_net_dev_children;
+
+// 每个容器持有的指标句柄，每秒更新时免去标签格式化和查找；容器或网卡消失时释放
+typedef struct {
+	guint64 cycle; // 最近一次出现的更新轮次
+	prom_metric_sample_t *memory_total_bytes;
+	prom_metric_sample_t *memory_usage_bytes;
+	prom_metric_sample_t *memory_swap_total_bytes;
+	prom_metric_sample_t *memory_swap_usage_bytes;
+	prom_metric_sample_t *memory_cache_bytes;
+	prom_metric_sample_t *cpu_usage_seconds_total;
+	prom_metric_sample_t *disk_usage_bytes;
+	prom_metric_sample_t *disk_iodelay_total;
+	prom_metric_sample_t *icmp_out_type8_total;
+	prom_metric_sample_t *icmp_in_type0_total;
+
+	gchar *ping_ip;     // ping句柄对应的ip，NULL表示尚无ping句柄
+	guint64 ping_cycle; // 最近一次有ping数据的更新轮次
+	prom_metric_sample_t *ping_send_count_total;
+	prom_metric_sample_t *ping_recv_count_total;
+	prom_metric_sample_t *ping_rtt_total;
+	prom_metric_sample_histogram_t *ping_rtt_seconds;
+	prom_metric_sample_t *ping_loss_ratio[PING_MAX_LOSS_WINDOWS]; // 丢包率统计窗口启动后不再变化
+
+	GHashTable *net_devs; // "网卡名/网络模式" -> ctn_net_dev_children
+} ctn_resource_children;
+
+static GHashTable *ctn_children = NULL; // 容器id -> ctn_resource_children
+static guint64 update_cycle = 0;
 
 static void group_container_resource_init()
 {
@@ -98,6 +141,13 @@ static void group_container_resource_init()
 	grp->metrics = g_list_append(grp->metrics, cpds_container_ping_recv_count_total);
 	cpds_container_ping_rtt_total = prom_counter_new("cpds_container_ping_rtt_total", "totla ping round-trip time", ping_label_count, ping_labels);
 	grp->metrics = g_list_append(grp->metrics, cpds_container_ping_rtt_total);
+	prom_histogram_buckets_t *rtt_buckets = prom_histogram_buckets_exponential(PING_RTT_BUCKET_START, PING_RTT_BUCKET_FACTOR, PING_RTT_BUCKET_COUNT);
+	cpds_container_ping_rtt_seconds = prom_histogram_new("cpds_container_ping_rtt_seconds", "container ping round-trip time distribution", rtt_buckets, ping_label_count, ping_labels);
+	grp->metrics = g_list_append(grp->metrics, cpds_container_ping_rtt_seconds);
+	const char *loss_labels[] = {"container", "ip", "window"};
+	size_t loss_label_count = sizeof(loss_labels) / sizeof(loss_labels[0]);
+	cpds_container_ping_loss_ratio = prom_gauge_new("cpds_container_ping_loss_ratio", "container ping loss ratio over recent window", loss_label_count, loss_labels);
+	grp->metrics = g_list_append(grp->metrics, cpds_container_ping_loss_ratio);
 
 	const char *net_labels[] = {"container", "interface", "network_mode"};
 	size_t net_label_count = sizeof(net_labels) / sizeof(net_labels[0]);
@@ -119,80 +169,284 @@ static void group_container_resource_init()
 	grp->metrics = g_list_append(grp->metrics, cpds_container_network_transmit_packets_total);
 }
 
+static void ctn_net_dev_children_destroy(gpointer data)
+{
+	ctn_net_dev_children *ndc = data;
+	prom_metric_sample_release(ndc->receive_bytes_total);
+	prom_metric_sample_release(ndc->receive_drop_total);
+	prom_metric_sample_release(ndc->receive_errors_total);
+	prom_metric_sample_release(ndc->receive_packets_total);
+	prom_metric_sample_release(ndc->transmit_bytes_total);
+	prom_metric_sample_release(ndc->transmit_drop_total);
+	prom_metric_sample_release(ndc->transmit_errors_total);
+	prom_metric_sample_release(ndc->transmit_packets_total);
+	g_free(ndc);
+}
+
+static ctn_net_dev_children *ctn_net_dev_children_new(const char **labels)
+{
+	ctn_net_dev_children *ndc = g_malloc0(sizeof(ctn_net_dev_children));
+	if (ndc == NULL)
+		return NULL;
+	ndc->receive_bytes_total = prom_counter_child(cpds_container_network_receive_bytes_total, labels);
+	ndc->receive_drop_total = prom_counter_child(cpds_container_network_receive_drop_total, labels);
+	ndc->receive_errors_total = prom_counter_child(cpds_container_network_receive_errors_total, labels);
+	ndc->receive_packets_total = prom_counter_child(cpds_container_network_receive_packets_total, labels);
+	ndc->transmit_bytes_total = prom_counter_child(cpds_container_network_transmit_bytes_total, labels);
+	ndc->transmit_drop_total = prom_counter_child(cpds_container_network_transmit_drop_total, labels);
+	ndc->transmit_errors_total = prom_counter_child(cpds_container_network_transmit_errors_total, labels);
+	ndc->transmit_packets_total = prom_counter_child(cpds_container_network_transmit_packets_total, labels);
+	return ndc;
+}
+
+static void ctn_ping_children_release(ctn_resource_children *cc)
+{
+	prom_metric_sample_release(cc->ping_send_count_total);
+	prom_metric_sample_release(cc->ping_recv_count_total);
+	prom_metric_sample_release(cc->ping_rtt_total);
+	prom_metric_sample_histogram_release(cc->ping_rtt_seconds);
+	for (int i = 0; i < PING_MAX_LOSS_WINDOWS; i++) {
+		prom_metric_sample_release(cc->ping_loss_ratio[i]);
+		cc->ping_loss_ratio[i] = NULL;
+	}
+	cc->ping_send_count_total = NULL;
+	cc->ping_recv_count_total = NULL;
+	cc->ping_rtt_total = NULL;
+	cc->ping_rtt_seconds = NULL;
+	g_free(cc->ping_ip);
+	cc->ping_ip = NULL;
+}
+
+static void ctn_resource_children_destroy(gpointer data)
+{
+	ctn_resource_children *cc = data;
+	prom_metric_sample_release(cc->memory_total_bytes);
+	prom_metric_sample_release(cc->memory_usage_bytes);
+	prom_metric_sample_release(cc->memory_swap_total_bytes);
+	prom_metric_sample_release(cc->memory_swap_usage_bytes);
+	prom_metric_sample_release(cc->memory_cache_bytes);
+	prom_metric_sample_release(cc->cpu_usage_seconds_total);
+	prom_metric_sample_release(cc->disk_usage_bytes);
+	prom_metric_sample_release(cc->disk_iodelay_total);
+	prom_metric_sample_release(cc->icmp_out_type8_total);
+	prom_metric_sample_release(cc->icmp_in_type0_total);
+	ctn_ping_children_release(cc);
+	g_hash_table_destroy(cc->net_devs);
+	g_free(cc);
+}
+
+static ctn_resource_children *ctn_resource_children_new(const char *cid)
+{
+	ctn_resource_children *cc = g_malloc0(sizeof(ctn_resource_children));
+	if (cc == NULL)
+		return NULL;
+	const char *labels[] = {cid};
+	cc->memory_total_bytes = prom_gauge_child(cpds_container_memory_total_bytes, labels);
+	cc->memory_usage_bytes = prom_gauge_child(cpds_container_memory_usage_bytes, labels);
+	cc->memory_swap_total_bytes = prom_gauge_child(cpds_container_memory_swap_total_bytes, labels);
+	cc->memory_swap_usage_bytes = prom_gauge_child(cpds_container_memory_swap_usage_bytes, labels);
+	cc->memory_cache_bytes = prom_gauge_child(cpds_container_memory_cache_bytes, labels);
+	cc->cpu_usage_seconds_total = prom_gauge_child(cpds_container_cpu_usage_seconds_total, labels);
+	cc->disk_usage_bytes = prom_gauge_child(cpds_container_disk_usage_bytes, labels);
+	cc->disk_iodelay_total = prom_gauge_child(cpds_container_disk_iodelay_total, labels);
+	cc->icmp_out_type8_total = prom_gauge_child(cpds_container_icmp_out_type8_total, labels);
+	cc->icmp_in_type0_total = prom_gauge_child(cpds_container_icmp_in_type0_total, labels);
+	cc->net_devs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, ctn_net_dev_children_destroy);
+	return cc;
+}
+
 static void group_container_resource_destroy()
 {
+	if (ctn_children) {
+		g_hash_table_destroy(ctn_children);
+		ctn_children = NULL;
+	}
 	if (group_container_resource.metrics)
 		g_list_free(group_container_resource.metrics);
 }
 
+// 句柄为NULL(创建失败)时跳过，该样本本轮不更新
+static void child_set(prom_metric_sample_t *child, double value)
+{
+	if (child)
+		prom_metric_sample_set(child, value);
+}
+
+static void update_container_ping_info(ctn_resource_children *cc, ctn_resource_metric *crm)
+{
+	if (cc->ping_ip != NULL && g_strcmp0(cc->ping_ip, crm->ip_addr) != 0)
+		ctn_ping_children_release(cc);
+	if (cc->ping_ip == NULL) {
+		const char *labels[] = {crm->cid, crm->ip_addr};
+		cc->ping_ip = g_strdup(crm->ip_addr);
+		cc->ping_send_count_total = prom_counter_child(cpds_container_ping_send_count_total, labels);
+		cc->ping_recv_count_total = prom_counter_child(cpds_container_ping_recv_count_total, labels);
+		cc->ping_rtt_total = prom_counter_child(cpds_container_ping_rtt_total, labels);
+		cc->ping_rtt_seconds = prom_histogram_child(cpds_container_ping_rtt_seconds, labels);
+	}
+	cc->ping_cycle = update_cycle;
+
+	child_set(cc->ping_send_count_total, crm->ctn_ping_stat.send_cnt);
+	child_set(cc->ping_recv_count_total, crm->ctn_ping_stat.recv_cnt);
+	child_set(cc->ping_rtt_total, crm->ctn_ping_stat.rtt);
+	if (cc->ping_rtt_seconds)
+		prom_metric_sample_histogram_set(cc->ping_rtt_seconds, crm->ctn_ping_stat.dist.rtt_buckets, crm->ctn_ping_stat.rtt);
+	for (int i = 0; i < crm->ctn_ping_stat.dist.loss_window_cnt && i < PING_MAX_LOSS_WINDOWS; i++) {
+		if (cc->ping_loss_ratio[i] == NULL) {
+			char window[16];
+			snprintf(window, sizeof(window), "%ds", crm->ctn_ping_stat.dist.loss_window_s[i]);
+			cc->ping_loss_ratio[i] = prom_gauge_child(cpds_container_ping_loss_ratio, (const char *[]){crm->cid, crm->ip_addr, window});
+		}
+		child_set(cc->ping_loss_ratio[i], crm->ctn_ping_stat.dist.loss_ratio[i]);
+	}
+}
+
+static void update_container_net_dev_info(ctn_resource_children *cc, ctn_resource_metric *crm)
+{
+	GList *sub_iter = crm->ctn_net_dev_stat_list;
+	while (sub_iter != NULL) {
+		ctn_net_dev_stat_metric *cndsm = sub_iter->data;
+		gchar *key = g_strdup_printf("%s/%s", cndsm->ifname, crm->network_mode);
+		ctn_net_dev_children *ndc = g_hash_table_lookup(cc->net_devs, key);
+		if (ndc == NULL) {
+			ndc = ctn_net_dev_children_new((const char *[]){crm->cid, cndsm->ifname, crm->network_mode});
+			if (ndc == NULL) {
+				g_free(key);
+				sub_iter = sub_iter->next;
+				continue;
+			}
+			g_hash_table_insert(cc->net_devs, key, ndc);
+		} else {
+			g_free(key);
+		}
+		ndc->cycle = update_cycle;
+
+		child_set(ndc->receive_bytes_total, cndsm->network_receive_bytes_total);
+		child_set(ndc->receive_drop_total, cndsm->network_receive_drop_total);
+		child_set(ndc->receive_errors_total, cndsm->network_receive_errors_total);
+		child_set(ndc->receive_packets_total, cndsm->network_receive_packets_total);
+		child_set(ndc->transmit_bytes_total, cndsm->network_transmit_bytes_total);
+		child_set(ndc->transmit_drop_total, cndsm->network_transmit_drop_total);
+		child_set(ndc->transmit_errors_total, cndsm->network_transmit_errors_total);
+		child_set(ndc->transmit_packets_total, cndsm->network_transmit_packets_total);
+		sub_iter = sub_iter->next;
+	}
+}
+
+// 释放本轮未出现的容器、网卡和ping目标的句柄，随后的end_update会删除它们的序列
+static void release_stale_children()
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, ctn_children);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		ctn_resource_children *cc = value;
+		if (cc->cycle != update_cycle) {
+			g_hash_table_iter_remove(&iter);
+			continue;
+		}
+		if (cc->ping_ip != NULL && cc->ping_cycle != update_cycle)
+			ctn_ping_children_release(cc);
+
+		GHashTableIter sub_iter;
+		gpointer sub_value;
+		g_hash_table_iter_init(&sub_iter, cc->net_devs);
+		while (g_hash_table_iter_next(&sub_iter, NULL, &sub_value)) {
+			ctn_net_dev_children *ndc = sub_value;
+			if (ndc->cycle != update_cycle)
+				g_hash_table_iter_remove(&sub_iter);
+		}
+	}
+}
+
 static void update_container_resource_info(GList *plist)
 {
-	prom_gauge_clear(cpds_container_memory_total_bytes);
-	prom_gauge_clear(cpds_container_memory_usage_bytes);
-	prom_gauge_clear(cpds_container_memory_swap_total_bytes);
-	prom_gauge_clear(cpds_container_memory_swap_usage_bytes);
-	prom_gauge_clear(cpds_container_memory_cache_bytes);
-	prom_gauge_clear(cpds_container_cpu_usage_seconds_total);
-	prom_gauge_clear(cpds_container_disk_usage_bytes);
-	prom_gauge_clear(cpds_container_disk_iodelay_total);
-	prom_gauge_clear(cpds_container_icmp_out_type8_total);
-	prom_gauge_clear(cpds_container_icmp_in_type0_total);
-	prom_counter_clear(cpds_container_network_receive_bytes_total);
-	prom_counter_clear(cpds_container_network_receive_drop_total);
-	prom_counter_clear(cpds_container_network_receive_errors_total);
-	prom_counter_clear(cpds_container_network_receive_packets_total);
-	prom_counter_clear(cpds_container_network_transmit_bytes_total);
-	prom_counter_clear(cpds_container_network_transmit_drop_total);
-	prom_counter_clear(cpds_container_network_transmit_errors_total);
-	prom_counter_clear(cpds_container_network_transmit_packets_total);
-	prom_counter_clear(cpds_container_ping_send_count_total);
-	prom_counter_clear(cpds_container_ping_recv_count_total);
-	prom_counter_clear(cpds_container_ping_rtt_total);
+	prom_gauge_begin_update(cpds_container_memory_total_bytes);
+	prom_gauge_begin_update(cpds_container_memory_usage_bytes);
+	prom_gauge_begin_update(cpds_container_memory_swap_total_bytes);
+	prom_gauge_begin_update(cpds_container_memory_swap_usage_bytes);
+	prom_gauge_begin_update(cpds_container_memory_cache_bytes);
+	prom_gauge_begin_update(cpds_container_cpu_usage_seconds_total);
+	prom_gauge_begin_update(cpds_container_disk_usage_bytes);
+	prom_gauge_begin_update(cpds_container_disk_iodelay_total);
+	prom_gauge_begin_update(cpds_container_icmp_out_type8_total);
+	prom_gauge_begin_update(cpds_container_icmp_in_type0_total);
+	prom_counter_begin_update(cpds_container_network_receive_bytes_total);
+	prom_counter_begin_update(cpds_container_network_receive_drop_total);
+	prom_counter_begin_update(cpds_container_network_receive_errors_total);
+	prom_counter_begin_update(cpds_container_network_receive_packets_total);
+	prom_counter_begin_update(cpds_container_network_transmit_bytes_total);
+	prom_counter_begin_update(cpds_container_network_transmit_drop_total);
+	prom_counter_begin_update(cpds_container_network_transmit_errors_total);
+	prom_counter_begin_update(cpds_container_network_transmit_packets_total);
+	prom_counter_begin_update(cpds_container_ping_send_count_total);
+	prom_counter_begin_update(cpds_container_ping_recv_count_total);
+	prom_counter_begin_update(cpds_container_ping_rtt_total);
+	prom_histogram_begin_update(cpds_container_ping_rtt_seconds);
+	prom_gauge_begin_update(cpds_container_ping_loss_ratio);
+
+	if (ctn_children == NULL)
+		ctn_children = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, ctn_resource_children_destroy);
+	update_cycle++;
 
 	GList *iter = plist;
 	while (iter != NULL) {
 		ctn_resource_metric *crm = iter->data;
-		prom_gauge_set(cpds_container_memory_total_bytes, crm->memory_total_bytes, (const char *[]){crm->cid});
-		prom_gauge_set(cpds_container_memory_usage_bytes, crm->memory_usage_bytes, (const char *[]){crm->cid});
-		prom_gauge_set(cpds_container_memory_swap_total_bytes, crm->memory_swap_total_bytes, (const char *[]){crm->cid});
-		prom_gauge_set(cpds_container_memory_swap_usage_bytes, crm->memory_swap_usage_bytes, (const char *[]){crm->cid});
-		prom_gauge_set(cpds_container_memory_cache_bytes, crm->memory_cached_bytes, (const char *[]){crm->cid});
-		prom_gauge_set(cpds_container_cpu_usage_seconds_total, crm->cpu_usage_seconds, (const char *[]){crm->cid});
-		prom_gauge_set(cpds_container_disk_usage_bytes, crm->disk_usage_bytes, (const char *[]){crm->cid});
-		prom_gauge_set(cpds_container_disk_iodelay_total, crm->disk_iodelay, (const char *[]){crm->cid});
-
-		prom_gauge_set(cpds_container_icmp_out_type8_total, crm->ctn_net_snmp_stat.network_icmp_out_type8_total, (const char *[]){crm->cid});
-		prom_gauge_set(cpds_container_icmp_in_type0_total, crm->ctn_net_snmp_stat.network_icmp_in_type0_total, (const char *[]){crm->cid});
-
-		if (crm->ctn_ping_stat.send_cnt > 0) {
-			prom_counter_set(cpds_container_ping_send_count_total, crm->ctn_ping_stat.send_cnt, (const char *[]){crm->cid, crm->ip_addr});
-			prom_counter_set(cpds_container_ping_recv_count_total, crm->ctn_ping_stat.recv_cnt, (const char *[]){crm->cid, crm->ip_addr});
-			prom_counter_set(cpds_container_ping_rtt_total, crm->ctn_ping_stat.rtt, (const char *[]){crm->cid, crm->ip_addr});
+		ctn_resource_children *cc = g_hash_table_lookup(ctn_children, crm->cid);
+		if (cc == NULL) {
+			cc = ctn_resource_children_new(crm->cid);
+			if (cc == NULL) {
+				iter = iter->next;
+				continue;
+			}
+			g_hash_table_insert(ctn_children, g_strdup(crm->cid), cc);
 		}
+		cc->cycle = update_cycle;
 
-		GList *sub_iter = crm->ctn_net_dev_stat_list;
-		while (sub_iter != NULL) {
-			ctn_net_dev_stat_metric *cndsm = sub_iter->data;
-			prom_counter_set(cpds_container_network_receive_bytes_total, cndsm->network_receive_bytes_total,
-			                 (const char *[]){crm->cid, cndsm->ifname, crm->network_mode});
-			prom_counter_set(cpds_container_network_receive_drop_total, cndsm->network_receive_drop_total,
-			                 (const char *[]){crm->cid, cndsm->ifname, crm->network_mode});
-			prom_counter_set(cpds_container_network_receive_errors_total, cndsm->network_receive_errors_total,
-			                 (const char *[]){crm->cid, cndsm->ifname, crm->network_mode});
-			prom_counter_set(cpds_container_network_receive_packets_total, cndsm->network_receive_packets_total,
-			                 (const char *[]){crm->cid, cndsm->ifname, crm->network_mode});
-			prom_counter_set(cpds_container_network_transmit_bytes_total, cndsm->network_transmit_bytes_total,
-			                 (const char *[]){crm->cid, cndsm->ifname, crm->network_mode});
-			prom_counter_set(cpds_container_network_transmit_drop_total, cndsm->network_transmit_drop_total,
-			                 (const char *[]){crm->cid, cndsm->ifname, crm->network_mode});
-			prom_counter_set(cpds_container_network_transmit_errors_total, cndsm->network_transmit_errors_total,
-			                 (const char *[]){crm->cid, cndsm->ifname, crm->network_mode});
-			prom_counter_set(cpds_container_network_transmit_packets_total, cndsm->network_transmit_packets_total,
-			                 (const char *[]){crm->cid, cndsm->ifname, crm->network_mode});
-			sub_iter = sub_iter->next;
-		}
+		child_set(cc->memory_total_bytes, crm->memory_total_bytes);
+		child_set(cc->memory_usage_bytes, crm->memory_usage_bytes);
+		child_set(cc->memory_swap_total_bytes, crm->memory_swap_total_bytes);
+		child_set(cc->memory_swap_usage_bytes, crm->memory_swap_usage_bytes);
+		child_set(cc->memory_cache_bytes, crm->memory_cached_bytes);
+		child_set(cc->cpu_usage_seconds_total, crm->cpu_usage_seconds);
+		child_set(cc->disk_usage_bytes, crm->disk_usage_bytes);
+		child_set(cc->disk_iodelay_total, crm->disk_iodelay);
+
+		child_set(cc->icmp_out_type8_total, crm->ctn_net_snmp_stat.network_icmp_out_type8_total);
+		child_set(cc->icmp_in_type0_total, crm->ctn_net_snmp_stat.network_icmp_in_type0_total);
+
+		if (crm->ctn_ping_stat.send_cnt > 0)
+			update_container_ping_info(cc, crm);
+
+		update_container_net_dev_info(cc, crm);
 		iter = iter->next;
 	}
+	release_stale_children();
+
+	prom_gauge_end_update(cpds_container_memory_total_bytes);
+	prom_gauge_end_update(cpds_container_memory_usage_bytes);
+	prom_gauge_end_update(cpds_container_memory_swap_total_bytes);
+	prom_gauge_end_update(cpds_container_memory_swap_usage_bytes);
+	prom_gauge_end_update(cpds_container_memory_cache_bytes);
+	prom_gauge_end_update(cpds_container_cpu_usage_seconds_total);
+	prom_gauge_end_update(cpds_container_disk_usage_bytes);
+	prom_gauge_end_update(cpds_container_disk_iodelay_total);
+	prom_gauge_end_update(cpds_container_icmp_out_type8_total);
+	prom_gauge_end_update(cpds_container_icmp_in_type0_total);
+	prom_counter_end_update(cpds_container_network_receive_bytes_total);
+	prom_counter_end_update(cpds_container_network_receive_drop_total);
+	prom_counter_end_update(cpds_container_network_receive_errors_total);
+	prom_counter_end_update(cpds_container_network_receive_packets_total);
+	prom_counter_end_update(cpds_container_network_transmit_bytes_total);
+	prom_counter_end_update(cpds_container_network_transmit_drop_total);
+	prom_counter_end_update(cpds_container_network_transmit_errors_total);
+	prom_counter_end_update(cpds_container_network_transmit_packets_total);
+	prom_counter_end_update(cpds_container_ping_send_count_total);
+	prom_counter_end_update(cpds_container_ping_recv_count_total);
+	prom_counter_end_update(cpds_container_ping_rtt_total);
+	prom_histogram_end_update(cpds_container_ping_rtt_seconds);
+	prom_gauge_end_update(cpds_container_ping_loss_ratio);
 }
 
 static void group_container_resource_update()
@@ -172,7 +172,7 @@ static void update_kernel_crash_metrics()
 	GDir *carsh_dir = NULL;
 	const char *crash_dir_name = "/var/crash";
 
-	prom_gauge_clear(cpds_kernel_crash);
+	prom_gauge_begin_update(cpds_kernel_crash);
 
 	carsh_dir = g_dir_open(crash_dir_name, 0, NULL);
 	if (carsh_dir == NULL) {
@@ -198,6 +198,7 @@ static void update_kernel_crash_metrics()
 	}
 
 out:
+	prom_gauge_end_update(cpds_kernel_crash);
 	if (carsh_dir)
 		g_dir_close(carsh_dir);
 }
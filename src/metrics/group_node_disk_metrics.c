@@ -99,8 +99,8 @@ static int update_node_blk_metrics()
 	gchar *lsblk_output = NULL;
 	cJSON *j_root = NULL;
 
-	// 每次更新清理一下，避免残留已删除的指标项
-	prom_gauge_clear(cpds_node_blk_total_bytes);
+	// 每次更新开启新一轮，结束时移除本轮未更新的指标项
+	prom_gauge_begin_update(cpds_node_blk_total_bytes);
 
 	const gchar *lsblk_cmd = "lsblk -lbJ -o NAME,TYPE,SIZE,MOUNTPOINT";
 	if (g_spawn_command_line_sync(lsblk_cmd, &lsblk_output, NULL, NULL, NULL) == FALSE) {
@@ -139,6 +139,7 @@ static int update_node_blk_metrics()
 	ret = 0;
 
 out:
+	prom_gauge_end_update(cpds_node_blk_total_bytes);
 	if (lsblk_output)
 		g_free(lsblk_output);
 	if (j_root)
@@ -228,7 +229,7 @@ static void update_node_lvm_state_metrics()
 	GError *gerr = NULL;
 	char **line_arr = NULL;
 
-	prom_gauge_clear(cpds_node_lvm_state);
+	prom_gauge_begin_update(cpds_node_lvm_state);
 
 	if (g_spawn_command_line_sync("lvscan", &cmd_out, &cmd_err, NULL, &gerr) == FALSE) {
 		CPDS_LOG_WARN("Failed to exe lvscan. - %s", gerr->message);
@@ -253,6 +254,7 @@ static void update_node_lvm_state_metrics()
 	}
 
 out:
+	prom_gauge_end_update(cpds_node_lvm_state);
 	if (line_arr)
 		g_strfreev(line_arr);
 	if (cmd_out)
@@ -60,19 +60,20 @@ static void group_node_fs_destroy()
 
 int update_node_fs_metrics()
 {
+	int ret = -1;
 	FILE *mount_table;
 	struct mntent *mount_entry;
 	struct statfs s;
 
-	// 每次更新清理一下，避免残留已删除的指标项
-	prom_gauge_clear(cpds_node_fs_total_bytes);
-	prom_gauge_clear(cpds_node_fs_usage_bytes);
-	prom_gauge_clear(cpds_node_fs_available_bytes);
+	// 每次更新开启新一轮，结束时移除本轮未更新的指标项
+	prom_gauge_begin_update(cpds_node_fs_total_bytes);
+	prom_gauge_begin_update(cpds_node_fs_usage_bytes);
+	prom_gauge_begin_update(cpds_node_fs_available_bytes);
 
 	mount_table = setmntent("/etc/mtab", "r");
 	if (!mount_table) {
 		CPDS_LOG_ERROR("set mount entry error. '%s'", strerror(errno));
-		return -1;
+		goto out;
 	}
 
 	while (1) {
@@ -101,7 +102,13 @@ int update_node_fs_metrics()
 			prom_gauge_set(cpds_node_fs_available_bytes, available, (const char *[]){device, mount_point});
 		}
 	}
-	return 0;
+	ret = 0;
+
+out:
+	prom_gauge_end_update(cpds_node_fs_total_bytes);
+	prom_gauge_end_update(cpds_node_fs_usage_bytes);
+	prom_gauge_end_update(cpds_node_fs_available_bytes);
+	return ret;
 }
 
 static void group_node_fs_update()
@@ -40,6 +40,14 @@ static prom_gauge_t *cpds_node_memory_buff_cache_bytes;
 static prom_gauge_t *cpds_node_memory_swap_total_bytes;
 static prom_gauge_t *cpds_node_memory_swap_usage_bytes;
 
+// 无标签指标的样本句柄，更新时免去标签查找
+static prom_metric_sample_t *node_memory_total_sample;
+static prom_metric_sample_t *node_memory_free_sample;
+static prom_metric_sample_t *node_memory_usage_sample;
+static prom_metric_sample_t *node_memory_buff_cache_sample;
+static prom_metric_sample_t *node_memory_swap_total_sample;
+static prom_metric_sample_t *node_memory_swap_usage_sample;
+
 static void group_node_memory_init()
 {
 	metric_group *grp = &group_node_memory;
@@ -55,10 +63,23 @@ static void group_node_memory_init()
 	grp->metrics = g_list_append(grp->metrics, cpds_node_memory_swap_total_bytes);
 	cpds_node_memory_swap_usage_bytes = prom_gauge_new("cpds_node_memory_swap_usage_bytes", "node swap used memory in bytes", 0, NULL);
 	grp->metrics = g_list_append(grp->metrics, cpds_node_memory_swap_usage_bytes);
+
+	node_memory_total_sample = prom_gauge_child(cpds_node_memory_total_bytes, NULL);
+	node_memory_free_sample = prom_gauge_child(cpds_node_memory_free_bytes, NULL);
+	node_memory_usage_sample = prom_gauge_child(cpds_node_memory_usage_bytes, NULL);
+	node_memory_buff_cache_sample = prom_gauge_child(cpds_node_memory_buff_cache_bytes, NULL);
+	node_memory_swap_total_sample = prom_gauge_child(cpds_node_memory_swap_total_bytes, NULL);
+	node_memory_swap_usage_sample = prom_gauge_child(cpds_node_memory_swap_usage_bytes, NULL);
 }
 
 static void group_node_memory_destroy()
 {
+	prom_metric_sample_release(node_memory_total_sample);
+	prom_metric_sample_release(node_memory_free_sample);
+	prom_metric_sample_release(node_memory_usage_sample);
+	prom_metric_sample_release(node_memory_buff_cache_sample);
+	prom_metric_sample_release(node_memory_swap_total_sample);
+	prom_metric_sample_release(node_memory_swap_usage_sample);
 	if (group_node_memory.metrics)
 		g_list_free(group_node_memory.metrics);
 }
@@ -103,12 +124,12 @@ static void group_node_memory_update()
 	}
 
 	unsigned long buff_cache_sum = mem_buffers + mem_cached + mem_sreclaimable;
-	prom_gauge_set(cpds_node_memory_total_bytes, (double)mem_total * 1024, NULL);
-	prom_gauge_set(cpds_node_memory_free_bytes, (double)mem_free * 1024, NULL);
-	prom_gauge_set(cpds_node_memory_buff_cache_bytes, (double)buff_cache_sum * 1024, NULL);
-	prom_gauge_set(cpds_node_memory_usage_bytes, (double)(mem_total - mem_free - buff_cache_sum) * 1024, NULL);
-	prom_gauge_set(cpds_node_memory_swap_total_bytes, (double)mem_swap_total * 1024, NULL);
-	prom_gauge_set(cpds_node_memory_swap_usage_bytes, (double)(mem_swap_total - mem_swap_free) * 1024, NULL);
+	prom_metric_sample_set(node_memory_total_sample, (double)mem_total * 1024);
+	prom_metric_sample_set(node_memory_free_sample, (double)mem_free * 1024);
+	prom_metric_sample_set(node_memory_buff_cache_sample, (double)buff_cache_sum * 1024);
+	prom_metric_sample_set(node_memory_usage_sample, (double)(mem_total - mem_free - buff_cache_sum) * 1024);
+	prom_metric_sample_set(node_memory_swap_total_sample, (double)mem_swap_total * 1024);
+	prom_metric_sample_set(node_memory_swap_usage_sample, (double)(mem_swap_total - mem_swap_free) * 1024);
 
 	g_strfreev(line_arr);
 }
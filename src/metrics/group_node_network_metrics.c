@@ -60,6 +60,26 @@ static prom_counter_t *cpds_node_netstat_tcp_out_segs;
 static prom_counter_t *cpds_node_ping_send_count_total;
 static prom_counter_t *cpds_node_ping_recv_count_total;
 static prom_counter_t *cpds_node_ping_rtt_total;
+static prom_histogram_t *cpds_node_ping_rtt_seconds;
+static prom_gauge_t *cpds_node_ping_loss_ratio;
+static prom_histogram_t *cpds_node_ping_self_latency_seconds;
+
+// 每个网卡的计数器句柄，更新时免去标签格式化和查找；网卡消失时释放
+typedef struct {
+	guint64 cycle; // 最近一次出现的更新轮次
+	prom_metric_sample_t *up;
+	prom_metric_sample_t *receive_bytes_total;
+	prom_metric_sample_t *receive_drop_total;
+	prom_metric_sample_t *receive_errors_total;
+	prom_metric_sample_t *receive_packets_total;
+	prom_metric_sample_t *transmit_bytes_total;
+	prom_metric_sample_t *transmit_drop_total;
+	prom_metric_sample_t *transmit_errors_total;
+	prom_metric_sample_t *transmit_packets_total;
+} net_dev_children;
+
+static GHashTable *net_dev_children_map = NULL; // 网卡名 -> net_dev_children
+static guint64 net_dev_cycle = 0;
 
 static void group_node_network_init()
 {
@@ -103,19 +123,97 @@ static void group_node_network_init()
 	grp->metrics = g_list_append(grp->metrics, cpds_node_ping_recv_count_total);
 	cpds_node_ping_rtt_total = prom_counter_new("cpds_node_ping_rtt_total", "totla ping round-trip time", 0, NULL);
 	grp->metrics = g_list_append(grp->metrics, cpds_node_ping_rtt_total);
+	prom_histogram_buckets_t *rtt_buckets = prom_histogram_buckets_exponential(PING_RTT_BUCKET_START, PING_RTT_BUCKET_FACTOR, PING_RTT_BUCKET_COUNT);
+	cpds_node_ping_rtt_seconds = prom_histogram_new("cpds_node_ping_rtt_seconds", "ping round-trip time distribution", rtt_buckets, 0, NULL);
+	grp->metrics = g_list_append(grp->metrics, cpds_node_ping_rtt_seconds);
+	const char *loss_labels[] = {"window"};
+	cpds_node_ping_loss_ratio = prom_gauge_new("cpds_node_ping_loss_ratio", "ping loss ratio over recent window", 1, loss_labels);
+	grp->metrics = g_list_append(grp->metrics, cpds_node_ping_loss_ratio);
+	const char *self_labels[] = {"direction"};
+	prom_histogram_buckets_t *self_buckets = prom_histogram_buckets_exponential(PING_RTT_BUCKET_START, PING_RTT_BUCKET_FACTOR, PING_RTT_BUCKET_COUNT);
+	cpds_node_ping_self_latency_seconds = prom_histogram_new("cpds_node_ping_self_latency_seconds", "agent's own ping send/receive queuing delay", self_buckets, 1, self_labels);
+	grp->metrics = g_list_append(grp->metrics, cpds_node_ping_self_latency_seconds);
 
 	ping_tag = gen_ping_tag();
 	register_ping_item(ping_tag, global_ctx.net_diagnostic_dest);
 }
 
+static void net_dev_children_destroy(gpointer data)
+{
+	net_dev_children *ndc = data;
+	prom_metric_sample_release(ndc->up);
+	prom_metric_sample_release(ndc->receive_bytes_total);
+	prom_metric_sample_release(ndc->receive_drop_total);
+	prom_metric_sample_release(ndc->receive_errors_total);
+	prom_metric_sample_release(ndc->receive_packets_total);
+	prom_metric_sample_release(ndc->transmit_bytes_total);
+	prom_metric_sample_release(ndc->transmit_drop_total);
+	prom_metric_sample_release(ndc->transmit_errors_total);
+	prom_metric_sample_release(ndc->transmit_packets_total);
+	g_free(ndc);
+}
+
+static net_dev_children *net_dev_children_get(const char *ifname)
+{
+	if (net_dev_children_map == NULL)
+		net_dev_children_map = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, net_dev_children_destroy);
+
+	net_dev_children *ndc = g_hash_table_lookup(net_dev_children_map, ifname);
+	if (ndc != NULL)
+		return ndc;
+
+	ndc = g_malloc0(sizeof(net_dev_children));
+	if (ndc == NULL)
+		return NULL;
+	const char *labels[] = {ifname};
+	ndc->up = prom_gauge_child(cpds_node_network_up, labels);
+	ndc->receive_bytes_total = prom_counter_child(cpds_node_network_receive_bytes_total, labels);
+	ndc->receive_drop_total = prom_counter_child(cpds_node_network_receive_drop_total, labels);
+	ndc->receive_errors_total = prom_counter_child(cpds_node_network_receive_errors_total, labels);
+	ndc->receive_packets_total = prom_counter_child(cpds_node_network_receive_packets_total, labels);
+	ndc->transmit_bytes_total = prom_counter_child(cpds_node_network_transmit_bytes_total, labels);
+	ndc->transmit_drop_total = prom_counter_child(cpds_node_network_transmit_drop_total, labels);
+	ndc->transmit_errors_total = prom_counter_child(cpds_node_network_transmit_errors_total, labels);
+	ndc->transmit_packets_total = prom_counter_child(cpds_node_network_transmit_packets_total, labels);
+	g_hash_table_insert(net_dev_children_map, g_strdup(ifname), ndc);
+	return ndc;
+}
+
+// 释放本轮未出现的网卡的句柄，随后的end_update会删除它们的序列
+static void release_stale_net_dev_children()
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if (net_dev_children_map == NULL)
+		return;
+	g_hash_table_iter_init(&iter, net_dev_children_map);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		net_dev_children *ndc = value;
+		if (ndc->cycle != net_dev_cycle)
+			g_hash_table_iter_remove(&iter);
+	}
+}
+
+// 句柄为NULL(创建失败)时跳过，该样本本轮不更新
+static void child_set(prom_metric_sample_t *child, double value)
+{
+	if (child)
+		prom_metric_sample_set(child, value);
+}
+
 static void group_node_network_destroy()
 {
+	if (net_dev_children_map) {
+		g_hash_table_destroy(net_dev_children_map);
+		net_dev_children_map = NULL;
+	}
 	if (group_node_network.metrics)
 		g_list_free(group_node_network.metrics);
 	unregister_ping_item(ping_tag);
 }
 
-static void update_interface_info_metircs(const char *ifname)
+static void update_interface_info_metircs(const char *ifname, net_dev_children *ndc)
 {
 	int fd;
 	struct ifreq ifr;
@@ -137,9 +235,9 @@ static void update_interface_info_metircs(const char *ifname)
 	if (ioctl(fd, SIOCGIFFLAGS, &ifr) == 0) {
 		// get "up"/"down" state of this interface
 		if (ifr.ifr_flags & IFF_UP)
-			prom_gauge_set(cpds_node_network_up, 1, (const char *[]){ifr.ifr_name});
+			child_set(ndc->up, 1);
 		else
-			prom_gauge_set(cpds_node_network_up, 0, (const char *[]){ifr.ifr_name});
+			child_set(ndc->up, 0);
 	}
 
 	// get the mac of this interface
@@ -192,17 +290,18 @@ static void update_net_dev_metrics()
 	unsigned long long t_carrier;
 	unsigned long long t_compressed;
 
-	prom_gauge_clear(cpds_node_network_info);
-	prom_gauge_clear(cpds_node_network_up);
-	prom_counter_clear(cpds_node_network_receive_bytes_total);
-	prom_counter_clear(cpds_node_network_receive_drop_total);
-	prom_counter_clear(cpds_node_network_receive_errors_total);
-	prom_counter_clear(cpds_node_network_receive_packets_total);
-	prom_counter_clear(cpds_node_network_transmit_bytes_total);
-	prom_counter_clear(cpds_node_network_transmit_drop_total);
-	prom_counter_clear(cpds_node_network_transmit_errors_total);
-	prom_counter_clear(cpds_node_network_transmit_packets_total);
-
+	prom_gauge_begin_update(cpds_node_network_info);
+	prom_gauge_begin_update(cpds_node_network_up);
+	prom_counter_begin_update(cpds_node_network_receive_bytes_total);
+	prom_counter_begin_update(cpds_node_network_receive_drop_total);
+	prom_counter_begin_update(cpds_node_network_receive_errors_total);
+	prom_counter_begin_update(cpds_node_network_receive_packets_total);
+	prom_counter_begin_update(cpds_node_network_transmit_bytes_total);
+	prom_counter_begin_update(cpds_node_network_transmit_drop_total);
+	prom_counter_begin_update(cpds_node_network_transmit_errors_total);
+	prom_counter_begin_update(cpds_node_network_transmit_packets_total);
+
+	net_dev_cycle++;
 	fp = fopen("/proc/net/dev", "r");
 	if (fp == NULL) {
 		goto out;
@@ -217,19 +316,34 @@ static void update_net_dev_metrics()
 		       &t_packets, &t_errs, &t_drop, &t_fifo, &t_colls, &t_carrier, &t_compressed);
 		char *p = strtok(ifname, ":");
 		if (p) {
-			update_interface_info_metircs(ifname);
-			prom_counter_set(cpds_node_network_receive_bytes_total, r_bytes, (const char *[]){ifname});
-			prom_counter_set(cpds_node_network_receive_drop_total, r_drop, (const char *[]){ifname});
-			prom_counter_set(cpds_node_network_receive_errors_total, r_errs, (const char *[]){ifname});
-			prom_counter_set(cpds_node_network_receive_packets_total, r_packets, (const char *[]){ifname});
-			prom_counter_set(cpds_node_network_transmit_bytes_total, t_bytes, (const char *[]){ifname});
-			prom_counter_set(cpds_node_network_transmit_drop_total, t_drop, (const char *[]){ifname});
-			prom_counter_set(cpds_node_network_transmit_errors_total, t_errs, (const char *[]){ifname});
-			prom_counter_set(cpds_node_network_transmit_packets_total, t_packets, (const char *[]){ifname});
+			net_dev_children *ndc = net_dev_children_get(ifname);
+			if (ndc == NULL)
+				continue;
+			ndc->cycle = net_dev_cycle;
+			update_interface_info_metircs(ifname, ndc);
+			child_set(ndc->receive_bytes_total, r_bytes);
+			child_set(ndc->receive_drop_total, r_drop);
+			child_set(ndc->receive_errors_total, r_errs);
+			child_set(ndc->receive_packets_total, r_packets);
+			child_set(ndc->transmit_bytes_total, t_bytes);
+			child_set(ndc->transmit_drop_total, t_drop);
+			child_set(ndc->transmit_errors_total, t_errs);
+			child_set(ndc->transmit_packets_total, t_packets);
 		}
 	}
 
 out:
+	release_stale_net_dev_children();
+	prom_gauge_end_update(cpds_node_network_info);
+	prom_gauge_end_update(cpds_node_network_up);
+	prom_counter_end_update(cpds_node_network_receive_bytes_total);
+	prom_counter_end_update(cpds_node_network_receive_drop_total);
+	prom_counter_end_update(cpds_node_network_receive_errors_total);
+	prom_counter_end_update(cpds_node_network_receive_packets_total);
+	prom_counter_end_update(cpds_node_network_transmit_bytes_total);
+	prom_counter_end_update(cpds_node_network_transmit_drop_total);
+	prom_counter_end_update(cpds_node_network_transmit_errors_total);
+	prom_counter_end_update(cpds_node_network_transmit_packets_total);
 	if (fp)
 		fclose(fp);
 }
@@ -287,6 +401,19 @@ static void update_ping_metrics()
 		prom_counter_set(cpds_node_ping_send_count_total, info.send_cnt, NULL);
 		prom_counter_set(cpds_node_ping_recv_count_total, info.recv_cnt, NULL);
 		prom_counter_set(cpds_node_ping_rtt_total, info.rtt, NULL);
+		prom_histogram_set(cpds_node_ping_rtt_seconds, info.dist.rtt_buckets, info.rtt, NULL);
+		for (int i = 0; i < info.dist.loss_window_cnt; i++) {
+			char window[16];
+			snprintf(window, sizeof(window), "%ds", info.dist.loss_window_s[i]);
+			prom_gauge_set(cpds_node_ping_loss_ratio, info.dist.loss_ratio[i], (const char *[]){window});
+		}
+	}
+
+	// 只有内核时间戳可用时才能测量自身时延
+	ping_self_latency_t lat = {0};
+	if (get_ping_self_latency(&lat) == 0 && lat.kernel_ts) {
+		prom_histogram_set(cpds_node_ping_self_latency_seconds, lat.tx_buckets, lat.tx_sum, (const char *[]){"tx"});
+		prom_histogram_set(cpds_node_ping_self_latency_seconds, lat.rx_buckets, lat.rx_sum, (const char *[]){"rx"});
 	}
 }
 
@@ -29,7 +29,8 @@ typedef struct _pod_ping_stat {
 	int tag;
 	int send_cnt; // 发送次数
 	int recv_cnt; // 接收次数
-	double rtt;   // 往返时间(s)
+	double rtt;       // 往返时间(s)
+	ping_dist_t dist; // RTT分布和丢包率
 } pod_ping_stat_t;
 
 typedef struct _pod_info {
@@ -71,6 +72,8 @@ static prom_gauge_t *cpds_pod_state;
 static prom_counter_t *cpds_pod_ping_send_count_total;
 static prom_counter_t *cpds_pod_ping_recv_count_total;
 static prom_counter_t *cpds_pod_ping_rtt_total;
+static prom_histogram_t *cpds_pod_ping_rtt_seconds;
+static prom_gauge_t *cpds_pod_ping_loss_ratio;
 
 static void group_pod_info_init()
 {
@@ -88,6 +91,13 @@ static void group_pod_info_init()
 	grp->metrics = g_list_append(grp->metrics, cpds_pod_ping_recv_count_total);
 	cpds_pod_ping_rtt_total = prom_counter_new("cpds_pod_ping_rtt_total", "totla ping round-trip time", net_label_count, net_labels);
 	grp->metrics = g_list_append(grp->metrics, cpds_pod_ping_rtt_total);
+	prom_histogram_buckets_t *rtt_buckets = prom_histogram_buckets_exponential(PING_RTT_BUCKET_START, PING_RTT_BUCKET_FACTOR, PING_RTT_BUCKET_COUNT);
+	cpds_pod_ping_rtt_seconds = prom_histogram_new("cpds_pod_ping_rtt_seconds", "pod ping round-trip time distribution", rtt_buckets, net_label_count, net_labels);
+	grp->metrics = g_list_append(grp->metrics, cpds_pod_ping_rtt_seconds);
+	const char *loss_labels[] = {"name", "ip", "window"};
+	size_t loss_label_count = sizeof(loss_labels) / sizeof(loss_labels[0]);
+	cpds_pod_ping_loss_ratio = prom_gauge_new("cpds_pod_ping_loss_ratio", "pod ping loss ratio over recent window", loss_label_count, loss_labels);
+	grp->metrics = g_list_append(grp->metrics, cpds_pod_ping_loss_ratio);
 
 	// 初始化 curl
 	curl_global_init(CURL_GLOBAL_ALL);
@@ -162,13 +172,15 @@ static void group_pod_info_destroy()
 
 static void group_pod_info_update()
 {
-	prom_gauge_clear(cpds_pod_state);
-	prom_counter_clear(cpds_pod_ping_send_count_total);
-	prom_counter_clear(cpds_pod_ping_recv_count_total);
-	prom_counter_clear(cpds_pod_ping_rtt_total);
+	prom_gauge_begin_update(cpds_pod_state);
+	prom_counter_begin_update(cpds_pod_ping_send_count_total);
+	prom_counter_begin_update(cpds_pod_ping_recv_count_total);
+	prom_counter_begin_update(cpds_pod_ping_rtt_total);
+	prom_histogram_begin_update(cpds_pod_ping_rtt_seconds);
+	prom_gauge_begin_update(cpds_pod_ping_loss_ratio);
 
 	if (pthread_rwlock_wrlock(&rwlock) != 0)
-		return;
+		goto out;
 
 	GList *iter = pod_info_list;
 	while (iter != NULL) {
@@ -181,11 +193,27 @@ static void group_pod_info_update()
 			prom_counter_set(cpds_pod_ping_recv_count_total, pod_info->ping_stat.recv_cnt,
 			                 (const char *[]){pod_info->name, pod_info->pod_ip});
 			prom_counter_set(cpds_pod_ping_rtt_total, pod_info->ping_stat.rtt, (const char *[]){pod_info->name, pod_info->pod_ip});
+			prom_histogram_set(cpds_pod_ping_rtt_seconds, pod_info->ping_stat.dist.rtt_buckets, pod_info->ping_stat.rtt,
+			                   (const char *[]){pod_info->name, pod_info->pod_ip});
+			for (int i = 0; i < pod_info->ping_stat.dist.loss_window_cnt; i++) {
+				char window[16];
+				snprintf(window, sizeof(window), "%ds", pod_info->ping_stat.dist.loss_window_s[i]);
+				prom_gauge_set(cpds_pod_ping_loss_ratio, pod_info->ping_stat.dist.loss_ratio[i],
+				               (const char *[]){pod_info->name, pod_info->pod_ip, window});
+			}
 		}
 		iter = iter->next;
 	}
 
 	pthread_rwlock_unlock(&rwlock);
+
+out:
+	prom_gauge_end_update(cpds_pod_state);
+	prom_counter_end_update(cpds_pod_ping_send_count_total);
+	prom_counter_end_update(cpds_pod_ping_recv_count_total);
+	prom_counter_end_update(cpds_pod_ping_rtt_total);
+	prom_histogram_end_update(cpds_pod_ping_rtt_seconds);
+	prom_gauge_end_update(cpds_pod_ping_loss_ratio);
 }
 
 // Callback function to handle the server response
@@ -245,6 +273,7 @@ static GList *update_pod_info_list(GList *curr_list, GList *new_list)
 						new_info->ping_stat.send_cnt = p.send_cnt;
 						new_info->ping_stat.recv_cnt = p.recv_cnt;
 						new_info->ping_stat.rtt = p.rtt;
+						new_info->ping_stat.dist = p.dist;
 					}
 				}
 				// 将新表中与原表匹配的项数据更新到原表，然后删除原表数据，移除新表中的项
@@ -14,28 +14,64 @@
  *  limitations under the License. 
  */
 
+#define _GNU_SOURCE // sendmmsg/recvmmsg
+
 #include "ping.h"
 #include "logger.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <pthread.h>
-#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
-#include <sys/time.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <glib.h>
 
-#define BUFSIZE 1500   // 发送缓存最大值
+#define BUFSIZE 1500   // 接收缓存最大值
 #define DEFAULT_LEN 56 // ping消息数据默认大小
 
+#define PING_WHEEL_TICK_MS 10   // 时间轮刻度(ms)
+#define PING_WHEEL_SLOTS 1024   // 时间轮槽位数，需为2的幂
+#define PING_BATCH_SIZE 64      // sendmmsg/recvmmsg 单批消息数
+#define PING_MAX_EVENTS 8       // epoll 单次返回的最大事件数
+#define PING_CTRL_SIZE 512      // 接收辅助数据(时间戳)缓存大小
+
+#define PING_DEFAULT_INTERVAL_MS 1000
+#define PING_DEFAULT_JITTER_MS 100
+#define PING_DEFAULT_TCP_PORT 80
+
+#define PING_SEQ_RING 1024          // 记录最近应答情况的序号环大小，需为8的倍数
+#define PING_REPLY_TIMEOUT_MS 1000  // 超过该时间未应答才计入丢包
+#define PING_TX_TS_RING 32          // 记录最近报文内核发送时间戳的环大小
+#define PING_CLOCK_STEP_NS 1000000  // 系统时钟相对单调时钟的偏移变化超过该值视为时钟被调整
+
+// tag 低16位为槽位下标(同时作为ICMP标识)，高位为槽位复用代数
+#define PING_MAX_SLOTS 65536
+#define PING_SLOT_SEGMENT_SIZE 256
+#define PING_MAX_SEGMENTS (PING_MAX_SLOTS / PING_SLOT_SEGMENT_SIZE)
+#define PING_TAG_INDEX(tag) ((tag) & 0xffff)
+#define PING_TAG_GEN(tag) ((tag) >> 16)
+#define PING_MAX_GEN 0x7fff
+
+// TCP探测连接的 epoll 数据：高32位为 tag，低32位为 fd
+#define PING_TCP_EV_DATA(tag, fd) (((guint64)(tag) << 32) | (guint32)(fd))
+#define PING_EV_TAG(data) ((int)((data) >> 32))
+#define PING_EV_FD(data) ((int)(guint32)(data))
+
 // 数据类型别名
 typedef unsigned char u8;
 typedef unsigned short u16;
@@ -67,7 +103,8 @@ struct icmphdr {
 // 自定义 icmp 数据区
 struct icmpdata {
 	int tag;
-	struct timeval sendtime;
+	struct timespec sendtime;      // 发送时间(单调时钟)
+	struct timespec sendtime_real; // 发送时间(系统时钟)，与内核时间戳比较
 };
 #define ICMP_DATA_SIZE sizeof(struct icmpdata)
 
@@ -86,16 +123,105 @@ struct iphdr {
 };
 
 #define IP_HSIZE sizeof(struct iphdr) // 定义IP_HSIZE为ip头部长度
+#define PING_ETH_HSIZE 14             // 以太网头部长度
 #define IPVERSION 4                   // 定义IPVERSION为4，指出用ipv4
 #define MAX_TTL 250
 
-static GHashTable *ping_map = NULL; // map: <tag, ping_info_t>
+#define PING_PKT_SIZE (IP_HSIZE + ICMP_HSIZE + ICMP_DATA_SIZE)
+
+// 槽位状态
+enum {
+	PING_SLOT_FREE = 0,  // 空闲
+	PING_SLOT_ALLOCATED, // 已分配tag，未注册
+	PING_SLOT_ACTIVE,    // 已注册，挂在时间轮上
+	PING_SLOT_REMOVED,   // 已注销，等待事件循环出轮后回收
+};
+
+// 探测目标槽位，按 tag 低16位索引；槽位内存直到服务销毁才释放，不会移动
+typedef struct _ping_slot {
+	// 统计数据只由事件循环更新，读取无需加锁
+	_Atomic int tag;                                        // 当前生效的tag，0 表示未注册
+	_Atomic int send_cnt;                                   // 发送次数
+	_Atomic int recv_cnt;                                   // 接收次数
+	_Atomic guint64 rtt_ns;                                 // 往返时间累计(ns)
+	_Atomic guint64 rtt_buckets[PING_RTT_BUCKET_COUNT + 1]; // RTT直方图(非累积)
+	_Atomic unsigned int seq_bitmap[PING_SEQ_RING / 32];    // 最近序号是否已收到应答
+	_Atomic guint64 tx_ns[PING_TX_TS_RING];                 // 最近报文的内核发送时间戳(ns)
+	_Atomic int tx_seq[PING_TX_TS_RING];                    // 对应的报文序号+1，0 表示无效
+
+	// 以下字段只在持有 lock 时访问
+	int index;                // 槽位下标
+	int gen;                  // 槽位复用代数
+	int state;                // 槽位状态
+	char *dest;               // ping 主机名
+	struct sockaddr_in addr;  // 注册时解析好的目标地址
+	int resolved;             // 地址是否解析成功
+	guint64 due_tick;         // 下次发送所在的刻度
+	struct _ping_slot *next;  // 时间轮链表或空闲链表
+
+	// TCP探测状态，只在事件循环线程访问
+	int tcp_fd;               // 进行中的连接，-1 表示无
+	u16 tcp_seq;              // 进行中连接对应的序号
+	guint64 tcp_start_ns;     // 发起连接的时间(单调时钟)
+} ping_slot_t;
+
+// 单层时间轮，超出一圈的目标出轮后重新入轮
+typedef struct _ping_wheel {
+	ping_slot_t *heads[PING_WHEEL_SLOTS];
+	guint64 cur_tick;  // 已处理到的刻度
+	guint64 start_ms;  // 刻度 0 对应的单调时钟时间
+} ping_wheel_t;
+
+// 发送批次
+typedef struct _ping_send_batch {
+	struct mmsghdr msgs[PING_BATCH_SIZE];
+	struct iovec iovs[PING_BATCH_SIZE];
+	struct sockaddr_in addrs[PING_BATCH_SIZE];
+	char bufs[PING_BATCH_SIZE][PING_PKT_SIZE];
+	int cnt;
+} ping_send_batch_t;
+
+// 接收批次
+typedef struct _ping_recv_batch {
+	struct mmsghdr msgs[PING_BATCH_SIZE];
+	struct iovec iovs[PING_BATCH_SIZE];
+	struct sockaddr_in addrs[PING_BATCH_SIZE];
+	char bufs[PING_BATCH_SIZE][BUFSIZE];
+	char ctrls[PING_BATCH_SIZE][PING_CTRL_SIZE];
+} ping_recv_batch_t;
+
+// 分段槽位表，段指针发布后不再变化，读者无锁访问
+static ping_slot_t *_Atomic slot_segments[PING_MAX_SEGMENTS];
+static int slot_cnt = 0;               // 已使用过的槽位数
+static ping_slot_t *free_slots = NULL; // 空闲槽位链表
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; // 保护槽位分配、注册状态和时间轮
+
+static ping_wheel_t wheel;
+static ping_svc_cfg_t svc_cfg;
 static int sockfd = -1;
-static pthread_rwlock_t rwlock;
-static pthread_t send_thread_id = 0;
-static pthread_t recv_thread_id = 0;
+static int sock_type = PING_SOCKET_RAW; // 实际使用的ICMP socket类型
+static int kernel_ts = 0; // socket 是否启用了内核软件时间戳
+static int epfd = -1;
+static int timerfd = -1;
+static int wakefd = -1;
+static pthread_t loop_thread_id = 0;
 static int done = 0;
 
+static double tokens = 0;          // 当前可用发包令牌
+static double tokens_per_tick = 0; // 每个刻度补充的令牌
+static double tokens_burst = 0;    // 令牌桶容量
+
+static double rtt_bounds[PING_RTT_BUCKET_COUNT]; // RTT直方图区间上界(s)
+
+// 服务自身时延：发送为用户态发出到内核发送时间戳，接收为内核接收时间戳到用户态读取
+static _Atomic guint64 self_tx_buckets[PING_RTT_BUCKET_COUNT + 1];
+static _Atomic guint64 self_tx_ns;
+static _Atomic guint64 self_rx_buckets[PING_RTT_BUCKET_COUNT + 1];
+static _Atomic guint64 self_rx_ns;
+
+static ping_send_batch_t send_batch;
+static ping_recv_batch_t recv_batch;
+
 static u16 checksum(u8 *buf, int len)
 {
 	u32 sum = 0;
@@ -116,46 +242,206 @@ static u16 checksum(u8 *buf, int len)
 	return ~sum;
 }
 
+static guint64 mono_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (guint64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static guint64 ts_to_ns(const struct timespec *ts)
+{
+	return (guint64)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static guint64 clock_ns(clockid_t clk)
+{
+	struct timespec ts;
+	clock_gettime(clk, &ts);
+	return ts_to_ns(&ts);
+}
+
+// 时间差(s)，时钟回退时记为0
+static double ns_diff(guint64 end, guint64 start)
+{
+	return end > start ? (end - start) / 1000000000.0 : 0;
+}
+
+// 内核软件时间戳基于系统时钟，判断系统时钟在发送后是否被调整(相对单调时钟的偏移发生变化)
+static int clock_stepped(const struct icmpdata *data, guint64 now_mono, guint64 now_real)
+{
+	gint64 send_offset = (gint64)(ts_to_ns(&data->sendtime_real) - ts_to_ns(&data->sendtime));
+	gint64 recv_offset = (gint64)(now_real - now_mono);
+	gint64 step = recv_offset - send_offset;
+	return step > PING_CLOCK_STEP_NS || step < -PING_CLOCK_STEP_NS;
+}
+
+static int rtt_bucket_index(double val)
+{
+	int idx = 0;
+	while (idx < PING_RTT_BUCKET_COUNT && val > rtt_bounds[idx])
+		idx++;
+	return idx;
+}
+
+static void observe_self_latency(_Atomic guint64 *buckets, _Atomic guint64 *sum_ns, double val)
+{
+	atomic_fetch_add_explicit(&buckets[rtt_bucket_index(val)], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(sum_ns, (guint64)(val * 1000000000.0), memory_order_relaxed);
+}
+
+static int ms_to_ticks(int ms)
+{
+	int ticks = ms / PING_WHEEL_TICK_MS;
+	return ticks > 0 ? ticks : 1;
+}
+
 static int reset_socket()
 {
 	if (sockfd > 0) {
+		if (epfd >= 0)
+			epoll_ctl(epfd, EPOLL_CTL_DEL, sockfd, NULL);
 		close(sockfd);
 		sockfd = -1;
 	}
 
-	if ((sockfd = socket(PF_INET, SOCK_RAW, IPPROTO_ICMP)) < 0) {
-		CPDS_LOG_ERROR("Failed to create socket - %s", strerror(errno));
-		return -1;
+	// 优先使用ICMP数据报socket，由内核按socket过滤应答，且不需要特权
+	if (svc_cfg.socket_type != PING_SOCKET_RAW) {
+		sockfd = socket(PF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+		if (sockfd < 0 && svc_cfg.socket_type == PING_SOCKET_DGRAM) {
+			CPDS_LOG_ERROR("Failed to create ICMP datagram socket, check net.ipv4.ping_group_range - %s",
+			               strerror(errno));
+			return -1;
+		}
+		if (sockfd < 0)
+			CPDS_LOG_INFO("ICMP datagram socket unavailable, use raw socket - %s", strerror(errno));
 	}
 
-	int on = 1;
-	setsockopt(sockfd, IPPROTO_IP, IP_HDRINCL, &on, sizeof(on));
+	if (sockfd >= 0) {
+		sock_type = PING_SOCKET_DGRAM;
+	} else {
+		if ((sockfd = socket(PF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP)) < 0) {
+			CPDS_LOG_ERROR("Failed to create socket - %s", strerror(errno));
+			return -1;
+		}
+		sock_type = PING_SOCKET_RAW;
+
+		int on = 1;
+		setsockopt(sockfd, IPPROTO_IP, IP_HDRINCL, &on, sizeof(on));
+	}
+
+	// 开启内核软件收发时间戳，排除本服务调度延迟；不支持时退回用户态计时
+	int ts_flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE;
+	kernel_ts = setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPING, &ts_flags, sizeof(ts_flags)) == 0;
+	if (kernel_ts == 0)
+		CPDS_LOG_WARN("Kernel timestamping unavailable, use user space clock - %s", strerror(errno));
+
+	if (epfd >= 0) {
+		struct epoll_event ev = {.events = EPOLLIN, .data.u64 = sockfd};
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &ev) != 0) {
+			CPDS_LOG_ERROR("Failed to add socket to epoll - %s", strerror(errno));
+			return -1;
+		}
+	}
 
 	return 0;
 }
 
-static int send_ping(int tag, int seq, const char *hostname)
+static ping_slot_t *lookup_slot(int index)
+{
+	if (index < 0 || index >= PING_MAX_SLOTS)
+		return NULL;
+
+	ping_slot_t *segment = atomic_load_explicit(&slot_segments[index / PING_SLOT_SEGMENT_SIZE], memory_order_acquire);
+	if (segment == NULL)
+		return NULL;
+
+	return &segment[index % PING_SLOT_SEGMENT_SIZE];
+}
+
+// 分配槽位，调用者需持有锁
+static ping_slot_t *alloc_slot()
+{
+	ping_slot_t *slot = free_slots;
+	if (slot != NULL) {
+		free_slots = slot->next;
+		slot->next = NULL;
+		return slot;
+	}
+
+	if (slot_cnt >= PING_MAX_SLOTS)
+		return NULL;
+
+	// 按段扩容，已发布的段不会移动，读者持有的槽位指针始终有效
+	int seg_idx = slot_cnt / PING_SLOT_SEGMENT_SIZE;
+	ping_slot_t *segment = atomic_load_explicit(&slot_segments[seg_idx], memory_order_relaxed);
+	if (segment == NULL) {
+		segment = g_malloc0(sizeof(ping_slot_t) * PING_SLOT_SEGMENT_SIZE);
+		for (int i = 0; i < PING_SLOT_SEGMENT_SIZE; i++) {
+			segment[i].index = seg_idx * PING_SLOT_SEGMENT_SIZE + i;
+			segment[i].tcp_fd = -1;
+		}
+		atomic_store_explicit(&slot_segments[seg_idx], segment, memory_order_release);
+	}
+
+	return &segment[slot_cnt++ % PING_SLOT_SEGMENT_SIZE];
+}
+
+// 回收槽位，调用者需持有锁
+static void release_slot(ping_slot_t *slot)
+{
+	slot->state = PING_SLOT_FREE;
+	slot->next = free_slots;
+	free_slots = slot;
+}
+
+// 根据 tag 查找已分配的槽位，调用者需持有锁
+static ping_slot_t *slot_by_tag(int tag)
+{
+	if (tag <= 0)
+		return NULL;
+
+	ping_slot_t *slot = lookup_slot(PING_TAG_INDEX(tag));
+	if (slot == NULL || slot->state == PING_SLOT_FREE || slot->gen != PING_TAG_GEN(tag))
+		return NULL;
+
+	return slot;
+}
+
+// 目标入轮，调用者需持有锁
+static void wheel_insert(ping_slot_t *slot)
+{
+	if (slot->due_tick <= wheel.cur_tick)
+		slot->due_tick = wheel.cur_tick + 1;
+
+	ping_slot_t **head = &wheel.heads[slot->due_tick & (PING_WHEEL_SLOTS - 1)];
+	slot->next = *head;
+	*head = slot;
+}
+
+// 计算下次发送刻度: 周期 ± 抖动
+static guint64 next_due_tick(guint64 now)
+{
+	int interval = ms_to_ticks(svc_cfg.interval_ms);
+	int jitter = svc_cfg.jitter_ms / PING_WHEEL_TICK_MS;
+	if (jitter > 0) {
+		interval += g_random_int_range(-jitter, jitter + 1);
+		if (interval < 1)
+			interval = 1;
+	}
+	return now + interval;
+}
+
+// 填充一个ICMP请求报文
+static void build_ping(char *sendbuf, int tag, int seq, const struct sockaddr_in *dest)
 {
-	struct sockaddr_in dest;      // 被ping的主机IP
 	struct iphdr *ip_hdr;         // iphdr为IP头部结构体
 	struct icmphdr *icmp_hdr;     // icmphdr为ICMP头部结构体
-	char sendbuf[BUFSIZE];        // 发送字符串数组
 	int datalen = ICMP_DATA_SIZE; // ICMP消息携带的数据长度
-	int len;
 	int ip_len;
 
-	struct hostent *host = gethostbyname(hostname);
-	if ((host) == NULL) {
-		CPDS_LOG_WARN("Failed to gethostbyname - name:%s", hostname);
-		return -1;
-	}
-
-	memset(&dest, 0, sizeof dest);
-	dest.sin_family = PF_INET; // PF_INET为IPV4，internet协议，在<netinet/in.h>中，地址族
-	dest.sin_port = ntohs(0);  // 端口号,ntohs()返回一个以主机字节顺序表达的数。
-	dest.sin_addr = *(struct in_addr *)host->h_addr_list[0]; // host->h_addr_list[0]是地址的指针.返回IP地址，初始化
-
 	// ip头部结构体变量初始化
+	memset(sendbuf, 0, PING_PKT_SIZE);
 	ip_hdr = (struct iphdr *)sendbuf;                  // 字符串指针
 	ip_hdr->hlen = sizeof(struct iphdr) >> 2;          // 头部长度
 	ip_hdr->ver = IPVERSION;                           // 版本
@@ -165,88 +451,316 @@ static int send_ping(int tag, int seq, const char *hostname)
 	ip_hdr->frag_off = 0;                              // 设置flag标记为0
 	ip_hdr->protocol = IPPROTO_ICMP;                   // 运用的协议为ICMP协议
 	ip_hdr->ttl = MAX_TTL;                             // 一个封包在网络上可以存活的时间
-	ip_hdr->daddr = dest.sin_addr.s_addr;              // 目的地址
+	ip_hdr->daddr = dest->sin_addr.s_addr;             // 目的地址
 	ip_len = ip_hdr->hlen << 2;                        // ip数据长度
 
 	// icmp头部结构体变量初始化
 	icmp_hdr = (struct icmphdr *)(sendbuf + ip_len); // 字符串指针
 	icmp_hdr->type = 8;                              // 初始化ICMP消息类型type
 	icmp_hdr->code = 0;                              // 初始化消息代码code
-	icmp_hdr->icmp_id = htons(tag);                  // 把tag标识码赋值给icmp_id
+	icmp_hdr->icmp_id = htons(PING_TAG_INDEX(tag));  // 把tag槽位下标赋值给icmp_id
 	icmp_hdr->icmp_seq = htons(seq);                 // 发送的ICMP消息序号赋值给icmp序号
 
 	// icmp数据区赋值
-	memset(icmp_hdr->data, 0xff, datalen);
-	struct icmpdata *data = (struct icmpdata *)icmp_hdr->data;
-	data->tag = tag;
-	gettimeofday(&data->sendtime, NULL); // 获取当前时间
+	// 数据区在报文中不满足对齐要求，先填本地变量再拷贝
+	struct icmpdata data;
+	data.tag = tag;
+	clock_gettime(CLOCK_MONOTONIC, &data.sendtime);
+	clock_gettime(CLOCK_REALTIME, &data.sendtime_real);
+	memcpy(icmp_hdr->data, &data, sizeof(data));
+
+	icmp_hdr->checksum = 0;
+	icmp_hdr->checksum = checksum((u8 *)icmp_hdr, ICMP_HSIZE + datalen); // 计算校验和
+}
 
-	len = ip_hdr->tot_len;                              // 报文总长度赋值给len变量
-	icmp_hdr->checksum = 0;                             // 初始化
-	icmp_hdr->checksum = checksum((u8 *)icmp_hdr, len); // 计算校验和
+// 批量发送已填充的报文
+static void flush_send_batch()
+{
+	int sent = 0;
 
-	sendto(sockfd, sendbuf, len, 0, (struct sockaddr *)&dest, sizeof(dest));
+	while (sent < send_batch.cnt) {
+		int ret = sendmmsg(sockfd, send_batch.msgs + sent, send_batch.cnt - sent, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+				// 发送缓冲区满时丢弃本批剩余报文，按丢包统计
+				CPDS_LOG_DEBUG("sendmmsg dropped %d pings - %s", send_batch.cnt - sent, strerror(errno));
+				break;
+			}
+			// 单个目标不可达等错误只跳过该报文，不影响同批其他目标
+			sent++;
+			continue;
+		}
+		sent += ret;
+	}
 
-	// CPDS_LOG_DEBUG(">>> ping send %s: tag:%d, seq:%d", hostname, data->tag, seq);
+	send_batch.cnt = 0;
+}
 
-	return 0;
+// 记录一次应答
+static void record_reply(ping_slot_t *slot, u16 seq, double rtt)
+{
+	// 报文中只有16位序号，按最近发送的序号还原
+	int send_cnt = atomic_load_explicit(&slot->send_cnt, memory_order_relaxed);
+	u16 delta = (u16)send_cnt - seq;
+	if (delta >= PING_SEQ_RING || delta >= send_cnt)
+		return;
+
+	// 重复应答只统计一次
+	unsigned int bit = (unsigned int)(send_cnt - delta) % PING_SEQ_RING;
+	unsigned int mask = 1u << (bit & 31);
+	if (atomic_fetch_or_explicit(&slot->seq_bitmap[bit >> 5], mask, memory_order_relaxed) & mask)
+		return;
+
+	atomic_fetch_add_explicit(&slot->rtt_buckets[rtt_bucket_index(rtt)], 1, memory_order_relaxed);
+
+	atomic_fetch_add_explicit(&slot->rtt_ns, (guint64)(rtt * 1000000000.0), memory_order_relaxed);
+	atomic_fetch_add_explicit(&slot->recv_cnt, 1, memory_order_relaxed);
 }
 
-static void send_thread(void *arg)
+// 分配下一个探测序号，序号环复用前清除旧的应答标记
+static int next_probe_seq(ping_slot_t *slot)
 {
-	pthread_testcancel();
-	while (done == 0) {
+	int seq = atomic_fetch_add_explicit(&slot->send_cnt, 1, memory_order_relaxed) + 1;
+	unsigned int bit = (unsigned int)seq % PING_SEQ_RING;
+	atomic_fetch_and_explicit(&slot->seq_bitmap[bit >> 5], ~(1u << (bit & 31)), memory_order_relaxed);
+	return seq;
+}
 
-		sleep(2);
+static void add_to_send_batch(ping_slot_t *slot, int seq)
+{
+	int i = send_batch.cnt;
 
-		GHashTableIter iter;
-		gpointer key, value;
-		g_hash_table_iter_init(&iter, ping_map);
-		while (1) {
-			if (pthread_rwlock_wrlock(&rwlock) != 0)
-				return;
-			if (g_hash_table_iter_next(&iter, &key, &value) == FALSE) {
-				pthread_rwlock_unlock(&rwlock);
-				break;
-			}
-			if (value == NULL) {
-				pthread_rwlock_unlock(&rwlock);
-				continue;
-			}
-			
-			ping_info_t *info = (ping_info_t *)value;
-			if (info->dest == NULL) {
-				pthread_rwlock_unlock(&rwlock);
-				continue;
-			}
-			char *hostname = g_strdup(info->dest);
-			int seq = info->send_cnt;
-			info->send_cnt = info->send_cnt + 2;
-			int tag = GPOINTER_TO_INT(key);
-			pthread_rwlock_unlock(&rwlock);
+	if (slot->resolved == 0)
+		return;
+
+	send_batch.addrs[i] = slot->addr;
+	build_ping(send_batch.bufs[i], atomic_load_explicit(&slot->tag, memory_order_relaxed), seq, &slot->addr);
+	// 数据报socket由内核填充IP头部
+	if (sock_type == PING_SOCKET_DGRAM) {
+		send_batch.iovs[i].iov_base = send_batch.bufs[i] + IP_HSIZE;
+		send_batch.iovs[i].iov_len = PING_PKT_SIZE - IP_HSIZE;
+	} else {
+		send_batch.iovs[i].iov_base = send_batch.bufs[i];
+		send_batch.iovs[i].iov_len = PING_PKT_SIZE;
+	}
+	memset(&send_batch.msgs[i], 0, sizeof(struct mmsghdr));
+	send_batch.msgs[i].msg_hdr.msg_name = &send_batch.addrs[i];
+	send_batch.msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+	send_batch.msgs[i].msg_hdr.msg_iov = &send_batch.iovs[i];
+	send_batch.msgs[i].msg_hdr.msg_iovlen = 1;
+	send_batch.cnt++;
+}
+
+static void close_tcp_probe(ping_slot_t *slot)
+{
+	if (slot->tcp_fd < 0)
+		return;
+
+	// 关闭 fd 时自动从 epoll 中移除
+	close(slot->tcp_fd);
+	slot->tcp_fd = -1;
+}
+
+// 结束TCP探测，收到 SYN-ACK(连接成功)或 RST(端口拒绝)都说明对端可达
+static void finish_tcp_probe(ping_slot_t *slot, int err)
+{
+	if (err == 0 || err == ECONNREFUSED) {
+		double rtt = ns_diff(clock_ns(CLOCK_MONOTONIC), slot->tcp_start_ns);
+		record_reply(slot, slot->tcp_seq, rtt);
+	} else {
+		CPDS_LOG_DEBUG("tcp probe to %s failed - %s", slot->dest, strerror(err));
+	}
+	close_tcp_probe(slot);
+}
+
+// 发起一次非阻塞TCP连接探测，调用者需持有锁
+static void start_tcp_probe(ping_slot_t *slot, int seq)
+{
+	// 上一次探测仍未完成，按丢包处理
+	close_tcp_probe(slot);
+	if (slot->resolved == 0)
+		return;
+
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		CPDS_LOG_DEBUG("Failed to create tcp probe socket - %s", strerror(errno));
+		return;
+	}
+	// 关闭时直接发送RST，避免大量 TIME_WAIT
+	struct linger lg = {.l_onoff = 1, .l_linger = 0};
+	setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+
+	struct sockaddr_in addr = slot->addr;
+	addr.sin_port = htons(svc_cfg.tcp_port);
+
+	slot->tcp_fd = fd;
+	slot->tcp_seq = seq;
+	slot->tcp_start_ns = clock_ns(CLOCK_MONOTONIC);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+		finish_tcp_probe(slot, 0);
+		return;
+	}
+	if (errno != EINPROGRESS) {
+		finish_tcp_probe(slot, errno);
+		return;
+	}
+
+	struct epoll_event ev = {.events = EPOLLOUT, .data.u64 = PING_TCP_EV_DATA(atomic_load_explicit(&slot->tag, memory_order_relaxed), fd)};
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		CPDS_LOG_DEBUG("Failed to add tcp probe to epoll - %s", strerror(errno));
+		close_tcp_probe(slot);
+	}
+}
+
+// 处理TCP探测连接的可写事件
+static void on_tcp_event(guint64 ev_data)
+{
+	int tag = PING_EV_TAG(ev_data);
+	int fd = PING_EV_FD(ev_data);
+
+	pthread_mutex_lock(&lock);
+
+	// fd 已被关闭或复用的过期事件
+	ping_slot_t *slot = slot_by_tag(tag);
+	if (slot == NULL || slot->tcp_fd != fd)
+		goto out;
+
+	int err = 0;
+	socklen_t errlen = sizeof(err);
+	if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen) != 0)
+		err = errno;
+
+	// 同一轮事件中 fd 被新的探测复用时连接可能仍在进行
+	if (err == 0) {
+		struct sockaddr_in peer;
+		socklen_t peerlen = sizeof(peer);
+		if (getpeername(fd, (struct sockaddr *)&peer, &peerlen) != 0)
+			goto out;
+	}
+	finish_tcp_probe(slot, err);
+
+out:
+	pthread_mutex_unlock(&lock);
+}
+
+// 处理一个到期刻度，调用者需持有锁；批次满时临时释放锁发送
+static void process_tick()
+{
+	guint64 tick = wheel.cur_tick;
+	ping_slot_t **head = &wheel.heads[tick & (PING_WHEEL_SLOTS - 1)];
+	ping_slot_t *list = *head;
+	*head = NULL;
+
+	if (tokens_per_tick > 0) {
+		tokens += tokens_per_tick;
+		if (tokens > tokens_burst)
+			tokens = tokens_burst;
+	}
+
+	while (list != NULL) {
+		ping_slot_t *slot = list;
+		list = slot->next;
+		slot->next = NULL;
 
-			// 发送ping包
-			send_ping(tag, seq + 1, hostname);
-			send_ping(tag, seq + 2, hostname);
+		// 已注销的槽位出轮后才能复用
+		if (slot->state == PING_SLOT_REMOVED) {
+			close_tcp_probe(slot);
+			release_slot(slot);
+			continue;
+		}
 
-			g_free(hostname);
+		// 不在本圈，重新入轮
+		if (slot->due_tick > tick) {
+			wheel_insert(slot);
+			continue;
+		}
 
-			g_usleep(2000);
+		// 超出全局速率预算，顺延到下一刻度
+		if (tokens_per_tick > 0 && tokens < 1) {
+			slot->due_tick = tick + 1;
+			wheel_insert(slot);
+			continue;
+		}
+		if (tokens_per_tick > 0)
+			tokens -= 1;
+
+		int seq = next_probe_seq(slot);
+		if (svc_cfg.probe_type == PING_PROBE_TCP)
+			start_tcp_probe(slot, seq);
+		else
+			add_to_send_batch(slot, seq);
+		slot->due_tick = next_due_tick(tick);
+		wheel_insert(slot);
+
+		if (send_batch.cnt == PING_BATCH_SIZE) {
+			pthread_mutex_unlock(&lock);
+			flush_send_batch();
+			pthread_mutex_lock(&lock);
 		}
 	}
 }
 
-static int recv_ping(char *recv_buf, int recv_len, struct sockaddr_in *from)
+static void on_timer()
+{
+	guint64 expirations;
+	if (read(timerfd, &expirations, sizeof(expirations)) < 0)
+		return;
+
+	guint64 now_tick = (mono_ms() - wheel.start_ms) / PING_WHEEL_TICK_MS;
+
+	pthread_mutex_lock(&lock);
+
+	// 落后超过一圈时，每个槽位只需再处理一次
+	if (now_tick > wheel.cur_tick + PING_WHEEL_SLOTS)
+		wheel.cur_tick = now_tick - PING_WHEEL_SLOTS;
+
+	while (wheel.cur_tick < now_tick) {
+		wheel.cur_tick++;
+		process_tick();
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	if (send_batch.cnt > 0)
+		flush_send_batch();
+}
+
+// 解析 type 类型的ICMP报文(不含IP头部)，返回 tag，非本服务的报文返回 -1
+static int parse_icmp(char *buf, int len, u8 type, struct icmpdata *data, u16 *seq)
+{
+	struct icmphdr *icmp = (struct icmphdr *)buf;
+
+	if (len < ICMP_HSIZE + ICMP_DATA_SIZE) {
+		return -1;
+	}
+
+	if (checksum((u8 *)icmp, len)) {
+		CPDS_LOG_INFO("checksum fail");
+		return -1;
+	}
+
+	if (icmp->type != type) {
+		return -1;
+	}
+
+	memcpy(data, icmp->data, sizeof(*data));
+	// 数据报socket的ICMP标识由内核分配，并已按socket过滤
+	if (sock_type == PING_SOCKET_RAW && icmp->icmp_id != htons(PING_TAG_INDEX(data->tag))) {
+		return -1;
+	}
+
+	*seq = ntohs(icmp->icmp_seq);
+	return data->tag;
+}
+
+// 解析带IP头部的ICMP报文，返回 tag，非本服务的报文返回 -1
+static int parse_ping_pkt(char *recv_buf, int recv_len, u8 type, struct icmpdata *data, u16 *seq)
 {
 	struct iphdr *ip;
-	struct icmphdr *icmp;
-	struct icmpdata *data;
 	int ip_hlen;
 	u16 ip_datalen;
-	int tag;
-
-	struct timeval recvtime;
-	gettimeofday(&recvtime, NULL); // 记录收到应答的时间
 
 	if (recv_len < IP_HSIZE + ICMP_HSIZE + ICMP_DATA_SIZE) {
 		CPDS_LOG_INFO("Receive size too short");
@@ -256,132 +770,417 @@ static int recv_ping(char *recv_buf, int recv_len, struct sockaddr_in *from)
 	ip = (struct iphdr *)recv_buf;
 	ip_hlen = ip->hlen << 2;
 	ip_datalen = ntohs(ip->tot_len) - ip_hlen;
-	icmp = (struct icmphdr *)(recv_buf + ip_hlen);
 
-	if (checksum((u8 *)icmp, ip_datalen)) {
-		CPDS_LOG_INFO("checksum fail");
+	if (ip_hlen + ICMP_HSIZE + ICMP_DATA_SIZE > recv_len || ip_hlen + ip_datalen > recv_len) {
 		return -1;
 	}
 
-	if (ip->ttl >= MAX_TTL) {
+	// 过滤本机发出的请求报文
+	if (type == 0 && ip->ttl >= MAX_TTL) {
 		return -1;
 	}
 
-	// 不是应答，忽略
-	if (icmp->type != 0) {
+	return parse_icmp(recv_buf + ip_hlen, ip_datalen, type, data, seq);
+}
+
+// 计算最近 window_s 秒内已超时序号的丢包率
+static double calc_loss_ratio(ping_slot_t *slot, int send_cnt, int window_s)
+{
+	int interval_ms = svc_cfg.interval_ms;
+	int inflight = (PING_REPLY_TIMEOUT_MS + interval_ms - 1) / interval_ms;
+	int end = send_cnt - inflight;
+	int n = (int)((long)window_s * 1000 / interval_ms);
+
+	if (n > PING_SEQ_RING - inflight)
+		n = PING_SEQ_RING - inflight;
+	if (n > end)
+		n = end;
+	if (n <= 0)
 		return 0;
+
+	int got = 0;
+	for (int seq = end - n + 1; seq <= end; seq++) {
+		unsigned int bit = (unsigned int)seq % PING_SEQ_RING;
+		if (atomic_load_explicit(&slot->seq_bitmap[bit >> 5], memory_order_relaxed) & (1u << (bit & 31)))
+			got++;
 	}
-		
-	data = (struct icmpdata *)icmp->data;
-	tag = data->tag;
 
-	if (pthread_rwlock_wrlock(&rwlock) != 0)
-		return -1;
+	return 1.0 - (double)got / n;
+}
 
-	// 查表，更新接收数据
-	ping_info_t *pinfo = g_hash_table_lookup(ping_map, GINT_TO_POINTER(tag));
-	if (pinfo == NULL) {
-		pthread_rwlock_unlock(&rwlock);
-		return -1;
+static void prepare_recv_batch()
+{
+	for (int i = 0; i < PING_BATCH_SIZE; i++) {
+		recv_batch.iovs[i].iov_base = recv_batch.bufs[i];
+		recv_batch.iovs[i].iov_len = BUFSIZE;
+		memset(&recv_batch.msgs[i], 0, sizeof(struct mmsghdr));
+		recv_batch.msgs[i].msg_hdr.msg_name = &recv_batch.addrs[i];
+		recv_batch.msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		recv_batch.msgs[i].msg_hdr.msg_iov = &recv_batch.iovs[i];
+		recv_batch.msgs[i].msg_hdr.msg_iovlen = 1;
+		recv_batch.msgs[i].msg_hdr.msg_control = recv_batch.ctrls[i];
+		recv_batch.msgs[i].msg_hdr.msg_controllen = PING_CTRL_SIZE;
 	}
-	double rtt = (recvtime.tv_sec - data->sendtime.tv_sec) + (recvtime.tv_usec - data->sendtime.tv_usec) / 1000000.0;
-	pinfo->rtt += rtt;
-	pinfo->recv_cnt++;
+}
 
-	// CPDS_LOG_DEBUG("<<< %d bytes from %s:icmp_seq=%u ttl=%d rtt=%.3f ms", ip_datalen, // IP数据长度
-	//                inet_ntoa(from->sin_addr),                                         // 目的ip地址
-	//                ntohs(icmp->icmp_seq),                                             // icmp报文序列号
-	//                ip->ttl,                                                           // 生存时间
-	//                rtt * 1000);                                                       // 往返时间
+// 取出消息附带的内核软件时间戳(ns)，没有时返回0
+static guint64 get_kernel_ts(struct msghdr *msg)
+{
+	struct cmsghdr *cmsg;
 
-	pthread_rwlock_unlock(&rwlock);
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+			struct scm_timestamping tss;
+			memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+			return ts_to_ns(&tss.ts[0]);
+		}
+	}
 
 	return 0;
 }
 
-static void recv_thread(void *arg)
+// 查找报文的内核发送时间戳，没有时返回0
+static guint64 lookup_tx_ts(ping_slot_t *slot, u16 seq)
 {
-	pthread_testcancel();
+	int i = seq % PING_TX_TS_RING;
+	if (atomic_load_explicit(&slot->tx_seq[i], memory_order_acquire) != seq + 1)
+		return 0;
+	return atomic_load_explicit(&slot->tx_ns[i], memory_order_relaxed);
+}
 
-	int recv_len = 0;
-	socklen_t addr_len;
-	struct sockaddr_in from;
-	char recv_buf[BUFSIZE] = {0};
-	int inner_fail_count = 0;
-	int outer_fail_count = 0;
+// 记录错误队列中回送报文的发送时间戳
+static void record_tx_ts(char *buf, int len, guint64 tx_ns)
+{
+	struct icmpdata data;
+	u16 seq;
+
+	// 回送报文从链路层头部开始，以太网头部后移到缓存起始处以满足对齐
+	if (len > PING_ETH_HSIZE && (u8)buf[12] == 0x08 && (u8)buf[13] == 0x00) {
+		len -= PING_ETH_HSIZE;
+		memmove(buf, buf + PING_ETH_HSIZE, len);
+	}
+
+	int tag = parse_ping_pkt(buf, len, 8, &data, &seq);
+	if (tag <= 0)
+		return;
+
+	observe_self_latency(self_tx_buckets, &self_tx_ns, ns_diff(tx_ns, ts_to_ns(&data.sendtime_real)));
+
+	ping_slot_t *slot = lookup_slot(PING_TAG_INDEX(tag));
+	if (slot == NULL || atomic_load_explicit(&slot->tag, memory_order_acquire) != tag)
+		return;
+	int i = seq % PING_TX_TS_RING;
+	atomic_store_explicit(&slot->tx_ns[i], tx_ns, memory_order_relaxed);
+	atomic_store_explicit(&slot->tx_seq[i], seq + 1, memory_order_release);
+}
+
+// 读空错误队列中的发送时间戳，返回值小于0表示socket出错
+static int on_errqueue()
+{
+	int total = 0;
 
-	addr_len = sizeof(from);
 	while (done == 0) {
-		if ((recv_len = recvfrom(sockfd, recv_buf, sizeof(recv_buf), 0, (struct sockaddr *)&from, &addr_len)) < 0) {
-			if (errno == EINTR) // EINTR表示信号中断
+		prepare_recv_batch();
+
+		int cnt = recvmmsg(sockfd, recv_batch.msgs, PING_BATCH_SIZE, MSG_ERRQUEUE | MSG_DONTWAIT, NULL);
+		if (cnt < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				CPDS_LOG_ERROR("Receive ping timestamp error - %s", strerror(errno));
+				return -1;
+			}
+			if (total > 0)
+				return 0;
+			// 错误队列为空，是socket本身出错
+			int err = 0;
+			socklen_t errlen = sizeof(err);
+			getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &errlen);
+			if (err != 0) {
+				CPDS_LOG_ERROR("Ping socket error - %s", strerror(err));
+				return -1;
+			}
+			return 0;
+		}
+		total += cnt;
+
+		for (int i = 0; i < cnt; i++) {
+			guint64 tx_ns = get_kernel_ts(&recv_batch.msgs[i].msg_hdr);
+			if (tx_ns > 0)
+				record_tx_ts(recv_batch.bufs[i], recv_batch.msgs[i].msg_len, tx_ns);
+		}
+
+		if (cnt < PING_BATCH_SIZE)
+			return 0;
+	}
+
+	return 0;
+}
+
+// 批量接收应答直到socket读空，返回值小于0表示socket出错
+static int on_readable()
+{
+	struct icmpdata data;
+	u16 seq;
+	int i;
+
+	while (done == 0) {
+		prepare_recv_batch();
+
+		int cnt = recvmmsg(sockfd, recv_batch.msgs, PING_BATCH_SIZE, MSG_DONTWAIT, NULL);
+		if (cnt < 0) {
+			if (errno == EINTR)
 				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
 			CPDS_LOG_ERROR("Receive ping response error - %s", strerror(errno));
-			if (++inner_fail_count >= 3) {
-				// 尝试重置socket
-				CPDS_LOG_ERROR("Try to reset socket");
-				reset_socket();
-				inner_fail_count = 0;
-				if (++outer_fail_count >= 3) {
-					CPDS_LOG_ERROR("Failed to fix socket error");
-					break;
-				}
+			return -1;
+		}
+
+		// 记录收到应答的时间
+		guint64 now_mono = clock_ns(CLOCK_MONOTONIC);
+		guint64 now_real = clock_ns(CLOCK_REALTIME);
+
+		// 按 tag 直接定位槽位，更新接收数据
+		for (i = 0; i < cnt; i++) {
+			// 数据报socket收到的应答不含IP头部
+			int tag;
+			if (sock_type == PING_SOCKET_DGRAM)
+				tag = parse_icmp(recv_batch.bufs[i], recv_batch.msgs[i].msg_len, 0, &data, &seq);
+			else
+				tag = parse_ping_pkt(recv_batch.bufs[i], recv_batch.msgs[i].msg_len, 0, &data, &seq);
+			if (tag <= 0)
 				continue;
-			} else {
+
+			guint64 rx_ns = get_kernel_ts(&recv_batch.msgs[i].msg_hdr);
+			if (rx_ns > 0)
+				observe_self_latency(self_rx_buckets, &self_rx_ns, ns_diff(now_real, rx_ns));
+
+			ping_slot_t *slot = lookup_slot(PING_TAG_INDEX(tag));
+			if (slot == NULL || atomic_load_explicit(&slot->tag, memory_order_acquire) != tag)
 				continue;
+
+			// 优先使用内核时间戳，缺少发送时间戳时用用户态发送时间。
+			// 内核时间戳基于系统时钟，系统时钟在发送后被调整或结果超过应答超时时，改用单调时钟计算
+			double rtt = -1;
+			if (rx_ns > 0 && !clock_stepped(&data, now_mono, now_real)) {
+				guint64 tx_ns = lookup_tx_ts(slot, seq);
+				if (tx_ns == 0)
+					tx_ns = ts_to_ns(&data.sendtime_real);
+				rtt = ns_diff(rx_ns, tx_ns);
+				if (rtt * 1000 > PING_REPLY_TIMEOUT_MS)
+					rtt = -1;
 			}
+			if (rtt < 0)
+				rtt = ns_diff(now_mono, ts_to_ns(&data.sendtime));
+			record_reply(slot, seq, rtt);
 		}
 
-		recv_ping(recv_buf, recv_len, &from);
+		if (cnt < PING_BATCH_SIZE)
+			return 0;
 	}
+
+	return 0;
 }
 
-static void ping_info_destroy(gpointer data)
+static void loop_thread(void *arg)
 {
-	ping_info_t *info = (ping_info_t *)data;
-	if (info) {
-		if (info->dest) {
-			g_free(info->dest);
-			info->dest = NULL;
+	struct epoll_event events[PING_MAX_EVENTS];
+	int inner_fail_count = 0;
+	int outer_fail_count = 0;
+
+	while (done == 0) {
+		int n = epoll_wait(epfd, events, PING_MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR) // EINTR表示信号中断
+				continue;
+			CPDS_LOG_ERROR("Ping epoll wait error - %s", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < n && done == 0; i++) {
+			guint64 ev_data = events[i].data.u64;
+			if (PING_EV_TAG(ev_data) > 0) {
+				on_tcp_event(ev_data);
+				continue;
+			}
+
+			int fd = PING_EV_FD(ev_data);
+			if (fd == wakefd) {
+				break;
+			} else if (fd == timerfd) {
+				on_timer();
+			} else if (fd == sockfd) {
+				// 发送时间戳在错误队列中，通过 EPOLLERR 通知
+				int ret = 0;
+				if (events[i].events & EPOLLERR)
+					ret = on_errqueue();
+				if (ret == 0 && (events[i].events & EPOLLIN))
+					ret = on_readable();
+				if (ret == 0)
+					continue;
+				if (++inner_fail_count >= 3) {
+					// 尝试重置socket
+					CPDS_LOG_ERROR("Try to reset socket");
+					reset_socket();
+					inner_fail_count = 0;
+					if (++outer_fail_count >= 3) {
+						CPDS_LOG_ERROR("Failed to fix socket error");
+						done = 1;
+					}
+				}
+			}
 		}
-		g_free(info);
+	}
+}
+
+static int init_event_loop()
+{
+	struct epoll_event ev;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		CPDS_LOG_ERROR("Failed to create epoll - %s", strerror(errno));
+		return -1;
+	}
+
+	timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timerfd < 0) {
+		CPDS_LOG_ERROR("Failed to create timerfd - %s", strerror(errno));
+		return -1;
+	}
+	struct itimerspec its = {
+	    .it_interval = {.tv_sec = 0, .tv_nsec = PING_WHEEL_TICK_MS * 1000000},
+	    .it_value = {.tv_sec = 0, .tv_nsec = PING_WHEEL_TICK_MS * 1000000},
+	};
+	if (timerfd_settime(timerfd, 0, &its, NULL) != 0) {
+		CPDS_LOG_ERROR("Failed to arm timerfd - %s", strerror(errno));
+		return -1;
+	}
+
+	wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wakefd < 0) {
+		CPDS_LOG_ERROR("Failed to create eventfd - %s", strerror(errno));
+		return -1;
+	}
+
+	ev.events = EPOLLIN;
+	ev.data.u64 = timerfd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev) != 0) {
+		CPDS_LOG_ERROR("Failed to add timerfd to epoll - %s", strerror(errno));
+		return -1;
+	}
+	ev.events = EPOLLIN;
+	ev.data.u64 = wakefd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev) != 0) {
+		CPDS_LOG_ERROR("Failed to add eventfd to epoll - %s", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+static void close_fd(int *fd)
+{
+	if (*fd >= 0) {
+		close(*fd);
+		*fd = -1;
 	}
 }
 
 int gen_ping_tag()
 {
-	static int tag = 0;
-	return ++tag;
+	pthread_mutex_lock(&lock);
+
+	ping_slot_t *slot = alloc_slot();
+	if (slot == NULL) {
+		pthread_mutex_unlock(&lock);
+		CPDS_LOG_ERROR("Failed to alloc ping slot, too many targets");
+		return 0;
+	}
+	slot->gen = slot->gen % PING_MAX_GEN + 1;
+	slot->state = PING_SLOT_ALLOCATED;
+	int tag = (slot->gen << 16) | slot->index;
+
+	pthread_mutex_unlock(&lock);
+
+	return tag;
 }
 
-int init_ping_svc()
+int init_ping_svc(const ping_svc_cfg_t *cfg)
 {
 	int ret = -1;
 
-	if (pthread_rwlock_init(&rwlock, NULL) != 0) {
-		CPDS_LOG_ERROR("Failed to init pthread rwlock");
-		return -1;
+	svc_cfg.interval_ms = PING_DEFAULT_INTERVAL_MS;
+	svc_cfg.jitter_ms = PING_DEFAULT_JITTER_MS;
+	svc_cfg.max_pps = 0;
+	svc_cfg.loss_window_cnt = 0;
+	svc_cfg.socket_type = PING_SOCKET_AUTO;
+	svc_cfg.probe_type = PING_PROBE_ICMP;
+	svc_cfg.tcp_port = PING_DEFAULT_TCP_PORT;
+	if (cfg != NULL) {
+		if (cfg->interval_ms > 0)
+			svc_cfg.interval_ms = cfg->interval_ms;
+		if (cfg->jitter_ms >= 0)
+			svc_cfg.jitter_ms = cfg->jitter_ms;
+		svc_cfg.max_pps = cfg->max_pps;
+		svc_cfg.socket_type = cfg->socket_type;
+		svc_cfg.probe_type = cfg->probe_type;
+		if (cfg->tcp_port > 0 && cfg->tcp_port <= 65535)
+			svc_cfg.tcp_port = cfg->tcp_port;
+		for (int i = 0; i < cfg->loss_window_cnt && i < PING_MAX_LOSS_WINDOWS; i++) {
+			if (cfg->loss_window_s[i] > 0)
+				svc_cfg.loss_window_s[svc_cfg.loss_window_cnt++] = cfg->loss_window_s[i];
+		}
+	}
+	if (svc_cfg.loss_window_cnt == 0) {
+		svc_cfg.loss_window_s[svc_cfg.loss_window_cnt++] = 10;
+		svc_cfg.loss_window_s[svc_cfg.loss_window_cnt++] = 60;
+	}
+
+	// 与 prom_histogram_buckets_exponential 相同的计算方式，保证区间上界完全一致
+	rtt_bounds[0] = PING_RTT_BUCKET_START;
+	for (int i = 1; i < PING_RTT_BUCKET_COUNT; i++)
+		rtt_bounds[i] = rtt_bounds[i - 1] * PING_RTT_BUCKET_FACTOR;
+	if (svc_cfg.jitter_ms > svc_cfg.interval_ms / 2)
+		svc_cfg.jitter_ms = svc_cfg.interval_ms / 2;
+
+	// 令牌桶容量取一个刻度的配额与1中的较大值，避免低速率时永远发不出包
+	if (svc_cfg.max_pps > 0) {
+		tokens_per_tick = svc_cfg.max_pps * PING_WHEEL_TICK_MS / 1000.0;
+		tokens_burst = tokens_per_tick > 1 ? tokens_per_tick : 1;
+		tokens = tokens_burst;
 	}
 
-	if (reset_socket() != 0) {
+	if (init_event_loop() != 0) {
 		return -1;
 	}
 
-	ping_map = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, ping_info_destroy);
-	
-	// 启动ping发送线程
-	ret = pthread_create(&send_thread_id, NULL, (void *)send_thread, NULL);
-	if (ret != 0) {
-		CPDS_LOG_ERROR("Failed to create ping send thread - %s", strerror(errno));
+	// TCP探测不需要ICMP socket
+	if (svc_cfg.probe_type == PING_PROBE_ICMP && reset_socket() != 0) {
 		return -1;
 	}
 
-	// 启动ping接收线程
-	ret = pthread_create(&recv_thread_id, NULL, (void *)recv_thread, NULL);
+	pthread_mutex_lock(&lock);
+	memset(&wheel, 0, sizeof(wheel));
+	wheel.start_ms = mono_ms();
+	pthread_mutex_unlock(&lock);
+
+	// 启动ping事件循环线程
+	ret = pthread_create(&loop_thread_id, NULL, (void *)loop_thread, NULL);
 	if (ret != 0) {
-		CPDS_LOG_ERROR("Failed to create ping recv thread - %s", strerror(errno));
+		CPDS_LOG_ERROR("Failed to create ping loop thread - %s", strerror(errno));
 		return -1;
 	}
 
+	if (svc_cfg.probe_type == PING_PROBE_TCP)
+		CPDS_LOG_INFO("ping svc started. probe=tcp:%d, interval=%dms, jitter=%dms, max_pps=%d", svc_cfg.tcp_port,
+		              svc_cfg.interval_ms, svc_cfg.jitter_ms, svc_cfg.max_pps);
+	else
+		CPDS_LOG_INFO("ping svc started. probe=icmp(%s), interval=%dms, jitter=%dms, max_pps=%d",
+		              sock_type == PING_SOCKET_DGRAM ? "dgram" : "raw", svc_cfg.interval_ms, svc_cfg.jitter_ms,
+		              svc_cfg.max_pps);
+
 	return 0;
 }
 
@@ -389,96 +1188,172 @@ void destroy_ping_svc()
 {
 	void *status;
 
-	if (sockfd > 0) {
-		close(sockfd);
-		sockfd = -1;
-	}
-
 	done = 1;
 
-	if (send_thread_id > 0) {
-		pthread_cancel(send_thread_id);
-		pthread_join(send_thread_id, &status);
+	if (loop_thread_id > 0) {
+		guint64 one = 1;
+		if (write(wakefd, &one, sizeof(one)) < 0)
+			CPDS_LOG_WARN("Failed to wake ping loop - %s", strerror(errno));
+		pthread_join(loop_thread_id, &status);
+		loop_thread_id = 0;
 	}
 
-	if (recv_thread_id > 0) {
-		pthread_cancel(recv_thread_id);
-		pthread_join(recv_thread_id, &status);
+	close_fd(&sockfd);
+	close_fd(&timerfd);
+	close_fd(&wakefd);
+	close_fd(&epfd);
+
+	pthread_mutex_lock(&lock);
+	for (int i = 0; i < PING_MAX_SEGMENTS; i++) {
+		ping_slot_t *segment = atomic_load_explicit(&slot_segments[i], memory_order_relaxed);
+		if (segment == NULL)
+			continue;
+		for (int j = 0; j < PING_SLOT_SEGMENT_SIZE; j++) {
+			close_tcp_probe(&segment[j]);
+			g_free(segment[j].dest);
+		}
+		atomic_store_explicit(&slot_segments[i], NULL, memory_order_release);
+		g_free(segment);
 	}
+	slot_cnt = 0;
+	free_slots = NULL;
+	memset(&wheel, 0, sizeof(wheel));
+	pthread_mutex_unlock(&lock);
+}
 
-	if (ping_map != NULL) {
-		pthread_rwlock_wrlock(&rwlock);
-		g_hash_table_destroy(ping_map);
-		ping_map = NULL;
-		pthread_rwlock_unlock(&rwlock);
+// 解析目标地址，只在注册时做一次
+static int resolve_dest(const char *dest, struct sockaddr_in *addr)
+{
+	struct addrinfo hints;
+	struct addrinfo *result = NULL;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_RAW;
+
+	int ret = getaddrinfo(dest, NULL, &hints, &result);
+	if (ret != 0 || result == NULL) {
+		CPDS_LOG_WARN("Failed to resolve ping dest - name:%s, %s", dest, gai_strerror(ret));
+		return -1;
 	}
 
-	pthread_rwlock_destroy(&rwlock);
+	memcpy(addr, result->ai_addr, sizeof(struct sockaddr_in));
+	freeaddrinfo(result);
+
+	return 0;
 }
 
 void register_ping_item(int tag, const char *dest)
 {
-	if (ping_map == NULL) {
-		CPDS_LOG_ERROR("register_ping_item ping_map NULL!!");
-		return;
-	}
+	struct sockaddr_in addr;
 
-	if (pthread_rwlock_wrlock(&rwlock) != 0)
+	if (tag <= 0 || dest == NULL)
 		return;
 
-	ping_info_t *pinfo = g_hash_table_lookup(ping_map, GINT_TO_POINTER(tag));
-	if (pinfo != NULL) {
+	// 在锁外解析地址，避免阻塞事件循环
+	int resolved = resolve_dest(dest, &addr) == 0;
+
+	pthread_mutex_lock(&lock);
+
+	ping_slot_t *slot = slot_by_tag(tag);
+	if (slot == NULL) {
+		CPDS_LOG_ERROR("register ping tag:%d not allocated", tag);
+		goto out;
+	}
+	if (slot->state != PING_SLOT_ALLOCATED) {
 		CPDS_LOG_INFO("tag:%d already registered", tag);
 		goto out;
 	}
-	ping_info_t *info = g_malloc0(sizeof(ping_info_t));
-	info->dest = g_strdup(dest);
-	g_hash_table_insert(ping_map, GINT_TO_POINTER(tag), info);
-	CPDS_LOG_DEBUG("register ping tag: %d, host: %s", tag, info->dest);
+
+	// 复用槽位前清空上一次注册的统计数据
+	atomic_store_explicit(&slot->send_cnt, 0, memory_order_relaxed);
+	atomic_store_explicit(&slot->recv_cnt, 0, memory_order_relaxed);
+	atomic_store_explicit(&slot->rtt_ns, 0, memory_order_relaxed);
+	for (int i = 0; i <= PING_RTT_BUCKET_COUNT; i++)
+		atomic_store_explicit(&slot->rtt_buckets[i], 0, memory_order_relaxed);
+	for (int i = 0; i < PING_SEQ_RING / 32; i++)
+		atomic_store_explicit(&slot->seq_bitmap[i], 0, memory_order_relaxed);
+	for (int i = 0; i < PING_TX_TS_RING; i++)
+		atomic_store_explicit(&slot->tx_seq[i], 0, memory_order_relaxed);
+
+	slot->dest = g_strdup(dest);
+	slot->addr = addr;
+	slot->resolved = resolved;
+	slot->state = PING_SLOT_ACTIVE;
+
+	// 首次发送时间在一个周期内随机打散
+	slot->due_tick = wheel.cur_tick + 1 + g_random_int_range(0, ms_to_ticks(svc_cfg.interval_ms));
+	wheel_insert(slot);
+
+	// 发布 tag 后读者才能看到该槽位
+	atomic_store_explicit(&slot->tag, tag, memory_order_release);
+	CPDS_LOG_DEBUG("register ping tag: %d, host: %s", tag, slot->dest);
 
 out:
-	pthread_rwlock_unlock(&rwlock);
+	pthread_mutex_unlock(&lock);
 }
 
 void unregister_ping_item(int tag)
 {
-	if (ping_map == NULL) {
-		CPDS_LOG_ERROR("unregister_ping_item ping_map NULL!!");
-		return;
-	}
-
-	if (pthread_rwlock_wrlock(&rwlock) != 0)
-		return;
-
-	if (g_hash_table_remove(ping_map, GINT_TO_POINTER(tag)) == TRUE) {
+	pthread_mutex_lock(&lock);
+
+	ping_slot_t *slot = slot_by_tag(tag);
+	if (slot != NULL) {
+		atomic_store_explicit(&slot->tag, 0, memory_order_release);
+		g_free(slot->dest);
+		slot->dest = NULL;
+		if (slot->state == PING_SLOT_ACTIVE) {
+			// 槽位由事件循环在出轮时回收
+			slot->state = PING_SLOT_REMOVED;
+		} else if (slot->state == PING_SLOT_ALLOCATED) {
+			release_slot(slot);
+		}
 		CPDS_LOG_DEBUG("unregister ping tag:%d", tag);
 	}
 
-	pthread_rwlock_unlock(&rwlock);
+	pthread_mutex_unlock(&lock);
 }
 
 int get_ping_info(int tag, ping_info_t *info)
 {
-	if (info == NULL)
+	if (info == NULL || tag <= 0)
 		return -1;
 
-	int ret = -1;
-
-	if (pthread_rwlock_wrlock(&rwlock) != 0)
+	ping_slot_t *slot = lookup_slot(PING_TAG_INDEX(tag));
+	if (slot == NULL || atomic_load_explicit(&slot->tag, memory_order_acquire) != tag)
 		return -1;
 
-	ping_info_t *pinfo = g_hash_table_lookup(ping_map, GINT_TO_POINTER(tag));
-	if (pinfo != NULL) {
-		info->send_cnt = pinfo->send_cnt;
-		info->recv_cnt = pinfo->recv_cnt;
-		info->rtt = pinfo->rtt;
-	} else {
-		goto out;
+	int send_cnt = atomic_load_explicit(&slot->send_cnt, memory_order_relaxed);
+	info->send_cnt = send_cnt;
+	info->recv_cnt = atomic_load_explicit(&slot->recv_cnt, memory_order_relaxed);
+	info->rtt = atomic_load_explicit(&slot->rtt_ns, memory_order_relaxed) / 1000000000.0;
+	for (int i = 0; i <= PING_RTT_BUCKET_COUNT; i++)
+		info->dist.rtt_buckets[i] = atomic_load_explicit(&slot->rtt_buckets[i], memory_order_relaxed);
+	info->dist.loss_window_cnt = svc_cfg.loss_window_cnt;
+	for (int i = 0; i < svc_cfg.loss_window_cnt; i++) {
+		info->dist.loss_window_s[i] = svc_cfg.loss_window_s[i];
+		info->dist.loss_ratio[i] = calc_loss_ratio(slot, send_cnt, svc_cfg.loss_window_s[i]);
 	}
 
-	ret = 0;
+	// 读取期间槽位被注销或复用，数据无效
+	if (atomic_load_explicit(&slot->tag, memory_order_acquire) != tag)
+		return -1;
 
-out:
-	pthread_rwlock_unlock(&rwlock);
-	return ret;
-}
\ No newline at end of file
+	return 0;
+}
+
+int get_ping_self_latency(ping_self_latency_t *lat)
+{
+	if (lat == NULL)
+		return -1;
+
+	lat->kernel_ts = kernel_ts;
+	for (int i = 0; i <= PING_RTT_BUCKET_COUNT; i++) {
+		lat->tx_buckets[i] = atomic_load_explicit(&self_tx_buckets[i], memory_order_relaxed);
+		lat->rx_buckets[i] = atomic_load_explicit(&self_rx_buckets[i], memory_order_relaxed);
+	}
+	lat->tx_sum = atomic_load_explicit(&self_tx_ns, memory_order_relaxed) / 1000000000.0;
+	lat->rx_sum = atomic_load_explicit(&self_rx_ns, memory_order_relaxed) / 1000000000.0;
+
+	return 0;
+}
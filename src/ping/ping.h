@@ -17,18 +17,66 @@
 #ifndef _PING_H_
 #define _PING_H_
 
+// RTT 直方图区间上界为 PING_RTT_BUCKET_START * PING_RTT_BUCKET_FACTOR^i (s)，i < PING_RTT_BUCKET_COUNT
+#define PING_RTT_BUCKET_START 0.0001
+#define PING_RTT_BUCKET_FACTOR 2
+#define PING_RTT_BUCKET_COUNT 16
+
+#define PING_MAX_LOSS_WINDOWS 4 // 丢包率统计窗口最大个数
+
+typedef struct _ping_dist {
+	double rtt_buckets[PING_RTT_BUCKET_COUNT + 1]; // 各区间RTT计数(非累积)，最后一项为超出上界的计数
+	int loss_window_cnt;                           // 丢包率统计窗口个数
+	int loss_window_s[PING_MAX_LOSS_WINDOWS];      // 丢包率统计窗口(s)
+	double loss_ratio[PING_MAX_LOSS_WINDOWS];      // 各窗口丢包率
+} ping_dist_t;
+
 typedef struct _ping_info {
-	char *dest;   // ping 主机名
-	int send_cnt; // 发送次数
-	int recv_cnt; // 接收次数
-	double rtt;   // 往返时间(s)
+	char *dest;       // ping 主机名
+	int send_cnt;     // 发送次数
+	int recv_cnt;     // 接收次数
+	double rtt;       // 往返时间(s)
+	ping_dist_t dist; // RTT分布和丢包率
 } ping_info_t;
 
+// 服务自身时延分布，区间与 RTT 直方图相同
+typedef struct _ping_self_latency {
+	int kernel_ts;                                // 是否使用内核时间戳，否则无自身时延数据
+	double tx_buckets[PING_RTT_BUCKET_COUNT + 1]; // 用户态发出到内核发送的时延计数(非累积)
+	double tx_sum;                                // 发送时延累计(s)
+	double rx_buckets[PING_RTT_BUCKET_COUNT + 1]; // 内核接收到用户态读取的时延计数(非累积)
+	double rx_sum;                                // 接收时延累计(s)
+} ping_self_latency_t;
+
+typedef enum _ping_socket_type {
+	PING_SOCKET_AUTO = 0, // 优先ICMP数据报socket，不可用时使用原始socket
+	PING_SOCKET_DGRAM,    // ICMP数据报socket，需 net.ipv4.ping_group_range 允许
+	PING_SOCKET_RAW,      // 原始socket，需 CAP_NET_RAW
+} ping_socket_type_t;
+
+typedef enum _ping_probe_type {
+	PING_PROBE_ICMP = 0, // ICMP echo
+	PING_PROBE_TCP,      // 向 tcp_port 发起TCP连接
+} ping_probe_type_t;
+
+typedef struct _ping_svc_cfg {
+	int interval_ms;                          // 单个目标的探测周期(ms)
+	int jitter_ms;                            // 探测周期随机抖动范围(ms)
+	int max_pps;                              // 全局发包速率上限(包/秒)，<=0 表示不限速
+	int loss_window_cnt;                      // 丢包率统计窗口个数
+	int loss_window_s[PING_MAX_LOSS_WINDOWS]; // 丢包率统计窗口(s)
+	ping_socket_type_t socket_type;           // ICMP socket类型
+	ping_probe_type_t probe_type;             // 探测方式
+	int tcp_port;                             // TCP探测端口
+} ping_svc_cfg_t;
+
+// 分配探测目标 tag，失败返回0；tag 须注销后才会被回收
 int gen_ping_tag();
-int init_ping_svc();
+int init_ping_svc(const ping_svc_cfg_t *cfg);
 void destroy_ping_svc();
 void register_ping_item(int tag, const char *dest);
 void unregister_ping_item(int tag);
 int get_ping_info(int tag, ping_info_t *info);
+int get_ping_self_latency(ping_self_latency_t *lat);
 
 #endif
\ No newline at end of file
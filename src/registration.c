@@ -16,14 +16,24 @@
 
 #include "registration.h"
 #include "collection.h"
+#include "context.h"
 #include "prom.h"
+#include "promhttp.h"
 
 #include <glib.h>
+#include <string.h>
+
+#define GROUP_NAME_SUFFIX "_group"
 
 int init_default_prometheus_registry()
 {
 	int ret = prom_collector_registry_default_init();
-	return ret;
+	if (ret != 0)
+		return ret;
+
+	if (global_ctx.max_series_total > 0)
+		prom_metric_set_global_max_series(global_ctx.max_series_total);
+	return prom_collector_registry_enable_self_metrics(PROM_COLLECTOR_REGISTRY_DEFAULT);
 }
 
 int register_metircs_to_default_registry(metric_group_list *mgroups)
@@ -33,15 +43,24 @@ int register_metircs_to_default_registry(metric_group_list *mgroups)
 	GList *giter = NULL;
 	for (giter = g_list_first(mgroups); giter != NULL; giter = g_list_next(giter)) {
 		metric_group *group = (metric_group *)giter->data;
+		// 以去掉 "_group" 后缀的组名提供 /metrics/<group> 和 /metrics?group=<group> 按组抓取
+		gchar *path_name = g_str_has_suffix(group->name, GROUP_NAME_SUFFIX)
+		                       ? g_strndup(group->name, strlen(group->name) - strlen(GROUP_NAME_SUFFIX))
+		                       : g_strdup(group->name);
 		GList *miter = NULL;
 		for (miter = g_list_first(group->metrics); miter != NULL; miter = g_list_next(miter)) {
 			prom_metric_t *metric = (prom_metric_t *)miter->data;
+			if (global_ctx.max_series_per_metric > 0)
+				prom_metric_set_max_series(metric, global_ctx.max_series_per_metric);
 			int err = prom_collector_registry_register_metric(metric);
+			if (err == 0)
+				err = promhttp_add_group_metric(path_name, prom_metric_name(metric));
 			if (err != 0) {
 				ret = -1;
 				break;
 			}
 		}
+		g_free(path_name);
 	}
 
 	return ret;
@@ -49,5 +68,6 @@ int register_metircs_to_default_registry(metric_group_list *mgroups)
 
 int destroy_default_prometheus_registry()
 {
+	promhttp_clear_groups();
 	return prom_collector_registry_default_destroy();
 }
\ No newline at end of file
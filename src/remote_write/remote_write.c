@@ -0,0 +1,627 @@
+/* 
+ *  Copyright 2023 CPDS Author
+ *  
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *       https://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License. 
+ */
+
+#include "remote_write.h"
+#include "logger.h"
+#include "prom.h"
+#include "rw_wal.h"
+#include "snappy.h"
+
+#include <curl/curl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#define RW_DEFAULT_BATCH_SIZE 2000
+#define RW_DEFAULT_FLUSH_INTERVAL_MS 15000
+#define RW_DEFAULT_SHARDS 2
+#define RW_DEFAULT_MIN_BACKOFF_MS 100
+#define RW_DEFAULT_MAX_BACKOFF_MS 30000
+#define RW_DEFAULT_TIMEOUT_MS 10000
+#define RW_DEFAULT_WAL_SIZE_MB 64
+
+#define RW_MAX_SHARDS 64
+#define RW_MIN_SHARD_WAL_SIZE (1 << 20) // 单个分片落盘缓冲最小值
+#define RW_MAX_LABELS 64                // 单个序列最多的标签数，含 __name__ 和附加标签
+#define RW_JOB_NAME "cpds-agent"        // 附加的 job 标签，对应拉取时由 Prometheus 添加的标签
+
+// 标签名和值都指向已有内存，不以0结尾
+typedef struct _rw_label {
+	const char *name;
+	gsize name_len;
+	const char *value;
+	gsize value_len;
+} rw_label_t;
+
+typedef struct _rw_shard {
+	int index;
+	pthread_t thread_id;
+	pthread_mutex_t lock;  // 保护 wal
+	pthread_cond_t cond;   // 有新批次或服务停止时通知发送线程
+	rw_wal_t *wal;
+	GByteArray *batch;     // 当前批次已编码的 TimeSeries，仅采集线程访问
+	guint32 batch_samples; // 当前批次的样本数
+	GByteArray *send_buf;  // 发送线程从 wal 读出的批次
+	CURL *curl;
+} rw_shard_t;
+
+static remote_write_cfg_t svc_cfg;
+static gchar *svc_url = NULL;
+static gchar *svc_wal_dir = NULL;
+static rw_shard_t *shards = NULL;
+static int shard_cnt = 0;
+static struct curl_slist *http_headers = NULL;
+static int curl_inited = 0;
+static char instance[256]; // 附加的 instance 标签，取主机名
+
+static pthread_t collect_thread_id = 0;
+static pthread_mutex_t collect_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t collect_cond = PTHREAD_COND_INITIALIZER; // 服务停止时通知采集线程
+static int done = 0;
+
+// 以下仅采集线程访问
+static GByteArray *scratch = NULL; // 反转义后的标签值
+static char *compress_buf = NULL;
+static gsize compress_cap = 0;
+
+static prom_counter_t *rw_samples_total = NULL; // 按结果统计的样本数: sent/dropped/rejected
+static prom_counter_t *rw_retries_total = NULL;
+static prom_gauge_t *rw_wal_used_bytes = NULL;
+
+static void count_samples(const char *result, guint64 cnt)
+{
+	if (rw_samples_total != NULL && cnt > 0)
+		prom_counter_add(rw_samples_total, cnt, (const char *[]){result});
+}
+
+static void deadline_after(struct timespec *ts, int ms)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_sec += ms / 1000;
+	ts->tv_nsec += (long)(ms % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+static gsize varint_len(guint64 v)
+{
+	gsize n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+static void put_varint(GByteArray *buf, guint64 v)
+{
+	guint8 tmp[10];
+	gsize n = 0;
+	while (v >= 0x80) {
+		tmp[n++] = (guint8)(v | 0x80);
+		v >>= 7;
+	}
+	tmp[n++] = (guint8)v;
+	g_byte_array_append(buf, tmp, n);
+}
+
+static void put_tag(GByteArray *buf, int field, int wire_type)
+{
+	guint8 tag = (guint8)(field << 3 | wire_type);
+	g_byte_array_append(buf, &tag, 1);
+}
+
+static void put_bytes(GByteArray *buf, int field, const char *data, gsize len)
+{
+	put_tag(buf, field, 2);
+	put_varint(buf, len);
+	g_byte_array_append(buf, (const guint8 *)data, len);
+}
+
+static gsize label_msg_len(const rw_label_t *label)
+{
+	return 1 + varint_len(label->name_len) + label->name_len + 1 + varint_len(label->value_len) + label->value_len;
+}
+
+// 编码一个 WriteRequest.timeseries 追加到批次，labels 已按名称排序
+// TimeSeries { repeated Label labels = 1; repeated Sample samples = 2; }
+// Label { string name = 1; string value = 2; }  Sample { double value = 1; int64 timestamp = 2; }
+static void encode_series(GByteArray *buf, const rw_label_t *labels, int cnt, double value, gint64 ts_ms)
+{
+	gsize sample_len = 1 + sizeof(double) + 1 + varint_len((guint64)ts_ms);
+	gsize series_len = 1 + varint_len(sample_len) + sample_len;
+	for (int i = 0; i < cnt; i++) {
+		gsize n = label_msg_len(&labels[i]);
+		series_len += 1 + varint_len(n) + n;
+	}
+
+	put_tag(buf, 1, 2);
+	put_varint(buf, series_len);
+	for (int i = 0; i < cnt; i++) {
+		put_tag(buf, 1, 2);
+		put_varint(buf, label_msg_len(&labels[i]));
+		put_bytes(buf, 1, labels[i].name, labels[i].name_len);
+		put_bytes(buf, 2, labels[i].value, labels[i].value_len);
+	}
+	put_tag(buf, 2, 2);
+	put_varint(buf, sample_len);
+	guint64 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bits = GUINT64_TO_LE(bits);
+	put_tag(buf, 1, 1);
+	g_byte_array_append(buf, (const guint8 *)&bits, sizeof(bits));
+	put_tag(buf, 2, 0);
+	put_varint(buf, (guint64)ts_ms);
+}
+
+static int label_compare(const void *a, const void *b)
+{
+	const rw_label_t *la = a;
+	const rw_label_t *lb = b;
+	int r = memcmp(la->name, lb->name, MIN(la->name_len, lb->name_len));
+	if (r != 0)
+		return r;
+	return la->name_len < lb->name_len ? -1 : la->name_len > lb->name_len;
+}
+
+static int has_label(const rw_label_t *labels, int cnt, const char *name)
+{
+	gsize len = strlen(name);
+	for (int i = 0; i < cnt; i++) {
+		if (labels[i].name_len == len && memcmp(labels[i].name, name, len) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+// 解析一行文本格式的样本 name{k="v",...} value，标签值反转义到 scratch
+// 返回标签数(含 __name__)，格式错误返回-1；key_len 为值之前的序列标识长度
+static int parse_sample(const char *line, gsize len, rw_label_t *labels, int max, double *value, gsize *key_len)
+{
+	const char *p = line;
+	const char *end = line + len;
+	guint8 *out = scratch->data;
+	int cnt = 0;
+
+	while (p < end && *p != '{' && *p != ' ')
+		p++;
+	if (p == line || p == end)
+		return -1;
+	labels[cnt++] = (rw_label_t){"__name__", strlen("__name__"), line, p - line};
+
+	if (*p == '{') {
+		p++;
+		while (p < end && *p != '}') {
+			const char *key = p;
+			while (p < end && *p != '=')
+				p++;
+			if (p + 1 >= end || p[1] != '"' || cnt >= max)
+				return -1;
+			rw_label_t *label = &labels[cnt++];
+			label->name = key;
+			label->name_len = p - key;
+			label->value = (const char *)out;
+			for (p += 2; p < end && *p != '"'; p++) {
+				if (*p == '\\' && p + 1 < end) {
+					p++;
+					*out++ = *p == 'n' ? '\n' : *p;
+				} else {
+					*out++ = *p;
+				}
+			}
+			if (p == end)
+				return -1;
+			label->value_len = (const char *)out - label->value;
+			p++;
+			if (p < end && *p == ',')
+				p++;
+		}
+		if (p == end)
+			return -1;
+		p++;
+	}
+
+	*key_len = p - line;
+	if (p == end || *p != ' ')
+		return -1;
+	p++;
+	// 行尾之后总有换行符或字符串结束符，不会读越界
+	char *num_end = NULL;
+	*value = g_ascii_strtod(p, &num_end);
+	if (num_end == p)
+		return -1;
+	return cnt;
+}
+
+// 压缩当前批次写入落盘缓冲，通知发送线程
+static void seal_batch(rw_shard_t *shard)
+{
+	if (shard->batch_samples == 0)
+		return;
+
+	gsize max = snappy_max_compressed_length(shard->batch->len);
+	if (compress_cap < max) {
+		compress_buf = g_realloc(compress_buf, max);
+		compress_cap = max;
+	}
+	gsize len = snappy_compress((const char *)shard->batch->data, shard->batch->len, compress_buf);
+
+	guint64 dropped = 0;
+	pthread_mutex_lock(&shard->lock);
+	int ret = rw_wal_append(shard->wal, compress_buf, len, shard->batch_samples, &dropped);
+	pthread_cond_signal(&shard->cond);
+	pthread_mutex_unlock(&shard->lock);
+
+	if (ret != 0) {
+		CPDS_LOG_WARN("remote write batch of %lu bytes exceeds WAL of shard %d, dropped", len, shard->index);
+		dropped += shard->batch_samples;
+	}
+	count_samples("dropped", dropped);
+
+	g_byte_array_set_size(shard->batch, 0);
+	shard->batch_samples = 0;
+}
+
+static void add_sample(const char *line, gsize len, gint64 ts_ms)
+{
+	rw_label_t labels[RW_MAX_LABELS];
+	double value = 0;
+	gsize key_len = 0;
+
+	int cnt = parse_sample(line, len, labels, RW_MAX_LABELS - 2, &value, &key_len);
+	if (cnt < 0) {
+		CPDS_LOG_DEBUG("remote write skips unparsable line %.*s", (int)len, line);
+		return;
+	}
+	if (!has_label(labels, cnt, "job"))
+		labels[cnt++] = (rw_label_t){"job", strlen("job"), RW_JOB_NAME, strlen(RW_JOB_NAME)};
+	if (!has_label(labels, cnt, "instance"))
+		labels[cnt++] = (rw_label_t){"instance", strlen("instance"), instance, strlen(instance)};
+	qsort(labels, cnt, sizeof(rw_label_t), label_compare);
+
+	// 按序列标识分片，同一序列的样本总由同一分片按顺序发送
+	guint32 hash = 2166136261u;
+	for (gsize i = 0; i < key_len; i++)
+		hash = (hash ^ (guint8)line[i]) * 16777619u;
+	rw_shard_t *shard = &shards[hash % shard_cnt];
+
+	encode_series(shard->batch, labels, cnt, value, ts_ms);
+	if (++shard->batch_samples >= (guint32)svc_cfg.batch_size)
+		seal_batch(shard);
+}
+
+static void add_text(const char *text, gsize len, gint64 ts_ms)
+{
+	if (scratch->len < len)
+		g_byte_array_set_size(scratch, len);
+
+	const char *p = text;
+	const char *end = text + len;
+	while (p < end) {
+		const char *nl = memchr(p, '\n', end - p);
+		gsize line_len = nl != NULL ? (gsize)(nl - p) : (gsize)(end - p);
+		if (line_len > 0 && *p != '#')
+			add_sample(p, line_len, ts_ms);
+		p += line_len + 1;
+	}
+}
+
+// 读取 registry 的全部样本，按分片打包，周期结束时提交所有未满的批次
+static void collect_once()
+{
+	gint64 ts_ms = g_get_real_time() / 1000;
+	const char *text = NULL;
+	size_t len = 0;
+	int ret = 0;
+
+	prom_collector_registry_stream_t *stream = prom_collector_registry_stream_new(PROM_COLLECTOR_REGISTRY_DEFAULT);
+	if (stream == NULL) {
+		CPDS_LOG_ERROR("Failed to create registry stream for remote write");
+		return;
+	}
+	// 每段都是完整的若干个指标，不会截断行
+	while ((ret = prom_collector_registry_stream_next(stream, &text, &len, NULL)) > 0)
+		add_text(text, len, ts_ms);
+	if (ret < 0)
+		CPDS_LOG_ERROR("Failed to read registry for remote write");
+	prom_collector_registry_stream_destroy(stream);
+
+	guint64 used = 0;
+	for (int i = 0; i < shard_cnt; i++) {
+		seal_batch(&shards[i]);
+		pthread_mutex_lock(&shards[i].lock);
+		used += rw_wal_used(shards[i].wal);
+		pthread_mutex_unlock(&shards[i].lock);
+	}
+	if (rw_wal_used_bytes != NULL)
+		prom_gauge_set(rw_wal_used_bytes, used, NULL);
+}
+
+static void collect_thread(void *arg)
+{
+	pthread_mutex_lock(&collect_lock);
+	while (done == 0) {
+		struct timespec deadline;
+		deadline_after(&deadline, svc_cfg.flush_interval_ms);
+		while (done == 0 && pthread_cond_timedwait(&collect_cond, &collect_lock, &deadline) != ETIMEDOUT)
+			;
+		if (done != 0)
+			break;
+		pthread_mutex_unlock(&collect_lock);
+		collect_once();
+		pthread_mutex_lock(&collect_lock);
+	}
+	pthread_mutex_unlock(&collect_lock);
+}
+
+static size_t discard_response(void *ptr, size_t size, size_t nmemb, void *data)
+{
+	return size * nmemb;
+}
+
+// 推送发送缓冲中的批次，返回 HTTP 状态码，请求失败返回-1
+static long post_batch(rw_shard_t *shard)
+{
+	curl_easy_setopt(shard->curl, CURLOPT_POSTFIELDS, shard->send_buf->data);
+	curl_easy_setopt(shard->curl, CURLOPT_POSTFIELDSIZE, (long)shard->send_buf->len);
+	CURLcode res = curl_easy_perform(shard->curl);
+	if (res != CURLE_OK) {
+		CPDS_LOG_DEBUG("remote write shard %d request fail - %s", shard->index, curl_easy_strerror(res));
+		return -1;
+	}
+	long status = 0;
+	curl_easy_getinfo(shard->curl, CURLINFO_RESPONSE_CODE, &status);
+	return status;
+}
+
+// 等待 ms 毫秒，服务停止时提前返回
+static void backoff_wait(rw_shard_t *shard, int ms)
+{
+	struct timespec deadline;
+	deadline_after(&deadline, ms);
+	pthread_mutex_lock(&shard->lock);
+	while (done == 0 && pthread_cond_timedwait(&shard->cond, &shard->lock, &deadline) != ETIMEDOUT)
+		;
+	pthread_mutex_unlock(&shard->lock);
+}
+
+static void send_thread(void *arg)
+{
+	rw_shard_t *shard = (rw_shard_t *)arg;
+	int backoff = svc_cfg.min_backoff_ms;
+
+	for (;;) {
+		guint32 samples = 0;
+		guint64 pos = 0;
+		pthread_mutex_lock(&shard->lock);
+		while (done == 0 && rw_wal_peek(shard->wal, shard->send_buf, &samples, &pos) == 0)
+			pthread_cond_wait(&shard->cond, &shard->lock);
+		pthread_mutex_unlock(&shard->lock);
+		if (done != 0)
+			break;
+
+		// 2xx 成功；429 以外的 4xx 重试也不会成功，丢弃该批次；其余情况退避后重试
+		long status = post_batch(shard);
+		if ((status >= 200 && status < 300) || (status >= 400 && status < 500 && status != 429)) {
+			if (status >= 400)
+				CPDS_LOG_WARN("remote write shard %d rejected with %ld, %u samples dropped", shard->index, status,
+				              samples);
+			// 发送期间批次可能已被新批次挤出落盘缓冲并计入 dropped，此时不再重复计数
+			pthread_mutex_lock(&shard->lock);
+			int committed = rw_wal_commit(shard->wal, pos);
+			pthread_mutex_unlock(&shard->lock);
+			if (committed)
+				count_samples(status >= 400 ? "rejected" : "sent", samples);
+			backoff = svc_cfg.min_backoff_ms;
+			continue;
+		}
+
+		if (backoff == svc_cfg.min_backoff_ms)
+			CPDS_LOG_WARN("remote write shard %d failed with %ld, retrying", shard->index, status);
+		if (rw_retries_total != NULL)
+			prom_counter_inc(rw_retries_total, NULL);
+		// 在 [backoff/2, backoff] 内随机等待，避免各分片同时重试
+		backoff_wait(shard, g_random_int_range(backoff / 2, backoff + 1));
+		backoff = MIN(backoff * 2, svc_cfg.max_backoff_ms);
+	}
+}
+
+static int register_self_metrics()
+{
+	const char *labels[] = {"result"};
+	rw_samples_total = prom_counter_new("cpds_remote_write_samples_total",
+	                                    "samples pushed by remote write, by result: sent, dropped or rejected", 1,
+	                                    labels);
+	rw_retries_total = prom_counter_new("cpds_remote_write_retries_total", "remote write requests retried", 0, NULL);
+	rw_wal_used_bytes = prom_gauge_new("cpds_remote_write_wal_used_bytes", "bytes of batches waiting in the WAL", 0,
+	                                   NULL);
+	if (prom_collector_registry_register_metric(rw_samples_total) != 0 ||
+	    prom_collector_registry_register_metric(rw_retries_total) != 0 ||
+	    prom_collector_registry_register_metric(rw_wal_used_bytes) != 0) {
+		CPDS_LOG_ERROR("Failed to register remote write metrics");
+		return -1;
+	}
+	return 0;
+}
+
+static int init_shard(rw_shard_t *shard, int index, guint64 wal_size)
+{
+	shard->index = index;
+	pthread_mutex_init(&shard->lock, NULL);
+	pthread_cond_init(&shard->cond, NULL);
+	shard->batch = g_byte_array_new();
+	shard->send_buf = g_byte_array_new();
+
+	gchar *path = g_strdup_printf("%s/shard-%d.wal", svc_wal_dir, index);
+	shard->wal = rw_wal_open(path, wal_size);
+	g_free(path);
+	if (shard->wal == NULL)
+		return -1;
+
+	shard->curl = curl_easy_init();
+	if (shard->curl == NULL) {
+		CPDS_LOG_ERROR("Init curl fail");
+		return -1;
+	}
+	curl_easy_setopt(shard->curl, CURLOPT_URL, svc_url);
+	curl_easy_setopt(shard->curl, CURLOPT_POST, 1L);
+	curl_easy_setopt(shard->curl, CURLOPT_HTTPHEADER, http_headers);
+	curl_easy_setopt(shard->curl, CURLOPT_TIMEOUT_MS, (long)svc_cfg.timeout_ms);
+	curl_easy_setopt(shard->curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(shard->curl, CURLOPT_WRITEFUNCTION, discard_response);
+
+	if (pthread_create(&shard->thread_id, NULL, (void *)send_thread, shard) != 0) {
+		shard->thread_id = 0;
+		CPDS_LOG_ERROR("Failed to create remote write thread - %s", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+int init_remote_write(const remote_write_cfg_t *cfg)
+{
+	if (cfg == NULL || cfg->url == NULL || cfg->url[0] == '\0' || cfg->wal_dir == NULL) {
+		CPDS_LOG_ERROR("remote write url or wal dir not set");
+		return -1;
+	}
+
+	svc_cfg = *cfg;
+	svc_url = g_strdup(cfg->url);
+	svc_wal_dir = g_strdup(cfg->wal_dir);
+	if (svc_cfg.batch_size <= 0)
+		svc_cfg.batch_size = RW_DEFAULT_BATCH_SIZE;
+	if (svc_cfg.flush_interval_ms <= 0)
+		svc_cfg.flush_interval_ms = RW_DEFAULT_FLUSH_INTERVAL_MS;
+	if (svc_cfg.shards <= 0 || svc_cfg.shards > RW_MAX_SHARDS)
+		svc_cfg.shards = RW_DEFAULT_SHARDS;
+	if (svc_cfg.min_backoff_ms <= 0)
+		svc_cfg.min_backoff_ms = RW_DEFAULT_MIN_BACKOFF_MS;
+	if (svc_cfg.max_backoff_ms < svc_cfg.min_backoff_ms)
+		svc_cfg.max_backoff_ms = MAX(RW_DEFAULT_MAX_BACKOFF_MS, svc_cfg.min_backoff_ms);
+	if (svc_cfg.timeout_ms <= 0)
+		svc_cfg.timeout_ms = RW_DEFAULT_TIMEOUT_MS;
+	if (svc_cfg.wal_size_mb <= 0)
+		svc_cfg.wal_size_mb = RW_DEFAULT_WAL_SIZE_MB;
+	done = 0;
+
+	if (gethostname(instance, sizeof(instance) - 1) != 0)
+		g_strlcpy(instance, "localhost", sizeof(instance));
+
+	if (g_mkdir_with_parents(svc_wal_dir, 0700) != 0) {
+		CPDS_LOG_ERROR("Failed to create remote write wal dir %s - %s", svc_wal_dir, strerror(errno));
+		goto err;
+	}
+	if (register_self_metrics() != 0)
+		goto err;
+
+	curl_global_init(CURL_GLOBAL_ALL);
+	curl_inited = 1;
+	http_headers = curl_slist_append(http_headers, "Content-Encoding: snappy");
+	http_headers = curl_slist_append(http_headers, "Content-Type: application/x-protobuf");
+	http_headers = curl_slist_append(http_headers, "User-Agent: cpds-agent/" CPDS_AGENT_VERSION);
+	http_headers = curl_slist_append(http_headers, "X-Prometheus-Remote-Write-Version: 0.1.0");
+
+	scratch = g_byte_array_new();
+	shards = g_malloc0(sizeof(rw_shard_t) * svc_cfg.shards);
+	guint64 wal_size = MAX(((guint64)svc_cfg.wal_size_mb << 20) / svc_cfg.shards, RW_MIN_SHARD_WAL_SIZE);
+	for (shard_cnt = 0; shard_cnt < svc_cfg.shards;) {
+		// 先计数，初始化失败时由 destroy_remote_write 清理该分片
+		rw_shard_t *shard = &shards[shard_cnt++];
+		if (init_shard(shard, shard_cnt - 1, wal_size) != 0)
+			goto err;
+	}
+
+	if (pthread_create(&collect_thread_id, NULL, (void *)collect_thread, NULL) != 0) {
+		collect_thread_id = 0;
+		CPDS_LOG_ERROR("Failed to create remote write collect thread - %s", strerror(errno));
+		goto err;
+	}
+
+	CPDS_LOG_INFO("remote write started. url=%s, shards=%d, batch=%d, interval=%dms, wal=%dMB", svc_url,
+	              svc_cfg.shards, svc_cfg.batch_size, svc_cfg.flush_interval_ms, svc_cfg.wal_size_mb);
+	return 0;
+
+err:
+	destroy_remote_write();
+	return -1;
+}
+
+void destroy_remote_write()
+{
+	void *status;
+
+	pthread_mutex_lock(&collect_lock);
+	done = 1;
+	pthread_cond_broadcast(&collect_cond);
+	pthread_mutex_unlock(&collect_lock);
+	if (collect_thread_id > 0) {
+		pthread_join(collect_thread_id, &status);
+		collect_thread_id = 0;
+	}
+
+	for (int i = 0; i < shard_cnt; i++) {
+		pthread_mutex_lock(&shards[i].lock);
+		pthread_cond_broadcast(&shards[i].cond);
+		pthread_mutex_unlock(&shards[i].lock);
+	}
+	for (int i = 0; i < shard_cnt; i++) {
+		rw_shard_t *shard = &shards[i];
+		if (shard->thread_id > 0)
+			pthread_join(shard->thread_id, &status);
+		rw_wal_close(shard->wal);
+		if (shard->curl != NULL)
+			curl_easy_cleanup(shard->curl);
+		g_byte_array_free(shard->batch, TRUE);
+		g_byte_array_free(shard->send_buf, TRUE);
+		pthread_mutex_destroy(&shard->lock);
+		pthread_cond_destroy(&shard->cond);
+	}
+	g_free(shards);
+	shards = NULL;
+	shard_cnt = 0;
+
+	if (http_headers != NULL) {
+		curl_slist_free_all(http_headers);
+		http_headers = NULL;
+	}
+	if (curl_inited) {
+		curl_global_cleanup();
+		curl_inited = 0;
+	}
+	if (scratch != NULL) {
+		g_byte_array_free(scratch, TRUE);
+		scratch = NULL;
+	}
+	g_free(compress_buf);
+	compress_buf = NULL;
+	compress_cap = 0;
+	g_free(svc_url);
+	svc_url = NULL;
+	g_free(svc_wal_dir);
+	svc_wal_dir = NULL;
+
+	// 指标由 registry 持有并释放
+	rw_samples_total = NULL;
+	rw_retries_total = NULL;
+	rw_wal_used_bytes = NULL;
+}
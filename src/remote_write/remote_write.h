@@ -0,0 +1,39 @@
+/* 
+ *  Copyright 2023 CPDS Author
+ *  
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *       https://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License. 
+ */
+
+#ifndef _REMOTE_WRITE_H_
+#define _REMOTE_WRITE_H_
+
+// Prometheus remote write 推送：周期读取默认 registry 的全部指标，按序列哈希分片，
+// 每个分片把样本打包成 snappy 压缩的 WriteRequest，先写入落盘缓冲再由分片发送线程推送
+
+typedef struct _remote_write_cfg {
+	const char *url;       // 接收端地址，如 http://host:9090/api/v1/write
+	int batch_size;        // 单个请求最多携带的样本数
+	int flush_interval_ms; // 读取指标并提交批次的周期(ms)
+	int shards;            // 并行发送的分片数，同一序列总在同一分片，保证发送顺序
+	int min_backoff_ms;    // 失败重试的初始退避时间(ms)
+	int max_backoff_ms;    // 退避时间上限(ms)
+	int timeout_ms;        // 单个请求的超时时间(ms)
+	const char *wal_dir;   // 落盘缓冲目录
+	int wal_size_mb;       // 落盘缓冲总大小(MB)，平分给各分片，写满后丢弃最旧的批次
+} remote_write_cfg_t;
+
+// 启动推送并向默认 registry 注册 cpds_remote_write_* 指标，须在 http 服务启动前调用
+int init_remote_write(const remote_write_cfg_t *cfg);
+void destroy_remote_write();
+
+#endif
@@ -0,0 +1,216 @@
+/* 
+ *  Copyright 2023 CPDS Author
+ *  
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *       https://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License. 
+ */
+
+#include "rw_wal.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define RW_WAL_MAGIC 0x4c415752   // "RWAL"
+#define RW_WAL_VERSION 1
+#define RW_WAL_HEADER_SIZE 4096   // 文件头占一页，数据区随后
+#define RW_WAL_ALIGN 16           // 记录按该长度对齐，环尾剩余空间总能放下记录头
+#define RW_WAL_FLAG_PAD 1         // 填充到环尾的空记录
+
+#define RW_WAL_ALIGNED(n) (((n) + RW_WAL_ALIGN - 1) & ~(guint64)(RW_WAL_ALIGN - 1))
+
+// 文件头，位置均为单调递增的逻辑偏移，对数据区大小取模得到实际位置
+typedef struct _rw_wal_header {
+	guint32 magic;
+	guint32 version;
+	guint64 size; // 数据区大小
+	guint64 head; // 下一个记录写入位置
+	guint64 tail; // 最旧记录位置
+} rw_wal_header_t;
+
+typedef struct _rw_wal_record {
+	guint32 len;     // 数据长度，不含记录头
+	guint32 crc;     // 数据的 crc32
+	guint32 samples; // 批次中的样本数
+	guint32 flags;
+} rw_wal_record_t;
+
+struct _rw_wal {
+	int fd;
+	guint8 *map;
+	gsize map_len;
+	rw_wal_header_t *hdr;
+	guint8 *data;
+};
+
+rw_wal_t *rw_wal_open(const char *path, guint64 size)
+{
+	size = size / RW_WAL_ALIGN * RW_WAL_ALIGN;
+	if (size < RW_WAL_ALIGN * 2) {
+		CPDS_LOG_ERROR("WAL size %lu too small", size);
+		return NULL;
+	}
+
+	rw_wal_t *wal = g_malloc0(sizeof(rw_wal_t));
+	wal->map_len = RW_WAL_HEADER_SIZE + size;
+	wal->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (wal->fd < 0) {
+		CPDS_LOG_ERROR("Failed to open WAL %s - %s", path, strerror(errno));
+		goto err;
+	}
+	if (ftruncate(wal->fd, wal->map_len) != 0) {
+		CPDS_LOG_ERROR("Failed to resize WAL %s - %s", path, strerror(errno));
+		goto err;
+	}
+	wal->map = mmap(NULL, wal->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, wal->fd, 0);
+	if (wal->map == MAP_FAILED) {
+		wal->map = NULL;
+		CPDS_LOG_ERROR("Failed to map WAL %s - %s", path, strerror(errno));
+		goto err;
+	}
+	wal->hdr = (rw_wal_header_t *)wal->map;
+	wal->data = wal->map + RW_WAL_HEADER_SIZE;
+
+	rw_wal_header_t *hdr = wal->hdr;
+	if (hdr->magic != RW_WAL_MAGIC || hdr->version != RW_WAL_VERSION || hdr->size != size || hdr->tail > hdr->head ||
+	    hdr->head - hdr->tail > size || hdr->tail % RW_WAL_ALIGN != 0 || hdr->head % RW_WAL_ALIGN != 0) {
+		if (hdr->magic == RW_WAL_MAGIC)
+			CPDS_LOG_WARN("Discard WAL %s of another size or damaged", path);
+		hdr->magic = RW_WAL_MAGIC;
+		hdr->version = RW_WAL_VERSION;
+		hdr->size = size;
+		hdr->head = 0;
+		hdr->tail = 0;
+	} else if (hdr->head != hdr->tail) {
+		CPDS_LOG_INFO("Resume WAL %s with %lu bytes pending", path, hdr->head - hdr->tail);
+	}
+	return wal;
+
+err:
+	rw_wal_close(wal);
+	return NULL;
+}
+
+void rw_wal_close(rw_wal_t *wal)
+{
+	if (wal == NULL)
+		return;
+	if (wal->map != NULL) {
+		msync(wal->map, wal->map_len, MS_SYNC);
+		munmap(wal->map, wal->map_len);
+	}
+	if (wal->fd >= 0)
+		close(wal->fd);
+	g_free(wal);
+}
+
+static rw_wal_record_t *record_at(rw_wal_t *wal, guint64 pos)
+{
+	return (rw_wal_record_t *)(wal->data + pos % wal->hdr->size);
+}
+
+// 记录(含填充)占用的空间
+static guint64 record_span(rw_wal_t *wal, guint64 pos)
+{
+	rw_wal_record_t *rec = record_at(wal, pos);
+	if (rec->flags & RW_WAL_FLAG_PAD)
+		return wal->hdr->size - pos % wal->hdr->size;
+	return RW_WAL_ALIGNED(sizeof(rw_wal_record_t) + rec->len);
+}
+
+int rw_wal_append(rw_wal_t *wal, const void *data, guint32 len, guint32 samples, guint64 *dropped)
+{
+	rw_wal_header_t *hdr = wal->hdr;
+	guint64 need = RW_WAL_ALIGNED(sizeof(rw_wal_record_t) + len);
+	if (need > hdr->size)
+		return -1;
+
+	// 记录不跨越环尾，放不下时用填充记录跳到环首
+	guint64 pad = 0;
+	for (;;) {
+		if (hdr->head == hdr->tail && hdr->head % hdr->size != 0) {
+			// 为空时跳到下一圈环首，保证不超过数据区的记录总能放下；位置单调递增，已读出的位置不会被复用
+			hdr->head = hdr->tail = (hdr->head / hdr->size + 1) * hdr->size;
+		}
+		guint64 room = hdr->size - hdr->head % hdr->size;
+		pad = room < need ? room : 0;
+		if (hdr->size - (hdr->head - hdr->tail) >= pad + need)
+			break;
+		rw_wal_record_t *oldest = record_at(wal, hdr->tail);
+		if (!(oldest->flags & RW_WAL_FLAG_PAD))
+			*dropped += oldest->samples;
+		hdr->tail += record_span(wal, hdr->tail);
+	}
+
+	if (pad > 0) {
+		rw_wal_record_t *rec = record_at(wal, hdr->head);
+		rec->len = 0;
+		rec->crc = 0;
+		rec->samples = 0;
+		rec->flags = RW_WAL_FLAG_PAD;
+		hdr->head += pad;
+	}
+	rw_wal_record_t *rec = record_at(wal, hdr->head);
+	memcpy(rec + 1, data, len);
+	rec->len = len;
+	rec->crc = crc32(0, data, len);
+	rec->samples = samples;
+	rec->flags = 0;
+	// 数据写完后再移动写入位置，进程异常退出时不会留下半条记录
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	hdr->head += need;
+	return 0;
+}
+
+int rw_wal_peek(rw_wal_t *wal, GByteArray *buf, guint32 *samples, guint64 *pos)
+{
+	rw_wal_header_t *hdr = wal->hdr;
+	while (hdr->tail != hdr->head) {
+		rw_wal_record_t *rec = record_at(wal, hdr->tail);
+		if (rec->flags & RW_WAL_FLAG_PAD) {
+			hdr->tail += record_span(wal, hdr->tail);
+			continue;
+		}
+		guint64 room = hdr->size - hdr->tail % hdr->size;
+		if (sizeof(rw_wal_record_t) + (guint64)rec->len > room ||
+		    crc32(0, (const Bytef *)(rec + 1), rec->len) != rec->crc) {
+			CPDS_LOG_ERROR("WAL record damaged, discard %lu bytes", hdr->head - hdr->tail);
+			hdr->tail = hdr->head;
+			return 0;
+		}
+		g_byte_array_set_size(buf, 0);
+		g_byte_array_append(buf, (const guint8 *)(rec + 1), rec->len);
+		*samples = rec->samples;
+		*pos = hdr->tail;
+		return 1;
+	}
+	return 0;
+}
+
+int rw_wal_commit(rw_wal_t *wal, guint64 pos)
+{
+	// 位置单调递增，tail 已越过 pos 说明该批次被 rw_wal_append 丢弃并计入了 dropped
+	if (wal->hdr->tail != pos || pos == wal->hdr->head)
+		return 0;
+	wal->hdr->tail += record_span(wal, pos);
+	return 1;
+}
+
+guint64 rw_wal_used(rw_wal_t *wal)
+{
+	return wal->hdr->head - wal->hdr->tail;
+}
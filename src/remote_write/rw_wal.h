@@ -0,0 +1,38 @@
+/* 
+ *  Copyright 2023 CPDS Author
+ *  
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *       https://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License. 
+ */
+
+#ifndef _RW_WAL_H_
+#define _RW_WAL_H_
+
+#include <glib.h>
+
+// remote write 待发送批次的落盘环形缓冲，文件 mmap 到内存，写满后丢弃最旧的批次
+// 进程重启后从上次未发送成功的批次继续发送。所有接口由调用者加锁
+typedef struct _rw_wal rw_wal_t;
+
+// 打开或创建 path，数据区 size 字节；已有文件大小不符或内容损坏时清空
+rw_wal_t *rw_wal_open(const char *path, guint64 size);
+void rw_wal_close(rw_wal_t *wal);
+// 追加一个批次，空间不足时丢弃最旧的批次，其样本数累加到 dropped；批次大于数据区时返回-1
+int rw_wal_append(rw_wal_t *wal, const void *data, guint32 len, guint32 samples, guint64 *dropped);
+// 读取最旧的批次到 buf 但不移除，返回1；为空时返回0。pos 用于 rw_wal_commit
+int rw_wal_peek(rw_wal_t *wal, GByteArray *buf, guint32 *samples, guint64 *pos);
+// 移除 rw_wal_peek 读出的批次，返回1；批次已被 rw_wal_append 丢弃(已计入 dropped)时返回0
+int rw_wal_commit(rw_wal_t *wal, guint64 pos);
+// 已用空间(字节)
+guint64 rw_wal_used(rw_wal_t *wal);
+
+#endif
@@ -0,0 +1,142 @@
+/* 
+ *  Copyright 2023 CPDS Author
+ *  
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *       https://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License. 
+ */
+
+#include "snappy.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define SNAPPY_BLOCK_SIZE 65536 // 按块压缩，块内偏移可用2字节表示
+#define SNAPPY_HASH_BITS 14     // 匹配查找哈希表大小
+#define SNAPPY_MIN_INPUT 16     // 短于该长度的块直接作为字面量
+
+static inline uint32_t load32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t hash32(uint32_t v)
+{
+	return (v * 0x1e35a7bd) >> (32 - SNAPPY_HASH_BITS);
+}
+
+static uint8_t *emit_varint(uint8_t *dst, size_t v)
+{
+	while (v >= 0x80) {
+		*dst++ = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	*dst++ = (uint8_t)v;
+	return dst;
+}
+
+static uint8_t *emit_literal(uint8_t *dst, const uint8_t *lit, size_t len)
+{
+	// 长度减1小于60时直接放在标记字节中，否则标记字节后跟1~4字节小端长度
+	size_t n = len - 1;
+	if (n < 60) {
+		*dst++ = (uint8_t)(n << 2);
+	} else {
+		int bytes = n < (1 << 8) ? 1 : n < (1 << 16) ? 2 : n < (1 << 24) ? 3 : 4;
+		*dst++ = (uint8_t)((59 + bytes) << 2);
+		for (int i = 0; i < bytes; i++)
+			*dst++ = (uint8_t)(n >> (8 * i));
+	}
+	memcpy(dst, lit, len);
+	return dst + len;
+}
+
+// 输出一个长度4~64的复制元素
+static uint8_t *emit_copy_upto64(uint8_t *dst, size_t offset, size_t len)
+{
+	if (len < 12 && offset < 2048) {
+		*dst++ = (uint8_t)(1 | ((len - 4) << 2) | ((offset >> 8) << 5));
+		*dst++ = (uint8_t)offset;
+	} else {
+		*dst++ = (uint8_t)(2 | ((len - 1) << 2));
+		*dst++ = (uint8_t)offset;
+		*dst++ = (uint8_t)(offset >> 8);
+	}
+	return dst;
+}
+
+static uint8_t *emit_copy(uint8_t *dst, size_t offset, size_t len)
+{
+	// 与参考实现相同的拆分方式，保证最后一段不短于4字节
+	while (len >= 68) {
+		dst = emit_copy_upto64(dst, offset, 64);
+		len -= 64;
+	}
+	if (len > 64) {
+		dst = emit_copy_upto64(dst, offset, 60);
+		len -= 60;
+	}
+	return emit_copy_upto64(dst, offset, len);
+}
+
+// 压缩一个不超过 SNAPPY_BLOCK_SIZE 的块，匹配只在块内查找
+static uint8_t *compress_block(const uint8_t *src, size_t len, uint8_t *dst, uint16_t *table)
+{
+	const uint8_t *ip = src;
+	const uint8_t *end = src + len;
+	const uint8_t *lit = src; // 尚未输出的字面量起点
+
+	if (len >= SNAPPY_MIN_INPUT) {
+		memset(table, 0, sizeof(uint16_t) << SNAPPY_HASH_BITS);
+		const uint8_t *limit = end - 4;
+		while (ip <= limit) {
+			uint32_t cur = load32(ip);
+			uint32_t h = hash32(cur);
+			const uint8_t *cand = src + table[h];
+			table[h] = (uint16_t)(ip - src);
+			if (cand >= ip || load32(cand) != cur) {
+				ip++;
+				continue;
+			}
+
+			size_t match = 4;
+			while (ip + match < end && cand[match] == ip[match])
+				match++;
+			if (ip > lit)
+				dst = emit_literal(dst, lit, ip - lit);
+			dst = emit_copy(dst, ip - cand, match);
+			ip += match;
+			lit = ip;
+		}
+	}
+	if (lit < end)
+		dst = emit_literal(dst, lit, end - lit);
+	return dst;
+}
+
+size_t snappy_max_compressed_length(size_t len)
+{
+	return 32 + len + len / 6;
+}
+
+size_t snappy_compress(const char *src, size_t len, char *dst)
+{
+	uint16_t table[1 << SNAPPY_HASH_BITS];
+	uint8_t *op = emit_varint((uint8_t *)dst, len);
+
+	for (size_t pos = 0; pos < len; pos += SNAPPY_BLOCK_SIZE) {
+		size_t n = len - pos < SNAPPY_BLOCK_SIZE ? len - pos : SNAPPY_BLOCK_SIZE;
+		op = compress_block((const uint8_t *)src + pos, n, op, table);
+	}
+	return op - (uint8_t *)dst;
+}
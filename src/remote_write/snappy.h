@@ -0,0 +1,30 @@
+/* 
+ *  Copyright 2023 CPDS Author
+ *  
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  
+ *       https://www.apache.org/licenses/LICENSE-2.0
+ *  
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License. 
+ */
+
+#ifndef _SNAPPY_H_
+#define _SNAPPY_H_
+
+#include <stddef.h>
+
+// snappy 块格式压缩，remote write 请求体使用该格式
+// 格式说明: https://github.com/google/snappy/blob/main/format_description.txt
+
+// 压缩 len 字节最多需要的输出空间
+size_t snappy_max_compressed_length(size_t len);
+// 压缩 src 到 dst，dst 至少 snappy_max_compressed_length(len) 字节，返回压缩后长度
+size_t snappy_compress(const char *src, size_t len, char *dst);
+
+#endif
@@ -18,10 +18,105 @@
 #include "logger.h"
 #include "promhttp.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define HTTP_MAX_OPTIONS 8
+
 static struct MHD_Daemon *s_daemon = NULL;
+static struct MHD_Daemon *s_unix_daemon = NULL;
+static char *s_unix_path = NULL;
+
+// 填充 libmicrohttpd 选项，以 MHD_OPTION_END 结尾；pool 为 0 时不使用线程池
+static void fill_daemon_options(const http_service_cfg_t *cfg, int pool, struct MHD_OptionItem *opts)
+{
+	int n = 0;
+	int limit = cfg->connection_limit;
+
+	if (pool > 1) {
+		opts[n++] = (struct MHD_OptionItem){MHD_OPTION_THREAD_POOL_SIZE, pool, NULL};
+		// 连接数上限平分给各线程，不能小于线程数
+		if (limit > 0 && limit < pool)
+			limit = pool;
+	}
+	if (limit > 0)
+		opts[n++] = (struct MHD_OptionItem){MHD_OPTION_CONNECTION_LIMIT, limit, NULL};
+	if (cfg->per_ip_limit > 0)
+		opts[n++] = (struct MHD_OptionItem){MHD_OPTION_PER_IP_CONNECTION_LIMIT, cfg->per_ip_limit, NULL};
+	if (cfg->connection_timeout_s > 0)
+		opts[n++] = (struct MHD_OptionItem){MHD_OPTION_CONNECTION_TIMEOUT, cfg->connection_timeout_s, NULL};
+	opts[n] = (struct MHD_OptionItem){MHD_OPTION_END, 0, NULL};
+}
+
+static unsigned int daemon_flags(const http_service_cfg_t *cfg)
+{
+	return cfg->threads > 0 ? MHD_USE_EPOLL_INTERNAL_THREAD : MHD_USE_SELECT_INTERNALLY;
+}
+
+// 创建并监听 unix socket，已存在的同名 socket 文件会被替换
+static int listen_unix_socket(const char *path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	struct stat st;
+	int fd = -1;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		CPDS_LOG_ERROR("unix socket path too long: %s", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	// 上次退出时遗留的 socket 文件，其它类型的文件不删除
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		CPDS_LOG_ERROR("create unix socket fail - %s", strerror(errno));
+		return -1;
+	}
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || chmod(path, 0660) != 0 ||
+	    listen(fd, SOMAXCONN) != 0) {
+		CPDS_LOG_ERROR("listen on unix socket %s fail - %s", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int start_unix_daemon(const http_service_cfg_t *cfg)
+{
+	struct MHD_OptionItem opts[HTTP_MAX_OPTIONS];
+	int fd = listen_unix_socket(cfg->unix_socket);
+	if (fd < 0)
+		return -1;
+
+	// 同机抓取端数量少，不使用线程池
+	fill_daemon_options(cfg, 0, opts);
+	int n = 0;
+	while (opts[n].option != MHD_OPTION_END)
+		n++;
+	opts[n++] = (struct MHD_OptionItem){MHD_OPTION_LISTEN_SOCKET, fd, NULL};
+	opts[n] = (struct MHD_OptionItem){MHD_OPTION_END, 0, NULL};
+
+	s_unix_path = strdup(cfg->unix_socket);
+	s_unix_daemon = promhttp_start_daemon_with_options(daemon_flags(cfg), 0, NULL, NULL, opts);
+	if (s_unix_daemon == NULL) {
+		// 失败时 libmicrohttpd 可能已关闭传入的 socket，这里不再关闭，避免重复关闭
+		CPDS_LOG_ERROR("start http daemon on unix socket %s fail", cfg->unix_socket);
+		return -1;
+	}
+	return 0;
+}
 
-int start_http_service(int port)
+int start_http_service(const http_service_cfg_t *cfg)
 {
+	struct MHD_OptionItem opts[HTTP_MAX_OPTIONS];
+
 	if (s_daemon != NULL) {
 		CPDS_LOG_ERROR("Error: The http daemon is already running!");
 		return -1;
@@ -30,18 +125,48 @@ int start_http_service(int port)
 	// Set the active registry for the HTTP handler
 	promhttp_set_active_collector_registry(NULL);
 
+	// 多个抓取端同时抓取时共享渲染，渲染开销随时间而非抓取端数量增长
+	promhttp_set_render_coalescing(cfg->coalesce_scrapes != 0,
+	                               cfg->min_render_interval_ms > 0 ? cfg->min_render_interval_ms : 0);
+	promhttp_set_keep_alive(cfg->keep_alive != 0);
+
 	// start http s_daemon
-	s_daemon = promhttp_start_daemon(MHD_USE_SELECT_INTERNALLY, port, NULL, NULL);
+	// 使用 epoll 线程池时，慢速抓取端只占用一个连接，不会阻塞其它抓取端
+	fill_daemon_options(cfg, cfg->threads, opts);
+	s_daemon = promhttp_start_daemon_with_options(daemon_flags(cfg), cfg->port, NULL, NULL, opts);
 	if (s_daemon == NULL) {
 		CPDS_LOG_ERROR("start http daemon fail");
 		return -1;
 	}
+	CPDS_LOG_INFO("http service started. port=%d, threads=%d, connection limit=%d, per ip limit=%d, timeout=%ds",
+	              cfg->port, cfg->threads, cfg->connection_limit, cfg->per_ip_limit, cfg->connection_timeout_s);
+
+	if (cfg->unix_socket != NULL && cfg->unix_socket[0] != '\0') {
+		if (start_unix_daemon(cfg) != 0) {
+			stop_http_service();
+			return -1;
+		}
+		CPDS_LOG_INFO("http service listening on unix socket %s", cfg->unix_socket);
+	}
 
 	return 0;
 }
 
 void stop_http_service()
 {
-	if (s_daemon != NULL)
+	if (s_daemon != NULL) {
 		MHD_stop_daemon(s_daemon);
-}
\ No newline at end of file
+		s_daemon = NULL;
+	}
+	if (s_unix_daemon != NULL) {
+		// MHD_stop_daemon 会关闭监听 socket
+		MHD_stop_daemon(s_unix_daemon);
+		s_unix_daemon = NULL;
+	}
+	if (s_unix_path != NULL) {
+		unlink(s_unix_path);
+		free(s_unix_path);
+		s_unix_path = NULL;
+	}
+	promhttp_clear_render_cache();
+}
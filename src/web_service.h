@@ -17,7 +17,19 @@
 #ifndef _WEB_SERVICE_H_
 #define _WEB_SERVICE_H_
 
-int start_http_service(int port);
+typedef struct _http_service_cfg {
+	int port;                   // 监听端口
+	int coalesce_scrapes;       // 并发的全量抓取是否共享同一次渲染
+	int min_render_interval_ms; // 全量渲染结果的复用时间(ms)，0 表示只共享进行中的渲染
+	int threads;                // epoll 工作线程数，<=0 时使用单个 select 线程
+	int connection_limit;       // 最大并发连接数，<=0 时使用 libmicrohttpd 默认值
+	int per_ip_limit;           // 单个 IP 最大并发连接数，<=0 表示不限制
+	int connection_timeout_s;   // 连接空闲超时(s)，同时是 keep-alive 连接的保持时间，<=0 表示不超时
+	int keep_alive;             // 是否在请求之间保持连接
+	const char *unix_socket;    // unix socket 监听路径，供同机的抓取端使用，为空时不监听
+} http_service_cfg_t;
+
+int start_http_service(const http_service_cfg_t *cfg);
 
 void stop_http_service();
 